@@ -57,22 +57,31 @@
     ../../src/all/extern/imgui/imgui.h
     ../../src/all/extern/imgui/stb_truetype.h
     ../../src/all/frm/Framebuffer.h
+    ../../src/all/frm/FrameCapture.h
+    ../../src/all/frm/Benchmark.h
     ../../src/all/frm/RenderNodes.h
     ../../src/all/frm/Scene.h
     ../../src/all/frm/ShaderPreprocessor.h
+    ../../src/all/frm/ShaderCache.h
     ../../src/all/frm/Shader.h
     ../../src/all/frm/Input.h
     ../../src/all/frm/MeshData.h
     ../../src/all/frm/Resource.h
     ../../src/all/frm/math.h
     ../../src/all/frm/SkeletonAnimation.h
+    ../../src/all/frm/TextureArrayPool.h
     ../../src/all/frm/TextureAtlas.h
+    ../../src/all/frm/TextureCache.h
+    ../../src/all/frm/TextureCompressor.h
+    ../../src/all/frm/TextureTable.h
+    ../../src/all/frm/ThreadPool.h
     ../../src/all/frm/geom.h
     ../../src/all/frm/icon_fa.h
     ../../src/all/frm/App.h
     ../../src/all/frm/gl.h
     ../../src/all/frm/AppSample.h
     ../../src/all/frm/Mesh.h
+    ../../src/all/frm/MipGenerator.h
     ../../src/all/frm/Spline.h
     ../../src/all/frm/Texture.h
     ../../src/all/frm/ValueCurve.h
@@ -80,6 +89,7 @@
     ../../src/all/frm/LuaScript.h
     ../../src/all/frm/interpolation.h
     ../../src/all/frm/GlContext.h
+    ../../src/all/frm/GpuMemory.h
     ../../src/all/frm/Property.h
     ../../src/all/frm/Buffer.h
     ../../src/all/frm/Window.h
@@ -91,6 +101,7 @@
     ../../src/all/extern/lua/lua.hpp
     ../../src/all/frm/Shader.cpp
     ../../src/all/frm/GlContext.cpp
+    ../../src/all/frm/GpuMemory.cpp
     ../../src/all/frm/LuaScript.cpp
     ../../src/all/frm/Window.cpp
     ../../src/all/frm/Buffer.cpp
@@ -103,13 +114,23 @@
     ../../src/all/frm/AppSample.cpp
     ../../src/all/frm/Profiler.cpp
     ../../src/all/frm/ShaderPreprocessor.cpp
+    ../../src/all/frm/ShaderCache.cpp
     ../../src/all/frm/XForm.cpp
     ../../src/all/frm/Framebuffer.cpp
+    ../../src/all/frm/FrameCapture.cpp
+    ../../src/all/frm/Benchmark.cpp
     ../../src/all/frm/Texture.cpp
+    ../../src/all/frm/Texture_hdr.cpp
     ../../src/all/frm/App.cpp
     ../../src/all/frm/Input.cpp
+    ../../src/all/frm/TextureArrayPool.cpp
     ../../src/all/frm/TextureAtlas.cpp
+    ../../src/all/frm/TextureCache.cpp
+    ../../src/all/frm/TextureCompressor.cpp
+    ../../src/all/frm/TextureTable.cpp
+    ../../src/all/frm/ThreadPool.cpp
     ../../src/all/frm/Mesh.cpp
+    ../../src/all/frm/MipGenerator.cpp
     ../../src/all/frm/Resource.cpp
     ../../src/all/frm/Scene.cpp
     ../../src/all/frm/Spline.cpp
@@ -236,22 +257,31 @@ function(project_framework_Debug_Linux64)
     ../../src/all/extern/imgui/imgui.h
     ../../src/all/extern/imgui/stb_truetype.h
     ../../src/all/frm/Framebuffer.h
+    ../../src/all/frm/FrameCapture.h
+    ../../src/all/frm/Benchmark.h
     ../../src/all/frm/RenderNodes.h
     ../../src/all/frm/Scene.h
     ../../src/all/frm/ShaderPreprocessor.h
+    ../../src/all/frm/ShaderCache.h
     ../../src/all/frm/Shader.h
     ../../src/all/frm/Input.h
     ../../src/all/frm/MeshData.h
     ../../src/all/frm/Resource.h
     ../../src/all/frm/math.h
     ../../src/all/frm/SkeletonAnimation.h
+    ../../src/all/frm/TextureArrayPool.h
     ../../src/all/frm/TextureAtlas.h
+    ../../src/all/frm/TextureCache.h
+    ../../src/all/frm/TextureCompressor.h
+    ../../src/all/frm/TextureTable.h
+    ../../src/all/frm/ThreadPool.h
     ../../src/all/frm/geom.h
     ../../src/all/frm/icon_fa.h
     ../../src/all/frm/App.h
     ../../src/all/frm/gl.h
     ../../src/all/frm/AppSample.h
     ../../src/all/frm/Mesh.h
+    ../../src/all/frm/MipGenerator.h
     ../../src/all/frm/Spline.h
     ../../src/all/frm/Texture.h
     ../../src/all/frm/ValueCurve.h
@@ -259,6 +289,7 @@ function(project_framework_Debug_Linux64)
     ../../src/all/frm/LuaScript.h
     ../../src/all/frm/interpolation.h
     ../../src/all/frm/GlContext.h
+    ../../src/all/frm/GpuMemory.h
     ../../src/all/frm/Property.h
     ../../src/all/frm/Buffer.h
     ../../src/all/frm/Window.h
@@ -270,6 +301,7 @@ function(project_framework_Debug_Linux64)
     ../../src/all/extern/lua/lua.hpp
     ../../src/all/frm/Shader.cpp
     ../../src/all/frm/GlContext.cpp
+    ../../src/all/frm/GpuMemory.cpp
     ../../src/all/frm/LuaScript.cpp
     ../../src/all/frm/Window.cpp
     ../../src/all/frm/Buffer.cpp
@@ -282,13 +314,23 @@ function(project_framework_Debug_Linux64)
     ../../src/all/frm/AppSample.cpp
     ../../src/all/frm/Profiler.cpp
     ../../src/all/frm/ShaderPreprocessor.cpp
+    ../../src/all/frm/ShaderCache.cpp
     ../../src/all/frm/XForm.cpp
     ../../src/all/frm/Framebuffer.cpp
+    ../../src/all/frm/FrameCapture.cpp
+    ../../src/all/frm/Benchmark.cpp
     ../../src/all/frm/Texture.cpp
+    ../../src/all/frm/Texture_hdr.cpp
     ../../src/all/frm/App.cpp
     ../../src/all/frm/Input.cpp
+    ../../src/all/frm/TextureArrayPool.cpp
     ../../src/all/frm/TextureAtlas.cpp
+    ../../src/all/frm/TextureCache.cpp
+    ../../src/all/frm/TextureCompressor.cpp
+    ../../src/all/frm/TextureTable.cpp
+    ../../src/all/frm/ThreadPool.cpp
     ../../src/all/frm/Mesh.cpp
+    ../../src/all/frm/MipGenerator.cpp
     ../../src/all/frm/Resource.cpp
     ../../src/all/frm/Scene.cpp
     ../../src/all/frm/Spline.cpp
@@ -408,22 +450,31 @@ function(project_framework_Release_Win64)
     ../../src/all/extern/imgui/imgui.h
     ../../src/all/extern/imgui/stb_truetype.h
     ../../src/all/frm/Framebuffer.h
+    ../../src/all/frm/FrameCapture.h
+    ../../src/all/frm/Benchmark.h
     ../../src/all/frm/RenderNodes.h
     ../../src/all/frm/Scene.h
     ../../src/all/frm/ShaderPreprocessor.h
+    ../../src/all/frm/ShaderCache.h
     ../../src/all/frm/Shader.h
     ../../src/all/frm/Input.h
     ../../src/all/frm/MeshData.h
     ../../src/all/frm/Resource.h
     ../../src/all/frm/math.h
     ../../src/all/frm/SkeletonAnimation.h
+    ../../src/all/frm/TextureArrayPool.h
     ../../src/all/frm/TextureAtlas.h
+    ../../src/all/frm/TextureCache.h
+    ../../src/all/frm/TextureCompressor.h
+    ../../src/all/frm/TextureTable.h
+    ../../src/all/frm/ThreadPool.h
     ../../src/all/frm/geom.h
     ../../src/all/frm/icon_fa.h
     ../../src/all/frm/App.h
     ../../src/all/frm/gl.h
     ../../src/all/frm/AppSample.h
     ../../src/all/frm/Mesh.h
+    ../../src/all/frm/MipGenerator.h
     ../../src/all/frm/Spline.h
     ../../src/all/frm/Texture.h
     ../../src/all/frm/ValueCurve.h
@@ -431,6 +482,7 @@ function(project_framework_Release_Win64)
     ../../src/all/frm/LuaScript.h
     ../../src/all/frm/interpolation.h
     ../../src/all/frm/GlContext.h
+    ../../src/all/frm/GpuMemory.h
     ../../src/all/frm/Property.h
     ../../src/all/frm/Buffer.h
     ../../src/all/frm/Window.h
@@ -442,6 +494,7 @@ function(project_framework_Release_Win64)
     ../../src/all/extern/lua/lua.hpp
     ../../src/all/frm/Shader.cpp
     ../../src/all/frm/GlContext.cpp
+    ../../src/all/frm/GpuMemory.cpp
     ../../src/all/frm/LuaScript.cpp
     ../../src/all/frm/Window.cpp
     ../../src/all/frm/Buffer.cpp
@@ -454,13 +507,23 @@ function(project_framework_Release_Win64)
     ../../src/all/frm/AppSample.cpp
     ../../src/all/frm/Profiler.cpp
     ../../src/all/frm/ShaderPreprocessor.cpp
+    ../../src/all/frm/ShaderCache.cpp
     ../../src/all/frm/XForm.cpp
     ../../src/all/frm/Framebuffer.cpp
+    ../../src/all/frm/FrameCapture.cpp
+    ../../src/all/frm/Benchmark.cpp
     ../../src/all/frm/Texture.cpp
+    ../../src/all/frm/Texture_hdr.cpp
     ../../src/all/frm/App.cpp
     ../../src/all/frm/Input.cpp
+    ../../src/all/frm/TextureArrayPool.cpp
     ../../src/all/frm/TextureAtlas.cpp
+    ../../src/all/frm/TextureCache.cpp
+    ../../src/all/frm/TextureCompressor.cpp
+    ../../src/all/frm/TextureTable.cpp
+    ../../src/all/frm/ThreadPool.cpp
     ../../src/all/frm/Mesh.cpp
+    ../../src/all/frm/MipGenerator.cpp
     ../../src/all/frm/Resource.cpp
     ../../src/all/frm/Scene.cpp
     ../../src/all/frm/Spline.cpp
@@ -585,22 +648,31 @@ function(project_framework_Release_Linux64)
     ../../src/all/extern/imgui/imgui.h
     ../../src/all/extern/imgui/stb_truetype.h
     ../../src/all/frm/Framebuffer.h
+    ../../src/all/frm/FrameCapture.h
+    ../../src/all/frm/Benchmark.h
     ../../src/all/frm/RenderNodes.h
     ../../src/all/frm/Scene.h
     ../../src/all/frm/ShaderPreprocessor.h
+    ../../src/all/frm/ShaderCache.h
     ../../src/all/frm/Shader.h
     ../../src/all/frm/Input.h
     ../../src/all/frm/MeshData.h
     ../../src/all/frm/Resource.h
     ../../src/all/frm/math.h
     ../../src/all/frm/SkeletonAnimation.h
+    ../../src/all/frm/TextureArrayPool.h
     ../../src/all/frm/TextureAtlas.h
+    ../../src/all/frm/TextureCache.h
+    ../../src/all/frm/TextureCompressor.h
+    ../../src/all/frm/TextureTable.h
+    ../../src/all/frm/ThreadPool.h
     ../../src/all/frm/geom.h
     ../../src/all/frm/icon_fa.h
     ../../src/all/frm/App.h
     ../../src/all/frm/gl.h
     ../../src/all/frm/AppSample.h
     ../../src/all/frm/Mesh.h
+    ../../src/all/frm/MipGenerator.h
     ../../src/all/frm/Spline.h
     ../../src/all/frm/Texture.h
     ../../src/all/frm/ValueCurve.h
@@ -608,6 +680,7 @@ function(project_framework_Release_Linux64)
     ../../src/all/frm/LuaScript.h
     ../../src/all/frm/interpolation.h
     ../../src/all/frm/GlContext.h
+    ../../src/all/frm/GpuMemory.h
     ../../src/all/frm/Property.h
     ../../src/all/frm/Buffer.h
     ../../src/all/frm/Window.h
@@ -619,6 +692,7 @@ function(project_framework_Release_Linux64)
     ../../src/all/extern/lua/lua.hpp
     ../../src/all/frm/Shader.cpp
     ../../src/all/frm/GlContext.cpp
+    ../../src/all/frm/GpuMemory.cpp
     ../../src/all/frm/LuaScript.cpp
     ../../src/all/frm/Window.cpp
     ../../src/all/frm/Buffer.cpp
@@ -631,13 +705,23 @@ function(project_framework_Release_Linux64)
     ../../src/all/frm/AppSample.cpp
     ../../src/all/frm/Profiler.cpp
     ../../src/all/frm/ShaderPreprocessor.cpp
+    ../../src/all/frm/ShaderCache.cpp
     ../../src/all/frm/XForm.cpp
     ../../src/all/frm/Framebuffer.cpp
+    ../../src/all/frm/FrameCapture.cpp
+    ../../src/all/frm/Benchmark.cpp
     ../../src/all/frm/Texture.cpp
+    ../../src/all/frm/Texture_hdr.cpp
     ../../src/all/frm/App.cpp
     ../../src/all/frm/Input.cpp
+    ../../src/all/frm/TextureArrayPool.cpp
     ../../src/all/frm/TextureAtlas.cpp
+    ../../src/all/frm/TextureCache.cpp
+    ../../src/all/frm/TextureCompressor.cpp
+    ../../src/all/frm/TextureTable.cpp
+    ../../src/all/frm/ThreadPool.cpp
     ../../src/all/frm/Mesh.cpp
+    ../../src/all/frm/MipGenerator.cpp
     ../../src/all/frm/Resource.cpp
     ../../src/all/frm/Scene.cpp
     ../../src/all/frm/Spline.cpp
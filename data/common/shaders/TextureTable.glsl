@@ -0,0 +1,20 @@
+#ifndef TextureTable_glsl
+#define TextureTable_glsl
+
+// See frm/TextureTable.h. Use TextureTable_Get(index) as a sampler2D, e.g. texture(TextureTable_Get(i), uv).
+// Texture_BINDLESS is defined by the application if bindless textures are enabled, else the index must be
+// dynamically uniform and < TextureTable_kFallbackCount.
+
+#ifdef Texture_BINDLESS
+	layout(std430) readonly buffer _bfTextureTable
+	{
+		uvec2 uTextureTable[];
+	};
+	#define TextureTable_Get(_index) sampler2D(uTextureTable[_index])
+#else
+	#define TextureTable_kFallbackCount 16
+	uniform sampler2D uTextureTable[TextureTable_kFallbackCount];
+	#define TextureTable_Get(_index) uTextureTable[_index]
+#endif
+
+#endif // TextureTable_glsl
@@ -3,13 +3,20 @@
 #include <frm/icon_fa.h>
 #include <frm/math.h>
 #include <frm/App.h>
+#include <frm/Benchmark.h>
 #include <frm/Framebuffer.h>
+#include <frm/FrameCapture.h>
 #include <frm/GlContext.h>
+#include <frm/GpuMemory.h>
 #include <frm/Input.h>
 #include <frm/Mesh.h>
 #include <frm/Profiler.h>
 #include <frm/Shader.h>
+#include <frm/ShaderCache.h>
+#include <frm/ShaderPreprocessor.h>
 #include <frm/Texture.h>
+#include <frm/TextureCache.h>
+#include <frm/ThreadPool.h>
 #include <frm/Window.h>
 #include <frm/ui/Log.h>
 
@@ -20,6 +27,7 @@
 
 #include <imgui/imgui.h>
 
+#include <cstdlib>
 #include <cstring>
 
 using namespace frm;
@@ -63,6 +71,15 @@ bool AppSample::init(const apt::ArgList& _args)
 	m_propsPath.setf("%s.json", (const char*)m_name);
 	readProps(m_propsPath);
 
+ // benchmark: the workload mustn't depend on the saved UI state
+	if (_args.find("benchmark")) {
+		m_benchmark = Benchmark::Create(_args);
+		if (!m_benchmark) {
+			return false;
+		}
+		m_showMenu = m_showLog = m_showPropertyEditor = m_showProfilerViewer = m_showTextureViewer = m_showShaderViewer = false;
+	}
+
  // init the app
 	PropertyGroup* propGroup;
 	APT_VERIFY(propGroup = m_props.findGroup("AppSample"));
@@ -71,7 +88,34 @@ bool AppSample::init(const apt::ArgList& _args)
 	ivec2* glVersion = (ivec2*)propGroup->find("GlVersion")->getData();
 	bool* glCompatibility = (bool*)propGroup->find("GlCompatibility")->getData();
 	m_glContext = GlContext::Create(m_window, glVersion->x, glVersion->y, *glCompatibility);
-	m_glContext->setVsync((GlContext::Vsync)(m_vsyncMode - 1));
+	m_glContext->setVsync(m_benchmark ? GlContext::Vsync_Off : (GlContext::Vsync)(m_vsyncMode - 1));
+	if (m_shaderCacheSizeMb > 0) {
+		FileSystem::MakePath(m_shaderCachePath, "ShaderCache.bin", FileSystem::RootType_Application);
+		ShaderCache::Init(m_shaderCachePath, (uint64)m_shaderCacheSizeMb * 1024 * 1024);
+	}
+	ThreadPool::Init();
+	if (m_textureCache) {
+		FileSystem::MakePath(m_textureCachePath, "TextureCache", FileSystem::RootType_Application);
+		TextureCache::Init(m_textureCachePath);
+	}
+	Texture::InitStreaming();
+	Texture::SetMipStreamingBudget((GLsizeiptr)m_mipBudgetMb * 1024 * 1024);
+	Texture::SetCompressOnLoad(m_compressTextures);
+	Texture::SetSrgbOnLoad(m_srgbTextures);
+	Texture::SetBindless(m_bindlessTextures);
+	GpuMemory::SetBudget((GLsizeiptr)m_gpuBudgetMb * 1024 * 1024);
+	if (_args.find("capture")) {
+		m_frameCaptureEnabled = true;
+	}
+	const auto* profilerCaptureArg = _args.find("profilerCapture");
+	if (profilerCaptureArg) {
+		if (profilerCaptureArg->getValueCount() > 0) {
+			m_profilerCapturePath.set(profilerCaptureArg->getValue(0));
+		} else {
+			FileSystem::MakePath(m_profilerCapturePath, "Profiler.bin", FileSystem::RootType_Application);
+		}
+		Profiler::BeginCapture(m_profilerCapturePath);
+	}
 	FileSystem::MakePath(m_imguiIniPath, "imgui.ini", FileSystem::RootType_Application);
 	ImGui::GetIO().IniFilename = (const char*)m_imguiIniPath;
 	if (!ImGui_Init()) {
@@ -83,6 +127,13 @@ bool AppSample::init(const apt::ArgList& _args)
 	m_resolution.x = m_resolutionProp.x == -1 ? m_windowSize.x : m_resolutionProp.x;
 	m_resolution.y = m_resolutionProp.y == -1 ? m_windowSize.y : m_resolutionProp.y;
 
+	if (m_benchmark) {
+	 // the window is never shown (the context may be headless), draw overlays offscreen
+		m_txBenchmark = Texture::Create2d(m_windowSize.x, m_windowSize.y, GL_RGBA8);
+		m_fbBenchmark = Framebuffer::Create(1, m_txBenchmark);
+		m_fbDefault = m_fbBenchmark;
+	}
+
  // set ImGui callbacks
  // \todo poll input directly = easier to use proxy devices
 	Window::Callbacks cb = m_window->getCallbacks();
@@ -92,8 +143,9 @@ bool AppSample::init(const apt::ArgList& _args)
 	cb.m_OnChar = ImGui_OnChar;
 	m_window->setCallbacks(cb);
 
-
-	m_window->show();
+	if (!m_benchmark) {
+		m_window->show();
+	}
 
  // splash screen
 	APT_VERIFY(AppSample::update());
@@ -122,6 +174,22 @@ bool AppSample::init(const apt::ArgList& _args)
 void AppSample::shutdown()
 {	
 	ImGui_Shutdown();
+	m_frameCaptureEnabled = false;
+	updateFrameCapture(); // wait for pending frames
+	Profiler::EndCapture(); // before ThreadPool::Shutdown()
+	if (m_fbBenchmark) {
+		if (m_fbDefault == m_fbBenchmark) {
+			m_fbDefault = nullptr;
+		}
+		Framebuffer::Destroy(m_fbBenchmark);
+		Texture::Release(m_txBenchmark);
+	}
+	GpuMemory::Flush(); // before ShutdownStreaming(), cached textures may reference a stream
+	Texture::ShutdownStreaming();
+	TextureCache::Shutdown();
+	ShaderCache::Shutdown();
+	ShaderPreprocessor::ClearCache();
+	ThreadPool::Shutdown();
 	
 	if (m_glContext) {
 		GlContext::Destroy(m_glContext);
@@ -130,17 +198,107 @@ void AppSample::shutdown()
 		Window::Destroy(m_window);
 	}
 	
-	writeProps(m_propsPath);
+	if (m_benchmark) {
+		Benchmark::Destroy(m_benchmark); // props aren't written, the UI state was overridden
+	} else {
+		writeProps(m_propsPath);
+	}
 
 	App::shutdown();
 }
 
+bool AppSample::precook(const apt::ArgList& _args)
+{
+	const auto* precookArg = _args.find("precook");
+	if (!precookArg || precookArg->getValueCount() == 0) {
+		return false;
+	}
+
+	FileSystem::SetRoot(FileSystem::RootType_Common, "common");
+	FileSystem::SetRoot(FileSystem::RootType_Application, (const char*)m_name);
+	m_propsPath.setf("%s.json", (const char*)m_name);
+	readProps(m_propsPath);
+
+	ThreadPool::Init();
+	FileSystem::MakePath(m_textureCachePath, "TextureCache", FileSystem::RootType_Application);
+	bool ret = TextureCache::Init(m_textureCachePath);
+	if (ret) {
+	 // flags must match those used by Texture::reload() (sync) and Texture::Stream::decode() (async)
+		const uint32 asyncFlags = TextureCache::Flag_Mips | (m_compressTextures ? TextureCache::Flag_Compress : 0) | (m_srgbTextures ? TextureCache::Flag_Srgb : 0);
+		for (int i = 0; ret && i < (int)precookArg->getValueCount(); ++i) {
+			const char* dir = precookArg->getValue(i);
+			ret = TextureCache::Precook(dir, 0) >= 0 && TextureCache::Precook(dir, asyncFlags) >= 0;
+		}
+		TextureCache::LogReport();
+		TextureCache::Shutdown();
+	}
+	ThreadPool::Shutdown();
+	return ret;
+}
+
+bool AppSample::convertProfilerCapture(const apt::ArgList& _args)
+{
+	const auto* convertArg = _args.find("profilerConvert");
+	if (!convertArg || convertArg->getValueCount() == 0) {
+		return false;
+	}
+	const char* src = convertArg->getValue(0);
+	FileSystem::PathStr dst;
+	if (convertArg->getValueCount() > 1) {
+		dst.set(convertArg->getValue(1));
+	} else {
+		const char* ext = strrchr(src, '.');
+		if (ext && !strpbrk(ext, "/\\")) {
+			dst.set(src, ext - src);
+		} else {
+			dst.set(src);
+		}
+		dst.append(".json");
+	}
+	return Profiler::ConvertCapture(src, dst);
+}
+
+bool AppSample::compareBenchmark(const apt::ArgList& _args)
+{
+	const auto* compareArg = _args.find("benchmarkCompare");
+	if (!compareArg || compareArg->getValueCount() < 2) {
+		return false;
+	}
+	float tolerance = 0.05f;
+	const auto* toleranceArg = _args.find("benchmarkTolerance");
+	if (toleranceArg && toleranceArg->getValueCount() > 0) {
+		tolerance = (float)APT_MAX(atof(toleranceArg->getValue(0)), 0.0);
+	}
+	Benchmark::Report report, baseline;
+	return Benchmark::ReadReport(report, compareArg->getValue(0))
+		&& Benchmark::ReadReport(baseline, compareArg->getValue(1))
+		&& Benchmark::Compare(report, baseline, tolerance);
+}
+
 bool AppSample::update()
 {
 	App::update();
 
 	CPU_AUTO_MARKER("AppSample::update");
 
+	if (m_benchmark) {
+		m_deltaTime = m_benchmark->getTimestep() * m_timeScale;
+		if (!m_benchmark->update()) {
+			m_exitCode = m_benchmark->getResult() ? 0 : 1;
+			return false;
+		}
+	}
+
+	if (m_frameIndex == 1) {
+	 // first frame after init(), startup shaders/textures are loaded
+		ShaderCache::LogReport();
+		TextureCache::LogReport();
+	}
+	Shader::Update();
+	Texture::Update();
+	GpuMemory::Update();
+	updateFrameCapture();
+
 	if (!m_window->pollEvents()) { // dispatches callbacks to ImGui
 		return false;
 	}
@@ -169,7 +327,7 @@ bool AppSample::update()
 	}
 	if (keyboard->wasPressed(Keyboard::Key_F9)) {
 		m_glContext->setShader(0);
-		Shader::ReloadAll();
+		Shader::ReloadChanged();
 	}
 
 	if (ImGui::IsKeyPressed(Keyboard::Key_P) && ImGui::IsKeyDown(Keyboard::Key_LCtrl)) {
@@ -297,6 +455,11 @@ bool AppSample::update()
 
 void AppSample::draw()
 {
+	if (m_frameCapture) {
+	 // before the UI is drawn
+		CPU_AUTO_MARKER("FrameCapture::capture");
+		m_frameCapture->capture(m_frameIndex, m_fbDefault, m_windowSize.x, m_windowSize.y);
+	}
 	m_glContext->setFramebufferAndViewport(m_fbDefault);
 	ImGui::GetIO().UserData = m_glContext;
 	ImGui::Render();
@@ -322,6 +485,11 @@ AppSample::AppSample(const char* _name)
 	, m_glContext(nullptr)
 	, m_frameIndex(0)
 	, m_fbDefault(nullptr)
+	, m_frameCapture(nullptr)
+	, m_benchmark(nullptr)
+	, m_fbBenchmark(nullptr)
+	, m_txBenchmark(nullptr)
+	, m_exitCode(0)
 {
 	APT_ASSERT(g_current == 0); // don't support multiple apps (yet)
 	g_current = this;
@@ -337,6 +505,16 @@ AppSample::AppSample(const char* _name)
 	propGroup.addBool("Show Profiler",         false,                                              &m_showProfilerViewer);
 	propGroup.addBool("Show Texture Viewer",   false,                                              &m_showTextureViewer);
 	propGroup.addBool("Show Shader Viewer",    false,                                              &m_showShaderViewer);
+	propGroup.addInt ("Shader Cache Size Mb",  64,            0,      1024,                        &m_shaderCacheSizeMb);
+	propGroup.addInt ("Mip Budget Mb",         512,           0,      8192,                        &m_mipBudgetMb);
+	propGroup.addBool("Compress Textures",     false,                                              &m_compressTextures);
+	propGroup.addBool("sRGB Textures",         false,                                              &m_srgbTextures);
+	propGroup.addBool("Texture Cache",         true,                                               &m_textureCache);
+	propGroup.addBool("Bindless Textures",     false,                                              &m_bindlessTextures);
+	propGroup.addInt ("Gpu Budget Mb",         512,           0,      16384,                       &m_gpuBudgetMb);
+	propGroup.addBool("Frame Capture",         false,                                              &m_frameCaptureEnabled);
+	propGroup.addInt ("Frame Capture Format",  0,             0,      (int)FrameCapture::Format_Count - 1, &m_frameCaptureFormat);
+	propGroup.addInt ("Frame Capture Mb",      256,           16,     4096,                        &m_frameCaptureQueueMb);
 
 	propGroup.addInt2("GlVersion",             ivec2(4, 5),   1,      5);
 	propGroup.addBool("GlCompatibility",       false);
@@ -370,6 +548,22 @@ bool AppSample::writeProps(const char* _path, apt::FileSystem::RootType _rootHin
 
 // PRIVATE
 
+void AppSample::updateFrameCapture()
+{
+	if (m_frameCaptureEnabled && !m_frameCapture) {
+		FileSystem::MakePath(m_frameCapturePath, "Capture", FileSystem::RootType_Application);
+		m_frameCapture = FrameCapture::Create(m_frameCapturePath, (FrameCapture::Format)m_frameCaptureFormat, (GLsizeiptr)m_frameCaptureQueueMb * 1024 * 1024);
+		m_frameCaptureEnabled = m_frameCapture != nullptr;
+	} else if (!m_frameCaptureEnabled && m_frameCapture) {
+		m_frameCapture->flush();
+		m_frameCapture->logReport();
+		FrameCapture::Destroy(m_frameCapture);
+	}
+	if (m_frameCapture) {
+		m_frameCapture->update();
+	}
+}
+
 /*******************************************************************************
 
                                    ImGui
@@ -31,6 +31,22 @@ public:
 
 	virtual void        drawMainMenuBar()             {}
 	virtual void        drawStatusBar()               {}
+
+	// Batch mode, cook the textures in each directory passed via -precook to the texture cache (as loaded by
+	// Texture::Create(), sync and async) and return. Doesn't create a window or GL context, call instead of 
+	// init(). Return false if -precook wasn't passed or a directory couldn't be read.
+	bool                precook(const apt::ArgList& _args);
+
+	// Batch mode, convert a profiler capture (see Profiler::BeginCapture(), -profilerCapture) to Chrome trace JSON
+	// and return, e.g. -profilerConvert Profiler.bin [Profiler.json]. If the destination isn't passed the source
+	// extension is replaced. Call instead of init(). Return false if -profilerConvert wasn't passed or the conversion
+	// failed.
+	bool                convertProfilerCapture(const apt::ArgList& _args);
+
+	// Batch mode, compare a benchmark report with a baseline (see Benchmark) and return, e.g.
+	// -benchmarkCompare Benchmark.json Baseline.json [-benchmarkTolerance 0.05]. Call instead of init(). Return false
+	// if -benchmarkCompare wasn't passed, a report couldn't be read or there are regressions.
+	bool                compareBenchmark(const apt::ArgList& _args);
 	
 	void                drawNdcQuad();
 	
@@ -45,6 +61,12 @@ public:
 
 	uint                getFrameIndex() const         { return m_frameIndex; }
 
+	// Non-null if -benchmark was passed to init(). The window isn't shown, overlays are drawn to an offscreen
+	// framebuffer, vsync is off, the delta time is fixed and update() returns false when the run is complete.
+	Benchmark*          getBenchmark()                { return m_benchmark; }
+	// Non-zero if the benchmark failed or regressed, valid after update() returns false.
+	int                 getExitCode() const           { return m_exitCode; }
+
 protected:		
 	typedef apt::FileSystem::PathStr PathStr;
 
@@ -81,7 +103,30 @@ private:
 	bool               m_showTextureViewer;
 	bool               m_showShaderViewer;
 
+	int                m_shaderCacheSizeMb; // 0 disables the program binary cache
+	int                m_mipBudgetMb;       // 0 disables mip streaming
+	bool               m_compressTextures;  // block compress async texture loads
+	bool               m_srgbTextures;      // async loads of 8-bit color images are sRGB (see Texture::SetSrgbOnLoad())
+	bool               m_textureCache;      // read/write cooked textures (see TextureCache)
+	bool               m_bindlessTextures;  // use GL_ARB_bindless_texture if supported (see TextureTable)
+	int                m_gpuBudgetMb;       // released textures/meshes are cached until this is exceeded, 0 disables (see GpuMemory)
+	bool               m_frameCaptureEnabled; // write every frame to <app>/Capture (see FrameCapture), also enabled via -capture, reset on shutdown
+	int                m_frameCaptureFormat;  // FrameCapture::Format
+	int                m_frameCaptureQueueMb; // frames are dropped if the readback/encode queue exceeds this
+	FrameCapture*      m_frameCapture;
+	Benchmark*         m_benchmark;
+	Framebuffer*       m_fbBenchmark;           // offscreen default framebuffer when benchmarking
+	Texture*           m_txBenchmark;
+	int                m_exitCode;
+	apt::FileSystem::PathStr m_frameCapturePath;
+	apt::FileSystem::PathStr m_profilerCapturePath; // stream profiler markers here, set via -profilerCapture [path] (default <app>/Profiler.bin)
+	apt::FileSystem::PathStr m_shaderCachePath;
+	apt::FileSystem::PathStr m_textureCachePath;
+
 	apt::FileSystem::PathStr m_imguiIniPath;
+	// Create/destroy m_frameCapture according to m_frameCaptureEnabled, dispatch completed frames.
+	void updateFrameCapture();
+
 	static bool ImGui_Init();
 	static void ImGui_InitStyle();
 	static void ImGui_Shutdown();
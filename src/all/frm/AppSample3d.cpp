@@ -3,6 +3,7 @@
 #include <frm/def.h>
 #include <frm/gl.h>
 #include <frm/geom.h>
+#include <frm/Benchmark.h>
 #include <frm/GlContext.h>
 #include <frm/Input.h>
 #include <frm/Mesh.h>
@@ -83,6 +84,18 @@ bool AppSample3d::update()
 		}
 	}
 
+ // benchmark: the camera path overrides the draw camera's xforms
+	Benchmark* benchmark = getBenchmark();
+	if (benchmark && benchmark->hasCameraPath()) {
+		mat4 world = benchmark->getCameraMatrix();
+		if (currentCamera->m_parent) {
+			currentCamera->m_parent->setWorldMatrix(world);
+		} else {
+			currentCamera->m_world = world;
+		}
+		currentCamera->update();
+	}
+
  // keyboard shortcuts
 	Keyboard* keyb = Input::GetKeyboard();
 	if (keyb->wasPressed(Keyboard::Key_F2)) {
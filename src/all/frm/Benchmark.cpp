@@ -0,0 +1,317 @@
+#include <frm/Benchmark.h>
+
+#include <frm/Profiler.h>
+
+#include <apt/log.h>
+#include <apt/ArgList.h>
+#include <apt/Json.h>
+#include <apt/Time.h>
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace frm;
+using namespace apt;
+
+static const float kMinRegressionMs = 0.01f; // Ignore duration regressions smaller than this (timer noise).
+
+static void ToStat(const Profiler::MarkerStats& _stats, double _scale, Benchmark::Stat& stat_)
+{
+	stat_.m_name.set(_stats.m_name);
+	stat_.m_count    = (int)_stats.m_count;
+	stat_.m_perFrame = (float)((double)_stats.m_perFrame * _scale);
+	stat_.m_min      = (float)((double)_stats.m_min * _scale);
+	stat_.m_mean     = (float)((double)_stats.m_mean * _scale);
+	stat_.m_p50      = (float)((double)_stats.m_p50 * _scale);
+	stat_.m_p95      = (float)((double)_stats.m_p95 * _scale);
+	stat_.m_p99      = (float)((double)_stats.m_p99 * _scale);
+	stat_.m_max      = (float)((double)_stats.m_max * _scale);
+}
+
+static void SerializeStatList(const char* _name, eastl::vector<Benchmark::Stat>& _list_, JsonSerializer& _serializer_)
+{
+	if (_serializer_.getMode() == JsonSerializer::Mode_Read) {
+		_list_.clear();
+		if (_serializer_.beginArray(_name)) {
+			while (_serializer_.beginObject()) {
+				_list_.push_back();
+				_list_.back().serialize(_serializer_);
+				_serializer_.endObject();
+			}
+			_serializer_.endArray();
+		}
+	} else {
+		_serializer_.beginArray(_name);
+		for (auto& stat : _list_) {
+			_serializer_.beginObject();
+			stat.serialize(_serializer_);
+			_serializer_.endObject();
+		}
+		_serializer_.endArray();
+	}
+}
+
+static const Benchmark::Stat* FindStat(const eastl::vector<Benchmark::Stat>& _list, const char* _name)
+{
+	for (auto& stat : _list) {
+		if (strcmp(stat.m_name, _name) == 0) {
+			return &stat;
+		}
+	}
+	return nullptr;
+}
+
+// Return true if _value regresses relative to _baseline, log the regression.
+static bool CheckRegression(const char* _group, const char* _name, const char* _field, float _value, float _baseline, float _tolerance, float _minDelta)
+{
+	if (_value <= _baseline * (1.0f + _tolerance) || _value - _baseline <= _minDelta) {
+		return false;
+	}
+	APT_LOG_ERR("Benchmark: Regression %s '%s' %s %.3f -> %.3f (+%.1f%%)",
+		_group,
+		_name,
+		_field,
+		_baseline,
+		_value,
+		_baseline > 0.0f ? (_value / _baseline - 1.0f) * 100.0f : 100.0f
+		);
+	return true;
+}
+
+static int CompareStatList(const char* _group, const eastl::vector<Benchmark::Stat>& _list, const eastl::vector<Benchmark::Stat>& _baseline, float _tolerance, float _minDelta)
+{
+	int ret = 0;
+	for (auto& baseline : _baseline) {
+		const Benchmark::Stat* stat = FindStat(_list, baseline.m_name);
+		if (stat) {
+			ret += CheckRegression(_group, stat->m_name, "per frame", stat->m_perFrame, baseline.m_perFrame, _tolerance, _minDelta) ? 1 : 0;
+		}
+	}
+	return ret;
+}
+
+/*******************************************************************************
+
+                                 Benchmark
+
+*******************************************************************************/
+
+// PUBLIC
+
+bool Benchmark::Stat::serialize(JsonSerializer& _serializer_)
+{
+	_serializer_.value("Name",     (StringBase&)m_name);
+	_serializer_.value("Count",    m_count);
+	_serializer_.value("PerFrame", m_perFrame);
+	_serializer_.value("Min",      m_min);
+	_serializer_.value("Mean",     m_mean);
+	_serializer_.value("P50",      m_p50);
+	_serializer_.value("P95",      m_p95);
+	_serializer_.value("P99",      m_p99);
+	_serializer_.value("Max",      m_max);
+	return true;
+}
+
+bool Benchmark::Report::serialize(JsonSerializer& _serializer_)
+{
+	_serializer_.value("FrameCount",  m_frameCount);
+	_serializer_.value("WarmupCount", m_warmupCount);
+	_serializer_.value("Timestep",    m_timestep);
+	if (_serializer_.beginObject("CpuFrame")) {
+		m_cpuFrame.serialize(_serializer_);
+		_serializer_.endObject();
+	}
+	if (_serializer_.beginObject("GpuFrame")) {
+		m_gpuFrame.serialize(_serializer_);
+		_serializer_.endObject();
+	}
+	SerializeStatList("CpuMarkers", m_cpuMarkers, _serializer_);
+	SerializeStatList("GpuMarkers", m_gpuMarkers, _serializer_);
+	SerializeStatList("Counters",   m_counters,   _serializer_);
+	return true;
+}
+
+Benchmark* Benchmark::Create(const apt::ArgList& _args)
+{
+	Benchmark* ret = new Benchmark;
+
+	const auto* arg = _args.find("benchmark");
+	if (arg && arg->getValueCount() > 0) {
+		ret->m_frameCount = APT_MAX(atoi(arg->getValue(0)), 1);
+	}
+	arg = _args.find("benchmarkWarmup");
+	if (arg && arg->getValueCount() > 0) {
+		ret->m_warmupCount = APT_MAX(atoi(arg->getValue(0)), 0);
+	}
+	arg = _args.find("benchmarkTimestep");
+	if (arg && arg->getValueCount() > 0) {
+		ret->m_timestep = APT_MAX(atof(arg->getValue(0)), 0.0);
+	}
+	arg = _args.find("benchmarkTolerance");
+	if (arg && arg->getValueCount() > 0) {
+		ret->m_tolerance = (float)APT_MAX(atof(arg->getValue(0)), 0.0);
+	}
+	arg = _args.find("benchmarkReport");
+	if (arg && arg->getValueCount() > 0) {
+		ret->m_reportPath.set(arg->getValue(0));
+	} else {
+		FileSystem::MakePath(ret->m_reportPath, "Benchmark.json", FileSystem::RootType_Application);
+	}
+	arg = _args.find("benchmarkBaseline");
+	if (arg && arg->getValueCount() > 0) {
+		ret->m_baselinePath.set(arg->getValue(0));
+	}
+	arg = _args.find("benchmarkCamera");
+	if (arg && arg->getValueCount() > 0) {
+		Json json;
+		if (!Json::Read(json, arg->getValue(0))) {
+			APT_LOG_ERR("Benchmark: Failed to read camera path '%s'", (const char*)arg->getValue(0));
+			Destroy(ret);
+			return nullptr;
+		}
+		JsonSerializer serializer(&json, JsonSerializer::Mode_Read);
+		ret->m_cameraPath.serialize(serializer);
+		if (ret->m_cameraPath.getLength() <= 0.0f) {
+			APT_LOG_ERR("Benchmark: Camera path '%s' is empty", (const char*)arg->getValue(0));
+			Destroy(ret);
+			return nullptr;
+		}
+		ret->m_hasCameraPath = true;
+	}
+
+	APT_LOG("Benchmark: %d frames (%d warm-up), timestep %.4fs%s", ret->m_frameCount, ret->m_warmupCount, ret->m_timestep, ret->m_hasCameraPath ? ", camera path" : "");
+	return ret;
+}
+
+void Benchmark::Destroy(Benchmark*& _inst_)
+{
+	delete _inst_;
+	_inst_ = nullptr;
+}
+
+bool Benchmark::ReadReport(Report& report_, const char* _path)
+{
+	Json json;
+	if (!Json::Read(json, _path)) {
+		APT_LOG_ERR("Benchmark: Failed to read '%s'", _path);
+		return false;
+	}
+	JsonSerializer serializer(&json, JsonSerializer::Mode_Read);
+	return report_.serialize(serializer);
+}
+
+bool Benchmark::WriteReport(Report& _report, const char* _path)
+{
+	Json json;
+	JsonSerializer serializer(&json, JsonSerializer::Mode_Write);
+	if (!_report.serialize(serializer) || !Json::Write(json, _path)) {
+		APT_LOG_ERR("Benchmark: Failed to write '%s'", _path);
+		return false;
+	}
+	return true;
+}
+
+bool Benchmark::Compare(const Report& _report, const Report& _baseline, float _tolerance)
+{
+	int regressionCount = 0;
+	regressionCount += CheckRegression("CPU", "Frame", "P50", _report.m_cpuFrame.m_p50, _baseline.m_cpuFrame.m_p50, _tolerance, kMinRegressionMs) ? 1 : 0;
+	regressionCount += CheckRegression("CPU", "Frame", "P95", _report.m_cpuFrame.m_p95, _baseline.m_cpuFrame.m_p95, _tolerance, kMinRegressionMs) ? 1 : 0;
+	regressionCount += CheckRegression("GPU", "Frame", "P50", _report.m_gpuFrame.m_p50, _baseline.m_gpuFrame.m_p50, _tolerance, kMinRegressionMs) ? 1 : 0;
+	regressionCount += CheckRegression("GPU", "Frame", "P95", _report.m_gpuFrame.m_p95, _baseline.m_gpuFrame.m_p95, _tolerance, kMinRegressionMs) ? 1 : 0;
+	regressionCount += CompareStatList("CPU",     _report.m_cpuMarkers, _baseline.m_cpuMarkers, _tolerance, kMinRegressionMs);
+	regressionCount += CompareStatList("GPU",     _report.m_gpuMarkers, _baseline.m_gpuMarkers, _tolerance, kMinRegressionMs);
+	regressionCount += CompareStatList("Counter", _report.m_counters,   _baseline.m_counters,   _tolerance, 0.0f);
+
+	if (regressionCount > 0) {
+		APT_LOG_ERR("Benchmark: %d regressions (tolerance %.1f%%)", regressionCount, _tolerance * 100.0f);
+		return false;
+	}
+	APT_LOG("Benchmark: No regressions (tolerance %.1f%%)", _tolerance * 100.0f);
+	return true;
+}
+
+bool Benchmark::update()
+{
+	int frame = m_frame++;
+	if (frame == m_warmupCount) {
+	 // stats accumulated from the next call to Profiler::NextFrame() cover this frame
+		Profiler::ResetStats();
+		Profiler::ClearSpikes();
+	}
+	if (frame < m_warmupCount + m_frameCount) {
+		return true;
+	}
+
+	Report report;
+	getReport(report);
+	m_result = WriteReport(report, m_reportPath);
+	if (m_result) {
+		APT_LOG("Benchmark: Wrote '%s', CPU %.3fms P50/%.3fms P95, GPU %.3fms P50/%.3fms P95",
+			(const char*)m_reportPath,
+			report.m_cpuFrame.m_p50,
+			report.m_cpuFrame.m_p95,
+			report.m_gpuFrame.m_p50,
+			report.m_gpuFrame.m_p95
+			);
+	}
+	if (m_result && !m_baselinePath.isEmpty()) {
+		Report baseline;
+		m_result = ReadReport(baseline, m_baselinePath) && Compare(report, baseline, m_tolerance);
+	}
+	return false;
+}
+
+mat4 Benchmark::getCameraMatrix() const
+{
+	APT_ASSERT(m_hasCameraPath);
+	const float kLookAhead = 0.01f;
+	float t  = APT_CLAMP((float)m_frame / (float)APT_MAX(m_warmupCount + m_frameCount, 1), 0.0f, 1.0f);
+	float t0 = APT_MIN(t, 1.0f - kLookAhead);
+	vec3 position = m_cameraPath.sample(t);
+	vec3 forward  = m_cameraPath.sample(t0 + kLookAhead) - m_cameraPath.sample(t0);
+	return LookAt(position, position + forward);
+}
+
+// PRIVATE
+
+Benchmark::Benchmark()
+	: m_frameCount(1000)
+	, m_warmupCount(100)
+	, m_frame(0)
+	, m_timestep(1.0 / 60.0)
+	, m_tolerance(0.05f)
+	, m_hasCameraPath(false)
+	, m_result(false)
+{
+}
+
+Benchmark::~Benchmark()
+{
+}
+
+void Benchmark::getReport(Report& report_) const
+{
+	const double ticksToMs = 1e3 / (double)Time::GetSystemFrequency();
+	report_.m_frameCount  = m_frameCount;
+	report_.m_warmupCount = m_warmupCount;
+	report_.m_timestep    = (float)m_timestep;
+	ToStat(Profiler::GetCpuFrameStats(), ticksToMs, report_.m_cpuFrame);
+	ToStat(Profiler::GetGpuFrameStats(), ticksToMs, report_.m_gpuFrame);
+
+	eastl::vector<Profiler::MarkerStats> list(Profiler::kMaxNames);
+	uint count = Profiler::GetCpuMarkerStatsList(list.data(), (uint)list.size());
+	report_.m_cpuMarkers.resize(count);
+	for (uint i = 0; i < count; ++i) {
+		ToStat(list[i], ticksToMs, report_.m_cpuMarkers[i]);
+	}
+	count = Profiler::GetGpuMarkerStatsList(list.data(), (uint)list.size());
+	report_.m_gpuMarkers.resize(count);
+	for (uint i = 0; i < count; ++i) {
+		ToStat(list[i], ticksToMs, report_.m_gpuMarkers[i]);
+	}
+	count = Profiler::GetCounterCount();
+	report_.m_counters.resize(count);
+	for (uint i = 0; i < count; ++i) {
+		ToStat(Profiler::GetCounterStats(i), 1.0, report_.m_counters[i]);
+	}
+}
@@ -0,0 +1,115 @@
+#pragma once
+#ifndef frm_Benchmark_h
+#define frm_Benchmark_h
+
+#include <frm/def.h>
+#include <frm/math.h>
+#include <frm/Spline.h>
+
+#include <apt/FileSystem.h>
+#include <apt/String.h>
+
+#include <EASTL/vector.h>
+
+namespace frm {
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark
+// Run an app for a fixed workload and write a JSON report of the Profiler
+// stats (see AppSample, -benchmark).
+// - The run is a warm-up period followed by a fixed number of frames. The
+//   Profiler stats are reset at the end of the warm-up, hence the report only
+//   covers the measured frames (Gpu stats lag by the Gpu latency).
+// - The timestep is fixed and the draw camera optionally follows a SplinePath
+//   (AppSample3d), such that the frames are the same between runs.
+// - Reports can be compared with a baseline; an entry regresses if it exceeds
+//   the baseline by more than the tolerance (relative).
+//
+// Options:
+//   -benchmark [frames]            Measured frames (default 1000).
+//   -benchmarkWarmup frames        Frames before the measurement starts (default 100).
+//   -benchmarkTimestep seconds     Fixed timestep (default 1/60).
+//   -benchmarkCamera path          SplinePath json, traversed over the whole run.
+//   -benchmarkReport path          Report path (default <app>/Benchmark.json).
+//   -benchmarkBaseline path        Compare the report with a baseline.
+//   -benchmarkTolerance fraction   Relative regression threshold (default 0.05).
+////////////////////////////////////////////////////////////////////////////////
+class Benchmark
+{
+public:
+	// Durations are in milliseconds, counters are values per frame.
+	struct Stat
+	{
+		apt::String<64> m_name;
+		int             m_count;
+		float           m_perFrame;
+		float           m_min;
+		float           m_mean;
+		float           m_p50;
+		float           m_p95;
+		float           m_p99;
+		float           m_max;
+
+		bool serialize(apt::JsonSerializer& _serializer_);
+	};
+
+	struct Report
+	{
+		int                 m_frameCount;
+		int                 m_warmupCount;
+		float               m_timestep;
+		Stat                m_cpuFrame;
+		Stat                m_gpuFrame;
+		eastl::vector<Stat> m_cpuMarkers; // Sorted by cost.
+		eastl::vector<Stat> m_gpuMarkers; //    "
+		eastl::vector<Stat> m_counters;
+
+		bool serialize(apt::JsonSerializer& _serializer_);
+	};
+
+	// Return nullptr if the camera path couldn't be loaded.
+	static Benchmark* Create(const apt::ArgList& _args);
+	static void       Destroy(Benchmark*& _inst_);
+
+	static bool       ReadReport(Report& report_, const char* _path);
+	static bool       WriteReport(Report& _report, const char* _path);
+
+	// Log the entries of _report which regress relative to _baseline. Return false if there are any regressions.
+	// Entries which only appear in one report are ignored.
+	static bool       Compare(const Report& _report, const Report& _baseline, float _tolerance);
+
+	// Call once per frame, after Profiler::NextFrame(). Return false when the run is complete, in which case the
+	// report was written (and compared with the baseline, if any).
+	bool              update();
+
+	double            getTimestep() const        { return m_timestep; }
+	bool              hasCameraPath() const      { return m_hasCameraPath; }
+	// World matrix for the current frame, along the camera path looking forward.
+	mat4              getCameraMatrix() const;
+
+	// True if the report was written and no regressions were found.
+	bool              getResult() const          { return m_result; }
+
+private:
+	int                      m_frameCount;
+	int                      m_warmupCount;
+	int                      m_frame;          // Index of the current frame (warm-up included).
+	double                   m_timestep;
+	float                    m_tolerance;
+	SplinePath               m_cameraPath;
+	bool                     m_hasCameraPath;
+	apt::FileSystem::PathStr m_reportPath;
+	apt::FileSystem::PathStr m_baselinePath;
+	bool                     m_result;
+
+	Benchmark();
+	~Benchmark();
+
+	// Fill _report_ from the Profiler stats.
+	void getReport(Report& report_) const;
+
+}; // class Benchmark
+
+} // namespace frm
+
+#endif // frm_Benchmark_h
@@ -1,6 +1,8 @@
 #include <frm/Buffer.h>
 
 #include <frm/gl.h>
+#include <frm/GpuMemory.h>
+#include <frm/Profiler.h>
 
 using namespace frm;
 using namespace apt;
@@ -11,6 +13,7 @@ Buffer* Buffer::Create(GLenum _target, GLsizei _size, GLbitfield _flags, GLvoid*
 {
 	Buffer* ret = new Buffer(_target, _size, _flags);
 	glAssert(glNamedBufferStorage(ret->m_handle, _size, _data, _flags));
+	GpuMemory::Alloc(GpuMemory::Type_Buffer, _size);
 	return ret;
 }
 
@@ -26,6 +29,7 @@ void Buffer::setData(GLsizeiptr _size, GLvoid* _data, GLintptr _offset)
 	APT_ASSERT(m_flags & GL_DYNAMIC_STORAGE_BIT);
 	APT_ASSERT(_offset + _size <= m_size);
 	glAssert(glNamedBufferSubData(m_handle, _offset, _size, _data));
+	Profiler::Counter("GL Buffer Upload Bytes", (uint64)_size);
 }
 
 template <>
@@ -88,6 +92,7 @@ Buffer::~Buffer()
 	if (m_handle) {
 		glAssert(glDeleteBuffers(1, &m_handle));
 		m_handle = 0;
+		GpuMemory::Free(GpuMemory::Type_Buffer, m_size);
 	}
 	m_target = GL_NONE;
 }
\ No newline at end of file
@@ -0,0 +1,25 @@
+#include <frm/FileUtil.h>
+
+#include <apt/platform.h>
+
+#ifdef APT_PLATFORM_WIN
+	#include <apt/win.h> // CreateDirectory
+#else
+	#include <sys/stat.h>
+#endif
+
+#include <cerrno>
+
+using namespace frm;
+using namespace apt;
+
+// PUBLIC
+
+bool FileUtil::CreateDir(const char* _path)
+{
+	#ifdef APT_PLATFORM_WIN
+		return CreateDirectory(_path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+	#else
+		return mkdir(_path, 0755) == 0 || errno == EEXIST;
+	#endif
+}
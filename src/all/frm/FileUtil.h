@@ -0,0 +1,24 @@
+#pragma once
+#ifndef frm_FileUtil_h
+#define frm_FileUtil_h
+
+#include <frm/def.h>
+
+namespace frm {
+
+////////////////////////////////////////////////////////////////////////////////
+// FileUtil
+// File system helpers not provided by apt::FileSystem.
+////////////////////////////////////////////////////////////////////////////////
+class FileUtil
+{
+public:
+	// Create the directory _path (the parent must exist). Return true if the
+	// directory was created or already exists.
+	static bool CreateDir(const char* _path);
+
+}; // class FileUtil
+
+} // namespace frm
+
+#endif // frm_FileUtil_h
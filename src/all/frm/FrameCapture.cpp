@@ -0,0 +1,303 @@
+#include <frm/FrameCapture.h>
+
+#include <frm/FileUtil.h>
+#include <frm/Framebuffer.h>
+#include <frm/GpuMemory.h>
+#include <frm/ThreadPool.h>
+
+#include <apt/log.h>
+#include <apt/File.h>
+#include <apt/Image.h>
+#include <apt/String.h>
+#include <apt/Time.h>
+
+#include <cstring>
+#include <thread>
+
+using namespace frm;
+using namespace apt;
+
+static const int kReportMaxDroppedFrames = 32; // Max dropped frame indices listed by logReport().
+
+// Bytes per pixel as read by glReadPixels(), GL_RGB with GL_PACK_ALIGNMENT 1.
+static GLsizeiptr GetPixelSize(FrameCapture::Format _format)
+{
+	return _format == FrameCapture::Format_Exr ? 3 * sizeof(float) : 3;
+}
+
+struct FrameCapture::Slot
+{
+	enum State
+	{
+		State_Free,
+		State_Reading,   // Readback in flight, waiting for m_fence.
+		State_Writing    // Dispatched to a worker.
+	};
+
+	GLuint           m_buffer;
+	const char*      m_data;        // Persistent mapping of m_buffer.
+	GLsizeiptr       m_size;
+	GLsync           m_fence;
+	GLsizei          m_width;
+	GLsizei          m_height;
+	uint64           m_frameIndex;
+	std::atomic<int> m_state;       // Set to State_Free by the worker.
+
+	bool init(GLsizeiptr _size)
+	{
+		const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glAssert(glCreateBuffers(1, &m_buffer));
+		glAssert(glNamedBufferStorage(m_buffer, _size, nullptr, flags));
+		glAssert(m_data = (const char*)glMapNamedBufferRange(m_buffer, 0, _size, flags));
+		if (!m_data) {
+			APT_LOG_ERR("FrameCapture: Failed to map readback buffer (%lld bytes)", (long long)_size);
+			glAssert(glDeleteBuffers(1, &m_buffer));
+			m_buffer = 0;
+			return false;
+		}
+		m_size  = _size;
+		m_fence = 0;
+		m_state = State_Free;
+		GpuMemory::Alloc(GpuMemory::Type_Buffer, m_size);
+		return true;
+	}
+
+	void shutdown()
+	{
+		APT_ASSERT(m_state == State_Free);
+		if (m_buffer) {
+			glAssert(glUnmapNamedBuffer(m_buffer));
+			glAssert(glDeleteBuffers(1, &m_buffer));
+			m_buffer = 0;
+			m_data = nullptr;
+			GpuMemory::Free(GpuMemory::Type_Buffer, m_size);
+		}
+	}
+};
+
+// PUBLIC
+
+FrameCapture* FrameCapture::Create(const char* _dir, Format _format, GLsizeiptr _maxQueueBytes)
+{
+	if (!FileUtil::CreateDir(_dir)) {
+		APT_LOG_ERR("FrameCapture: Failed to create '%s'", _dir);
+		return nullptr;
+	}
+	return new FrameCapture(_dir, _format, _maxQueueBytes);
+}
+
+void FrameCapture::Destroy(FrameCapture*& _inst_)
+{
+	delete _inst_;
+	_inst_ = nullptr;
+}
+
+void FrameCapture::capture(uint64 _frameIndex, const Framebuffer* _fb, GLsizei _width, GLsizei _height)
+{
+	Timestamp t = Time::GetTimestamp();
+
+	GLsizei w = _fb ? _fb->getWidth()  : _width;
+	GLsizei h = _fb ? _fb->getHeight() : _height;
+	Slot* slot = findSlot((GLsizeiptr)w * (GLsizeiptr)h * GetPixelSize(m_format));
+	if (slot) {
+		GLint prevReadFb, prevPackBuffer, prevPackAlignment;
+		glAssert(glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevReadFb));
+		glAssert(glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &prevPackBuffer));
+		glAssert(glGetIntegerv(GL_PACK_ALIGNMENT, &prevPackAlignment));
+
+		glAssert(glBindFramebuffer(GL_READ_FRAMEBUFFER, _fb ? _fb->getHandle() : 0));
+		GLint prevReadBuffer; // per-framebuffer state, restored before rebinding prevReadFb
+		glAssert(glGetIntegerv(GL_READ_BUFFER, &prevReadBuffer));
+		glAssert(glReadBuffer(_fb ? GL_COLOR_ATTACHMENT0 : GL_BACK));
+		glAssert(glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->m_buffer));
+		glAssert(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+		glAssert(glReadPixels(0, 0, w, h, GL_RGB, m_format == Format_Exr ? GL_FLOAT : GL_UNSIGNED_BYTE, nullptr));
+		glAssert(slot->m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+
+		glAssert(glPixelStorei(GL_PACK_ALIGNMENT, prevPackAlignment));
+		glAssert(glBindBuffer(GL_PIXEL_PACK_BUFFER, prevPackBuffer));
+		glAssert(glReadBuffer((GLenum)prevReadBuffer));
+		glAssert(glBindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFb));
+
+		slot->m_width      = w;
+		slot->m_height     = h;
+		slot->m_frameIndex = _frameIndex;
+		slot->m_state      = Slot::State_Reading;
+		++m_capturedCount;
+	} else {
+		m_droppedFrames.push_back(_frameIndex);
+	}
+
+	m_frameMs += (Time::GetTimestamp() - t).asMilliseconds();
+	m_totalCaptureMs += m_frameMs;
+	m_maxCaptureMs = APT_MAX(m_maxCaptureMs, m_frameMs);
+	m_frameMs = 0.0;
+	++m_frameCount;
+}
+
+void FrameCapture::update()
+{
+	Timestamp t = Time::GetTimestamp();
+	dispatch(false);
+	m_frameMs += (Time::GetTimestamp() - t).asMilliseconds();
+}
+
+void FrameCapture::flush()
+{
+	dispatch(true);
+	for (Slot* slot : m_slots) {
+		while (slot->m_state != Slot::State_Free) {
+			std::this_thread::yield();
+		}
+	}
+ // slots are freed before the image is encoded/written, wait for the workers to finish
+	while (m_pendingWrites > 0) {
+		std::this_thread::yield();
+	}
+}
+
+FrameCapture::Stats FrameCapture::getStats() const
+{
+	Stats ret;
+	ret.m_capturedCount = m_capturedCount;
+	ret.m_writtenCount  = m_writtenCount;
+	ret.m_droppedCount  = (int)m_droppedFrames.size();
+	ret.m_failedCount   = m_failedCount;
+	ret.m_avgCaptureMs  = m_frameCount > 0 ? m_totalCaptureMs / (double)m_frameCount : 0.0;
+	ret.m_maxCaptureMs  = m_maxCaptureMs;
+	return ret;
+}
+
+void FrameCapture::logReport() const
+{
+	Stats stats = getStats();
+	APT_LOG("FrameCapture: '%s', %d captured, %d written, %d dropped, %d failed, %.3fms avg/%.3fms max per frame",
+		(const char*)m_dir,
+		stats.m_capturedCount,
+		stats.m_writtenCount,
+		stats.m_droppedCount,
+		stats.m_failedCount,
+		stats.m_avgCaptureMs,
+		stats.m_maxCaptureMs
+		);
+	if (!m_droppedFrames.empty()) {
+		String<256> list;
+		for (int i = 0, n = APT_MIN((int)m_droppedFrames.size(), kReportMaxDroppedFrames); i < n; ++i) {
+			list.append(String<24>(i == 0 ? "%llu" : ", %llu", (unsigned long long)m_droppedFrames[i]));
+		}
+		APT_LOG("FrameCapture: Dropped frames %s%s (increase the queue size)", (const char*)list, (int)m_droppedFrames.size() > kReportMaxDroppedFrames ? ", ..." : "");
+	}
+}
+
+// PRIVATE
+
+FrameCapture::FrameCapture(const char* _dir, Format _format, GLsizeiptr _maxQueueBytes)
+	: m_dir(_dir)
+	, m_format(_format)
+	, m_maxQueueBytes(_maxQueueBytes)
+	, m_queueBytes(0)
+	, m_capturedCount(0)
+	, m_writtenCount(0)
+	, m_failedCount(0)
+	, m_pendingWrites(0)
+	, m_frameCount(0)
+	, m_frameMs(0.0)
+	, m_totalCaptureMs(0.0)
+	, m_maxCaptureMs(0.0)
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+	flush();
+	for (Slot* slot : m_slots) {
+		slot->shutdown();
+		delete slot;
+	}
+	m_slots.clear();
+}
+
+FrameCapture::Slot* FrameCapture::findSlot(GLsizeiptr _size)
+{
+	for (Slot* slot : m_slots) {
+		if (slot->m_state == Slot::State_Free && slot->m_size == _size) {
+			return slot;
+		}
+	}
+
+ // free slots of a different size (resolution changed) are reallocated
+	for (auto it = m_slots.begin(); it != m_slots.end(); ++it) {
+		Slot* slot = *it;
+		if (slot->m_state == Slot::State_Free) {
+			m_queueBytes -= slot->m_size;
+			slot->shutdown();
+			if (m_queueBytes + _size <= m_maxQueueBytes || m_queueBytes == 0) {
+				if (slot->init(_size)) {
+					m_queueBytes += _size;
+					return slot;
+				}
+			}
+			m_slots.erase(it);
+			delete slot;
+			return nullptr;
+		}
+	}
+
+ // new slot, at least 1 even if _size exceeds the max
+	if (m_queueBytes + _size > m_maxQueueBytes && m_queueBytes > 0) {
+		return nullptr;
+	}
+	Slot* slot = new Slot;
+	if (!slot->init(_size)) {
+		delete slot;
+		return nullptr;
+	}
+	m_slots.push_back(slot);
+	m_queueBytes += _size;
+	return slot;
+}
+
+void FrameCapture::dispatch(bool _wait)
+{
+	for (Slot* slot : m_slots) {
+		if (slot->m_state != Slot::State_Reading) {
+			continue;
+		}
+		GLenum status;
+		glAssert(status = glClientWaitSync(slot->m_fence, _wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, _wait ? (GLuint64)1e9 : 0));
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+			continue;
+		}
+		glAssert(glDeleteSync(slot->m_fence));
+		slot->m_fence = 0;
+		slot->m_state = Slot::State_Writing;
+		++m_pendingWrites;
+		ThreadPool::Dispatch([this, slot]() { write(slot); });
+	}
+}
+
+void FrameCapture::write(Slot* _slot)
+{
+	const bool       exr      = m_format == Format_Exr;
+	const GLsizeiptr rowSize  = (GLsizeiptr)_slot->m_width * GetPixelSize(m_format);
+	Image* img = Image::Create2d(_slot->m_width, _slot->m_height, Image::Layout_RGB, exr ? DataType::Float32 : DataType::Uint8N);
+
+ // flip, GL rows are bottom-up
+	char* dst = img->getRawImage(0, 0);
+	for (GLsizei y = 0; y < _slot->m_height; ++y) {
+		memcpy(dst + y * rowSize, _slot->m_data + (_slot->m_height - y - 1) * rowSize, (size_t)rowSize);
+	}
+	const uint64 frameIndex = _slot->m_frameIndex;
+	_slot->m_state = Slot::State_Free; // data copied, the slot can be reused
+
+	FileSystem::PathStr pth("%s/%06llu.%s", (const char*)m_dir, (unsigned long long)frameIndex, exr ? "exr" : "png");
+	File f;
+	if (Image::Write(*img, f, exr ? Image::FileFormat_Exr : Image::FileFormat_Png) && FileSystem::Write(f, pth)) {
+		++m_writtenCount;
+	} else {
+		APT_LOG_ERR("FrameCapture: Failed to write '%s'", (const char*)pth);
+		++m_failedCount;
+	}
+	Image::Destroy(img);
+	--m_pendingWrites; // last access to this
+}
@@ -0,0 +1,108 @@
+#pragma once
+#ifndef frm_FrameCapture_h
+#define frm_FrameCapture_h
+
+#include <frm/def.h>
+#include <frm/gl.h>
+
+#include <apt/FileSystem.h>
+
+#include <EASTL/vector.h>
+
+#include <atomic>
+
+namespace frm {
+
+////////////////////////////////////////////////////////////////////////////////
+// FrameCapture
+// Write a sequence of frames to disk as numbered images (e.g. for recording
+// perf regression runs).
+// - capture() reads back the frame into a persistent-mapped pixel pack buffer
+//   and places a fence; it never waits on the GPU.
+// - update() dispatches frames whose fence was signaled to ThreadPool. The
+//   worker reads directly from the mapped buffer (no copy on the main
+//   thread), flips, encodes and writes the image. Buffers are recycled when
+//   the write completes.
+// - Queue memory is bounded by _maxQueueBytes: if all buffers are in use and
+//   another can't be allocated within the bound, the frame is dropped (see
+//   Stats, logReport()).
+////////////////////////////////////////////////////////////////////////////////
+class FrameCapture
+{
+public:
+	enum Format
+	{
+		Format_Png,  // RGB8
+		Format_Exr,  // RGB32F
+
+		Format_Count
+	};
+
+	struct Stats
+	{
+		int    m_capturedCount;  // Frames read back.
+		int    m_writtenCount;   // Frames written to disk.
+		int    m_droppedCount;   // Frames dropped because the queue was full.
+		int    m_failedCount;    // Frames which failed to encode/write.
+		double m_avgCaptureMs;   // Main thread time per frame spent in capture() + update().
+		double m_maxCaptureMs;
+	};
+
+	// Frames are written to _dir (created if it doesn't exist) as %06d.png/.exr, numbered by frame index.
+	static FrameCapture* Create(const char* _dir, Format _format, GLsizeiptr _maxQueueBytes = 256 * 1024 * 1024);
+	// Wait for pending readbacks/writes (see flush()).
+	static void          Destroy(FrameCapture*& _inst_);
+
+	// Read back color attachment 0 of _fb, or the backbuffer if _fb is null in which case _width/_height must be
+	// the backbuffer size (else they are ignored). Call after drawing the frame, before present.
+	void          capture(uint64 _frameIndex, const Framebuffer* _fb, GLsizei _width = 0, GLsizei _height = 0);
+
+	// Dispatch completed readbacks to the worker threads, recycle written buffers. Call once per frame.
+	void          update();
+
+	// Block until all pending frames are written (the workers are done with this).
+	void          flush();
+
+	Stats         getStats() const;
+	const char*   getDir() const     { return m_dir; }
+	Format        getFormat() const  { return m_format; }
+
+	// Log counts/timings plus the indices of dropped frames.
+	void          logReport() const;
+
+private:
+	struct Slot;
+
+	apt::FileSystem::PathStr m_dir;
+	Format                   m_format;
+	GLsizeiptr               m_maxQueueBytes;
+	GLsizeiptr               m_queueBytes;      // Total size of m_slots.
+	eastl::vector<Slot*>     m_slots;
+	eastl::vector<uint64>    m_droppedFrames;
+
+	int                      m_capturedCount;
+	std::atomic<int>         m_writtenCount;
+	std::atomic<int>         m_failedCount;
+	std::atomic<int>         m_pendingWrites;   // Dispatched to a worker, decremented when write() returns.
+	int                      m_frameCount;      // Frames timed (calls to capture()).
+	double                   m_frameMs;         // Accumulated by update(), committed by capture().
+	double                   m_totalCaptureMs;
+	double                   m_maxCaptureMs;
+
+	FrameCapture(const char* _dir, Format _format, GLsizeiptr _maxQueueBytes);
+	~FrameCapture();
+
+	// Return a free slot of _size bytes, reallocate or create one if required. Return nullptr if the queue is full.
+	Slot* findSlot(GLsizeiptr _size);
+
+	// Poll (or wait on, if _wait) the fences of pending readbacks and dispatch the completed frames.
+	void  dispatch(bool _wait);
+
+	// Encode and write _slot, called on a worker thread.
+	void  write(Slot* _slot);
+
+}; // class FrameCapture
+
+} // namespace frm
+
+#endif // frm_FrameCapture_h
@@ -7,6 +7,7 @@
 #include <frm/Framebuffer.h>
 #include <frm/Mesh.h>
 #include <frm/MeshData.h>
+#include <frm/Profiler.h>
 #include <frm/Resource.h>
 #include <frm/Shader.h>
 #include <frm/Texture.h>
@@ -56,6 +57,8 @@ void GlContext::draw(GLsizei _instances)
 			_instances
 			));
 	}
+	Profiler::Counter("GL Draw Calls", 1);
+	Profiler::Counter("GL Vertices", (uint64)(m_currentMesh->getIndexBufferHandle() != 0 ? submesh.m_indexCount : submesh.m_vertexCount) * (uint64)_instances);
 }
 
 void GlContext::drawIndirect(const Buffer* _buffer, const void* _offset)
@@ -77,6 +80,7 @@ void GlContext::drawIndirect(const Buffer* _buffer, const void* _offset)
 	} else {
 		glAssert(glDrawArraysIndirect(m_currentMesh->getPrimitive(), _offset));
 	}
+	Profiler::Counter("GL Draw Calls", 1);
 }
 
 void GlContext::drawNdcQuad(const Camera* _cam)
@@ -122,6 +126,7 @@ void GlContext::dispatch(GLuint _groupsX, GLuint _groupsY, GLuint _groupsZ)
 	APT_ASSERT(_groupsY < (GLuint)kMaxComputeWorkGroups[1]);
 	APT_ASSERT(_groupsZ < (GLuint)kMaxComputeWorkGroups[2]);
 	glAssert(glDispatchCompute(_groupsX, _groupsY, _groupsZ));
+	Profiler::Counter("GL Dispatches", 1);
 }
 
 void GlContext::dispatchIndirect(const Buffer* _buffer, const void* _offset)
@@ -129,6 +134,7 @@ void GlContext::dispatchIndirect(const Buffer* _buffer, const void* _offset)
 	APT_ASSERT(m_currentShader);
 	bindBuffer(_buffer, GL_DISPATCH_INDIRECT_BUFFER);
 	glAssert(glDispatchComputeIndirect((GLintptr)_offset));
+	Profiler::Counter("GL Dispatches", 1);
 }
 
 void GlContext::setFramebuffer(const Framebuffer* _framebuffer)
@@ -192,7 +198,7 @@ void GlContext::setShader(const Shader* _shader)
 	if (_shader == m_currentShader) {
 		return;
 	}
-	if (!_shader || _shader->getState() != Shader::State_Loaded) {
+	if (!_shader || _shader->getHandle() == 0) { // handle may be valid while State_Compiling (previous program)
 		glAssert(glUseProgram(0));
 	} else {
 		glAssert(glUseProgram(_shader->getHandle()));
@@ -200,72 +206,95 @@ void GlContext::setShader(const Shader* _shader)
 	m_currentShader = _shader;
 }
 
+template <typename tType>
+static void SetUniformArray(GLint _location, const tType* _val, GLsizei _count);
+
 template <>
-void GlContext::setUniformArray<int>(const char* _name, const int* _val, GLsizei _count)
+void SetUniformArray<int>(GLint _location, const int* _val, GLsizei _count)
 {
-	glAssert(glUniform1iv(m_currentShader->getUniformLocation(_name), _count, (const GLint*)_val));
+	glAssert(glUniform1iv(_location, _count, (const GLint*)_val));
 }
 template <>
-void GlContext::setUniformArray<uint32>(const char* _name, const uint32* _val, GLsizei _count)
+void SetUniformArray<uint32>(GLint _location, const uint32* _val, GLsizei _count)
 {
-	glAssert(glUniform1uiv(m_currentShader->getUniformLocation(_name), _count, (const GLuint*)_val));
+	glAssert(glUniform1uiv(_location, _count, (const GLuint*)_val));
 }
 template <>
-void GlContext::setUniformArray<float>(const char* _name, const float* _val, GLsizei _count)
+void SetUniformArray<float>(GLint _location, const float* _val, GLsizei _count)
 {
-	glAssert(glUniform1fv(m_currentShader->getUniformLocation(_name), _count, (const GLfloat*)_val));
+	glAssert(glUniform1fv(_location, _count, (const GLfloat*)_val));
 }
 template <>
-void GlContext::setUniformArray<vec2>(const char* _name, const vec2* _val, GLsizei _count)
+void SetUniformArray<vec2>(GLint _location, const vec2* _val, GLsizei _count)
 {
-	glAssert(glUniform2fv(m_currentShader->getUniformLocation(_name), _count, (const GLfloat*)_val));
+	glAssert(glUniform2fv(_location, _count, (const GLfloat*)_val));
 }
 template <>
-void GlContext::setUniformArray<vec3>(const char* _name, const vec3* _val, GLsizei _count)
+void SetUniformArray<vec3>(GLint _location, const vec3* _val, GLsizei _count)
 {
-	glAssert(glUniform3fv(m_currentShader->getUniformLocation(_name), _count, (const GLfloat*)_val));
+	glAssert(glUniform3fv(_location, _count, (const GLfloat*)_val));
 }
 template <>
-void GlContext::setUniformArray<vec4>(const char* _name, const vec4* _val, GLsizei _count)
+void SetUniformArray<vec4>(GLint _location, const vec4* _val, GLsizei _count)
 {
-	glAssert(glUniform4fv(m_currentShader->getUniformLocation(_name), _count, (const GLfloat*)_val));
+	glAssert(glUniform4fv(_location, _count, (const GLfloat*)_val));
 }
 template <>
-void GlContext::setUniformArray<ivec2>(const char* _name, const ivec2* _val, GLsizei _count)
+void SetUniformArray<ivec2>(GLint _location, const ivec2* _val, GLsizei _count)
 {
-	glAssert(glUniform2iv(m_currentShader->getUniformLocation(_name), _count, (const GLint*)_val));
+	glAssert(glUniform2iv(_location, _count, (const GLint*)_val));
 }
 template <>
-void GlContext::setUniformArray<ivec3>(const char* _name, const ivec3* _val, GLsizei _count)
+void SetUniformArray<ivec3>(GLint _location, const ivec3* _val, GLsizei _count)
 {
-	glAssert(glUniform3iv(m_currentShader->getUniformLocation(_name), _count, (const GLint*)_val));
+	glAssert(glUniform3iv(_location, _count, (const GLint*)_val));
 }
 template <>
-void GlContext::setUniformArray<ivec4>(const char* _name, const ivec4* _val, GLsizei _count)
+void SetUniformArray<ivec4>(GLint _location, const ivec4* _val, GLsizei _count)
 {
-	glAssert(glUniform4iv(m_currentShader->getUniformLocation(_name), _count, (const GLint*)_val));
+	glAssert(glUniform4iv(_location, _count, (const GLint*)_val));
 }
 template <>
-void GlContext::setUniformArray<uvec2>(const char* _name, const uvec2* _val, GLsizei _count)
+void SetUniformArray<uvec2>(GLint _location, const uvec2* _val, GLsizei _count)
 {
-	glAssert(glUniform2uiv(m_currentShader->getUniformLocation(_name), _count, (const GLuint*)_val));
+	glAssert(glUniform2uiv(_location, _count, (const GLuint*)_val));
 }
 template <>
-void GlContext::setUniformArray<uvec3>(const char* _name, const uvec3* _val, GLsizei _count)
+void SetUniformArray<uvec3>(GLint _location, const uvec3* _val, GLsizei _count)
 {
-	glAssert(glUniform3uiv(m_currentShader->getUniformLocation(_name), _count, (const GLuint*)_val));
+	glAssert(glUniform3uiv(_location, _count, (const GLuint*)_val));
 }
 template <>
-void GlContext::setUniformArray<uvec4>(const char* _name, const uvec4* _val, GLsizei _count)
+void SetUniformArray<uvec4>(GLint _location, const uvec4* _val, GLsizei _count)
 {
-	glAssert(glUniform4uiv(m_currentShader->getUniformLocation(_name), _count, (const GLuint*)_val));
+	glAssert(glUniform4uiv(_location, _count, (const GLuint*)_val));
 }
 template <>
-void GlContext::setUniformArray<mat4>(const char* _name, const mat4* _val, GLsizei _count)
+void SetUniformArray<mat4>(GLint _location, const mat4* _val, GLsizei _count)
 {
-	glAssert(glUniformMatrix4fv(m_currentShader->getUniformLocation(_name), _count, false, (const GLfloat*)_val));
+	glAssert(glUniformMatrix4fv(_location, _count, false, (const GLfloat*)_val));
 }
 
+template <typename tType>
+void GlContext::setUniformArray(StringHash _name, const tType* _val, GLsizei _count)
+{
+	APT_ASSERT(m_currentShader);
+	SetUniformArray<tType>(m_currentShader->getUniformLocation(_name), _val, _count);
+}
+template void GlContext::setUniformArray<int>(StringHash _name, const int* _val, GLsizei _count);
+template void GlContext::setUniformArray<uint32>(StringHash _name, const uint32* _val, GLsizei _count);
+template void GlContext::setUniformArray<float>(StringHash _name, const float* _val, GLsizei _count);
+template void GlContext::setUniformArray<vec2>(StringHash _name, const vec2* _val, GLsizei _count);
+template void GlContext::setUniformArray<vec3>(StringHash _name, const vec3* _val, GLsizei _count);
+template void GlContext::setUniformArray<vec4>(StringHash _name, const vec4* _val, GLsizei _count);
+template void GlContext::setUniformArray<ivec2>(StringHash _name, const ivec2* _val, GLsizei _count);
+template void GlContext::setUniformArray<ivec3>(StringHash _name, const ivec3* _val, GLsizei _count);
+template void GlContext::setUniformArray<ivec4>(StringHash _name, const ivec4* _val, GLsizei _count);
+template void GlContext::setUniformArray<uvec2>(StringHash _name, const uvec2* _val, GLsizei _count);
+template void GlContext::setUniformArray<uvec3>(StringHash _name, const uvec3* _val, GLsizei _count);
+template void GlContext::setUniformArray<uvec4>(StringHash _name, const uvec4* _val, GLsizei _count);
+template void GlContext::setUniformArray<mat4>(StringHash _name, const mat4* _val, GLsizei _count);
+
 
 void GlContext::setMesh(const Mesh* _mesh, int _submeshId)
 {
@@ -282,14 +311,13 @@ void GlContext::setMesh(const Mesh* _mesh, int _submeshId)
 	m_currentMesh = _mesh;
 }
 
-void GlContext::bindBuffer(const char* _location, const Buffer* _buffer)
+void GlContext::bindBuffer(StringHash _location, const Buffer* _buffer)
 {
 	bindBufferRange(_location, _buffer, 0, _buffer->getSize());
 }
 
-void GlContext::bindBufferRange(const char* _location, const Buffer* _buffer, GLintptr _offset, GLsizeiptr _size)
+void GlContext::bindBufferRange(StringHash _location, const Buffer* _buffer, GLintptr _offset, GLsizeiptr _size)
 {
-	APT_ASSERT(_location);
 	APT_ASSERT(m_currentShader);
 	APT_ASSERT(_buffer->getTarget() == GL_UNIFORM_BUFFER || 
 	           _buffer->getTarget() == GL_SHADER_STORAGE_BUFFER ||
@@ -361,18 +389,18 @@ void GlContext::clearBufferBindings()
 }
 
 
-void GlContext::bindTexture(const char* _location, const Texture* _texture)
+void GlContext::bindTexture(StringHash _location, const Texture* _texture)
 {
-	APT_ASSERT(_location);
 	APT_ASSERT(m_currentShader);
 	GLint loc = m_currentShader->getUniformLocation(_location);
-	if (loc != GL_INVALID_INDEX) {
+	if (loc != -1) {
 		APT_ASSERT(m_nextTextureSlot < kTextureSlotCount);
 		glAssert(glUniform1i(loc, m_nextTextureSlot));
 		glAssert(glActiveTexture(GL_TEXTURE0 + m_nextTextureSlot));
 		glAssert(glBindTexture(_texture->getTarget(), _texture->getHandle()));
 		m_currentTextures[m_nextTextureSlot] = _texture;
 		++m_nextTextureSlot;
+		Profiler::Counter("GL Texture Binds", 1);
 	}
 }
 
@@ -397,12 +425,11 @@ void GlContext::clearTextureBindings()
 #endif
 }
 
-void GlContext::bindImage(const char* _location, const Texture* _texture, GLenum _access, GLint _level)
+void GlContext::bindImage(StringHash _location, const Texture* _texture, GLenum _access, GLint _level)
 {
-	APT_ASSERT(_location);
 	APT_ASSERT(m_currentShader);
 	GLint loc = m_currentShader->getUniformLocation(_location);
-	if (loc != GL_INVALID_INDEX) {
+	if (loc != -1) {
 		APT_ASSERT(m_nextImageSlot < kImageSlotCount);
 		glAssert(glUniform1i(loc, m_nextImageSlot));
 		
@@ -454,6 +481,9 @@ bool GlContext::init()
 {
 	setVsync(m_vsync);
 	queryLimits();
+	if (GLEW_ARB_parallel_shader_compile) {
+		glAssert(glMaxShaderCompilerThreadsARB(0xffffffff)); // implementation-dependent max
+	}
 	return true;
 }
 void GlContext::shutdown()
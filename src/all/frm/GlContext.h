@@ -4,6 +4,8 @@
 
 #include <frm/gl.h>
 
+#include <apt/StringHash.h>
+
 namespace frm {
 
 class Buffer;
@@ -94,11 +96,16 @@ public:
 	void setShader(const Shader* _shader);
 	const Shader* getShader()                    { return m_currentShader; }	
 	// Set uniform values on the currently bound shader. If there is no current
-	// shader or if _name is not an active uniform, the call does nothing.
+	// shader or if _name is not an active uniform, the call does nothing. The
+	// StringHash overloads avoid rehashing _name (use a precomputed hash).
+	template <typename tType>
+	void setUniformArray(const char* _name, const tType* _val, GLsizei _count)   { setUniformArray<tType>(apt::StringHash(_name), _val, _count); }
+	template <typename tType>
+	void setUniformArray(apt::StringHash _name, const tType* _val, GLsizei _count);
 	template <typename tType>
-	void setUniformArray(const char* _name, const tType* _val, GLsizei _count);
+	void setUniform(const char* _name, const tType& _val)                        { setUniformArray<tType>(apt::StringHash(_name), &_val, 1); }
 	template <typename tType>
-	void setUniform(const char* _name, const tType& _val) { setUniformArray<tType>(_name, &_val, 1); }
+	void setUniform(apt::StringHash _name, const tType& _val)                    { setUniformArray<tType>(_name, &_val, 1); }
 
  // MESH
 
@@ -112,8 +119,10 @@ public:
 	// uniform and storage buffers are allowed. Binding indices are managed 
 	// automatically; they are reset only when the current shader changes. 
 	// If _location is not active on the current shader, do nothing.
-	void bindBuffer(const char* _location, const Buffer* _buffer);
-	void bindBufferRange(const char* _location, const Buffer* _buffer, GLintptr _offset, GLsizeiptr _size);
+	void bindBuffer(const char* _location, const Buffer* _buffer)                { bindBuffer(apt::StringHash(_location), _buffer); }
+	void bindBuffer(apt::StringHash _location, const Buffer* _buffer);
+	void bindBufferRange(const char* _location, const Buffer* _buffer, GLintptr _offset, GLsizeiptr _size) { bindBufferRange(apt::StringHash(_location), _buffer, _offset, _size); }
+	void bindBufferRange(apt::StringHash _location, const Buffer* _buffer, GLintptr _offset, GLsizeiptr _size);
 
 	// As bindBuffer()/bindBufferRange() but use _buffer->getName() as the location.
 	void bindBuffer(const Buffer* _buffer);
@@ -132,7 +141,8 @@ public:
 	// indices are managed automatically; they are reset only when the current
 	// shader changes. If _location is not active on the current shader, do 
 	// nothing.
-	void bindTexture(const char* _location, const Texture* _texture);
+	void bindTexture(const char* _location, const Texture* _texture)             { bindTexture(apt::StringHash(_location), _texture); }
+	void bindTexture(apt::StringHash _location, const Texture* _texture);
 
 	// As bindTexture() but use _texture->getName() as the location.
 	void bindTexture(const Texture* _texture);
@@ -144,7 +154,8 @@ public:
 
 	// Bind _texture as an image to a named _location on the current shader. _access
 	// is one of GL_READ_ONLY, GL_WRITE_ONLY or GL_READ_WRITE.
-	void bindImage(const char* _location, const Texture* _texture, GLenum _access, GLint _level = 0);
+	void bindImage(const char* _location, const Texture* _texture, GLenum _access, GLint _level = 0) { bindImage(apt::StringHash(_location), _texture, _access, _level); }
+	void bindImage(apt::StringHash _location, const Texture* _texture, GLenum _access, GLint _level = 0);
 
 	// Clear all image bindings. 
 	void clearImageBindings();
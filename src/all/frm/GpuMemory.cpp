@@ -0,0 +1,124 @@
+#include <frm/GpuMemory.h>
+
+#include <EASTL/utility.h>
+#include <EASTL/vector.h>
+
+using namespace frm;
+using namespace apt;
+
+struct CacheEntry
+{
+	GpuMemory::Type         m_type;
+	void*                   m_resource;
+	GLsizeiptr              m_bytes;
+	GpuMemory::IsUsedFunc*  m_isUsed;
+	GpuMemory::DestroyFunc* m_destroy;
+};
+
+static GpuMemory::Stats          g_stats;
+static eastl::vector<CacheEntry> g_cache;   // Ordered by release time, oldest first.
+
+// PUBLIC
+
+void GpuMemory::Alloc(Type _type, GLsizeiptr _bytes)
+{
+	APT_ASSERT(_type < Type_Count);
+	g_stats.m_bytes[_type] += _bytes;
+	++g_stats.m_count[_type];
+	g_stats.m_totalBytes += _bytes;
+}
+
+void GpuMemory::Free(Type _type, GLsizeiptr _bytes)
+{
+	APT_ASSERT(_type < Type_Count);
+	APT_ASSERT(g_stats.m_count[_type] > 0 && g_stats.m_bytes[_type] >= _bytes);
+	g_stats.m_bytes[_type] -= _bytes;
+	--g_stats.m_count[_type];
+	g_stats.m_totalBytes -= _bytes;
+}
+
+bool GpuMemory::Defer(Type _type, void* _resource, GLsizeiptr _bytes, IsUsedFunc* _isUsed, DestroyFunc* _destroy)
+{
+	if (g_stats.m_budget <= 0) {
+		return false;
+	}
+	for (auto it = g_cache.begin(); it != g_cache.end(); ++it) {
+		if (it->m_resource == _resource) {
+		 // revived and released again before Update(), move to the back
+			g_stats.m_cachedBytes -= it->m_bytes;
+			--g_stats.m_cachedCount;
+			g_cache.erase(it);
+			break;
+		}
+	}
+	CacheEntry entry = { _type, _resource, _bytes, _isUsed, _destroy };
+	g_cache.push_back(entry);
+	g_stats.m_cachedBytes += _bytes;
+	++g_stats.m_cachedCount;
+	return true;
+}
+
+void GpuMemory::Update()
+{
+ // drop revived resources, they're deferred again when next released
+	for (auto it = g_cache.begin(); it != g_cache.end();) {
+		if (it->m_isUsed(it->m_resource)) {
+			g_stats.m_cachedBytes -= it->m_bytes;
+			--g_stats.m_cachedCount;
+			++g_stats.m_revivedCount;
+			it = g_cache.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+ // evict oldest first; the entry is removed before calling m_destroy (which calls Free())
+	size_t evictCount = 0;
+	while (evictCount < g_cache.size() && g_stats.m_totalBytes > g_stats.m_budget) {
+		CacheEntry& entry = g_cache[evictCount++];
+		g_stats.m_cachedBytes -= entry.m_bytes;
+		--g_stats.m_cachedCount;
+		++g_stats.m_evictedCount;
+		entry.m_destroy(entry.m_resource);
+	}
+	g_cache.erase(g_cache.begin(), g_cache.begin() + evictCount);
+}
+
+void GpuMemory::Flush()
+{
+	eastl::vector<CacheEntry> cache;
+	eastl::swap(cache, g_cache);
+	for (auto& entry : cache) {
+		if (!entry.m_isUsed(entry.m_resource)) {
+			entry.m_destroy(entry.m_resource);
+			++g_stats.m_evictedCount;
+		}
+	}
+	g_stats.m_cachedBytes = 0;
+	g_stats.m_cachedCount = 0;
+}
+
+void GpuMemory::SetBudget(GLsizeiptr _bytes)
+{
+	g_stats.m_budget = APT_MAX(_bytes, (GLsizeiptr)0);
+}
+
+GLsizeiptr GpuMemory::GetBudget()
+{
+	return g_stats.m_budget;
+}
+
+GpuMemory::Stats GpuMemory::GetStats()
+{
+	return g_stats;
+}
+
+const char* GpuMemory::GetTypeName(Type _type)
+{
+	switch (_type) {
+		case Type_Texture: return "Texture";
+		case Type_Mesh:    return "Mesh";
+		case Type_Buffer:  return "Buffer";
+		default:           APT_ASSERT(false); return "Unknown";
+	};
+}
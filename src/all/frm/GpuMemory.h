@@ -0,0 +1,79 @@
+#pragma once
+#ifndef frm_GpuMemory_h
+#define frm_GpuMemory_h
+
+#include <frm/def.h>
+#include <frm/gl.h>
+
+namespace frm {
+
+////////////////////////////////////////////////////////////////////////////////
+// GpuMemory
+// Accounting of the GPU memory allocated by resources, plus an LRU cache of
+// released resources.
+// - Sizes are estimates (e.g. Texture computes its size from the format and
+//   dimensions), driver overhead/padding isn't included.
+// - Resources which can be recreated by path (Texture, Mesh) defer destruction
+//   when their refcount reaches 0: the resource stays in the instance list and
+//   a subsequent Create() with the same path revives it without reloading.
+//   Deferred resources are destroyed in LRU order when the total exceeds the
+//   budget. A budget of 0 disables the cache (destruction is immediate).
+// - Not thread safe, call from the thread which owns the GL context.
+////////////////////////////////////////////////////////////////////////////////
+class GpuMemory
+{
+public:
+	enum Type
+	{
+		Type_Texture,
+		Type_Mesh,
+		Type_Buffer,
+
+		Type_Count
+	};
+
+	struct Stats
+	{
+		GLsizeiptr m_bytes[Type_Count];  // Includes cached resources.
+		int        m_count[Type_Count];  //    "
+		GLsizeiptr m_totalBytes;
+		GLsizeiptr m_cachedBytes;        // Deferred resources awaiting eviction.
+		int        m_cachedCount;
+		GLsizeiptr m_budget;
+		int        m_revivedCount;       // Total number of cached resources which were reused.
+		int        m_evictedCount;       // Total number of cached resources which were destroyed.
+	};
+
+	// Return true if the resource is in use (refcount > 0).
+	typedef bool (IsUsedFunc)(void* _resource);
+	// Destroy the resource.
+	typedef void (DestroyFunc)(void* _resource);
+
+	// Track an allocation/free of _bytes.
+	static void        Alloc(Type _type, GLsizeiptr _bytes);
+	static void        Free(Type _type, GLsizeiptr _bytes);
+
+	// Add _resource to the cache. Return false if the cache is disabled, in which case the caller should
+	// destroy the resource immediately. _bytes is used only to compute m_cachedBytes (the resource remains
+	// counted by Alloc() until it's destroyed).
+	static bool        Defer(Type _type, void* _resource, GLsizeiptr _bytes, IsUsedFunc* _isUsed, DestroyFunc* _destroy);
+
+	// Remove revived resources from the cache, evict the least recently released resources until the total is
+	// within the budget. Call once per frame.
+	static void        Update();
+
+	// Destroy all cached resources. Call before the GL context is destroyed.
+	static void        Flush();
+
+	static void        SetBudget(GLsizeiptr _bytes);
+	static GLsizeiptr  GetBudget();
+
+	static Stats       GetStats();
+
+	static const char* GetTypeName(Type _type);
+
+}; // class GpuMemory
+
+} // namespace frm
+
+#endif // frm_GpuMemory_h
@@ -2,6 +2,7 @@
 
 #include <frm/gl.h>
 #include <frm/GlContext.h>
+#include <frm/GpuMemory.h>
 #include <frm/Resource.h>
 
 #include <apt/log.h>
@@ -72,6 +73,16 @@ Mesh* Mesh::Create(const MeshDesc& _desc)
 
 void Mesh::Destroy(Mesh*& _inst_)
 {
+	if (_inst_->getRefCount() == 0 && !_inst_->m_path.isEmpty() && _inst_->getState() == State_Loaded) {
+	 // keep the instance, Create() with the same path revives it until it's evicted
+		bool deferred = GpuMemory::Defer(GpuMemory::Type_Mesh, _inst_, _inst_->m_gpuSize,
+			[](void* _mesh) { return ((Mesh*)_mesh)->getRefCount() > 0; },
+			[](void* _mesh) { delete (Mesh*)_mesh; }
+			);
+		if (deferred) {
+			return;
+		}
+	}
 	delete _inst_;
 }
 
@@ -121,8 +132,10 @@ void Mesh::setVertexData(const void* _data, uint _vertexCount, GLenum _usage)
 	} else {
 		glAssert(glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer));
 	}
-	glAssert(glBufferData(GL_ARRAY_BUFFER, _vertexCount * m_desc.getVertexSize(), _data, _usage));
+	m_vertexDataSize = (GLsizeiptr)_vertexCount * m_desc.getVertexSize();
+	glAssert(glBufferData(GL_ARRAY_BUFFER, m_vertexDataSize, _data, _usage));
 	m_submeshes[0].m_vertexCount = _vertexCount;
+	updateGpuSize();
 
 	glAssert(glBindVertexArray(0)); // prevent changing the vao state
 	glAssert(glBindBuffer(GL_ARRAY_BUFFER, prevVbo));
@@ -141,9 +154,11 @@ void Mesh::setIndexData(DataType _dataType, const void* _data, uint _indexCount,
 		glAssert(glGenBuffers(1, &m_indexBuffer));
 	}
 	glAssert(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer));
-	glAssert(glBufferData(GL_ELEMENT_ARRAY_BUFFER, _indexCount * DataType::GetSizeBytes(_dataType), _data, _usage));
+	m_indexDataSize = (GLsizeiptr)_indexCount * DataType::GetSizeBytes(_dataType);
+	glAssert(glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indexDataSize, _data, _usage));
 	m_submeshes[0].m_indexCount = _indexCount;
 	m_indexDataType = internal::GlDataTypeToEnum(_dataType);
+	updateGpuSize();
 
 	glAssert(glBindVertexArray(0)); // prevent changing the vao state
 	glAssert(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, prevIbo));
@@ -169,6 +184,9 @@ Mesh::Mesh(uint64 _id, const char* _name)
 	, m_indexBuffer(0)
 	, m_indexDataType(GL_NONE)
 	, m_primitive(GL_NONE)
+	, m_vertexDataSize(0)
+	, m_indexDataSize(0)
+	, m_gpuSize(0)
 {
 	APT_ASSERT(GlContext::GetCurrent());
 	m_submeshes.push_back(MeshData::Submesh());
@@ -198,9 +216,22 @@ void Mesh::unload()
 		m_bindPose = nullptr;
 	}
 	m_submeshes.clear();
+	m_vertexDataSize = m_indexDataSize = 0;
+	updateGpuSize();
 	setState(State_Unloaded);
 }
 
+void Mesh::updateGpuSize()
+{
+	if (m_gpuSize > 0) {
+		GpuMemory::Free(GpuMemory::Type_Mesh, m_gpuSize);
+	}
+	m_gpuSize = m_vertexDataSize + m_indexDataSize;
+	if (m_gpuSize > 0) {
+		GpuMemory::Alloc(GpuMemory::Type_Mesh, m_gpuSize);
+	}
+}
+
 
 void Mesh::load(const MeshData& _data)
 {
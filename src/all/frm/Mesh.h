@@ -50,6 +50,9 @@ public:
 	const Skeleton*   getBindPose() const                { return m_bindPose; }
 	void              setBindPose(const Skeleton& _skel);
 
+	// Size of the vertex + index data in bytes (see GpuMemory).
+	GLsizeiptr        getGpuSize() const                 { return m_gpuSize; }
+
 private:
 	apt::String<32> m_path; // empty if not from a file
 
@@ -63,11 +66,18 @@ private:
 	GLenum m_indexDataType;
 	GLenum m_primitive;
 
+	GLsizeiptr m_vertexDataSize;
+	GLsizeiptr m_indexDataSize;
+	GLsizeiptr m_gpuSize;       // Size passed to GpuMemory::Alloc().
+
 	Mesh(uint64 _id, const char* _name);
 	~Mesh();
 	
 	void unload();
 
+	// Update m_gpuSize from the vertex/index data sizes, update GpuMemory.
+	void updateGpuSize();
+
 	void load(const MeshData& _data);
 	void load(const MeshDesc& _desc);
 
@@ -0,0 +1,588 @@
+#include <frm/MipGenerator.h>
+
+#include <frm/ThreadPool.h>
+
+#include <apt/log.h>
+#include <apt/Image.h>
+
+#include <EASTL/utility.h>
+#include <EASTL/vector.h>
+
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define MipGenerator_SSE 1
+	#include <xmmintrin.h>
+#else
+	#define MipGenerator_SSE 0
+#endif
+
+using namespace frm;
+using namespace apt;
+
+struct Texel
+{
+	float m_v[4];
+};
+// Uninitialized texel storage (eastl::vector would zero-initialize on resize, which is as expensive as filtering).
+class TexelBuffer
+{
+public:
+	TexelBuffer(): m_data(nullptr), m_size(0)     {}
+	~TexelBuffer()                                { delete[] m_data; }
+
+	void   resize(int _size)                      { delete[] m_data; m_data = new Texel[_size]; m_size = _size; }
+	void   swap(TexelBuffer& _other)              { eastl::swap(m_data, _other.m_data); eastl::swap(m_size, _other.m_size); }
+	Texel* data()                                 { return m_data; }
+	const Texel* data() const                     { return m_data; }
+	int    size() const                           { return m_size; }
+
+private:
+	Texel* m_data;
+	int    m_size;
+
+	TexelBuffer(const TexelBuffer&);
+	TexelBuffer& operator=(const TexelBuffer&);
+};
+
+static const float kFilterRadius[MipGenerator::Filter_Count] =
+{
+	0.5f, // Filter_Box
+	3.0f, // Filter_Kaiser
+	3.0f  // Filter_Lanczos
+};
+static const float kKaiserAlpha   = 4.0f;
+static const int   kRowsPerJob    = 16;   // Granularity of the parallel filter passes.
+static const float kCoverageScale = 4.0f; // Max alpha scale searched by ScaleAlphaCoverage().
+
+static float Sinc(float _x)
+{
+	if (fabs(_x) < 1e-6f) {
+		return 1.0f;
+	}
+	_x *= 3.14159265359f;
+	return sinf(_x) / _x;
+}
+
+// Modified Bessel function of the first kind, order 0.
+static float BesselI0(float _x)
+{
+	float ret = 1.0f;
+	float term = 1.0f;
+	float x2 = _x * _x * 0.25f;
+	for (int k = 1; k < 32 && term > ret * 1e-7f; ++k) {
+		term *= x2 / (float)(k * k);
+		ret += term;
+	}
+	return ret;
+}
+
+// _x is in units of destination texels.
+static float EvaluateFilter(MipGenerator::Filter _filter, float _x)
+{
+	const float r = kFilterRadius[_filter];
+	switch (_filter) {
+		case MipGenerator::Filter_Box:
+			return (_x >= -r && _x < r) ? 1.0f : 0.0f;
+		case MipGenerator::Filter_Kaiser: {
+			if (fabs(_x) >= r) {
+				return 0.0f;
+			}
+			float t = _x / r;
+			return Sinc(_x) * BesselI0(kKaiserAlpha * sqrtf(1.0f - t * t)) / BesselI0(kKaiserAlpha);
+		}
+		case MipGenerator::Filter_Lanczos:
+			return fabs(_x) < r ? Sinc(_x) * Sinc(_x / r) : 0.0f;
+		default:
+			APT_ASSERT(false);
+			return 0.0f;
+	};
+}
+
+static float SrgbToLinear(float _x)
+{
+	return _x <= 0.04045f ? _x / 12.92f : powf((_x + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSrgb(float _x)
+{
+	return _x <= 0.0031308f ? _x * 12.92f : 1.055f * powf(_x, 1.0f / 2.4f) - 0.055f;
+}
+
+static int GetComponentCount(Image::Layout _layout)
+{
+	switch (_layout) {
+		case Image::Layout_R:    return 1;
+		case Image::Layout_RG:   return 2;
+		case Image::Layout_RGB:  return 3;
+		case Image::Layout_RGBA: return 4;
+		default:                 return 0;
+	};
+}
+
+// Call _job(i) for i in [0,_count), via ThreadPool unless _serial.
+static void For(int _count, bool _serial, const ThreadPool::IndexJob& _job)
+{
+	if (_serial) {
+		for (int i = 0; i < _count; ++i) {
+			_job(i);
+		}
+	} else {
+		ThreadPool::ParallelFor(_count, _job);
+	}
+}
+
+/*******************************************************************************
+
+                                   Kernel
+
+*******************************************************************************/
+
+// Resampling weights for one axis. Destination texel i is the sum of m_weights[i * m_taps + j] * src[m_indices[i * m_taps + j]]
+// for j in [0,m_taps). Edge handling (clamp/wrap) is resolved into m_indices.
+struct Kernel
+{
+	int                  m_taps;
+	eastl::vector<int>   m_indices;
+	eastl::vector<float> m_weights;
+
+	void init(MipGenerator::Filter _filter, int _srcSize, int _dstSize, bool _wrap)
+	{
+		const float scale  = (float)_srcSize / (float)_dstSize;
+		const float radius = kFilterRadius[_filter] * scale;
+		const int maxTaps  = (int)ceilf(radius * 2.0f) + 1;
+
+	 // evaluate the filter over the max footprint, find the actual number of non-zero taps
+		eastl::vector<float> weights(_dstSize * maxTaps);
+		eastl::vector<int>   first(_dstSize);
+		eastl::vector<int>   nonZeroBeg(_dstSize);
+		m_taps = 1;
+		for (int i = 0; i < _dstSize; ++i) {
+			float center = ((float)i + 0.5f) * scale;
+			first[i] = (int)floorf(center - radius);
+			int beg = maxTaps, end = 0;
+			for (int j = 0; j < maxTaps; ++j) {
+				float w = EvaluateFilter(_filter, ((float)(first[i] + j) + 0.5f - center) / scale);
+				weights[i * maxTaps + j] = w;
+				if (w != 0.0f) {
+					beg = APT_MIN(beg, j);
+					end = j + 1;
+				}
+			}
+			nonZeroBeg[i] = beg < end ? beg : 0;
+			m_taps = APT_MAX(m_taps, end - nonZeroBeg[i]);
+		}
+
+		m_indices.resize(_dstSize * m_taps);
+		m_weights.resize(_dstSize * m_taps);
+		for (int i = 0; i < _dstSize; ++i) {
+			int beg = APT_MIN(nonZeroBeg[i], maxTaps - m_taps);
+			float sum = 0.0f;
+			for (int j = 0; j < m_taps; ++j) {
+				sum += weights[i * maxTaps + beg + j];
+			}
+			sum = sum == 0.0f ? 1.0f : 1.0f / sum;
+			for (int j = 0; j < m_taps; ++j) {
+				int k = first[i] + beg + j;
+				if (_wrap) {
+					k = ((k % _srcSize) + _srcSize) % _srcSize;
+				} else {
+					k = APT_MIN(APT_MAX(k, 0), _srcSize - 1);
+				}
+				m_indices[i * m_taps + j] = k;
+				m_weights[i * m_taps + j] = weights[i * maxTaps + beg + j] * sum;
+			}
+		}
+	}
+};
+
+// Filter a single row along x.
+static void FilterRow(const Kernel& _kernel, const Texel* _src, Texel* _dst, int _dstWidth)
+{
+	const int taps = _kernel.m_taps;
+	const int* indices = _kernel.m_indices.data();
+	const float* weights = _kernel.m_weights.data();
+	for (int x = 0; x < _dstWidth; ++x, indices += taps, weights += taps) {
+	#if MipGenerator_SSE
+		__m128 acc = _mm_setzero_ps();
+		for (int t = 0; t < taps; ++t) {
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(_src[indices[t]].m_v)));
+		}
+		_mm_storeu_ps(_dst[x].m_v, acc);
+	#else
+		float acc[4] = {};
+		for (int t = 0; t < taps; ++t) {
+			const float* src = _src[indices[t]].m_v;
+			for (int c = 0; c < 4; ++c) {
+				acc[c] += weights[t] * src[c];
+			}
+		}
+		memcpy(_dst[x].m_v, acc, sizeof(acc));
+	#endif
+	}
+}
+
+// Filter along y or z for destination lines [_lineBeg,_lineEnd). Lines are rows (y) or slices (z) of _lineSize texels.
+static void FilterLines(const Kernel& _kernel, const Texel* _src, Texel* _dst, int _lineSize, int _lineBeg, int _lineEnd)
+{
+	const int taps = _kernel.m_taps;
+	for (int i = _lineBeg; i < _lineEnd; ++i) {
+		Texel* dst = _dst + i * _lineSize;
+		const int* indices = &_kernel.m_indices[i * taps];
+		const float* weights = &_kernel.m_weights[i * taps];
+	#if MipGenerator_SSE
+		for (int x = 0; x < _lineSize; ++x) {
+			_mm_storeu_ps(dst[x].m_v, _mm_setzero_ps());
+		}
+		for (int t = 0; t < taps; ++t) {
+			const Texel* src = _src + indices[t] * _lineSize;
+			__m128 w = _mm_set1_ps(weights[t]);
+			for (int x = 0; x < _lineSize; ++x) {
+				_mm_storeu_ps(dst[x].m_v, _mm_add_ps(_mm_loadu_ps(dst[x].m_v), _mm_mul_ps(w, _mm_loadu_ps(src[x].m_v))));
+			}
+		}
+	#else
+		memset(dst, 0, sizeof(Texel) * _lineSize);
+		for (int t = 0; t < taps; ++t) {
+			const Texel* src = _src + indices[t] * _lineSize;
+			for (int x = 0; x < _lineSize; ++x) {
+				for (int c = 0; c < 4; ++c) {
+					dst[x].m_v[c] += weights[t] * src[x].m_v[c];
+				}
+			}
+		}
+	#endif
+	}
+}
+
+/*******************************************************************************
+
+                                 Conversion
+
+*******************************************************************************/
+
+// sRGB <-> linear for 8-bit values.
+static const struct SrgbTable
+{
+	static const int kCoarseSize = 4096;
+
+	float m_values[256];
+	float m_thresholds[257];       // Linear value midway between sRGB values i-1 and i.
+	uint8 m_coarse[kCoarseSize];   // Encoded value for i / (kCoarseSize - 1), a lower bound for values in the interval.
+
+	SrgbTable()
+	{
+		for (int i = 0; i < 256; ++i) {
+			m_values[i] = SrgbToLinear((float)i / 255.0f);
+			m_thresholds[i] = i == 0 ? -FLT_MAX : SrgbToLinear(((float)i - 0.5f) / 255.0f);
+		}
+		m_thresholds[256] = FLT_MAX;
+		int j = 0;
+		for (int i = 0; i < kCoarseSize; ++i) {
+			float x = (float)i / (float)(kCoarseSize - 1);
+			while (x >= m_thresholds[j + 1]) {
+				++j;
+			}
+			m_coarse[i] = (uint8)j;
+		}
+	}
+
+	// Equivalent to round(LinearToSrgb(_x) * 255) for _x in [0,1].
+	uint8 encode(float _x) const
+	{
+		int i = m_coarse[(int)(_x * (float)(kCoarseSize - 1))];
+		while (_x >= m_thresholds[i + 1]) {
+			++i;
+		}
+		return (uint8)i;
+	}
+} g_srgbTable;
+
+// Convert _count texels from _src (_img format) to RGBA float, linearize if _srgb.
+static void Decode(const Image& _img, const char* _src, Texel* _dst, int _count, bool _srgb)
+{
+	const int compCount = GetComponentCount(_img.getLayout());
+	const int srgbCount = _srgb ? APT_MIN(compCount, 3) : 0;
+	const DataType srcType = _img.getImageDataType();
+	eastl::vector<float> tmp;
+	for (int i = 0; i < _count; ++i) {
+		for (int c = compCount; c < 4; ++c) {
+			_dst[i].m_v[c] = c == 3 ? 1.0f : 0.0f;
+		}
+	}
+	if (srcType == DataType::Uint8N) {
+		const uint8* src = (const uint8*)_src;
+		for (int i = 0; i < _count; ++i) {
+			for (int c = 0; c < compCount; ++c, ++src) {
+				_dst[i].m_v[c] = c < srgbCount ? g_srgbTable.m_values[*src] : (float)*src / 255.0f;
+			}
+		}
+	} else {
+		tmp.resize(_count * compCount);
+		DataType::Convert(srcType, DataType::Float32, _src, tmp.data(), (uint)tmp.size());
+		const float* src = tmp.data();
+		for (int i = 0; i < _count; ++i) {
+			for (int c = 0; c < compCount; ++c, ++src) {
+				_dst[i].m_v[c] = c < srgbCount ? SrgbToLinear(*src) : *src;
+			}
+		}
+	}
+}
+
+// Convert _count texels from _src to _img format, apply sRGB encoding if _srgb.
+static void Encode(const Image& _img, const Texel* _src, char* _dst, int _count, bool _srgb)
+{
+	const int compCount = GetComponentCount(_img.getLayout());
+	const int srgbCount = _srgb ? APT_MIN(compCount, 3) : 0;
+	const DataType dstType = _img.getImageDataType();
+
+ // clamp normalized types (filters with negative lobes can overshoot)
+	float minValue = -FLT_MAX, maxValue = FLT_MAX;
+	if (DataType::IsNormalized(dstType)) {
+		bool isSigned = dstType == DataType::Sint8N || dstType == DataType::Sint16N || dstType == DataType::Sint32N;
+		minValue = isSigned ? -1.0f : 0.0f;
+		maxValue = 1.0f;
+	}
+
+	if (dstType == DataType::Uint8N) {
+		uint8* dst = (uint8*)_dst;
+		for (int i = 0; i < _count; ++i) {
+			for (int c = 0; c < compCount; ++c, ++dst) {
+				float v = APT_MIN(APT_MAX(_src[i].m_v[c], 0.0f), 1.0f);
+				*dst = c < srgbCount ? g_srgbTable.encode(v) : (uint8)(v * 255.0f + 0.5f);
+			}
+		}
+	} else {
+		eastl::vector<float> tmp(_count * compCount);
+		float* dst = tmp.data();
+		for (int i = 0; i < _count; ++i) {
+			for (int c = 0; c < compCount; ++c, ++dst) {
+				float v = APT_MIN(APT_MAX(_src[i].m_v[c], minValue), maxValue);
+				*dst = c < srgbCount ? LinearToSrgb(APT_MAX(v, 0.0f)) : v;
+			}
+		}
+		DataType::Convert(DataType::Float32, dstType, tmp.data(), _dst, (uint)tmp.size());
+	}
+}
+
+/*******************************************************************************
+
+                               Alpha Coverage
+
+*******************************************************************************/
+
+// Return the number of texels with alpha * _scale >= _cutoff.
+static int CountCovered(const Texel* _texels, int _count, float _cutoff, float _scale)
+{
+	int ret = 0;
+	for (int i = 0; i < _count; ++i) {
+		ret += (_texels[i].m_v[3] * _scale >= _cutoff) ? 1 : 0;
+	}
+	return ret;
+}
+
+// Scale alpha such that the coverage matches _targetCoverage (binary search on the scale).
+static void ScaleAlphaCoverage(Texel* _texels, int _count, float _cutoff, float _targetCoverage)
+{
+	float lo = 0.0f, hi = kCoverageScale, scale = 1.0f;
+	for (int i = 0; i < 10; ++i) {
+		float coverage = (float)CountCovered(_texels, _count, _cutoff, scale) / (float)_count;
+		if (coverage < _targetCoverage) {
+			lo = scale;
+		} else if (coverage > _targetCoverage) {
+			hi = scale;
+		} else {
+			break;
+		}
+		scale = (lo + hi) * 0.5f;
+	}
+	for (int i = 0; i < _count; ++i) {
+		_texels[i].m_v[3] = APT_MIN(_texels[i].m_v[3] * scale, 1.0f);
+	}
+}
+
+/*******************************************************************************
+
+                                MipGenerator
+
+*******************************************************************************/
+
+// Return a ptr to row _row of the source for Downsample(). _scratch_ may be used as storage for the row.
+typedef std::function<const Texel*(int _row, TexelBuffer& _scratch_)> RowSource;
+
+// Downsample _srcW x _srcH x _srcD to _dst_ (_dstW x _dstH x _dstD) via separable x/y/z passes.
+static void Downsample(
+	const RowSource&     _src, 
+	int                  _srcW, 
+	int                  _srcH, 
+	int                  _srcD, 
+	TexelBuffer&         _dst_, 
+	int                  _dstW, 
+	int                  _dstH, 
+	int                  _dstD, 
+	MipGenerator::Filter _filter, 
+	bool                 _wrap, 
+	bool                 _serial
+	)
+{
+ // x pass -> _dstW x _srcH x _srcD
+	Kernel kx;
+	kx.init(_filter, _srcW, _dstW, _wrap);
+	TexelBuffer bx;
+	bx.resize(_dstW * _srcH * _srcD);
+	const int rowCount = _srcH * _srcD;
+	For((rowCount + kRowsPerJob - 1) / kRowsPerJob, _serial, [&](int _i) {
+		TexelBuffer scratch;
+		for (int y = _i * kRowsPerJob, n = APT_MIN(y + kRowsPerJob, rowCount); y < n; ++y) {
+			FilterRow(kx, _src(y, scratch), bx.data() + y * _dstW, _dstW);
+		}
+	});
+	if (_srcH == _dstH && _srcD == _dstD) {
+		_dst_.swap(bx);
+		return;
+	}
+
+ // y pass, per slice -> _dstW x _dstH x _srcD
+	TexelBuffer by;
+	TexelBuffer* result = &bx;
+	if (_srcH != _dstH) {
+		Kernel ky;
+		ky.init(_filter, _srcH, _dstH, _wrap);
+		by.resize(_dstW * _dstH * _srcD);
+		const int jobsPerSlice = (_dstH + kRowsPerJob - 1) / kRowsPerJob;
+		For(jobsPerSlice * _srcD, _serial, [&](int _i) {
+			int z = _i / jobsPerSlice;
+			int y = (_i % jobsPerSlice) * kRowsPerJob;
+			FilterLines(ky, bx.data() + z * _dstW * _srcH, by.data() + z * _dstW * _dstH, _dstW, y, APT_MIN(y + kRowsPerJob, _dstH));
+		});
+		result = &by;
+	}
+
+ // z pass -> _dstW x _dstH x _dstD
+	if (_srcD != _dstD) {
+		Kernel kz;
+		kz.init(_filter, _srcD, _dstD, _wrap);
+		_dst_.resize(_dstW * _dstH * _dstD);
+		const TexelBuffer& src = *result;
+		For(_dstD, _serial, [&](int _i) {
+			FilterLines(kz, src.data(), _dst_.data(), _dstW * _dstH, _i, _i + 1);
+		});
+	} else {
+		_dst_.swap(*result);
+	}
+}
+
+// PUBLIC
+
+bool MipGenerator::Generate(Image& _img_, Filter _filter, uint32 _flags, float _alphaCutoff)
+{
+	if (_img_.isCompressed()) {
+		APT_LOG_ERR("MipGenerator: Compressed images not supported");
+		return false;
+	}
+	const int mipCount = (int)_img_.getMipmapCount();
+	const int arrayCount = (int)_img_.getArrayCount();
+	if (mipCount < 2) {
+		return true;
+	}
+	const bool serial = (_flags & Flag_Serial) != 0;
+	const bool wrap   = (_flags & Flag_Wrap) != 0;
+	const bool srgb   = (_flags & Flag_Srgb) != 0;
+	const bool alphaCoverage = _alphaCutoff > 0.0f && GetComponentCount(_img_.getLayout()) == 4;
+	const int w = (int)_img_.getWidth();
+	const int h = APT_MAX((int)_img_.getHeight(), 1);
+	const int d = APT_MAX((int)_img_.getDepth(), 1);
+
+ // filter each mip from the previous one in float (each pass is itself parallel), mip 0 is decoded on the fly
+	TexelBuffer* mips = new TexelBuffer[arrayCount * mipCount];
+	eastl::vector<float> coverage(arrayCount, 0.0f);
+	For(arrayCount, serial, [&](int _i) {
+		TexelBuffer* layerMips = mips + _i * mipCount;
+		const char* raw = _img_.getRawImage(_i, 0);
+		const int rowSize = w * (int)_img_.getTexelSize();
+		std::atomic<int> coverageCount(0);
+		RowSource decodeRow = [&](int _row, TexelBuffer& _scratch_) -> const Texel* {
+			if (_scratch_.size() < w) {
+				_scratch_.resize(w);
+			}
+			Decode(_img_, raw + _row * rowSize, _scratch_.data(), w, srgb);
+			if (alphaCoverage) {
+				coverageCount += CountCovered(_scratch_.data(), w, _alphaCutoff, 1.0f);
+			}
+			return _scratch_.data();
+		};
+
+		for (int mip = 1; mip < mipCount; ++mip) {
+			const int srcW = APT_MAX(w >> (mip - 1), 1);
+			const TexelBuffer& src = layerMips[mip - 1];
+			RowSource srcRow = [&](int _row, TexelBuffer&) -> const Texel* {
+				return src.data() + _row * srcW;
+			};
+			Downsample(
+				mip == 1 ? decodeRow : srcRow, srcW, APT_MAX(h >> (mip - 1), 1), APT_MAX(d >> (mip - 1), 1),
+				layerMips[mip], APT_MAX(w >> mip, 1), APT_MAX(h >> mip, 1), APT_MAX(d >> mip, 1),
+				_filter, wrap, serial
+				);
+			if (mip == 1) {
+				coverage[_i] = (float)coverageCount / (float)(w * h * d);
+			}
+		}
+	});
+
+ // apply alpha coverage and encode each layer/mip
+	For(arrayCount * (mipCount - 1), serial, [&](int _i) {
+		int layer = _i / (mipCount - 1);
+		int mip   = _i % (mipCount - 1) + 1;
+		TexelBuffer& texels = mips[layer * mipCount + mip];
+		int count = texels.size();
+		if (alphaCoverage) {
+			ScaleAlphaCoverage(texels.data(), count, _alphaCutoff, coverage[layer]);
+		}
+		Encode(_img_, texels.data(), _img_.getRawImage(layer, mip), count, srgb);
+	});
+	delete[] mips;
+
+	return true;
+}
+
+Image* MipGenerator::Create(const Image& _img, Filter _filter, uint32 _flags, float _alphaCutoff)
+{
+	if (_img.isCompressed()) {
+		APT_LOG_ERR("MipGenerator: Compressed images not supported");
+		return nullptr;
+	}
+	const uint w = _img.getWidth();
+	const uint h = APT_MAX(_img.getHeight(), (uint)1);
+	const uint d = APT_MAX(_img.getDepth(),  (uint)1);
+	uint mipCount = 1;
+	while ((APT_MAX(w, APT_MAX(h, d)) >> mipCount) > 0) {
+		++mipCount;
+	}
+
+	Image* ret = nullptr;
+	switch (_img.getType()) {
+		case Image::Type_1d: ret = Image::Create1d(w,       _img.getLayout(), _img.getImageDataType(), mipCount); break;
+		case Image::Type_2d: ret = Image::Create2d(w, h,    _img.getLayout(), _img.getImageDataType(), mipCount); break;
+		case Image::Type_3d: ret = Image::Create3d(w, h, d, _img.getLayout(), _img.getImageDataType(), mipCount); break;
+		default:
+			APT_LOG_ERR("MipGenerator: Unsupported image type (use Generate() with a preallocated mip chain)");
+			return nullptr;
+	};
+	memcpy(ret->getRawImage(0, 0), _img.getRawImage(0, 0), _img.getRawImageSize(0));
+	Generate(*ret, _filter, _flags, _alphaCutoff);
+	return ret;
+}
+
+const char* MipGenerator::GetFilterName(Filter _filter)
+{
+	switch (_filter) {
+		case Filter_Box:     return "Box";
+		case Filter_Kaiser:  return "Kaiser";
+		case Filter_Lanczos: return "Lanczos";
+		default:             return "Unknown";
+	};
+}
@@ -0,0 +1,57 @@
+#pragma once
+#ifndef frm_MipGenerator_h
+#define frm_MipGenerator_h
+
+#include <frm/def.h>
+
+namespace frm {
+
+////////////////////////////////////////////////////////////////////////////////
+// MipGenerator
+// Generate mipmaps for an apt::Image on the CPU (no GL calls, hence usable
+// from worker threads and offline tools).
+// - Each mip is filtered from the previous mip with a separable kernel. The
+//   chain is kept in 32-bit float RGBA (SSE if available), so there is no
+//   requantization between mips. Any uncompressed data type is supported.
+// - Array layers/faces, row blocks within each filter pass and the final
+//   encoding of each mip are processed in parallel via ThreadPool.
+// - If Flag_Srgb, RGB is converted to linear before filtering and back to sRGB
+//   after (alpha is always linear).
+// - If _alphaCutoff > 0, alpha in each mip is scaled to preserve the fraction
+//   of texels in mip 0 with alpha >= _alphaCutoff (alpha-tested geometry
+//   otherwise gets thinner with distance).
+////////////////////////////////////////////////////////////////////////////////
+class MipGenerator
+{
+public:
+	enum Filter
+	{
+		Filter_Box,     // Equivalent to glGenerateMipmap().
+		Filter_Kaiser,  // Kaiser-windowed sinc (radius 3, alpha 4).
+		Filter_Lanczos, // Lanczos3.
+
+		Filter_Count
+	};
+
+	enum Flag
+	{
+		Flag_Srgb   = 1 << 0, // RGB is sRGB encoded.
+		Flag_Wrap   = 1 << 1, // Wrap at the image edges (default is clamp).
+		Flag_Serial = 1 << 2  // Don't use ThreadPool.
+	};
+
+	// Overwrite mips [1,n) of each array layer of _img_ with mips generated from mip 0. Return false if
+	// _img_ is compressed.
+	static bool Generate(apt::Image& _img_, Filter _filter = Filter_Kaiser, uint32 _flags = 0, float _alphaCutoff = 0.0f);
+
+	// Create a copy of mip 0 of _img with a full mip chain (1d/2d/3d images only). Return nullptr if _img
+	// is compressed or the image type is unsupported. The result must be released via apt::Image::Destroy().
+	static apt::Image* Create(const apt::Image& _img, Filter _filter = Filter_Kaiser, uint32 _flags = 0, float _alphaCutoff = 0.0f);
+
+	static const char* GetFilterName(Filter _filter);
+
+}; // class MipGenerator
+
+} // namespace frm
+
+#endif // frm_MipGenerator_h
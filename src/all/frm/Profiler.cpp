@@ -2,15 +2,27 @@
 
 #include <frm/gl.h>
 #include <frm/Input.h>
+#include <frm/ThreadPool.h>
 
 #include <apt/log.h>
+#include <apt/File.h>
+#include <apt/FileSystem.h>
 #include <apt/RingBuffer.h>
 #include <apt/String.h>
 #include <apt/Time.h>
 
+#include <EASTL/sort.h>
+#include <EASTL/vector.h>
+
 #include <imgui/imgui.h>
 
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
 #include <cstring>
+#include <cstdint>
+#include <mutex>
+#include <thread>
 
 using namespace frm;
 using namespace apt;
@@ -38,6 +50,10 @@ struct ProfilerViewer
 	bool            m_isMarkerHovered;
 	String<64>      m_hoverName;
 	ImGuiTextFilter m_markerFilter;
+	bool            m_showStats;
+	bool            m_showCounters;
+	eastl::vector<Profiler::MarkerStats> m_statsList;
+	eastl::vector<float> m_plotValues;
 
 	uint64 m_timeBeg; // all markers draw relative to this time
 	uint64 m_timeEnd; // start of the last marker
@@ -45,7 +61,9 @@ struct ProfilerViewer
 	vec2   m_windowBeg, m_windowEnd, m_windowSize;
 	
 	ProfilerViewer()
-		: m_regionBeg(0.0f)
+		: m_showStats(false)
+		, m_showCounters(false)
+		, m_regionBeg(0.0f)
 		, m_regionSize(100.0f)
 	{
 		kColorsGpu.kBackground      = kColorsCpu.kBackground = ImColor(0xff8e8e8e);
@@ -113,11 +131,11 @@ struct ProfilerViewer
 	}
 
 	// Return true if the marker is hovered.
-	bool drawFrameMarker(const Profiler::Marker& _marker, float _frameEndX)
+	bool drawFrameMarker(const Profiler::Frame& _frame, const Profiler::Marker& _marker, float _frameEndX)
 	{
 		float markerHeight = ImGui::GetItemsLineHeightWithSpacing();
-		vec2 markerBeg = vec2(timeToWindowX(_marker.m_start), m_windowBeg.y + markerHeight * (float)_marker.m_depth);
-		vec2 markerEnd = vec2(timeToWindowX(_marker.m_end) - 1.0f, markerBeg.y + markerHeight);
+		vec2 markerBeg = vec2(timeToWindowX(_frame.getStart(_marker)), m_windowBeg.y + markerHeight * (float)_marker.m_depth);
+		vec2 markerEnd = vec2(timeToWindowX(_frame.getEnd(_marker)) - 1.0f, markerBeg.y + markerHeight);
 		if (markerBeg.x > m_windowEnd.x || markerEnd.x < m_windowBeg.x) {
 			return false;
 		}
@@ -135,15 +153,16 @@ struct ProfilerViewer
 		ImGui::SetCursorPosX(floorf(markerBeg.x - wpos.x));
 		ImGui::SetCursorPosY(floorf(markerBeg.y - wpos.y));
 
+		const char* name = Profiler::GetMarkerName(_marker);
 		ImU32 buttonColor = kColors->kMarkerGray;
 		ImU32 textColor = kColors->kMarkerTextGray;
 		
 	 // if the marker is hovered and no filter is set, highlight the marker
 		bool hoverMatch = true;
 		if (!m_markerFilter.IsActive() && !m_hoverName.isEmpty()) {
-			hoverMatch = m_hoverName == _marker.m_name;
+			hoverMatch = m_hoverName == name;
 		}
-		if (hoverMatch && m_markerFilter.PassFilter(_marker.m_name)) {
+		if (hoverMatch && m_markerFilter.PassFilter(name)) {
 			buttonColor =  kColors->kFrame;
 			textColor = kColors->kMarkerText;
 		}
@@ -152,18 +171,227 @@ struct ProfilerViewer
 		ImGui::PushStyleColor(ImGuiCol_ButtonActive, ImColor(buttonColor));
 		ImGui::PushStyleColor(ImGuiCol_Text, ImColor(textColor)); 
 
-		ImGui::Button(_marker.m_name, ImVec2(floorf(markerWidth), floorf(markerHeight) - 1.0f));
+		ImGui::Button(name, ImVec2(floorf(markerWidth), floorf(markerHeight) - 1.0f));
 		
 		ImGui::PopStyleColor(4);
 
 		if (isMouseInside(markerBeg, markerEnd)) {
-			m_hoverName.set(_marker.m_name);
+			m_hoverName.set(name);
 			m_isMarkerHovered = true;
 			return true;
 		}
 		return false;
 	}
 
+	// Deepest marker in the history for _thread.
+	uint getCpuMaxDepth(uint _thread)
+	{
+		uint ret = 0;
+		for (uint i = 0, n = Profiler::GetCpuFrameCount(_thread); i < n; ++i) {
+			const Profiler::CpuFrame& frame = Profiler::GetCpuFrame(i, _thread);
+			for (uint j = frame.m_first, m = frame.m_first + frame.m_count; j < m; ++j) {
+				ret = APT_MAX(ret, (uint)Profiler::GetCpuMarker(j, _thread).m_depth);
+			}
+		}
+		return ret;
+	}
+
+	void drawCpuThread(uint _thread)
+	{
+		ImDrawList& drawList = *ImGui::GetWindowDrawList();
+		ImGui::PushClipRect(m_windowBeg, m_windowEnd, false);
+		for (uint i = 0, n = Profiler::GetCpuFrameCount(_thread) - 1; i < n; ++i) {
+			const Profiler::CpuFrame& frame = Profiler::GetCpuFrame(i, _thread);
+			const Profiler::CpuFrame& frameNext = Profiler::GetCpuFrame(i + 1, _thread);
+			if (cullFrame(frame, frameNext)) {
+				continue;
+			}
+
+		 // markers
+			ImGui::PushStyleVar(ImGuiStyleVar_FrameRounding, 0.0f);
+			m_windowBeg.y += ImGui::GetFontSize() + 2.0f; // space for the frame time
+			float fend = timeToWindowX(frameNext.m_start);
+			for (uint j = frame.m_first, m = frame.m_first + frame.m_count; j < m; ++j) {
+				const Profiler::CpuMarker& marker = Profiler::GetCpuMarker(j, _thread);
+				if (drawFrameMarker(frame, marker, fend)) {
+					ImGui::BeginTooltip();
+						ImGui::TextColored(ImColor(kColors->kFrame), Profiler::GetMarkerName(marker));
+						ImGui::Text("Duration: %s", timeToStr(frame.getEnd(marker) - frame.getStart(marker)));
+						if (_thread != 0) {
+							ImGui::Text("Thread:   %s", Profiler::GetCpuThreadName(_thread));
+						}
+					ImGui::EndTooltip();
+				}
+			}
+			m_windowBeg.y -= ImGui::GetFontSize() + 2.0f;
+			ImGui::PopStyleVar();
+
+			drawFrameBounds(frame, frameNext);
+		}
+		ImGui::PopClipRect();
+		drawList.AddRect(m_windowBeg, m_windowEnd, kColors->kBackground);
+	}
+
+	void drawStatsRow(const Profiler::MarkerStats& _stats)
+	{
+		ImGui::TextUnformatted(_stats.m_name);     ImGui::NextColumn();
+		ImGui::Text("%u", _stats.m_count);         ImGui::NextColumn();
+		ImGui::Text(timeToStr(_stats.m_perFrame)); ImGui::NextColumn();
+		ImGui::Text(timeToStr(_stats.m_min));      ImGui::NextColumn();
+		ImGui::Text(timeToStr(_stats.m_mean));     ImGui::NextColumn();
+		ImGui::Text(timeToStr(_stats.m_p50));      ImGui::NextColumn();
+		ImGui::Text(timeToStr(_stats.m_p95));      ImGui::NextColumn();
+		ImGui::Text(timeToStr(_stats.m_p99));      ImGui::NextColumn();
+		ImGui::Text(timeToStr(_stats.m_max));      ImGui::NextColumn();
+	}
+
+	// Frame stats followed by the first _count entries of m_statsList (sorted by cost) which pass the filter.
+	void drawStatsTable(const char* _id, const Profiler::MarkerStats& _frameStats, uint _count)
+	{
+		static const char* kHeaders[] = { "Name", "Count", "Per Frame", "Min", "Mean", "P50", "P95", "P99", "Max" };
+		ImGui::Columns(APT_ARRAY_COUNT(kHeaders), _id);
+		for (auto header : kHeaders) {
+			ImGui::TextColored(ImColor(kColors->kFrame), header);
+			ImGui::NextColumn();
+		}
+		ImGui::Separator();
+		drawStatsRow(_frameStats);
+		for (uint i = 0; i < _count; ++i) {
+			if (m_markerFilter.PassFilter(m_statsList[i].m_name)) {
+				drawStatsRow(m_statsList[i]);
+			}
+		}
+		ImGui::Columns(1);
+	}
+
+	// Counter values aren't durations, hence the table is separate from drawStatsTable().
+	void drawCounterStatsTable()
+	{
+		static const char* kHeaders[] = { "Name", "Total", "Min", "Mean", "P50", "P95", "P99", "Max" };
+		ImGui::Columns(APT_ARRAY_COUNT(kHeaders), "CounterStats");
+		for (auto header : kHeaders) {
+			ImGui::TextColored(ImColor(kColors->kFrame), header);
+			ImGui::NextColumn();
+		}
+		ImGui::Separator();
+		for (uint i = 0, n = Profiler::GetCounterCount(); i < n; ++i) {
+			Profiler::MarkerStats stats = Profiler::GetCounterStats(i);
+			if (!m_markerFilter.PassFilter(stats.m_name)) {
+				continue;
+			}
+			ImGui::TextUnformatted(stats.m_name);                      ImGui::NextColumn();
+			ImGui::Text("%llu", (unsigned long long)stats.m_total);    ImGui::NextColumn();
+			ImGui::Text("%llu", (unsigned long long)stats.m_min);      ImGui::NextColumn();
+			ImGui::Text("%llu", (unsigned long long)stats.m_mean);     ImGui::NextColumn();
+			ImGui::Text("%llu", (unsigned long long)stats.m_p50);      ImGui::NextColumn();
+			ImGui::Text("%llu", (unsigned long long)stats.m_p95);      ImGui::NextColumn();
+			ImGui::Text("%llu", (unsigned long long)stats.m_p99);      ImGui::NextColumn();
+			ImGui::Text("%llu", (unsigned long long)stats.m_max);      ImGui::NextColumn();
+		}
+		ImGui::Columns(1);
+	}
+
+	// Plot the Cpu frame duration and each counter over the history (the newest frame is incomplete and omitted).
+	void drawCounters(bool* _open_)
+	{
+		ImGui::SetNextWindowSize(ImVec2(ImGui::GetFontSize() * 32.0f, ImGui::GetFontSize() * 32.0f), ImGuiSetCond_FirstUseEver);
+		if (!ImGui::Begin("Profiler Counters", _open_)) {
+			ImGui::End();
+			return;
+		}
+		m_markerFilter.Draw("Filter", 160.0f);
+
+		uint frameCount = Profiler::GetCpuFrameCount() - 1;
+		if (frameCount == 0) {
+			ImGui::End();
+			return;
+		}
+		m_plotValues.resize(frameCount);
+		const ImVec2 plotSize(ImGui::GetContentRegionAvailWidth(), ImGui::GetFontSize() * 3.0f);
+
+		for (uint i = 0; i < frameCount; ++i) {
+			uint64 duration = Profiler::GetCpuFrame(i + 1).m_start - Profiler::GetCpuFrame(i).m_start;
+			m_plotValues[i] = Profiler::GetCpuFrame(i).m_start == 0 ? 0.0f : (float)Timestamp(duration).asMilliseconds();
+		}
+		ImGui::Text("CPU Frame");
+		ImGui::PlotLines("##CpuFrame", m_plotValues.data(), (int)frameCount, 0, String<32>("%.3fms", m_plotValues.back()), 0.0f, FLT_MAX, plotSize);
+
+		for (uint i = 0, n = Profiler::GetCounterCount(); i < n; ++i) {
+			const char* name = Profiler::GetCounterName(i);
+			if (!m_markerFilter.PassFilter(name)) {
+				continue;
+			}
+			for (uint j = 0; j < frameCount; ++j) {
+				m_plotValues[j] = (float)Profiler::GetCounterValue(i, Profiler::GetCpuFrame(j));
+			}
+			ImGui::PushID((int)i);
+			ImGui::TextUnformatted(name);
+			ImGui::PlotLines("##Counter", m_plotValues.data(), (int)frameCount, 0, String<32>("%llu", (unsigned long long)Profiler::GetCounterValue(i, Profiler::GetCpuFrame(frameCount - 1))), 0.0f, FLT_MAX, plotSize);
+			ImGui::PopID();
+		}
+
+		ImGui::End();
+	}
+
+	void drawStats(bool* _open_)
+	{
+		ImGui::SetNextWindowSize(ImVec2(ImGui::GetFontSize() * 48.0f, ImGui::GetFontSize() * 32.0f), ImGuiSetCond_FirstUseEver);
+		if (!ImGui::Begin("Profiler Stats", _open_)) {
+			ImGui::End();
+			return;
+		}
+		m_statsList.resize(Profiler::kMaxNames);
+
+		if (ImGui::Button("Reset")) {
+			Profiler::ResetStats();
+		}
+		ImGui::SameLine();
+		m_markerFilter.Draw("Filter", 160.0f);
+
+		kColors = &kColorsCpu;
+		if (ImGui::CollapsingHeader("CPU", ImGuiTreeNodeFlags_DefaultOpen)) {
+			uint count = Profiler::GetCpuMarkerStatsList(m_statsList.data(), (uint)m_statsList.size());
+			drawStatsTable("CpuStats", Profiler::GetCpuFrameStats(), count);
+		}
+		kColors = &kColorsGpu;
+		if (ImGui::CollapsingHeader("GPU", ImGuiTreeNodeFlags_DefaultOpen)) {
+			uint count = Profiler::GetGpuMarkerStatsList(m_statsList.data(), (uint)m_statsList.size());
+			drawStatsTable("GpuStats", Profiler::GetGpuFrameStats(), count);
+		}
+		kColors = &kColorsCpu;
+		if (Profiler::GetCounterCount() > 0 && ImGui::CollapsingHeader("Counters", ImGuiTreeNodeFlags_DefaultOpen)) {
+			drawCounterStatsTable();
+		}
+
+		kColors = &kColorsCpu;
+		if (ImGui::CollapsingHeader("Spikes", ImGuiTreeNodeFlags_DefaultOpen)) {
+			float threshold = (float)Profiler::GetSpikeThreshold();
+			ImGui::PushItemWidth(ImGui::GetFontSize() * 6.0f);
+			if (ImGui::InputFloat("Threshold (ms)", &threshold, 0.0f, 0.0f, 2, ImGuiInputTextFlags_EnterReturnsTrue)) {
+				Profiler::SetSpikeThreshold((double)threshold);
+			}
+			ImGui::PopItemWidth();
+			ImGui::SameLine();
+			if (ImGui::Button("Clear")) {
+				Profiler::ClearSpikes();
+			}
+			for (uint i = 0, n = Profiler::GetSpikeCount(); i < n; ++i) {
+				const Profiler::Spike& spike = Profiler::GetSpike(i);
+				if (ImGui::TreeNode((void*)(uintptr_t)spike.m_frameIndex, "Frame %llu: %s", (unsigned long long)spike.m_frameIndex, timeToStr(spike.m_duration))) {
+					for (uint j = 0; j < spike.m_markerCount; ++j) {
+						const Profiler::CpuMarker& marker = spike.m_markers[j];
+						ImGui::Text("%*s%s", (int)marker.m_depth * 2, "", Profiler::GetMarkerName(marker));
+						ImGui::SameLine(ImGui::GetWindowContentRegionWidth() * 0.5f);
+						ImGui::Text(timeToStr((uint64)APT_MAX(marker.m_end - marker.m_start, 0)));
+					}
+					ImGui::TreePop();
+				}
+			}
+		}
+
+		ImGui::End();
+	}
+
 	void draw(bool* _open_)
 	{
 		String<sizeof("999.999ms\0")> str;
@@ -184,10 +412,47 @@ struct ProfilerViewer
 				if (ImGui::MenuItem("Reset GPU Offset")) {
 					Profiler::ResetGpuOffset();
 				}
+				int maxCpuMarkers = (int)Profiler::GetMaxCpuMarkersPerFrame();
+				if (ImGui::InputInt("Max CPU Markers/Frame", &maxCpuMarkers, 0, 0, ImGuiInputTextFlags_EnterReturnsTrue)) {
+					Profiler::SetMaxCpuMarkersPerFrame((uint)APT_MAX(maxCpuMarkers, 1));
+				}
+				int maxGpuMarkers = (int)Profiler::GetMaxGpuMarkersPerFrame();
+				if (ImGui::InputInt("Max GPU Markers/Frame", &maxGpuMarkers, 0, 0, ImGuiInputTextFlags_EnterReturnsTrue)) {
+					Profiler::SetMaxGpuMarkersPerFrame((uint)APT_MAX(maxGpuMarkers, 1));
+				}
+				uint cpuDropCount = 0;
+				for (uint i = 0, n = Profiler::GetCpuThreadCount(); i < n; ++i) {
+					cpuDropCount += Profiler::GetCpuThreadDropCount(i);
+				}
+				Profiler::GpuStats gpuStats = Profiler::GetGpuStats();
+				ImGui::Text("Dropped: %u CPU, %u GPU", cpuDropCount, gpuStats.m_dropCount);
+				ImGui::Text("GPU latency: %u frames (max %u), %u pending", gpuStats.m_latency, gpuStats.m_maxLatency, gpuStats.m_pendingFrameCount);
+				ImGui::Text("GPU late: %u frames, %u markers", gpuStats.m_lateFrameCount, gpuStats.m_lateMarkerCount);
+				ImGui::Text("GPU queries: %u", gpuStats.m_queryCount);
+
+				ImGui::Separator();
+				if (ImGui::MenuItem("Export Trace")) {
+					FileSystem::PathStr path;
+					FileSystem::MakePath(path, "Profiler.json", FileSystem::RootType_Application);
+					Profiler::ExportTrace(path);
+				}
+				if (ImGui::MenuItem(Profiler::IsCapturing() ? "End Capture" : "Begin Capture")) {
+					if (Profiler::IsCapturing()) {
+						Profiler::EndCapture();
+					} else {
+						FileSystem::PathStr path;
+						FileSystem::MakePath(path, "Profiler.bin", FileSystem::RootType_Application);
+						Profiler::BeginCapture(path);
+					}
+				}
+				if (Profiler::IsCapturing()) {
+					Profiler::CaptureStats captureStats = Profiler::GetCaptureStats();
+					ImGui::Text("Capture: %u frames, %u dropped, %.2fMb written", captureStats.m_frameCount, captureStats.m_dropCount, (double)captureStats.m_writtenBytes / (1024.0 * 1024.0));
+				}
 				ImGui::EndMenu();
 			}
-			if (ImGui::SmallButton(Profiler::s_pause ? "Resume" : "Pause")) {
-				Profiler::s_pause = !Profiler::s_pause;
+			if (ImGui::SmallButton(Profiler::s_pause.load(std::memory_order_relaxed) ? "Resume" : "Pause")) {
+				Profiler::s_pause.store(!Profiler::s_pause.load(std::memory_order_relaxed), std::memory_order_relaxed);
 			}
 			ImGui::SameLine();
 			if (ImGui::SmallButton("Fit")) {
@@ -196,6 +461,14 @@ struct ProfilerViewer
 				m_regionBeg = - spacing;
 			}
 			ImGui::SameLine();
+			if (ImGui::SmallButton("Stats")) {
+				m_showStats = !m_showStats;
+			}
+			ImGui::SameLine();
+			if (ImGui::SmallButton("Counters")) {
+				m_showCounters = !m_showCounters;
+			}
+			ImGui::SameLine();
 			m_markerFilter.Draw("Filter", 160.0f);
 
 			ImGui::EndMenuBar();
@@ -220,7 +493,7 @@ struct ProfilerViewer
 
 		 // shortcuts
 			if (Input::GetKeyboard()->wasPressed(Keyboard::Key_P)) {
-				Profiler::s_pause = !Profiler::s_pause;
+				Profiler::s_pause.store(!Profiler::s_pause.load(std::memory_order_relaxed), std::memory_order_relaxed);
 			}
 		}
 
@@ -254,15 +527,15 @@ struct ProfilerViewer
 			float fend = timeToWindowX(frameNext.m_start);
 			for (uint j = frame.m_first, m = frame.m_first + frame.m_count; j < m; ++j) {
 				const Profiler::GpuMarker& marker = Profiler::GetGpuMarker(j);
-				if (drawFrameMarker(marker, fend)) {
-					vec2 lbeg = vec2(timeToWindowX(marker.m_start), m_windowBeg.y + ImGui::GetItemsLineHeightWithSpacing() * (float)marker.m_depth);
+				if (drawFrameMarker(frame, marker, fend)) {
+					vec2 lbeg = vec2(timeToWindowX(frame.getStart(marker)), m_windowBeg.y + ImGui::GetItemsLineHeightWithSpacing() * (float)marker.m_depth);
 					lbeg.y += ImGui::GetItemsLineHeightWithSpacing() * 0.5f;
-					vec2 lend = vec2(timeToWindowX(marker.m_cpuStart), m_windowBeg.y + m_windowSize.y);
+					vec2 lend = vec2(timeToWindowX(frame.getCpuStart(marker)), m_windowBeg.y + m_windowSize.y);
 					drawList.AddLine(lbeg, lend, kColors->kFrame, 2.0f);
 					ImGui::BeginTooltip();
-						ImGui::TextColored(ImColor(kColors->kFrame), marker.m_name);
-						ImGui::Text("Duration: %s", timeToStr(marker.m_end - marker.m_start));
-						ImGui::Text("Latency:  %s", timeToStr(marker.m_start - marker.m_cpuStart));
+						ImGui::TextColored(ImColor(kColors->kFrame), Profiler::GetMarkerName(marker));
+						ImGui::Text("Duration: %s", timeToStr(frame.getEnd(marker) - frame.getStart(marker)));
+						ImGui::Text("Latency:  %s", timeToStr(frame.getStart(marker) - frame.getCpuStart(marker)));
 					ImGui::EndTooltip();
 				}
 			}
@@ -276,40 +549,31 @@ struct ProfilerViewer
 
 		// CPU ---
 		kColors       = &kColorsCpu;
-		m_windowBeg.y = m_windowEnd.y + 1.0f;
-		m_windowEnd.y = m_windowBeg.y + m_windowSize.y + 1.0f;
+		float cpuEnd  = m_windowEnd.y + m_windowSize.y + 2.0f;
+
+	 // worker rows are sized to fit their deepest marker (up to half the CPU region), the main thread gets the rest
+		uint  threadCount = Profiler::GetCpuThreadCount();
+		float threadHeights[Profiler::kMaxCpuThreads];
+		float workerHeight = 0.0f;
+		for (uint i = 1; i < threadCount; ++i) {
+			threadHeights[i] = ImGui::GetFontSize() + 2.0f + ImGui::GetItemsLineHeightWithSpacing() * (float)(getCpuMaxDepth(i) + 1);
+			workerHeight += threadHeights[i];
+		}
+		float workerScale = APT_MIN(1.0f, m_windowSize.y * 0.5f / APT_MAX(workerHeight, 1.0f));
 
+		m_windowBeg.y = m_windowEnd.y + 1.0f;
+		m_windowEnd.y = cpuEnd - floorf(workerHeight * workerScale);
 		str.setf("CPU\n%s", timeToStr(Profiler::GetCpuAvgFrameDuration()));
 		drawList.AddText(vec2(infoX, m_windowBeg.y), kColors->kBackground, str);
+		drawCpuThread(0);
 
-		ImGui::PushClipRect(m_windowBeg, m_windowEnd, false);
-		for (uint i = 0, n = Profiler::GetGpuFrameCount() - 1; i < n; ++i) {
-			const Profiler::CpuFrame& frame = Profiler::GetCpuFrame(i);
-			const Profiler::CpuFrame& frameNext = Profiler::GetCpuFrame(i + 1);
-			if (cullFrame(frame, frameNext)) {
-				continue;
-			}
-
-		 // markers
-			ImGui::PushStyleVar(ImGuiStyleVar_FrameRounding, 0.0f);
-			m_windowBeg.y += ImGui::GetFontSize() + 2.0f; // space for the frame time
-			float fend = timeToWindowX(frameNext.m_start);
-			for (uint j = frame.m_first, m = frame.m_first + frame.m_count; j < m; ++j) {
-				const Profiler::CpuMarker& marker = Profiler::GetCpuMarker(j);
-				if (drawFrameMarker(marker, fend)) {
-					ImGui::BeginTooltip();
-						ImGui::TextColored(ImColor(kColors->kFrame), marker.m_name);
-						ImGui::Text("Duration: %s", timeToStr(marker.m_end - marker.m_start));
-					ImGui::EndTooltip();
-				}
-			}
-			m_windowBeg.y -= ImGui::GetFontSize() + 2.0f;
-			ImGui::PopStyleVar();
-
-			drawFrameBounds(frame, frameNext);
+		for (uint i = 1; i < threadCount; ++i) {
+			m_windowBeg.y = m_windowEnd.y;
+			m_windowEnd.y = m_windowBeg.y + floorf(threadHeights[i] * workerScale);
+			drawList.AddText(vec2(infoX, m_windowBeg.y), kColors->kBackground, Profiler::GetCpuThreadName(i));
+			drawCpuThread(i);
 		}
-		ImGui::PopClipRect();
-		drawList.AddRect(m_windowBeg, m_windowEnd, kColors->kBackground);
+		m_windowEnd.y = cpuEnd;
 
 		float regionSizePx = timeRange / m_regionSize * m_windowSize.x;
 		ImGui::SetNextWindowContentSize(ImVec2(regionSizePx, 0.0f));
@@ -335,6 +599,13 @@ struct ProfilerViewer
 		if (!m_isMarkerHovered) {
 			m_hoverName.clear();
 		}
+
+		if (m_showStats) {
+			drawStats(&m_showStats);
+		}
+		if (m_showCounters) {
+			drawCounters(&m_showCounters);
+		}
 	}
 };
 ProfilerViewer::Colors  ProfilerViewer::kColorsGpu;
@@ -354,41 +625,156 @@ void Profiler::ShowProfilerViewer(bool* _open_)
                                Profiler
 
 ******************************************************************************/
+
+// Marker names are interned by pointer (the common case is a string literal). Lookup is lock-free, the first push of
+// a new pointer takes a mutex and dedupes the string so that different pointers to the same name share an id.
+struct NameSlot
+{
+	std::atomic<const char*> m_key;
+	uint16                   m_id;
+};
+static const uint  kNameTableSize = Profiler::kMaxNames * 2; // max load factor 0.5
+static NameSlot    g_nameTable[kNameTableSize];
+static uint        g_nameSlotCount;
+static const uint16 kNameIdOverflow = 1; // shared by all names once the table or g_names is full
+static const char* g_names[Profiler::kMaxNames] = { "Unknown", "(overflow)" };
+static uint        g_nameCount = 2;
+static std::atomic<bool> g_nameTableFull; // set once g_nameTable reaches the max load factor, InternName() then skips the mutex
+static std::mutex  g_nameMutex;
+
+static uint16 InternNameSlow(const char* _name, uint _slot)
+{
+	std::lock_guard<std::mutex> lock(g_nameMutex);
+	for (;; _slot = (_slot + 1) & (kNameTableSize - 1)) {
+		const char* key = g_nameTable[_slot].m_key.load(std::memory_order_relaxed);
+		if (key == _name) {
+			return g_nameTable[_slot].m_id; // inserted by another thread
+		}
+		if (!key) {
+			break;
+		}
+	}
+	if (g_nameSlotCount == kNameTableSize / 2) {
+		if (!g_nameTableFull.load(std::memory_order_relaxed)) {
+			APT_LOG_ERR("Profiler: Too many marker name pointers (max %d), '%s' and subsequent new names will appear as '%s'", kNameTableSize / 2, _name, g_names[kNameIdOverflow]);
+			g_nameTableFull.store(true, std::memory_order_relaxed);
+		}
+		return kNameIdOverflow;
+	}
+
+	uint16 id = 0;
+	for (uint i = kNameIdOverflow + 1; i < g_nameCount; ++i) {
+		if (strcmp(g_names[i], _name) == 0) {
+			id = (uint16)i;
+			break;
+		}
+	}
+	if (id == 0) {
+		if (g_nameCount < (uint)Profiler::kMaxNames) {
+			id = (uint16)g_nameCount;
+			g_names[g_nameCount++] = _name;
+		} else {
+			static bool s_logged = false;
+			if (!s_logged) {
+				APT_LOG_ERR("Profiler: Too many marker names (max %d), '%s' and subsequent new names will appear as '%s'", Profiler::kMaxNames, _name, g_names[kNameIdOverflow]);
+				s_logged = true;
+			}
+			id = kNameIdOverflow;
+		}
+	}
+	g_nameTable[_slot].m_id = id;
+	g_nameTable[_slot].m_key.store(_name, std::memory_order_release);
+	++g_nameSlotCount;
+	return id;
+}
+
+static uint16 InternName(const char* _name)
+{
+	uint slot = (uint)(((uint64)(uintptr_t)_name * 0x9e3779b97f4a7c15ull) >> 32) & (kNameTableSize - 1);
+	for (;; slot = (slot + 1) & (kNameTableSize - 1)) {
+		const char* key = g_nameTable[slot].m_key.load(std::memory_order_acquire);
+		if (key == _name) {
+			return g_nameTable[slot].m_id;
+		}
+		if (!key) {
+			if (g_nameTableFull.load(std::memory_order_relaxed)) {
+				return kNameIdOverflow; // don't take the mutex for every push once full
+			}
+			return InternNameSlow(_name, slot);
+		}
+	}
+}
+
+// Convert an absolute time to ticks relative to _frameStart.
+static sint32 ToFrameTicks(uint64 _time, uint64 _frameStart)
+{
+	sint64 ret = (sint64)(_time - _frameStart);
+	return (sint32)APT_CLAMP(ret, (sint64)INT32_MIN, (sint64)INT32_MAX);
+}
+
+static uint RoundMarkersPerFrame(uint _count)
+{
+	_count = APT_CLAMP(_count, 1u, (uint)Profiler::kMaxMarkersPerFrame);
+	uint ret = 1;
+	while (ret < _count) {
+		ret <<= 1;
+	}
+	return ret;
+}
+
 template <typename tFrame, typename tMarker>
 struct ProfilerData
 {
-	RingBuffer<tFrame>  m_frames;
-	RingBuffer<tMarker> m_markers;
-	uint                m_markerStack[Profiler::kMaxDepth];
-	uint                m_markerStackTop;
-	uint64              m_avgFrameDuration;
-
-	ProfilerData(uint _frameCount, uint _maxTotalMarkersPerFrame)
+	static const uint kInvalidIndex = ~0u;
+
+	RingBuffer<tFrame>     m_frames;
+	eastl::vector<tMarker> m_markers;             // Ring buffer, the size is a power of 2.
+	uint                   m_markerCount;         // Total markers allocated, frame m_first/m_count index this sequence.
+	uint                   m_maxMarkersPerFrame;
+	uint                   m_markerStack[Profiler::kMaxDepth];
+	uint                   m_markerStackTop;
+	uint                   m_dropCount;
+	uint64                 m_avgFrameDuration;
+
+	ProfilerData(uint _frameCount, uint _maxMarkersPerFrame)
 		: m_frames(_frameCount)
-		, m_markers(_frameCount * _maxTotalMarkersPerFrame)
+		, m_markerStackTop(0)
+		, m_dropCount(0)
+		, m_avgFrameDuration(0)
 	{
-	 // \hack prime the frame/marker ring buffers and fill them with zeros, basically
-	 //  to avoid handling the edge case where the ring buffers are empty (which only happens
-	 //  when the app launches)
-
+	 // \hack prime the frame ring buffer and fill it with zeros, basically to avoid handling the edge case where
+	 //  the ring buffer is empty (which only happens when the app launches)
 		while (!m_frames.size() == m_frames.capacity()) {
 			m_frames.push_back(tFrame());
 		}
 		memset(m_frames.data(), 0, sizeof(tFrame) * m_frames.capacity());
-		while (!m_markers.size() == m_markers.capacity()) {
-			m_markers.push_back(tMarker());
+
+		init(_maxMarkersPerFrame);
+	}
+
+	// Reallocate the marker ring buffer, clear the marker history.
+	void init(uint _maxMarkersPerFrame)
+	{
+		APT_ASSERT(m_markerStackTop == 0);
+		m_maxMarkersPerFrame = RoundMarkersPerFrame(_maxMarkersPerFrame);
+		m_markers.clear();
+		m_markers.resize(m_maxMarkersPerFrame * Profiler::kMaxFrameCount);
+		memset(m_markers.data(), 0, sizeof(tMarker) * m_markers.size());
+		m_markerCount = 0;
+		for (uint i = 0; i < m_frames.size(); ++i) {
+			m_frames[i].m_first = 0;
+			m_frames[i].m_count = 0;
 		}
-		memset(m_markers.data(), 0, sizeof(tMarker) * m_markers.capacity());
 	}
 
-	uint     getCurrentMarkerIndex() const           { return &m_markers.back() - m_markers.data(); }
+	uint     getMarkerMask() const                   { return (uint)m_markers.size() - 1; }
+	tMarker& getMarker(uint _i)                      { return m_markers[_i & getMarkerMask()]; }
 	uint     getCurrentFrameIndex() const            { return &m_frames.back() - m_frames.data(); }
-	tMarker& getMarkerTop()                          { return m_markers.data()[m_markerStack[m_markerStackTop]]; }
 	uint     getMarkerIndex(const tMarker& _marker)  { return &_marker - m_markers.data(); }
 
 	tFrame& nextFrame()
 	{
-		APT_ASSERT_MSG(m_markerStackTop == 0, "Marker '%s' was not popped before frame end", getMarkerTop().m_name);
+		APT_ASSERT_MSG(m_markerStackTop == 0, "Marker '%s' was not popped before frame end", getStackTopName());
 		
 	 // get avg frame duration
 		m_avgFrameDuration = 0;
@@ -406,188 +792,1320 @@ struct ProfilerData
 		m_avgFrameDuration /= i;
 
 	 // advance to next frame
-		uint first = m_frames.back().m_first + m_frames.back().m_count;
 		m_frames.push_back(tFrame()); 
-		m_frames.back().m_first = first;
-		m_frames.back().m_count = 0;
+		memset(&m_frames.back(), 0, sizeof(tFrame));
+		m_frames.back().m_first = m_markerCount;
 		return m_frames.back(); 
 	}
 
-	tMarker& pushMarker(const char* _name)
+	// Return the sequence index of a new marker in the current frame, or kInvalidIndex if the frame is full.
+	uint allocMarker()
+	{
+		tFrame& frame = m_frames.back();
+		if (frame.m_count == m_maxMarkersPerFrame) {
+			++m_dropCount;
+			return kInvalidIndex;
+		}
+		++frame.m_count;
+		return m_markerCount++;
+	}
+
+	// Return nullptr if the marker was dropped (pop must still be called).
+	tMarker* pushMarker(uint16 _nameId)
 	{ 
 		APT_ASSERT(m_markerStackTop != Profiler::kMaxDepth);
-		m_markers.push_back(tMarker()); 
-		m_markerStack[m_markerStackTop++] = getCurrentMarkerIndex();
-		m_markers.back().m_name = _name;
-		m_markers.back().m_depth = (uint8)m_markerStackTop - 1;
-		m_frames.back().m_count++;
-		return m_markers.back(); 
+		uint i = allocMarker();
+		m_markerStack[m_markerStackTop++] = i;
+		if (i == kInvalidIndex) {
+			return nullptr;
+		}
+		tMarker& ret = getMarker(i);
+		ret.m_nameId = _nameId;
+		ret.m_depth  = (uint8)(m_markerStackTop - 1);
+		return &ret; 
 	}
 
-	tMarker& popMarker(const char* _name)
+	tMarker* popMarker(const char* _name)
 	{
-		tMarker& ret = m_markers.data()[m_markerStack[--m_markerStackTop]];
-		APT_ASSERT_MSG(strcmp(ret.m_name, _name) == 0, "Unmatched marker push/pop '%s'/'%s'", ret.m_name, _name);
-		return ret;
+		APT_ASSERT(m_markerStackTop > 0);
+		uint i = m_markerStack[--m_markerStackTop];
+		if (i == kInvalidIndex) {
+			return nullptr;
+		}
+		tMarker& ret = getMarker(i);
+		APT_ASSERT_MSG(ret.m_nameId <= kNameIdOverflow || strcmp(g_names[ret.m_nameId], _name) == 0, "Unmatched marker push/pop '%s'/'%s'", g_names[ret.m_nameId], _name);
+		return &ret;
 	}
 
-};
-static ProfilerData<Profiler::CpuFrame, Profiler::CpuMarker> s_cpu(Profiler::kMaxFrameCount, Profiler::kMaxTotalCpuMarkersPerFrame);
-static ProfilerData<Profiler::GpuFrame, Profiler::GpuMarker> s_gpu(Profiler::kMaxFrameCount, Profiler::kMaxTotalGpuMarkersPerFrame);
-
-
-
-static uint64 g_gpuTickOffset; // convert gpu time -> cpu time; note that this value can be arbitrarily large as the clocks aren't necessarily relative to the same moment
-static uint   g_gpuFrameQueryRetrieved;
-static bool   g_gpuInit = true;
-static GLuint g_gpuFrameStartQueries[Profiler::kMaxFrameCount] = {};
-static GLuint g_gpuMarkerStartQueries[Profiler::kMaxFrameCount * Profiler::kMaxTotalGpuMarkersPerFrame] = {};
-static GLuint g_gpuMarkerEndQueries[Profiler::kMaxFrameCount * Profiler::kMaxTotalGpuMarkersPerFrame]   = {};
+	const char* getStackTopName()
+	{
+		uint i = m_markerStack[m_markerStackTop - 1];
+		return i == kInvalidIndex ? "(dropped)" : g_names[getMarker(i).m_nameId];
+	}
 
+};
+static ProfilerData<Profiler::CpuFrame, Profiler::CpuMarker> s_cpu(Profiler::kMaxFrameCount, Profiler::kDefaultCpuMarkersPerFrame);
+static ProfilerData<Profiler::GpuFrame, Profiler::GpuMarker> s_gpu(Profiler::kMaxFrameCount, Profiler::kDefaultGpuMarkersPerFrame);
+static uint g_maxCpuMarkersPerFrame = Profiler::kDefaultCpuMarkersPerFrame; // Applied by NextFrame().
+static uint g_maxGpuMarkersPerFrame = Profiler::kDefaultGpuMarkersPerFrame; //    "
 
-static uint64 GpuToSystemTicks(GLuint64 _gpuTime)
-{
-	return (uint64)_gpuTime * Time::GetSystemFrequency() / 1000000000ull; // nanoseconds -> system ticks
-}
-static uint64 GpuToTimestamp(GLuint64 _gpuTime)
+struct CpuThread
 {
-	uint64 ret = GpuToSystemTicks(_gpuTime);
-	return ret + g_gpuTickOffset;
-}
+	typedef ProfilerData<Profiler::CpuFrame, Profiler::CpuMarker> Data;
 
+ // absolute times, converted to frame-relative by flush()
+	struct RawMarker
+	{
+		uint64 m_start;
+		uint64 m_end;
+		uint16 m_nameId;
+		uint8  m_depth;
+	};
 
-APT_DEFINE_STATIC_INIT(Profiler);
+	String<32>          m_name;
+	bool                m_isMain;
+	Data*               m_data;        // Frame history; s_cpu for the main thread, else written by flush().
 
-// PUBLIC
+ // owning thread only
+	RawMarker           m_stack[Profiler::kMaxDepth];
+	uint                m_stackTop;
 
-void Profiler::NextFrame()
-{
-	if_unlikely (g_gpuInit) {
-		glAssert(glGenQueries(kMaxFrameCount, g_gpuFrameStartQueries));
-		glAssert(glGenQueries(kMaxFrameCount * kMaxTotalGpuMarkersPerFrame, g_gpuMarkerStartQueries));
-		glAssert(glGenQueries(kMaxFrameCount * kMaxTotalGpuMarkersPerFrame, g_gpuMarkerEndQueries));
-		g_gpuInit = false;
+ // completed markers, m_write is advanced by the owning thread and m_read by flush()
+	RawMarker           m_buffer[Profiler::kCpuThreadBufferSize];
+	std::atomic<uint>   m_write;
+	std::atomic<uint>   m_read;
+	std::atomic<uint>   m_dropCount;
 
-		ResetGpuOffset();
-	}
+ // counter values for the current frame, added by the owning thread and taken by NextFrame()
+	std::atomic<uint64> m_counters[Profiler::kMaxCounters];
 
-	if (s_pause) {
-		return;
+	void pushMarker(const char* _name)
+	{
+		APT_ASSERT(m_stackTop != Profiler::kMaxDepth);
+		RawMarker& marker = m_stack[m_stackTop];
+		marker.m_nameId = InternName(_name);
+		marker.m_depth  = (uint8)m_stackTop;
+		++m_stackTop;
+		marker.m_start  = (uint64)Time::GetTimestamp().getRaw();
 	}
 
- // CPU: advance frame, get start time/first marker index
-	s_cpu.nextFrame().m_start = (uint64)Time::GetTimestamp().getRaw();
+	void popMarker(const char* _name)
+	{
+		uint64 end = (uint64)Time::GetTimestamp().getRaw();
+		APT_ASSERT(m_stackTop > 0);
+		RawMarker& marker = m_stack[--m_stackTop];
+		APT_ASSERT_MSG(marker.m_nameId <= kNameIdOverflow || strcmp(g_names[marker.m_nameId], _name) == 0, "Unmatched marker push/pop '%s'/'%s'", g_names[marker.m_nameId], _name);
+		marker.m_end = end;
+		if (Profiler::s_pause.load(std::memory_order_relaxed)) {
+			return;
+		}
+		uint w = m_write.load(std::memory_order_relaxed);
+		if (w - m_read.load(std::memory_order_acquire) == Profiler::kCpuThreadBufferSize) {
+			m_dropCount.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		m_buffer[w & (Profiler::kCpuThreadBufferSize - 1)] = marker;
+		m_write.store(w + 1, std::memory_order_release);
+	}
 
- // GPU: retrieve all queries **up to** the last available frame (i.e. when we implicitly know they are available)
-	GLint frameAvailable = GL_FALSE;
-	uint gpuFrameQueryAvail	= g_gpuFrameQueryRetrieved;
-	while (g_gpuFrameQueryRetrieved != s_gpu.getCurrentFrameIndex()) {
-		glAssert(glGetQueryObjectiv(g_gpuFrameStartQueries[g_gpuFrameQueryRetrieved], GL_QUERY_RESULT_AVAILABLE, &frameAvailable));
-		if (frameAvailable == GL_FALSE) {
-			break;
+	// Move completed markers into the current frame of m_data, called by NextFrame() before advancing the frame.
+	void flush()
+	{
+		uint r = m_read.load(std::memory_order_relaxed);
+		uint w = m_write.load(std::memory_order_acquire);
+		uint64 frameStart = m_data->m_frames.back().m_start;
+		for (; r != w; ++r) {
+			uint i = m_data->allocMarker();
+			if (i == Data::kInvalidIndex) {
+				m_dropCount.fetch_add(w - r, std::memory_order_relaxed);
+				break;
+			}
+			const RawMarker& src = m_buffer[r & (Profiler::kCpuThreadBufferSize - 1)];
+			Profiler::CpuMarker& dst = m_data->getMarker(i);
+			dst.m_start  = ToFrameTicks(src.m_start, frameStart);
+			dst.m_end    = ToFrameTicks(src.m_end, frameStart);
+			dst.m_nameId = src.m_nameId;
+			dst.m_depth  = src.m_depth;
 		}
-		g_gpuFrameQueryRetrieved = (g_gpuFrameQueryRetrieved + 1) % kMaxFrameCount;
+		m_read.store(w, std::memory_order_release);
 	}
+};
+static_assert((Profiler::kCpuThreadBufferSize & (Profiler::kCpuThreadBufferSize - 1)) == 0, "kCpuThreadBufferSize must be a power of 2");
+static_assert((Profiler::kMaxFrameCount & (Profiler::kMaxFrameCount - 1)) == 0, "kMaxFrameCount must be a power of 2");
 
-	for (; gpuFrameQueryAvail != g_gpuFrameQueryRetrieved; gpuFrameQueryAvail = (gpuFrameQueryAvail + 1) % kMaxFrameCount) {
-		GpuFrame& frame = s_gpu.m_frames.data()[gpuFrameQueryAvail];
-		GLuint64 gpuTime;
-		glAssert(glGetQueryObjectui64v(g_gpuFrameStartQueries[gpuFrameQueryAvail], GL_QUERY_RESULT, &gpuTime));
-		frame.m_start = GpuToTimestamp(gpuTime);
+// Threads are registered on first use and never unregistered (a thread which exits keeps its row in the viewer).
+static std::thread::id               g_cpuMainThreadId;   // Set by Init().
+static std::atomic<CpuThread*>       g_cpuThreads[Profiler::kMaxCpuThreads]; // Null until the thread is registered.
+static std::atomic<uint>             g_cpuThreadCount(1); // Slot 0 is reserved for the main thread.
+static thread_local CpuThread*       g_cpuThread;
 
-		for (uint i = frame.m_first, n = frame.m_first + frame.m_count; i < n; ++i) {
-			uint j = i % s_gpu.m_markers.capacity();
-			GpuMarker& marker = s_gpu.m_markers.data()[j];
+static CpuThread* RegisterCpuThread(const char* _name)
+{
+	CpuThread* ret   = new CpuThread;
+	ret->m_isMain    = std::this_thread::get_id() == g_cpuMainThreadId;
+	ret->m_data      = nullptr;
+	ret->m_stackTop  = 0;
+	ret->m_write     = 0;
+	ret->m_read      = 0;
+	ret->m_dropCount = 0;
+	for (auto& counter : ret->m_counters) {
+		counter = 0;
+	}
 
-	//glAssert(glGetQueryObjectiv(g_gpuMarkerStartQueries[j], GL_QUERY_RESULT_AVAILABLE, &frameAvailable));
-	//APT_ASSERT(frameAvailable == GL_TRUE);
-			glAssert(glGetQueryObjectui64v(g_gpuMarkerStartQueries[j], GL_QUERY_RESULT, &gpuTime));
-			marker.m_start = GpuToTimestamp(gpuTime);
-			
-	//glAssert(glGetQueryObjectiv(g_gpuMarkerEndQueries[j], GL_QUERY_RESULT_AVAILABLE, &frameAvailable));
-	//APT_ASSERT(frameAvailable == GL_TRUE);
-			glAssert(glGetQueryObjectui64v(g_gpuMarkerEndQueries[j], GL_QUERY_RESULT, &gpuTime));
-			marker.m_end = GpuToTimestamp(gpuTime);
-		}
+	if (ret->m_isMain) {
+		ret->m_name.set(_name ? _name : "Main");
+		ret->m_data = &s_cpu;
+		g_cpuThreads[0].store(ret, std::memory_order_release);
+		return ret;
 	}
 
-	s_gpu.nextFrame().m_start = 0;
-	glAssert(glQueryCounter(g_gpuFrameStartQueries[s_gpu.getCurrentFrameIndex()], GL_TIMESTAMP));
+	uint i = g_cpuThreadCount.fetch_add(1);
+	if (_name) {
+		ret->m_name.set(_name);
+	} else {
+		ret->m_name.setf("Thread %u", i);
+	}
+	if (i >= (uint)Profiler::kMaxCpuThreads) {
+	 // never published, markers fill the buffer and are dropped
+		APT_LOG_ERR("Profiler: Too many threads (max %d), markers from '%s' will be ignored", Profiler::kMaxCpuThreads, (const char*)ret->m_name);
+		return ret;
+	}
+ // capacity is corrected by NextFrame() if it differs, the history starts with a single (empty) frame
+	ret->m_data = new CpuThread::Data(Profiler::kMaxFrameCount, Profiler::kDefaultCpuMarkersPerFrame);
+	ret->m_data->m_frames.push_back(Profiler::CpuFrame());
+	memset(&ret->m_data->m_frames.back(), 0, sizeof(Profiler::CpuFrame));
+	g_cpuThreads[i].store(ret, std::memory_order_release);
+	return ret;
 }
 
-void Profiler::PushCpuMarker(const char* _name)
+static CpuThread* GetCpuThread()
 {
-	if (s_pause) {
-		return;
+	if_unlikely (!g_cpuThread) {
+		g_cpuThread = RegisterCpuThread(nullptr);
 	}
-	s_cpu.pushMarker(_name).m_start = (uint64)Time::GetTimestamp().getRaw();
+	return g_cpuThread;
 }
 
-void Profiler::PopCpuMarker(const char* _name)
+static CpuThread::Data& GetCpuThreadData(uint _thread)
 {
-	if (s_pause) {
-		return;
+	if (_thread == 0) {
+		return s_cpu;
 	}
-	s_cpu.popMarker(_name).m_end = (uint64)Time::GetTimestamp().getRaw();
+	CpuThread* thread = g_cpuThreads[_thread].load(std::memory_order_acquire);
+	APT_ASSERT(thread && thread->m_data);
+	return *thread->m_data;
 }
 
-const Profiler::CpuFrame& Profiler::GetCpuFrame(uint _i)
+
+
+static uint64 g_gpuTickOffset; // convert gpu time -> cpu time; note that this value can be arbitrarily large as the clocks aren't necessarily relative to the same moment
+static bool   g_gpuInit = true;
+
+// Timer queries are allocated from a pool when a marker is pushed and returned once the result is read (or the
+// frame is discarded), hence the pool only grows to cover the markers in flight. Results are read only when
+// available, the CPU never waits on the GPU.
+struct GpuMarkerQueries
 {
-	return s_cpu.m_frames[_i];
-}
+	GLuint m_start;
+	GLuint m_end;
+};
+struct GpuFrameQueries
+{
+	GLuint m_start;
+	GLuint m_last;     // Last query issued during the frame; results of a frame are read once this is available.
+	uint64 m_index;    // Value of g_frameIndex when the frame was issued.
+	bool   m_pending;
+};
+static eastl::vector<GLuint>           g_gpuQueryPool;                                  // Free queries.
+static eastl::vector<GpuMarkerQueries> g_gpuMarkerQueries;                              // Parallel to s_gpu.m_markers.
+static GpuFrameQueries                 g_gpuFrameQueries[Profiler::kMaxFrameCount];     // Parallel to s_gpu.m_frames.
+static uint                            g_gpuFrameResolved;                              // Index of the oldest unresolved frame in s_gpu.m_frames.
+static uint64                          g_frameIndex;                                    // Incremented by NextFrame().
+static Profiler::GpuStats              g_gpuStats;
 
-uint Profiler::GetCpuFrameCount()
+
+static uint64 GpuToSystemTicks(GLuint64 _gpuTime)
 {
-	return s_cpu.m_frames.size();
+	return (uint64)_gpuTime * Time::GetSystemFrequency() / 1000000000ull; // nanoseconds -> system ticks
 }
-
-const uint64 Profiler::GetCpuAvgFrameDuration()
+static uint64 GpuToTimestamp(GLuint64 _gpuTime)
 {
-	return s_cpu.m_avgFrameDuration;
+	uint64 ret = GpuToSystemTicks(_gpuTime);
+	return ret + g_gpuTickOffset;
 }
 
-uint Profiler::GetCpuFrameIndex(const CpuFrame& _frame)
+static GLuint AllocGpuQuery()
 {
-	return (uint)(&_frame - s_cpu.m_frames.data());
+	if_unlikely (g_gpuQueryPool.empty()) {
+		uint growCount = APT_MAX(g_gpuStats.m_queryCount / 2, 64u);
+		g_gpuQueryPool.resize(growCount);
+		glAssert(glGenQueries((GLsizei)growCount, g_gpuQueryPool.data()));
+		g_gpuStats.m_queryCount += growCount;
+	}
+	GLuint ret = g_gpuQueryPool.back();
+	g_gpuQueryPool.pop_back();
+	return ret;
 }
 
-const Profiler::CpuMarker& Profiler::GetCpuMarker(uint _i) 
+static void FreeGpuQuery(GLuint _query)
 {
-	return s_cpu.m_markers.data()[_i % s_cpu.m_markers.capacity()];
+	g_gpuQueryPool.push_back(_query);
 }
 
-void Profiler::PushGpuMarker(const char* _name)
+static bool IsGpuQueryAvailable(GLuint _query)
 {
-	if (s_pause) {
-		return;
-	}
-	s_gpu.pushMarker(_name).m_cpuStart = Time::GetTimestamp().getRaw();
-	glAssert(glQueryCounter(g_gpuMarkerStartQueries[s_gpu.getCurrentMarkerIndex()], GL_TIMESTAMP));
+	GLint ret = GL_FALSE;
+	glAssert(glGetQueryObjectiv(_query, GL_QUERY_RESULT_AVAILABLE, &ret));
+	return ret != GL_FALSE;
 }
 
-void Profiler::PopGpuMarker(const char* _name)
+// Return the queries of frame _i to the pool. If _late, the results weren't read.
+static void FreeGpuFrame(uint _i, bool _late)
 {
-	if (s_pause) {
+	GpuFrameQueries& queries = g_gpuFrameQueries[_i];
+	if (!queries.m_pending) {
 		return;
 	}
-	GpuMarker& marker = s_gpu.popMarker(_name);
-	glAssert(glQueryCounter(g_gpuMarkerEndQueries[s_gpu.getMarkerIndex(marker)], GL_TIMESTAMP));
+	Profiler::GpuFrame& frame = s_gpu.m_frames.data()[_i];
+	FreeGpuQuery(queries.m_start);
+	for (uint j = frame.m_first, n = frame.m_first + frame.m_count; j < n; ++j) {
+		GpuMarkerQueries& markerQueries = g_gpuMarkerQueries[j & s_gpu.getMarkerMask()];
+		FreeGpuQuery(markerQueries.m_start);
+		FreeGpuQuery(markerQueries.m_end);
+	}
+	queries.m_pending = false;
+	--g_gpuStats.m_pendingFrameCount;
+	if (_late) {
+		frame.m_start = 0; // invalid frame, see nextFrame()
+		++g_gpuStats.m_lateFrameCount;
+		g_gpuStats.m_lateMarkerCount += frame.m_count;
+	}
 }
 
-const Profiler::GpuFrame& Profiler::GetGpuFrame(uint _i)
+// Read the results for frame _i if available. Return false if the results aren't available yet.
+static bool ResolveGpuFrame(uint _i)
 {
-	return s_gpu.m_frames[_i];
+	GpuFrameQueries& queries = g_gpuFrameQueries[_i];
+	if (!IsGpuQueryAvailable(queries.m_last) || !IsGpuQueryAvailable(queries.m_start)) {
+		return false;
+	}
+
+	Profiler::GpuFrame& frame = s_gpu.m_frames.data()[_i];
+	GLuint64 gpuTime;
+	glAssert(glGetQueryObjectui64v(queries.m_start, GL_QUERY_RESULT, &gpuTime));
+	frame.m_start = GpuToTimestamp(gpuTime);
+	for (uint j = frame.m_first, n = frame.m_first + frame.m_count; j < n; ++j) {
+		Profiler::GpuMarker& marker = s_gpu.getMarker(j);
+		GpuMarkerQueries& markerQueries = g_gpuMarkerQueries[j & s_gpu.getMarkerMask()];
+	 // results should be available in issue order, check each query anyway to guarantee that the read doesn't block
+		if (!IsGpuQueryAvailable(markerQueries.m_start) || !IsGpuQueryAvailable(markerQueries.m_end)) {
+			marker.m_start = marker.m_end = 0;
+			++g_gpuStats.m_lateMarkerCount;
+			continue;
+		}
+		glAssert(glGetQueryObjectui64v(markerQueries.m_start, GL_QUERY_RESULT, &gpuTime));
+		marker.m_start = ToFrameTicks(GpuToTimestamp(gpuTime), frame.m_start);
+		glAssert(glGetQueryObjectui64v(markerQueries.m_end, GL_QUERY_RESULT, &gpuTime));
+		marker.m_end = ToFrameTicks(GpuToTimestamp(gpuTime), frame.m_start);
+	}
+
+	g_gpuStats.m_latency    = (uint)(g_frameIndex - queries.m_index);
+	g_gpuStats.m_maxLatency = APT_MAX(g_gpuStats.m_maxLatency, g_gpuStats.m_latency);
+	FreeGpuFrame(_i, false);
+	return true;
 }
 
-uint Profiler::GetGpuFrameCount()
+// Log-linear histogram of durations: values < kStatsSubBinCount have their own bin, above that each power of 2 is
+// split into kStatsSubBinCount bins (hence the bin width is at most 1/16 of the value).
+static const uint kStatsSubBits     = 4;
+static const uint kStatsSubBinCount = 1 << kStatsSubBits;
+static const uint kStatsBinCount    = (64 - kStatsSubBits + 1) * kStatsSubBinCount;
+
+static uint FindMsb(uint64 _x)
 {
-	return s_gpu.m_frames.size();
+	uint ret = 0;
+	if (_x >> 32) { _x >>= 32; ret += 32; }
+	if (_x >> 16) { _x >>= 16; ret += 16; }
+	if (_x >> 8)  { _x >>= 8;  ret += 8;  }
+	if (_x >> 4)  { _x >>= 4;  ret += 4;  }
+	if (_x >> 2)  { _x >>= 2;  ret += 2;  }
+	if (_x >> 1)  {            ret += 1;  }
+	return ret;
 }
 
-uint64 Profiler::GetGpuAvgFrameDuration()
+struct MarkerHistogram
 {
-	return s_gpu.m_avgFrameDuration;
-}
+	uint   m_bins[kStatsBinCount];
+	uint   m_count;
+	uint64 m_total;
+	uint64 m_min;
+	uint64 m_max;
+
+	static uint GetBin(uint64 _x)
+	{
+		if (_x < kStatsSubBinCount) {
+			return (uint)_x;
+		}
+		uint msb = FindMsb(_x);
+		uint sub = (uint)(_x >> (msb - kStatsSubBits)) & (kStatsSubBinCount - 1);
+		return (msb - kStatsSubBits + 1) * kStatsSubBinCount + sub;
+	}
+
+	// Midpoint of the range of values in _bin.
+	static uint64 GetBinValue(uint _bin)
+	{
+		if (_bin < kStatsSubBinCount) {
+			return _bin;
+		}
+		uint shift = _bin / kStatsSubBinCount - 1;
+		uint64 beg = (uint64)(kStatsSubBinCount + _bin % kStatsSubBinCount) << shift;
+		return beg + ((1ull << shift) >> 1);
+	}
+
+	void reset()
+	{
+		memset(m_bins, 0, sizeof(m_bins));
+		m_count = 0;
+		m_total = 0;
+		m_min   = 0;
+		m_max   = 0;
+	}
+
+	void add(uint64 _x)
+	{
+		++m_bins[GetBin(_x)];
+		m_min = m_count > 0 ? APT_MIN(m_min, _x) : _x;
+		m_max = APT_MAX(m_max, _x);
+		m_total += _x;
+		++m_count;
+	}
+
+	void getStats(Profiler::MarkerStats& stats_, uint _frameCount) const
+	{
+		stats_.m_count    = m_count;
+		stats_.m_total    = m_total;
+		stats_.m_perFrame = _frameCount > 0 ? m_total / _frameCount : 0;
+		stats_.m_min      = m_min;
+		stats_.m_mean     = m_count > 0 ? m_total / m_count : 0;
+		stats_.m_max      = m_max;
+
+	 // find the bins which contain the nth sample for each percentile
+		const double kPercentiles[] = { 0.5, 0.95, 0.99 };
+		uint64* ret[] = { &stats_.m_p50, &stats_.m_p95, &stats_.m_p99 };
+		uint p = 0;
+		uint64 sum = 0;
+		for (uint i = 0; i < kStatsBinCount && p < 3; ++i) {
+			sum += m_bins[i];
+			while (p < 3 && sum > 0 && sum >= (uint64)ceil(kPercentiles[p] * (double)m_count)) {
+				*ret[p++] = APT_CLAMP(GetBinValue(i), stats_.m_min, stats_.m_max);
+			}
+		}
+		for (; p < 3; ++p) {
+			*ret[p] = 0;
+		}
+	}
+};
+
+// Histograms are allocated on the first sample of each name.
+static eastl::vector<MarkerHistogram*> g_cpuMarkerStats(Profiler::kMaxNames, nullptr);   // By name id.
+static eastl::vector<MarkerHistogram*> g_gpuMarkerStats(Profiler::kMaxNames, nullptr);   //    "
+static MarkerHistogram                 g_cpuFrameStats;
+static MarkerHistogram                 g_gpuFrameStats;
+static uint                            g_cpuStatsFrameCount;
+static uint                            g_gpuStatsFrameCount;
+static uint64                          g_gpuStatsPrevIndex = ~0ull;                     // m_index/m_start of the last resolved Gpu frame.
+static uint64                          g_gpuStatsPrevStart;
+
+// Late Gpu markers are zeroed by ResolveGpuFrame(), Cpu markers are always valid (and may legitimately be 0,0 at the
+// start of a frame).
+static bool IsMarkerResolved(const Profiler::CpuMarker& _marker) { return true; }
+static bool IsMarkerResolved(const Profiler::GpuMarker& _marker) { return _marker.m_start != 0 || _marker.m_end != 0; }
+
+template <typename tFrame, typename tMarker>
+static void AccumulateStats(eastl::vector<MarkerHistogram*>& _stats, ProfilerData<tFrame, tMarker>& _data, const tFrame& _frame)
+{
+	for (uint i = _frame.m_first, n = _frame.m_first + _frame.m_count; i < n; ++i) {
+		const tMarker& marker = _data.getMarker(i);
+		if (!IsMarkerResolved(marker)) {
+			continue;
+		}
+		MarkerHistogram*& histogram = _stats[marker.m_nameId];
+		if_unlikely (!histogram) {
+			histogram = new MarkerHistogram;
+			histogram->reset();
+		}
+		histogram->add((uint64)APT_MAX(marker.m_end - marker.m_start, 0));
+	}
+}
+
+static bool FindMarkerStats(const eastl::vector<MarkerHistogram*>& _stats, uint _frameCount, const char* _name, Profiler::MarkerStats& stats_)
+{
+	std::lock_guard<std::mutex> lock(g_nameMutex);
+	for (uint i = 0; i < g_nameCount; ++i) {
+		if (_stats[i] && _stats[i]->m_count > 0 && strcmp(g_names[i], _name) == 0) {
+			stats_.m_name = g_names[i];
+			_stats[i]->getStats(stats_, _frameCount);
+			return true;
+		}
+	}
+	return false;
+}
+
+static uint GetMarkerStatsList(const eastl::vector<MarkerHistogram*>& _stats, uint _frameCount, Profiler::MarkerStats* list_, uint _maxCount)
+{
+	eastl::vector<uint16> ids;
+	for (uint i = 0; i < Profiler::kMaxNames; ++i) {
+		if (_stats[i] && _stats[i]->m_count > 0) {
+			ids.push_back((uint16)i);
+		}
+	}
+	eastl::sort(ids.begin(), ids.end(), [&_stats](uint16 _a, uint16 _b) { return _stats[_a]->m_total > _stats[_b]->m_total; });
+	uint ret = APT_MIN((uint)ids.size(), _maxCount);
+	for (uint i = 0; i < ret; ++i) {
+		list_[i].m_name = g_names[ids[i]];
+		_stats[ids[i]]->getStats(list_[i], _frameCount);
+	}
+	return ret;
+}
+
+struct SpikeData
+{
+	Profiler::Spike                   m_spike;
+	eastl::vector<Profiler::CpuMarker> m_markers;
+};
+static eastl::vector<SpikeData> g_spikes;            // Ordered by frame index.
+static uint64                   g_spikeThreshold;    // Ticks, 0 = disabled.
+
+// Copy the main thread markers for _frame, replace the shortest spike if kMaxSpikes is exceeded.
+static void PinSpike(const Profiler::CpuFrame& _frame, uint64 _duration)
+{
+	if ((int)g_spikes.size() == Profiler::kMaxSpikes) {
+		auto shortest = g_spikes.begin();
+		for (auto it = g_spikes.begin(); it != g_spikes.end(); ++it) {
+			if (it->m_spike.m_duration < shortest->m_spike.m_duration) {
+				shortest = it;
+			}
+		}
+		if (shortest->m_spike.m_duration >= _duration) {
+			return;
+		}
+		g_spikes.erase(shortest);
+	}
+	g_spikes.push_back();
+	SpikeData& spike = g_spikes.back();
+	spike.m_spike.m_frameIndex  = g_frameIndex;
+	spike.m_spike.m_start       = _frame.m_start;
+	spike.m_spike.m_duration    = _duration;
+	spike.m_spike.m_markerCount = _frame.m_count;
+	spike.m_markers.resize(_frame.m_count);
+	for (uint i = 0; i < _frame.m_count; ++i) {
+		spike.m_markers[i] = s_cpu.getMarker(_frame.m_first + i);
+	}
+}
+
+
+// Counters are registered by name id on first use. Values are summed over all threads by NextFrame() and stored per
+// frame, parallel to s_cpu.m_frames.
+static const uint8                     kCounterInvalid = 0xff;
+static std::atomic<uint8>              g_counterIndex[Profiler::kMaxNames];             // Counter index + 1 by name id, 0 if unregistered.
+static uint16                          g_counterNameIds[Profiler::kMaxCounters];
+static std::atomic<uint>               g_counterCount;
+static std::mutex                      g_counterMutex;
+static uint64                          g_counterValues[Profiler::kMaxFrameCount][Profiler::kMaxCounters];
+static eastl::vector<MarkerHistogram*> g_counterStats(Profiler::kMaxCounters, nullptr);
+
+// Return kMaxCounters if the counter can't be registered.
+static uint GetCounterIndex(const char* _name)
+{
+	uint16 nameId = InternName(_name);
+	uint ret = g_counterIndex[nameId].load(std::memory_order_acquire);
+	if (ret != 0) {
+		return ret == kCounterInvalid ? (uint)Profiler::kMaxCounters : ret - 1;
+	}
+
+	std::lock_guard<std::mutex> lock(g_counterMutex);
+	ret = g_counterIndex[nameId].load(std::memory_order_relaxed);
+	if (ret != 0) {
+		return ret == kCounterInvalid ? (uint)Profiler::kMaxCounters : ret - 1;
+	}
+	ret = g_counterCount.load(std::memory_order_relaxed);
+	if (ret == (uint)Profiler::kMaxCounters) {
+		APT_LOG_ERR("Profiler: Too many counters (max %d), '%s' will be ignored", Profiler::kMaxCounters, _name);
+		g_counterIndex[nameId].store(kCounterInvalid, std::memory_order_release);
+		return Profiler::kMaxCounters;
+	}
+	g_counterNameIds[ret] = nameId;
+	g_counterCount.store(ret + 1, std::memory_order_release);
+	g_counterIndex[nameId].store((uint8)(ret + 1), std::memory_order_release);
+	return ret;
+}
+static_assert(Profiler::kMaxCounters < kCounterInvalid, "kMaxCounters must be < kCounterInvalid");
+
+// Capture file layout: CaptureHeader followed by a sequence of records. Each record is a CaptureRecord followed by
+// m_count chars (name and thread records), m_count CaptureMarkers (frame records) or m_count CaptureCounters (counter
+// records, which follow the main thread frame record). Name and thread records are written before the first record
+// which references them. Host byte order.
+static const uint32 kCaptureMagic     = 0x50435246; // 'FRCP'
+static const uint32 kCaptureVersion   = 2;
+static const uint16 kCaptureGpuThread = 0xffff;     // Thread id of Gpu frame records.
+static const size_t kCaptureChunkSize = 256 * 1024; // Serialized data is dispatched to the writer in chunks of at least this size (or half the max queue size).
+
+struct CaptureHeader
+{
+	uint32 m_magic;
+	uint32 m_version;
+	uint64 m_frequency;  // System ticks per second.
+	uint64 m_start;      // Trace timestamps are relative to this.
+};
+
+enum CaptureRecordType
+{
+	CaptureRecord_Name,
+	CaptureRecord_Thread,
+	CaptureRecord_Frame,
+	CaptureRecord_Counters  // Version 2.
+};
+
+struct CaptureRecord
+{
+	uint16 m_type;       // CaptureRecordType.
+	uint16 m_id;         // Name id, thread index or kCaptureGpuThread.
+	uint32 m_count;      // String length, marker or counter count.
+	uint64 m_start;      // Frame start (frame and counter records only).
+};
+
+struct CaptureMarker
+{
+	sint32 m_start;      // Relative to the frame start.
+	sint32 m_end;
+	uint16 m_nameId;
+	uint8  m_depth;
+	uint8  m_pad;
+};
+
+struct CaptureCounter
+{
+	uint64 m_value;
+	uint16 m_nameId;
+	uint16 m_pad[3];
+};
+
+// Serialize frames to m_data, writing name/thread records on first use.
+struct CaptureWriter
+{
+	eastl::vector<char>* m_data;
+	bool                 m_names[Profiler::kMaxNames];
+	bool                 m_threads[Profiler::kMaxCpuThreads + 1]; // The last entry is the Gpu.
+
+	void reset(eastl::vector<char>* _data)
+	{
+		m_data = _data;
+		memset(m_names, 0, sizeof(m_names));
+		memset(m_threads, 0, sizeof(m_threads));
+	}
+
+	void write(const void* _src, size_t _size)
+	{
+		m_data->insert(m_data->end(), (const char*)_src, (const char*)_src + _size);
+	}
+
+	void writeString(CaptureRecordType _type, uint16 _id, const char* _str)
+	{
+		CaptureRecord record = {};
+		record.m_type  = (uint16)_type;
+		record.m_id    = _id;
+		record.m_count = (uint32)strlen(_str);
+		write(&record, sizeof(record));
+		write(_str, record.m_count);
+	}
+
+	template <typename tFrame, typename tMarker>
+	void writeFrame(uint16 _thread, ProfilerData<tFrame, tMarker>& _data, const tFrame& _frame)
+	{
+		bool& threadWritten = m_threads[_thread == kCaptureGpuThread ? Profiler::kMaxCpuThreads : _thread];
+		if (!threadWritten) {
+			writeString(CaptureRecord_Thread, _thread, _thread == kCaptureGpuThread ? "GPU" : Profiler::GetCpuThreadName(_thread));
+			threadWritten = true;
+		}
+		for (uint i = _frame.m_first, n = _frame.m_first + _frame.m_count; i < n; ++i) {
+			uint16 nameId = _data.getMarker(i).m_nameId;
+			if (!m_names[nameId]) {
+				writeString(CaptureRecord_Name, nameId, g_names[nameId]);
+				m_names[nameId] = true;
+			}
+		}
+
+		CaptureRecord record = {};
+		record.m_type  = (uint16)CaptureRecord_Frame;
+		record.m_id    = _thread;
+		record.m_start = _frame.m_start;
+		size_t offset = m_data->size();
+		m_data->resize(offset + sizeof(CaptureRecord) + _frame.m_count * sizeof(CaptureMarker));
+		char* dst = m_data->data() + offset + sizeof(CaptureRecord);
+		for (uint i = _frame.m_first, n = _frame.m_first + _frame.m_count; i < n; ++i) {
+			const tMarker& src = _data.getMarker(i);
+			if (!IsMarkerResolved(src)) {
+				continue;
+			}
+			CaptureMarker marker = { src.m_start, src.m_end, src.m_nameId, src.m_depth, 0 };
+			memcpy(dst, &marker, sizeof(CaptureMarker));
+			dst += sizeof(CaptureMarker);
+			++record.m_count;
+		}
+		m_data->resize(offset + sizeof(CaptureRecord) + record.m_count * sizeof(CaptureMarker));
+		memcpy(m_data->data() + offset, &record, sizeof(CaptureRecord));
+	}
+
+	// Write the values of all registered counters for the main thread frame _frame.
+	void writeCounters(const Profiler::CpuFrame& _frame)
+	{
+		uint count = g_counterCount.load(std::memory_order_acquire);
+		if (count == 0) {
+			return;
+		}
+		for (uint i = 0; i < count; ++i) {
+			uint16 nameId = g_counterNameIds[i];
+			if (!m_names[nameId]) {
+				writeString(CaptureRecord_Name, nameId, g_names[nameId]);
+				m_names[nameId] = true;
+			}
+		}
+
+		CaptureRecord record = {};
+		record.m_type  = (uint16)CaptureRecord_Counters;
+		record.m_count = count;
+		record.m_start = _frame.m_start;
+		write(&record, sizeof(record));
+		for (uint i = 0; i < count; ++i) {
+			CaptureCounter counter = {};
+			counter.m_value  = Profiler::GetCounterValue(i, _frame);
+			counter.m_nameId = g_counterNameIds[i];
+			write(&counter, sizeof(counter));
+		}
+	}
+};
+
+// Chunks are written in dispatch order: the writer holds m_writeMutex while it pops and writes the oldest chunk.
+struct Capture
+{
+	FILE*                               m_file;
+	String<128>                         m_path;
+	CaptureWriter                       m_writer;
+	eastl::vector<char>*                m_chunk;        // Being serialized by the main thread.
+	eastl::vector<eastl::vector<char>*> m_queue;        // Dispatched chunks, oldest first.
+	std::mutex                          m_queueMutex;
+	std::mutex                          m_writeMutex;
+	uint64                              m_maxQueueBytes;
+	size_t                              m_chunkSize;
+	std::atomic<uint64>                 m_queuedBytes;
+	std::atomic<uint64>                 m_writtenBytes;
+	std::atomic<bool>                   m_error;
+	uint                                m_frameCount;
+	uint                                m_dropCount;
+	double                              m_totalFrameMs;
+	double                              m_maxFrameMs;
+};
+static Capture g_capture;
+
+static void CaptureWriteChunk()
+{
+	std::lock_guard<std::mutex> writeLock(g_capture.m_writeMutex);
+	eastl::vector<char>* chunk;
+	{	std::lock_guard<std::mutex> queueLock(g_capture.m_queueMutex);
+		chunk = g_capture.m_queue.front();
+		g_capture.m_queue.erase(g_capture.m_queue.begin());
+	}
+	if (!g_capture.m_error) {
+		if (fwrite(chunk->data(), 1, chunk->size(), g_capture.m_file) == chunk->size()) {
+			g_capture.m_writtenBytes += chunk->size();
+		} else {
+			APT_LOG_ERR("Profiler: Failed to write '%s', the capture is incomplete", (const char*)g_capture.m_path);
+			g_capture.m_error = true;
+		}
+	}
+	g_capture.m_queuedBytes -= chunk->size();
+	delete chunk;
+}
+
+static void CaptureDispatchChunk()
+{
+	if (g_capture.m_chunk->empty()) {
+		return;
+	}
+	g_capture.m_queuedBytes += g_capture.m_chunk->size();
+	{	std::lock_guard<std::mutex> queueLock(g_capture.m_queueMutex);
+		g_capture.m_queue.push_back(g_capture.m_chunk);
+	}
+	g_capture.m_chunk = new eastl::vector<char>;
+	g_capture.m_chunk->reserve(g_capture.m_chunkSize * 2);
+	g_capture.m_writer.m_data = g_capture.m_chunk;
+	ThreadPool::Dispatch([]() { CaptureWriteChunk(); });
+}
+
+template <typename tFrame, typename tMarker>
+static void CaptureFrame(uint16 _thread, ProfilerData<tFrame, tMarker>& _data, const tFrame& _frame, double& _ms_)
+{
+	Timestamp t = Time::GetTimestamp();
+	g_capture.m_writer.writeFrame(_thread, _data, _frame);
+	_ms_ += (Time::GetTimestamp() - t).asMilliseconds();
+}
+
+static void CaptureCounters(const Profiler::CpuFrame& _frame, double& _ms_)
+{
+	Timestamp t = Time::GetTimestamp();
+	g_capture.m_writer.writeCounters(_frame);
+	_ms_ += (Time::GetTimestamp() - t).asMilliseconds();
+}
+
+// Append to a Chrome trace event JSON file.
+struct TraceJson
+{
+	eastl::vector<char> m_data;
+	bool                m_firstEvent;
+
+	TraceJson()
+		: m_firstEvent(true)
+	{
+		append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	}
+
+	void append(const char* _fmt, ...)
+	{
+		char buf[256];
+		va_list args;
+		va_start(args, _fmt);
+		int n = vsnprintf(buf, sizeof(buf), _fmt, args);
+		va_end(args);
+		m_data.insert(m_data.end(), buf, buf + APT_CLAMP(n, 0, (int)sizeof(buf) - 1));
+	}
+
+	void appendString(const char* _str, uint _len)
+	{
+		m_data.push_back('"');
+		for (uint i = 0; i < _len; ++i) {
+			char c = _str[i];
+			if (c == '"' || c == '\\') {
+				m_data.push_back('\\');
+				m_data.push_back(c);
+			} else if ((unsigned char)c < 0x20) {
+				append("\\u%04x", (uint)c);
+			} else {
+				m_data.push_back(c);
+			}
+		}
+		m_data.push_back('"');
+	}
+
+	void beginEvent()
+	{
+		append(m_firstEvent ? "\n" : ",\n");
+		m_firstEvent = false;
+	}
+
+	// Name metadata for a process (_tid < 0) or thread.
+	void metadata(int _pid, int _tid, const char* _name, uint _len)
+	{
+		beginEvent();
+		append("{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", _tid < 0 ? "process_name" : "thread_name", _pid, APT_MAX(_tid, 0));
+		appendString(_name, _len);
+		append("}}");
+	}
+
+	// Complete event, times in microseconds.
+	void event(int _pid, int _tid, const char* _name, uint _len, double _ts, double _dur)
+	{
+		beginEvent();
+		append("{\"name\":");
+		appendString(_name, _len);
+		append(",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", _pid, _tid, _ts, _dur);
+	}
+
+	// Counter event, time in microseconds.
+	void counter(int _pid, const char* _name, uint _len, double _ts, uint64 _value)
+	{
+		beginEvent();
+		append("{\"name\":");
+		appendString(_name, _len);
+		append(",\"ph\":\"C\",\"pid\":%d,\"ts\":%.3f,\"args\":{\"value\":%llu}}", _pid, _ts, (unsigned long long)_value);
+	}
+
+	bool write(const char* _path)
+	{
+		append("\n]}\n");
+		File f;
+		f.setData(m_data.data(), (uint)m_data.size());
+		return FileSystem::Write(f, _path);
+	}
+};
+
+// Convert capture data to JSON. Cpu threads are tids of pid 0, the Gpu is pid 1. Main thread frames are emitted as
+// 'Frame' events which contain the markers (hence the last frame, whose end isn't known, is omitted). Counters are
+// emitted as counter events of pid 0 at the start of the frame they were accumulated over.
+static bool WriteTrace(const char* _data, size_t _size, const char* _srcName, const char* _dstPath)
+{
+	const char* beg = _data;
+	const char* end = _data + _size;
+	CaptureHeader header;
+	if (_size < sizeof(CaptureHeader)) {
+		APT_LOG_ERR("Profiler: '%s' is not a capture file", _srcName);
+		return false;
+	}
+	memcpy(&header, beg, sizeof(CaptureHeader));
+	if (header.m_magic != kCaptureMagic) {
+		APT_LOG_ERR("Profiler: '%s' is not a capture file", _srcName);
+		return false;
+	}
+	if (header.m_version > kCaptureVersion) {
+		APT_LOG_ERR("Profiler: '%s' version mismatch (%u, expected <= %u)", _srcName, header.m_version, kCaptureVersion);
+		return false;
+	}
+	beg += sizeof(CaptureHeader);
+
+	const double toUs = 1e6 / (double)header.m_frequency;
+	struct Name { const char* m_str; uint m_len; };
+	eastl::vector<Name> names(Profiler::kMaxNames, Name());
+	names[0].m_str = g_names[0];
+	names[0].m_len = (uint)strlen(g_names[0]);
+	uint64 frameStart = 0;
+	uint64 frameCount = 0;
+
+	TraceJson json;
+	json.metadata(0, -1, "CPU", 3);
+	json.metadata(1, -1, "GPU", 3);
+	while (beg != end) {
+		CaptureRecord record;
+		if (beg + sizeof(CaptureRecord) > end) {
+			break;
+		}
+		memcpy(&record, beg, sizeof(CaptureRecord));
+		size_t recordSize = record.m_count;
+		if (record.m_type == CaptureRecord_Frame) {
+			recordSize *= sizeof(CaptureMarker);
+		} else if (record.m_type == CaptureRecord_Counters) {
+			recordSize *= sizeof(CaptureCounter);
+		}
+		if (beg + sizeof(CaptureRecord) + recordSize > end) {
+			break;
+		}
+		beg += sizeof(CaptureRecord);
+
+		const int pid = record.m_id == kCaptureGpuThread ? 1 : 0;
+		const int tid = record.m_id == kCaptureGpuThread ? 0 : (int)record.m_id;
+		switch (record.m_type) {
+			case CaptureRecord_Name:
+				if (record.m_id < Profiler::kMaxNames) {
+					names[record.m_id].m_str = beg;
+					names[record.m_id].m_len = record.m_count;
+				}
+				break;
+			case CaptureRecord_Thread:
+				json.metadata(pid, tid, beg, record.m_count);
+				break;
+			case CaptureRecord_Frame: {
+				if (pid == 0 && tid == 0) {
+					if (frameStart != 0) {
+						json.event(0, 0, "Frame", 5, (double)(sint64)(frameStart - header.m_start) * toUs, (double)(sint64)(record.m_start - frameStart) * toUs);
+					}
+					frameStart = record.m_start;
+					++frameCount;
+				}
+				for (uint i = 0; i < record.m_count; ++i) {
+					CaptureMarker marker;
+					memcpy(&marker, beg + i * sizeof(CaptureMarker), sizeof(CaptureMarker));
+					const Name& name = names[marker.m_nameId < Profiler::kMaxNames ? marker.m_nameId : 0];
+					uint64 start = record.m_start + (sint64)marker.m_start;
+					json.event(pid, tid, name.m_str ? name.m_str : g_names[0], name.m_str ? name.m_len : (uint)strlen(g_names[0]),
+						(double)(sint64)(start - header.m_start) * toUs,
+						(double)(marker.m_end - marker.m_start) * toUs
+						);
+				}
+				break;
+			}
+			case CaptureRecord_Counters: {
+				double ts = (double)(sint64)(record.m_start - header.m_start) * toUs;
+				for (uint i = 0; i < record.m_count; ++i) {
+					CaptureCounter counter;
+					memcpy(&counter, beg + i * sizeof(CaptureCounter), sizeof(CaptureCounter));
+					const Name& name = names[counter.m_nameId < Profiler::kMaxNames ? counter.m_nameId : 0];
+					json.counter(0, name.m_str ? name.m_str : g_names[0], name.m_str ? name.m_len : (uint)strlen(g_names[0]), ts, counter.m_value);
+				}
+				break;
+			}
+			default:
+				break;
+		};
+		beg += recordSize;
+	}
+	if (beg != end) {
+		APT_LOG("Profiler: '%s' is truncated, converted %llu frames", _srcName, (unsigned long long)frameCount);
+	}
+
+	if (!json.write(_dstPath)) {
+		return false;
+	}
+	APT_LOG("Profiler: Wrote '%s' (%llu frames)", _dstPath, (unsigned long long)frameCount);
+	return true;
+}
+
+
+APT_DEFINE_STATIC_INIT(Profiler);
+
+// PUBLIC
+
+void Profiler::NextFrame()
+{
+	if_unlikely (g_gpuInit) {
+		g_gpuMarkerQueries.resize(s_gpu.m_markers.size());
+		g_gpuInit = false;
+
+		ResetGpuOffset();
+	}
+
+	if (s_pause.load(std::memory_order_relaxed)) {
+		return;
+	}
+
+ // capture: drop the frame if the write queue is full
+	bool   capture   = g_capture.m_file != nullptr;
+	double captureMs = 0.0;
+	if (capture && g_capture.m_queuedBytes + g_capture.m_chunk->size() > g_capture.m_maxQueueBytes) {
+		++g_capture.m_dropCount;
+		capture = false;
+	}
+
+ // apply capacity changes (clears the history)
+	if (s_cpu.m_maxMarkersPerFrame != g_maxCpuMarkersPerFrame) {
+		s_cpu.init(g_maxCpuMarkersPerFrame);
+		memset(g_counterValues, 0, sizeof(g_counterValues));
+	}
+	if (s_gpu.m_maxMarkersPerFrame != g_maxGpuMarkersPerFrame) {
+		for (uint i = 0; i < kMaxFrameCount; ++i) {
+			FreeGpuFrame(i, false);
+		}
+		s_gpu.init(g_maxGpuMarkersPerFrame);
+		g_gpuMarkerQueries.resize(s_gpu.m_markers.size());
+	}
+
+ // CPU: flush worker threads into the current frame, then advance all threads in lockstep
+	uint64 frameStart = (uint64)Time::GetTimestamp().getRaw();
+	for (uint i = 1, n = GetCpuThreadCount(); i < n; ++i) {
+		CpuThread* thread = g_cpuThreads[i].load(std::memory_order_acquire);
+		if (!thread) {
+			continue; // registration in progress
+		}
+		CpuThread::Data& data = *thread->m_data;
+		if (data.m_maxMarkersPerFrame != s_cpu.m_maxMarkersPerFrame) {
+			data.init(s_cpu.m_maxMarkersPerFrame);
+		}
+		data.m_frames.back().m_start = s_cpu.m_frames.back().m_start; // set on the first flush after the thread was registered
+		thread->flush();
+		AccumulateStats(g_cpuMarkerStats, data, data.m_frames.back());
+		if (capture && data.m_frames.back().m_count > 0) {
+			CaptureFrame((uint16)i, data, data.m_frames.back(), captureMs);
+		}
+		data.nextFrame().m_start = frameStart;
+	}
+	CpuFrame& cpuFrame = s_cpu.m_frames.back();
+
+ // counters: take the values of the frame which is ending from all threads
+	uint64* counterValues = g_counterValues[s_cpu.getCurrentFrameIndex()];
+	uint counterCount = g_counterCount.load(std::memory_order_acquire);
+	memset(counterValues, 0, sizeof(g_counterValues[0]));
+	for (uint i = 0, n = GetCpuThreadCount(); i < n; ++i) {
+		CpuThread* thread = g_cpuThreads[i].load(std::memory_order_acquire);
+		if (!thread) {
+			continue;
+		}
+		for (uint j = 0; j < counterCount; ++j) {
+			counterValues[j] += thread->m_counters[j].exchange(0, std::memory_order_relaxed);
+		}
+	}
+
+	if (cpuFrame.m_start != 0) {
+		uint64 duration = frameStart - cpuFrame.m_start;
+		AccumulateStats(g_cpuMarkerStats, s_cpu, cpuFrame);
+		g_cpuFrameStats.add(duration);
+		++g_cpuStatsFrameCount;
+		if (g_spikeThreshold > 0 && duration > g_spikeThreshold) {
+			PinSpike(cpuFrame, duration);
+		}
+		for (uint i = 0; i < counterCount; ++i) {
+			if (!g_counterStats[i]) {
+				g_counterStats[i] = new MarkerHistogram;
+				g_counterStats[i]->reset();
+			}
+			g_counterStats[i]->add(counterValues[i]);
+		}
+		if (capture) {
+			CaptureFrame(0, s_cpu, cpuFrame, captureMs);
+			CaptureCounters(cpuFrame, captureMs);
+		}
+	}
+	s_cpu.nextFrame().m_start = frameStart;
+
+ // GPU: read results for pending frames in order, stop at the first frame whose results aren't available
+	++g_frameIndex;
+	while (g_gpuFrameResolved != s_gpu.getCurrentFrameIndex()) {
+		if (g_gpuFrameQueries[g_gpuFrameResolved].m_pending) {
+			if (!ResolveGpuFrame(g_gpuFrameResolved)) {
+				break;
+			}
+			const GpuFrame& frame = s_gpu.m_frames.data()[g_gpuFrameResolved];
+			const uint64 index = g_gpuFrameQueries[g_gpuFrameResolved].m_index;
+			AccumulateStats(g_gpuMarkerStats, s_gpu, frame);
+			if (index == g_gpuStatsPrevIndex + 1) { // else the previous frame was discarded
+				g_gpuFrameStats.add(frame.m_start - g_gpuStatsPrevStart);
+			}
+			g_gpuStatsPrevIndex = index;
+			g_gpuStatsPrevStart = frame.m_start;
+			++g_gpuStatsFrameCount;
+			if (capture) {
+				CaptureFrame(kCaptureGpuThread, s_gpu, frame, captureMs);
+			}
+		}
+		g_gpuFrameResolved = (g_gpuFrameResolved + 1) % kMaxFrameCount;
+	}
+
+ // GPU: the oldest frame is about to be overwritten, if it's still pending the results are discarded
+	uint nextFrame = (s_gpu.getCurrentFrameIndex() + 1) % kMaxFrameCount;
+	if (g_gpuFrameQueries[nextFrame].m_pending) {
+		FreeGpuFrame(nextFrame, true);
+		if (g_gpuFrameResolved == nextFrame) {
+			g_gpuFrameResolved = (g_gpuFrameResolved + 1) % kMaxFrameCount;
+		}
+	}
+
+	GpuFrame& gpuFrame = s_gpu.nextFrame();
+	gpuFrame.m_start    = 0;
+	gpuFrame.m_cpuStart = frameStart;
+	GpuFrameQueries& gpuQueries = g_gpuFrameQueries[s_gpu.getCurrentFrameIndex()];
+	gpuQueries.m_start   = gpuQueries.m_last = AllocGpuQuery();
+	gpuQueries.m_index   = g_frameIndex;
+	gpuQueries.m_pending = true;
+	++g_gpuStats.m_pendingFrameCount;
+	glAssert(glQueryCounter(gpuQueries.m_start, GL_TIMESTAMP));
+
+	if (capture) {
+		if (g_capture.m_chunk->size() >= g_capture.m_chunkSize) {
+			CaptureDispatchChunk();
+		}
+		++g_capture.m_frameCount;
+		g_capture.m_totalFrameMs += captureMs;
+		g_capture.m_maxFrameMs = APT_MAX(g_capture.m_maxFrameMs, captureMs);
+	}
+}
+
+void Profiler::SetMaxCpuMarkersPerFrame(uint _count)
+{
+	g_maxCpuMarkersPerFrame = RoundMarkersPerFrame(_count);
+}
+
+uint Profiler::GetMaxCpuMarkersPerFrame()
+{
+	return g_maxCpuMarkersPerFrame;
+}
+
+void Profiler::SetMaxGpuMarkersPerFrame(uint _count)
+{
+	g_maxGpuMarkersPerFrame = RoundMarkersPerFrame(_count);
+}
+
+uint Profiler::GetMaxGpuMarkersPerFrame()
+{
+	return g_maxGpuMarkersPerFrame;
+}
+
+const char* Profiler::GetMarkerName(const Marker& _marker)
+{
+	return g_names[_marker.m_nameId];
+}
+
+void Profiler::PushCpuMarker(const char* _name)
+{
+	CpuThread* thread = GetCpuThread();
+	if (!thread->m_isMain) {
+		thread->pushMarker(_name); // pause is checked by popMarker() to keep push/pop matched
+		return;
+	}
+	if (s_pause.load(std::memory_order_relaxed)) {
+		return;
+	}
+	CpuMarker* marker = s_cpu.pushMarker(InternName(_name));
+	if (marker) {
+		marker->m_start = ToFrameTicks((uint64)Time::GetTimestamp().getRaw(), s_cpu.m_frames.back().m_start);
+	}
+}
+
+void Profiler::PopCpuMarker(const char* _name)
+{
+	CpuThread* thread = GetCpuThread();
+	if (!thread->m_isMain) {
+		thread->popMarker(_name);
+		return;
+	}
+	if (s_pause.load(std::memory_order_relaxed)) {
+		return;
+	}
+	CpuMarker* marker = s_cpu.popMarker(_name);
+	if (marker) {
+		marker->m_end = ToFrameTicks((uint64)Time::GetTimestamp().getRaw(), s_cpu.m_frames.back().m_start);
+	}
+}
+
+void Profiler::SetCpuThreadName(const char* _name)
+{
+	if (g_cpuThread) {
+		g_cpuThread->m_name.set(_name);
+	} else {
+		g_cpuThread = RegisterCpuThread(_name);
+	}
+}
+
+uint Profiler::GetCpuThreadCount()
+{
+	uint ret = APT_MIN(g_cpuThreadCount.load(std::memory_order_acquire), (uint)kMaxCpuThreads);
+ // stop at the first thread which isn't published yet (count is incremented before the slot is written)
+	for (uint i = 1; i < ret; ++i) {
+		if (!g_cpuThreads[i].load(std::memory_order_acquire)) {
+			return i;
+		}
+	}
+	return ret;
+}
+
+const char* Profiler::GetCpuThreadName(uint _thread)
+{
+	APT_ASSERT(_thread < GetCpuThreadCount());
+	CpuThread* thread = g_cpuThreads[_thread].load(std::memory_order_acquire);
+	return thread ? (const char*)thread->m_name : "Main";
+}
+
+uint Profiler::GetCpuThreadDropCount(uint _thread)
+{
+	APT_ASSERT(_thread < GetCpuThreadCount());
+	CpuThread* thread = g_cpuThreads[_thread].load(std::memory_order_acquire);
+	uint ret = GetCpuThreadData(_thread).m_dropCount;
+	if (thread) {
+		ret += thread->m_dropCount.load(std::memory_order_relaxed);
+	}
+	return ret;
+}
+
+const Profiler::CpuFrame& Profiler::GetCpuFrame(uint _i, uint _thread)
+{
+	return GetCpuThreadData(_thread).m_frames[_i];
+}
+
+uint Profiler::GetCpuFrameCount(uint _thread)
+{
+	return GetCpuThreadData(_thread).m_frames.size();
+}
+
+const uint64 Profiler::GetCpuAvgFrameDuration()
+{
+	return s_cpu.m_avgFrameDuration;
+}
+
+uint Profiler::GetCpuFrameIndex(const CpuFrame& _frame, uint _thread)
+{
+	return (uint)(&_frame - GetCpuThreadData(_thread).m_frames.data());
+}
+
+const Profiler::CpuMarker& Profiler::GetCpuMarker(uint _i, uint _thread) 
+{
+	return GetCpuThreadData(_thread).getMarker(_i);
+}
+
+void Profiler::Counter(const char* _name, uint64 _value)
+{
+	if (s_pause.load(std::memory_order_relaxed)) {
+		return;
+	}
+	uint i = GetCounterIndex(_name);
+	if (i != (uint)kMaxCounters) {
+		GetCpuThread()->m_counters[i].fetch_add(_value, std::memory_order_relaxed);
+	}
+}
+
+uint Profiler::GetCounterCount()
+{
+	return g_counterCount.load(std::memory_order_acquire);
+}
+
+const char* Profiler::GetCounterName(uint _counter)
+{
+	APT_ASSERT(_counter < GetCounterCount());
+	return g_names[g_counterNameIds[_counter]];
+}
+
+uint64 Profiler::GetCounterValue(uint _counter, const CpuFrame& _frame)
+{
+	APT_ASSERT(_counter < (uint)kMaxCounters);
+	return g_counterValues[GetCpuFrameIndex(_frame)][_counter];
+}
+
+Profiler::MarkerStats Profiler::GetCounterStats(uint _counter)
+{
+	APT_ASSERT(_counter < GetCounterCount());
+	MarkerStats ret = {};
+	ret.m_name = GetCounterName(_counter);
+	if (g_counterStats[_counter]) {
+		g_counterStats[_counter]->getStats(ret, g_cpuStatsFrameCount);
+	}
+	return ret;
+}
+
+void Profiler::PushGpuMarker(const char* _name)
+{
+	APT_ASSERT(std::this_thread::get_id() == g_cpuMainThreadId);
+	if (s_pause.load(std::memory_order_relaxed) || g_gpuInit) { // g_gpuInit: before the first call to NextFrame()
+		return;
+	}
+	GpuMarker* marker = s_gpu.pushMarker(InternName(_name));
+	if (marker) {
+		marker->m_cpuStart = ToFrameTicks((uint64)Time::GetTimestamp().getRaw(), s_gpu.m_frames.back().m_cpuStart);
+		GpuMarkerQueries& queries = g_gpuMarkerQueries[s_gpu.getMarkerIndex(*marker)];
+		queries.m_start = AllocGpuQuery();
+		queries.m_end   = AllocGpuQuery();
+		glAssert(glQueryCounter(queries.m_start, GL_TIMESTAMP));
+		g_gpuFrameQueries[s_gpu.getCurrentFrameIndex()].m_last = queries.m_start;
+	}
+}
+
+void Profiler::PopGpuMarker(const char* _name)
+{
+	if (s_pause.load(std::memory_order_relaxed) || g_gpuInit) {
+		return;
+	}
+	GpuMarker* marker = s_gpu.popMarker(_name);
+	if (marker) {
+		GLuint query = g_gpuMarkerQueries[s_gpu.getMarkerIndex(*marker)].m_end;
+		glAssert(glQueryCounter(query, GL_TIMESTAMP));
+		g_gpuFrameQueries[s_gpu.getCurrentFrameIndex()].m_last = query;
+	}
+}
+
+const Profiler::GpuFrame& Profiler::GetGpuFrame(uint _i)
+{
+	return s_gpu.m_frames[_i];
+}
+
+uint Profiler::GetGpuFrameCount()
+{
+	return s_gpu.m_frames.size();
+}
+
+uint64 Profiler::GetGpuAvgFrameDuration()
+{
+	return s_gpu.m_avgFrameDuration;
+}
+
+Profiler::GpuStats Profiler::GetGpuStats()
+{
+	GpuStats ret = g_gpuStats;
+	ret.m_dropCount = s_gpu.m_dropCount;
+	return ret;
+}
 
 uint Profiler::GetGpuFrameIndex(const GpuFrame& _frame)
 {
@@ -596,7 +2114,7 @@ uint Profiler::GetGpuFrameIndex(const GpuFrame& _frame)
 
 const Profiler::GpuMarker& Profiler::GetGpuMarker(uint _i) 
 {
-	return s_gpu.m_markers.data()[_i % s_gpu.m_markers.capacity()];
+	return s_gpu.getMarker(_i);
 }
 
 void Profiler::ResetGpuOffset()
@@ -609,21 +2127,233 @@ void Profiler::ResetGpuOffset()
 	g_gpuTickOffset = cpuTicks - gpuTicks; // \todo is it possible that gpuTicks > cpuTicks?
 }
 
+void Profiler::ResetStats()
+{
+	for (uint i = 0; i < kMaxNames; ++i) {
+		if (g_cpuMarkerStats[i]) {
+			g_cpuMarkerStats[i]->reset();
+		}
+		if (g_gpuMarkerStats[i]) {
+			g_gpuMarkerStats[i]->reset();
+		}
+	}
+	for (uint i = 0; i < kMaxCounters; ++i) {
+		if (g_counterStats[i]) {
+			g_counterStats[i]->reset();
+		}
+	}
+	g_cpuFrameStats.reset();
+	g_gpuFrameStats.reset();
+	g_cpuStatsFrameCount = 0;
+	g_gpuStatsFrameCount = 0;
+	g_gpuStatsPrevIndex  = ~0ull;
+}
+
+bool Profiler::GetCpuMarkerStats(const char* _name, MarkerStats& stats_)
+{
+	return FindMarkerStats(g_cpuMarkerStats, g_cpuStatsFrameCount, _name, stats_);
+}
+
+bool Profiler::GetGpuMarkerStats(const char* _name, MarkerStats& stats_)
+{
+	return FindMarkerStats(g_gpuMarkerStats, g_gpuStatsFrameCount, _name, stats_);
+}
+
+uint Profiler::GetCpuMarkerStatsList(MarkerStats* list_, uint _maxCount)
+{
+	return GetMarkerStatsList(g_cpuMarkerStats, g_cpuStatsFrameCount, list_, _maxCount);
+}
+
+uint Profiler::GetGpuMarkerStatsList(MarkerStats* list_, uint _maxCount)
+{
+	return GetMarkerStatsList(g_gpuMarkerStats, g_gpuStatsFrameCount, list_, _maxCount);
+}
+
+Profiler::MarkerStats Profiler::GetCpuFrameStats()
+{
+	MarkerStats ret;
+	ret.m_name = "Frame";
+	g_cpuFrameStats.getStats(ret, g_cpuStatsFrameCount);
+	return ret;
+}
+
+Profiler::MarkerStats Profiler::GetGpuFrameStats()
+{
+	MarkerStats ret;
+	ret.m_name = "Frame";
+	g_gpuFrameStats.getStats(ret, g_gpuStatsFrameCount);
+	return ret;
+}
+
+void Profiler::SetSpikeThreshold(double _ms)
+{
+	g_spikeThreshold = (uint64)(APT_MAX(_ms, 0.0) * (double)Time::GetSystemFrequency() / 1000.0);
+}
+
+double Profiler::GetSpikeThreshold()
+{
+	return (double)g_spikeThreshold * 1000.0 / (double)Time::GetSystemFrequency();
+}
+
+uint Profiler::GetSpikeCount()
+{
+	return (uint)g_spikes.size();
+}
+
+const Profiler::Spike& Profiler::GetSpike(uint _i)
+{
+	SpikeData& spike = g_spikes[_i];
+	spike.m_spike.m_markers = spike.m_markers.data();
+	return spike.m_spike;
+}
+
+void Profiler::ClearSpikes()
+{
+	g_spikes.clear();
+}
+
+bool Profiler::BeginCapture(const char* _path, uint _maxQueueBytes)
+{
+	EndCapture();
+	FILE* file = fopen(_path, "wb");
+	if (!file) {
+		APT_LOG_ERR("Profiler: Failed to open '%s'", _path);
+		return false;
+	}
+	g_capture.m_file          = file;
+	g_capture.m_path.set(_path);
+	g_capture.m_maxQueueBytes = _maxQueueBytes;
+	g_capture.m_chunkSize     = APT_MIN(kCaptureChunkSize, (size_t)_maxQueueBytes / 2);
+	g_capture.m_queuedBytes   = 0;
+	g_capture.m_writtenBytes  = 0;
+	g_capture.m_error         = false;
+	g_capture.m_frameCount    = 0;
+	g_capture.m_dropCount     = 0;
+	g_capture.m_totalFrameMs  = 0.0;
+	g_capture.m_maxFrameMs    = 0.0;
+	g_capture.m_chunk         = new eastl::vector<char>;
+	g_capture.m_chunk->reserve(g_capture.m_chunkSize * 2);
+	g_capture.m_writer.reset(g_capture.m_chunk);
+
+	CaptureHeader header;
+	header.m_magic     = kCaptureMagic;
+	header.m_version   = kCaptureVersion;
+	header.m_frequency = (uint64)Time::GetSystemFrequency();
+	header.m_start     = (uint64)Time::GetTimestamp().getRaw();
+	g_capture.m_writer.write(&header, sizeof(CaptureHeader));
+	return true;
+}
+
+void Profiler::EndCapture()
+{
+	if (!g_capture.m_file) {
+		return;
+	}
+	CaptureDispatchChunk();
+	while (g_capture.m_queuedBytes > 0) {
+		std::this_thread::yield();
+	}
+	delete g_capture.m_chunk;
+	g_capture.m_chunk = nullptr;
+	if (fclose(g_capture.m_file) != 0) {
+		g_capture.m_error = true;
+	}
+	g_capture.m_file = nullptr;
+
+	CaptureStats stats = GetCaptureStats();
+	APT_LOG("Profiler: Capture '%s'%s, %u frames, %u dropped, %llu bytes, %.3fms avg/%.3fms max per frame",
+		(const char*)g_capture.m_path,
+		stats.m_error ? " (incomplete)" : "",
+		stats.m_frameCount,
+		stats.m_dropCount,
+		(unsigned long long)stats.m_writtenBytes,
+		stats.m_avgFrameMs,
+		stats.m_maxFrameMs
+		);
+}
+
+bool Profiler::IsCapturing()
+{
+	return g_capture.m_file != nullptr;
+}
+
+Profiler::CaptureStats Profiler::GetCaptureStats()
+{
+	CaptureStats ret;
+	ret.m_frameCount   = g_capture.m_frameCount;
+	ret.m_dropCount    = g_capture.m_dropCount;
+	ret.m_writtenBytes = g_capture.m_writtenBytes;
+	ret.m_queuedBytes  = g_capture.m_queuedBytes;
+	ret.m_avgFrameMs   = g_capture.m_frameCount > 0 ? g_capture.m_totalFrameMs / (double)g_capture.m_frameCount : 0.0;
+	ret.m_maxFrameMs   = g_capture.m_maxFrameMs;
+	ret.m_error        = g_capture.m_error;
+	return ret;
+}
+
+bool Profiler::ExportTrace(const char* _path)
+{
+	eastl::vector<char> data;
+	CaptureWriter writer;
+	writer.reset(&data);
+
+	CaptureHeader header;
+	header.m_magic     = kCaptureMagic;
+	header.m_version   = kCaptureVersion;
+	header.m_frequency = (uint64)Time::GetSystemFrequency();
+	header.m_start     = 0;
+	for (uint i = 0; i < s_cpu.m_frames.size() && header.m_start == 0; ++i) {
+		header.m_start = s_cpu.m_frames[i].m_start; // oldest valid frame
+	}
+	writer.write(&header, sizeof(CaptureHeader));
+
+ // the newest frame is omitted, it's incomplete
+	for (uint thread = 0, n = GetCpuThreadCount(); thread < n; ++thread) {
+		CpuThread::Data& cpu = GetCpuThreadData(thread);
+		for (uint i = 0; i < cpu.m_frames.size() - 1; ++i) {
+			const CpuFrame& frame = cpu.m_frames[i];
+			if (frame.m_start == 0 || (thread != 0 && frame.m_count == 0)) {
+				continue;
+			}
+			writer.writeFrame((uint16)thread, cpu, frame);
+			if (thread == 0) {
+				writer.writeCounters(frame);
+			}
+		}
+	}
+	for (uint i = 0; i < s_gpu.m_frames.size(); ++i) {
+		const GpuFrame& frame = s_gpu.m_frames[i];
+		if (frame.m_start == 0 || g_gpuFrameQueries[GetGpuFrameIndex(frame)].m_pending) {
+			continue;
+		}
+		writer.writeFrame(kCaptureGpuThread, s_gpu, frame);
+	}
+
+	return WriteTrace(data.data(), data.size(), "history", _path);
+}
+
+bool Profiler::ConvertCapture(const char* _srcPath, const char* _dstPath)
+{
+	File f;
+	if (!FileSystem::Read(f, _srcPath)) {
+		return false;
+	}
+	return WriteTrace(f.getData(), f.getDataSize(), _srcPath, _dstPath);
+}
+
 // PROTECTED
 
 void Profiler::Init()
 {
-	s_pause      = false;
+	s_pause.store(false, std::memory_order_relaxed);
+	g_cpuMainThreadId = std::this_thread::get_id();
 }
 
 void Profiler::Shutdown()
 {
  // \todo static initialization means we can't delete the queries
-	//glAssert(glDeleteQueries(kMaxTotalGpuMarkersPerFrame, g_gpuFrameStartQueries)); 
-	//glAssert(glDeleteQueries(kMaxTotalGpuMarkersPerFrame, g_gpuMarkerStartQueries)); 
-	//glAssert(glDeleteQueries(kMaxTotalGpuMarkersPerFrame, g_gpuMarkerEndQueries)); 
+	//glAssert(glDeleteQueries((GLsizei)g_gpuQueryPool.size(), g_gpuQueryPool.data())); 
 }
 
 // PRIVATE
 
-bool Profiler::s_pause;
+std::atomic<bool> Profiler::s_pause;
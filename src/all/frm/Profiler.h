@@ -6,6 +6,8 @@
 
 #include <apt/static_initializer.h>
 
+#include <atomic>
+
 //#define frm_Profiler_DISABLE
 #ifdef frm_Profiler_DISABLE
 	#define CPU_AUTO_MARKER(_name) APT_UNUSED(_name)
@@ -22,25 +24,51 @@ namespace frm {
 ////////////////////////////////////////////////////////////////////////////////
 // Profiler
 // - Ring buffers of marker data.
-// - Marker data = name, depth, start time, end time.
+// - Marker data = name id, depth, start time, end time. Times are stored as
+//   32 bit ticks relative to the frame start, names are interned (see
+//   GetMarkerName()).
 // - Marker depth indicates where the marker is relative to the previous marker
 //   in the buffer (if this depth > prev depth, this is a child of prev).
-// \todo Reduce the size of Marker for better coherency; store start/end as 
-//   frame-relative times.
+// - The max number of markers per frame is set at runtime (see
+//   SetMaxCpuMarkersPerFrame()). Markers pushed once the current frame is full
+//   are dropped.
+// - Cpu markers may be pushed from any thread. Each thread is registered on
+//   first use and writes completed markers into its own ring buffer without
+//   locking (single producer, NextFrame() is the single consumer). The main
+//   thread (which calls NextFrame()) writes directly to the frame history.
+//   Worker markers appear in the frame during which they were popped.
+// - Gpu markers must be pushed from the main thread. Timer queries are pooled
+//   and results are read without stalling (see GpuStats).
+// - Counters are numeric values accumulated per frame (e.g. draw calls, bytes
+//   uploaded). Each thread accumulates into its own slots, NextFrame() sums
+//   them into a table parallel to the Cpu frame history.
+// - Per-marker statistics (count, min/mean/max, percentiles) are accumulated
+//   over all frames, not only the history (see MarkerStats). Frames which
+//   exceed a threshold can be pinned for inspection (see Spike).
+// - The history can be exported as Chrome trace event JSON (ExportTrace()).
+//   Long runs can be streamed to a compact binary file (BeginCapture()) which
+//   is converted offline (ConvertCapture()).
 ////////////////////////////////////////////////////////////////////////////////
 class Profiler: private apt::non_copyable<Profiler>
 {
 public:
-	static const int kMaxFrameCount              = 64; // must be at least 2 (keep 1 frame to write to while visualizing the others)
+	static const int kMaxFrameCount              = 64; // must be at least 2 (keep 1 frame to write to while visualizing the others), must be a power of 2
 	static const int kMaxDepth                   = 255;
-	static const int kMaxTotalCpuMarkersPerFrame = 32;
-	static const int kMaxTotalGpuMarkersPerFrame = 32;
+	static const int kDefaultCpuMarkersPerFrame  = 1024; // per thread
+	static const int kDefaultGpuMarkersPerFrame  = 256;
+	static const int kMaxMarkersPerFrame         = 65536;
+	static const int kMaxNames                   = 4096; // unique marker names
+	static const int kMaxCpuThreads              = 32; // including the main thread
+	static const int kCpuThreadBufferSize        = 4096; // completed markers per worker thread between calls to NextFrame(), must be a power of 2
+	static const int kMaxSpikes                  = 16;
+	static const int kMaxCounters                = 64;
 
+	// Times are system ticks relative to the start of the frame which contains the marker, clamped to 32 bits.
 	struct Marker
 	{
-		const char*  m_name;
-		uint64       m_start;
-		uint64       m_end;
+		sint32       m_start;    // may be negative for worker markers which began during a previous frame
+		sint32       m_end;
+		uint16       m_nameId;
 		uint8        m_depth;
 	};
 	struct CpuMarker: public Marker
@@ -48,7 +76,7 @@ public:
 	};
 	struct GpuMarker: public Marker
 	{
-		uint64 m_cpuStart; // when PushGpuMarker() was called
+		sint32 m_cpuStart; // when PushGpuMarker() was called, relative to GpuFrame::m_cpuStart
 	};
 
 	struct Frame
@@ -56,28 +84,102 @@ public:
 		uint64 m_start;
 		uint   m_first;
 		uint   m_count;
+
+		// Absolute marker times.
+		uint64 getStart(const Marker& _marker) const  { return m_start + (sint64)_marker.m_start; }
+		uint64 getEnd(const Marker& _marker) const    { return m_start + (sint64)_marker.m_end; }
 	};
 	struct CpuFrame: public Frame
 	{
 	};
 	struct GpuFrame: public Frame
 	{
+		uint64 m_cpuStart; // when NextFrame() was called
+
+		uint64 getCpuStart(const GpuMarker& _marker) const  { return m_cpuStart + (sint64)_marker.m_cpuStart; }
+	};
+
+	// Gpu results are read when available (the Cpu never waits), typically a few frames after the frame was issued.
+	// Frames whose results aren't available within kMaxFrameCount frames are discarded (m_start = 0).
+	struct GpuStats
+	{
+		uint m_queryCount;         // Timer queries allocated by the pool (grows on demand).
+		uint m_pendingFrameCount;  // Frames awaiting results.
+		uint m_latency;            // Frames between issuing and reading the most recent results.
+		uint m_maxLatency;
+		uint m_lateFrameCount;     // Total number of frames discarded.
+		uint m_lateMarkerCount;    // Total number of markers discarded, or whose results were unavailable when the frame was read.
+		uint m_dropCount;          // Total number of markers dropped because the frame was full.
+	};
+	
+	// Accumulated by NextFrame() for each complete frame since the last call to ResetStats(). Durations are system
+	// ticks. Percentiles are estimated from a log-scale histogram (relative error < 4%). Also used for counters, in
+	// which case the samples are per-frame values.
+	struct MarkerStats
+	{
+		const char* m_name;
+		uint        m_count;     // Number of markers (or frames, see GetCpuFrameStats(), GetCounterStats()).
+		uint64      m_total;     // Sum of durations.
+		uint64      m_perFrame;  // m_total divided by the number of frames accumulated.
+		uint64      m_min;
+		uint64      m_mean;
+		uint64      m_max;
+		uint64      m_p50;
+		uint64      m_p95;
+		uint64      m_p99;
+	};
+
+	// Cpu frame which exceeded the spike threshold, with a copy of the main thread markers.
+	struct Spike
+	{
+		uint64           m_frameIndex;   // Number of calls to NextFrame() before the frame began.
+		uint64           m_start;        // Marker times are relative to this.
+		uint64           m_duration;
+		uint             m_markerCount;
+		const CpuMarker* m_markers;
 	};
 	
 	static void NextFrame();
 
-	// Push/pop a named Cpu marker.
+	// Max number of markers per frame (per thread for Cpu markers), rounded up to a power of 2. The change is applied
+	// by the next call to NextFrame(), which clears the marker history.
+	static void             SetMaxCpuMarkersPerFrame(uint _count);
+	static uint             GetMaxCpuMarkersPerFrame();
+	static void             SetMaxGpuMarkersPerFrame(uint _count);
+	static uint             GetMaxGpuMarkersPerFrame();
+
+	// Marker names are interned on push; markers with the same name string share an id.
+	static const char*      GetMarkerName(const Marker& _marker);
+
+	// Push/pop a named Cpu marker. Safe to call from any thread, _name must be a string literal (or otherwise persist).
 	static void             PushCpuMarker(const char* _name);
 	static void             PopCpuMarker(const char* _name);
+	// Set the name of the calling thread as it appears in the viewer (registers the thread). Call once at thread start.
+	static void             SetCpuThreadName(const char* _name);
+	// Registered threads, 0 is the main thread. NextFrame() advances all threads, a worker's history starts when it registers.
+	static uint             GetCpuThreadCount();
+	static const char*      GetCpuThreadName(uint _thread);
+	// Total number of markers dropped because the frame or the thread's buffer was full.
+	static uint             GetCpuThreadDropCount(uint _thread);
 	// Access to profiler frames. 0 is the oldest frame in the history buffer.
-	static const CpuFrame&  GetCpuFrame(uint _i);
-	static uint             GetCpuFrameCount();
+	static const CpuFrame&  GetCpuFrame(uint _i, uint _thread = 0);
+	static uint             GetCpuFrameCount(uint _thread = 0);
 	static const uint64     GetCpuAvgFrameDuration();
-	static uint             GetCpuFrameIndex(const CpuFrame& _frame);
+	static uint             GetCpuFrameIndex(const CpuFrame& _frame, uint _thread = 0);
 	// Access to marker data. Unlike access to frame data, the index accesses the internal ring buffer directly.
-	static const CpuMarker& GetCpuMarker(uint _i);
+	static const CpuMarker& GetCpuMarker(uint _i, uint _thread = 0);
 
 
+	// Add _value to the counter _name for the current frame. Safe to call from any thread, _name must be a string
+	// literal (or otherwise persist). Counters are registered on first use, at most kMaxCounters.
+	static void             Counter(const char* _name, uint64 _value);
+	static uint             GetCounterCount();
+	static const char*      GetCounterName(uint _counter);
+	// Value of _counter for a main thread frame in the history (see GetCpuFrame()).
+	static uint64           GetCounterValue(uint _counter, const CpuFrame& _frame);
+	// Per-frame values since the last call to ResetStats().
+	static MarkerStats      GetCounterStats(uint _counter);
+
 	// Push/pop a named Gpu marker.
 	static void             PushGpuMarker(const char* _name);
 	static void             PopGpuMarker(const char* _name);
@@ -86,12 +188,63 @@ public:
 	static const GpuFrame&  GetGpuFrame(uint _i);
 	static uint             GetGpuFrameCount();
 	static uint64           GetGpuAvgFrameDuration();
+	static GpuStats         GetGpuStats();
 	// Access to marker data. Unlike access to frame data, the index accesses the internal ring buffer directly.
 	static const GpuMarker& GetGpuMarker(uint _i);
 
 	// Reset Cpu->Gpu offset (call if the graphics context changes).
 	static void   ResetGpuOffset();
 
+	// Stats are accumulated and queried on the main thread.
+	static void             ResetStats();
+	// Return false if the marker has no samples.
+	static bool             GetCpuMarkerStats(const char* _name, MarkerStats& stats_);
+	static bool             GetGpuMarkerStats(const char* _name, MarkerStats& stats_);
+	// Write the stats for all markers with samples to list_, sorted by m_total (most expensive first). Return the
+	// number of entries written (at most _maxCount).
+	static uint             GetCpuMarkerStatsList(MarkerStats* list_, uint _maxCount);
+	static uint             GetGpuMarkerStatsList(MarkerStats* list_, uint _maxCount);
+	// Frame durations (Cpu: between calls to NextFrame(), Gpu: between consecutive frame starts).
+	static MarkerStats      GetCpuFrameStats();
+	static MarkerStats      GetGpuFrameStats();
+
+	// Cpu frames longer than _ms are pinned, 0 disables spike detection. If more than kMaxSpikes frames exceed the
+	// threshold the longest are kept.
+	static void             SetSpikeThreshold(double _ms);
+	static double           GetSpikeThreshold();
+	// Pinned frames, oldest first.
+	static uint             GetSpikeCount();
+	static const Spike&     GetSpike(uint _i);
+	static void             ClearSpikes();
+
+	// Frames are serialized by NextFrame() as they complete (Gpu frames once their results are read) and written to
+	// disk by a ThreadPool worker. If the data waiting to be written exceeds the max queue size the frame is dropped,
+	// hence the main thread never waits on the file.
+	struct CaptureStats
+	{
+		uint   m_frameCount;    // Frames serialized.
+		uint   m_dropCount;     // Frames dropped because the write queue was full.
+		uint64 m_writtenBytes;
+		uint64 m_queuedBytes;   // Serialized but not yet written.
+		double m_avgFrameMs;    // Main thread time per frame spent serializing.
+		double m_maxFrameMs;
+		bool   m_error;         // A write failed, the file is incomplete.
+	};
+
+	// Begin streaming frames to _path (ends the current capture, if any).
+	static bool         BeginCapture(const char* _path, uint _maxQueueBytes = 64 * 1024 * 1024);
+	// Write pending data and close the file. Call before ThreadPool::Shutdown().
+	static void         EndCapture();
+	static bool         IsCapturing();
+	static CaptureStats GetCaptureStats();
+
+	// Write the marker history (all threads, complete frames only) as Chrome trace event JSON, which can be loaded in
+	// chrome://tracing or the Perfetto UI.
+	static bool         ExportTrace(const char* _path);
+	// Convert a file written by BeginCapture() to Chrome trace event JSON. A truncated file (e.g. the app crashed) is
+	// converted up to the last complete record.
+	static bool         ConvertCapture(const char* _srcPath, const char* _dstPath);
+
 	class CpuAutoMarker
 	{
 		const char* m_name;
@@ -108,7 +261,7 @@ public:
 		~GpuAutoMarker()                                  { Profiler::PopGpuMarker(m_name); }
 	};
 
-	static bool       s_pause;
+	static std::atomic<bool> s_pause; // read by worker threads in PushCpuMarker()/PopCpuMarker()
 
 	static void Init();
 	static void Shutdown();
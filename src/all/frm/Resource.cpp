@@ -17,9 +17,9 @@ void Resource<tDerived>::Use(Derived* _inst_)
 {
 	if (_inst_) {
 		++(_inst_->m_refs);
-		if (_inst_->m_refs == 1 && _inst_->m_state != State_Loaded) {
+		if (_inst_->m_refs == 1 && _inst_->m_state != State_Loaded && _inst_->m_state != State_Compiling) {
 			_inst_->m_state = State_Error;
-			if (_inst_->load()) {
+			if (_inst_->load() && _inst_->m_state != State_Compiling) {
 				_inst_->m_state = State_Loaded;
 			}
 		}
@@ -15,7 +15,8 @@ namespace frm {
 // id is a hash of the name but the two can be set independently.
 //
 // Resources are refcounted; calling Use() implicitly calls load() when the
-// refcount is 1. Calling Release() implicitly calls Destroy() when the 
+// refcount is 1. load() may leave the resource in State_Compiling if loading
+// completes asynchronously. Calling Release() implicitly calls Destroy() when the 
 // refcount is 0.
 //
 // Deriving classes must:
@@ -35,7 +36,8 @@ public:
 	{
 		State_Error,      // failed to load
 		State_Unloaded,   // created but not loaded
-		State_Loaded      // successfully loaded
+		State_Loaded,     // successfully loaded
+		State_Compiling   // load in progress (e.g. async shader compile), a previously loaded state may still be in use
 	};
 	
 	// Increment the reference count for _inst, load if 1.
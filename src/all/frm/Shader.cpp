@@ -3,17 +3,22 @@
 #include <frm/gl.h>
 #include <frm/Camera.h> // Camera_Clip* define passed to shader
 #include <frm/GlContext.h>
+#include <frm/ShaderCache.h>
 #include <frm/ShaderPreprocessor.h>
+#include <frm/Texture.h> // Texture_BINDLESS define passed to shader
 
 #include <apt/hash.h>
 #include <apt/log.h>
 #include <apt/math.h>
 #include <apt/String.h>
+#include <apt/Time.h>
 
 #include <EASTL/vector.h>
 
 #include <imgui/imgui.h>
 
+#include <cstdlib>
+
 using namespace frm;
 using namespace apt;
 
@@ -62,13 +67,37 @@ struct ShaderViewer
 		ImGui::SameLine();
 		ImGui::Checkbox("Show Hidden", &m_showHidden);
 		ImGui::SameLine();
+		bool async = Shader::IsAsync();
+		if (ImGui::Checkbox("Async", &async)) {
+			Shader::SetAsync(async);
+		}
+		ImGui::SameLine();
+		bool minify = ShaderPreprocessor::GetMinify();
+		if (ImGui::Checkbox("Minify", &minify)) {
+			ShaderPreprocessor::SetMinify(minify);
+			Shader::ReloadAll();
+		}
+		ImGui::SameLine();
 		ImGui::PushItemWidth(ImGui::GetWindowWidth() * 0.2f);
 			filter.Draw("Filter##ShaderName");
 		ImGui::PopItemWidth();
 		ImGui::SameLine();
-		if (ImGui::Button("Reload All (F9)")) {
+		if (ImGui::Button("Reload Changed (F9)")) {
+			Shader::ReloadChanged();
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Reload All")) {
 			Shader::ReloadAll();
 		}
+		if (ShaderCache::IsEnabled()) {
+			const ShaderCache::Stats& cacheStats = ShaderCache::GetStats();
+			ImGui::SameLine();
+			ImGui::Text("Cache: %d hits, %d misses, %d entries (%.2fMb)", cacheStats.m_hitCount, cacheStats.m_missCount, cacheStats.m_entryCount, (float)cacheStats.m_totalSizeBytes / (1024.0f * 1024.0f));
+			ImGui::SameLine();
+			if (ImGui::Button("Clear Cache")) {
+				ShaderCache::Clear();
+			}
+		}
 
 		ImGui::Separator();
 		ImGui::Spacing();
@@ -96,6 +125,10 @@ struct ShaderViewer
 				//ImGui::PushStyleColor(ImGuiCol_Text, col);
 					ImGui::Selectable(sh->getName(), i == m_selectedShader);
 				//ImGui::PopStyleColor();
+				if (sh->isCompiling()) {
+					ImGui::SameLine();
+					ImGui::TextColored(ImColor(0.9f, 0.7f, 0.1f), "...");
+				}
 				
 				if (ImGui::IsItemClicked()) {
 					m_selectedShader = i;
@@ -126,6 +159,7 @@ struct ShaderViewer
 				
 				ImGui::SameLine();
 				if (ImGui::Button("Reload")) {
+					ShaderPreprocessor::CheckForChanges();
 					sh->reload();
 				}
 				
@@ -284,9 +318,10 @@ void ShaderDesc::addDefine<const char*>(GLenum _stage, const char* _name, const
 {
 	int i = internal::ShaderStageToIndex(_stage);
 
- // find/modify an existing define
+ // find/modify an existing define (match the whole name, e.g. "FOO" shouldn't match "FOO_BAR")
+	size_t nameLen = strlen(_name);
 	for (auto& def : m_stages[i].m_defines) {
-		if (def.find(_name)) {
+		if (strncmp(def, _name, nameLen) == 0 && (def[nameLen] == ' ' || def[nameLen] == '\0')) {
 			def.setf("%s %s", _name, _value);
 			return;
 		}
@@ -429,6 +464,7 @@ const char* ShaderDesc::getSource(GLenum _stage) const
 // PRIVATE
 
 ShaderDesc::VersionStr ShaderDesc::s_defaultVersion("430");
+bool Shader::s_async = false;
 
 bool ShaderDesc::StageDesc::isEnabled() const
 {
@@ -443,13 +479,19 @@ bool ShaderDesc::StageDesc::isEnabled() const
 
 // PUBLIC
 
-Shader* Shader::Create(const ShaderDesc& _desc)
+Shader* Shader::Create(const ShaderDesc& _desc, bool _async)
 {
 	Id id = _desc.getHash();
 	Shader* ret = Find(id);
 	if (!ret) {
 		ret = new Shader(id, ""); // "" forces an auto generated name during reload()
 		ret->m_desc = _desc;
+	 // take the reference without Use() calling load() (i.e. reload(s_async)), Use() doesn't load if the state is
+	 // State_Compiling; then load with the requested mode, a failure leaves the state as State_Error
+		ret->setState(State_Compiling);
+		Use(ret);
+		ret->reload(_async);
+		return ret;
 	}
 	Use(ret);
 	return ret;
@@ -496,7 +538,31 @@ void Shader::Destroy(Shader*& _inst_)
 	delete _inst_;
 }
 
-bool Shader::reload()
+bool Shader::ReloadAll()
+{
+	ShaderPreprocessor::CheckForChanges();
+	return Resource<Shader>::ReloadAll();
+}
+
+bool Shader::ReloadChanged()
+{
+	ShaderPreprocessor::CheckForChanges();
+	bool ret = true;
+	for (int i = 0; i < GetInstanceCount(); ++i) {
+		Shader* sh = GetInstance(i);
+		bool reload = sh->getState() == State_Error;
+		for (int j = 0; j < internal::kShaderStageCount && !reload; ++j) {
+			const ShaderDesc::StageDesc& stage = sh->m_desc.m_stages[j];
+			reload = stage.isEnabled() && !stage.m_path.isEmpty() && ShaderPreprocessor::IsAffected(stage.m_path);
+		}
+		if (reload) {
+			ret &= sh->reload();
+		}
+	}
+	return ret;
+}
+
+bool Shader::reload(bool _async)
 {
 	bool ret = true;
 
@@ -504,94 +570,124 @@ bool Shader::reload()
 		setAutoName();
 	}
 
- // load stages
+ // load stage sources
 	for (int i = 0; i < internal::kShaderStageCount; ++i) {
 		if (m_desc.m_stages[i].isEnabled()) {
-			ret &= loadStage(i);
+			ret &= loadStageSource(i);
 		}
 	}
+	if (!ret) {
+		setState(m_handle == 0 ? State_Error : State_Loaded);
+		return false;
+	}
 
- // attach/link stages
-	if (ret) {
-		GLuint handle;
-		glAssert(handle = glCreateProgram());
-		for (int i = 0; i < internal::kShaderStageCount; ++i) {
-			if (m_desc.m_stages[i].isEnabled()) {
-				glAssert(glAttachShader(handle, m_stageHandles[i]));
-			}
+ // cancel a pending async compile
+	if (m_pendingHandle != 0) {
+		glAssert(glDeleteProgram(m_pendingHandle));
+		m_pendingHandle = 0;
+	}
+
+ // try the program binary cache
+	ShaderCache::Key cacheKey = ShaderCache::MakeKey(m_desc.getHash(), getDependencyHash());
+	GLuint handle = ShaderCache::Load(cacheKey);
+	if (handle != 0) {
+		APT_LOG("Program %d loaded from cache.", handle);
+		setHandle(handle);
+		return true;
+	}
+
+ // compile stages
+	Timestamp compileStart = Time::GetTimestamp();
+	for (int i = 0; i < internal::kShaderStageCount; ++i) {
+		if (m_desc.m_stages[i].isEnabled()) {
+			ret &= compileStage(i, !_async);
 		}
+	}
+	if (!ret) {
+		setState(m_handle == 0 ? State_Error : State_Loaded);
+		return false;
+	}
 
-		glAssert(glLinkProgram(handle));
-		
-		GLint linkStatus = GL_FALSE;
-		glAssert(glGetProgramiv(handle, GL_LINK_STATUS, &linkStatus));
-		if (linkStatus == GL_FALSE) {
-			APT_LOG_ERR("Program %d link failed:", handle);
-			APT_LOG("\tstages:");
-			for (int i = 0; i < internal::kShaderStageCount; ++i) {
-				const ShaderDesc::StageDesc& stage = m_desc.m_stages[i];
-				if (stage.isEnabled()) {
-					APT_LOG("\t\t%s", internal::GlEnumStr(internal::kShaderStages[i]));
-					if (!stage.m_path.isEmpty()) {
-						APT_LOG("\t\tpath: '%s'", (const char*)stage.m_path);
-					}
-					if (stage.m_defines.size() > 0) {
-						APT_LOG("\t\tdefines:");
-						for (auto it = stage.m_defines.begin(); it != stage.m_defines.end(); ++it) {
-							APT_LOG("\t\t\t%s", (const char*)*it);
-						}
-					}
-				}
-			}
-			const char* log = GetProgramInfoLog(handle);
-			APT_LOG("\tlog:\n%s", log);
-			FreeProgramInfoLog(log);
-
-			glAssert(glDeleteProgram(handle));
-			if (m_handle == 0) {
-			 // handle is 0, meaning we didn't successfully load a shader previously
-				setState(State_Error);
-			}
-			ret = false;
-			//APT_ASSERT(false);
-		} else {
-			APT_LOG("Program %d link succeeded.", handle);
-			if (m_handle != 0) {
-				glAssert(glDeleteProgram(m_handle));
-			}
-			m_handle = handle;
-			ret = true;
-			setState(State_Loaded);
+ // attach/link stages
+	handle = linkProgram();
+	if (_async) {
+	 // completion is polled in Update(), the previous program (if any) remains in use
+		m_pendingHandle = handle;
+		m_pendingCacheKey = cacheKey;
+		setState(State_Compiling);
+		return true;
+	}
+	if (!getProgramStatus(handle)) {
+		glAssert(glDeleteProgram(handle));
+	 // if m_handle is 0 we didn't successfully load a shader previously
+		setState(m_handle == 0 ? State_Error : State_Loaded);
+		return false;
+	}
+	ShaderCache::Store(cacheKey, handle, (Time::GetTimestamp() - compileStart).asMilliseconds());
+	setHandle(handle);
+	return true;
+}
+
+void Shader::SetAsync(bool _async)
+{
+	s_async = _async;
+}
+
+void Shader::Update()
+{
+	for (int i = 0; i < GetInstanceCount(); ++i) {
+		Shader* sh = GetInstance(i);
+		if (sh->m_pendingHandle == 0) {
+			continue;
 		}
-	} else {
-		if (m_handle == 0) {
-			setState(State_Error);
+		if (GLEW_ARB_parallel_shader_compile) {
+			GLint complete = GL_FALSE;
+			glAssert(glGetProgramiv(sh->m_pendingHandle, GL_COMPLETION_STATUS_ARB, &complete));
+			if (complete == GL_FALSE) {
+				continue;
+			}
 		}
+	 // without GL_ARB_parallel_shader_compile this may block, but only if the driver didn't finish during the previous frame
+		sh->finishPending();
 	}
-	return ret;
 }
 
-
 GLint Shader::getResourceIndex(GLenum _type, const char* _name) const
 {
-	APT_ASSERT(getState() == State_Loaded);
-	if (getState() != State_Loaded) {
-		return -1;
+	if (getResourceMap(_type)) {
+		return getResourceIndex(_type, StringHash(_name));
+	}
+	APT_ASSERT(m_handle != 0);
+	if (m_handle == 0) {
+		return GL_INVALID_INDEX;
 	}
 	GLint ret = 0;
 	glAssert(ret = glGetProgramResourceIndex(m_handle, _type, _name));
 	return ret;
 }
 
-GLint Shader::getUniformLocation(const char* _name) const
+GLint Shader::getResourceIndex(GLenum _type, StringHash _nameHash) const
 {
-	APT_ASSERT(getState() == State_Loaded);
-	if (getState() != State_Loaded) {
-		return -1;
+	const ResourceInfo* res = findResource(_type, _nameHash);
+	return res ? res->m_index : GL_INVALID_INDEX;
+}
+
+GLint Shader::getUniformLocation(StringHash _nameHash) const
+{
+	const ResourceInfo* res = findResource(GL_UNIFORM, _nameHash);
+	return res ? res->m_index : -1;
+}
+
+const Shader::ResourceInfo* Shader::findResource(GLenum _type, StringHash _nameHash) const
+{
+	APT_ASSERT(getState() == State_Loaded || getState() == State_Compiling);
+	const ResourceMap* map = getResourceMap(_type);
+	APT_ASSERT(map);
+	if (!map) {
+		return nullptr;
 	}
-	GLint ret = 0;
-	glAssert(ret = glGetUniformLocation(m_handle, _name));
-	return ret;
+	auto it = map->find(_nameHash);
+	return it == map->end() ? nullptr : &it->second;
 }
 
 void Shader::setLocalSize(int _x, int _y, int _z)
@@ -600,7 +696,9 @@ void Shader::setLocalSize(int _x, int _y, int _z)
 	m_desc.addDefine(GL_COMPUTE_SHADER, "LOCAL_SIZE_X", _x);
 	m_desc.addDefine(GL_COMPUTE_SHADER, "LOCAL_SIZE_Y", _y);
 	m_desc.addDefine(GL_COMPUTE_SHADER, "LOCAL_SIZE_Z", _z);
-	if (loadStage(internal::ShaderStageToIndex(GL_COMPUTE_SHADER), false)) {
+ // reprocess the source, conditionals on LOCAL_SIZE_* were evaluated with the old defines
+	int stage = internal::ShaderStageToIndex(GL_COMPUTE_SHADER);
+	if (loadStageSource(stage) && compileStage(stage, true)) {
 		m_localSize[0] = _x;
 		m_localSize[1] = _y;
 		m_localSize[2] = _z;
@@ -641,6 +739,7 @@ void Shader::FreeProgramInfoLog(const char*& _log_)
 Shader::Shader(uint64 _id, const char* _name)
 	: Resource<Shader>(_id, _name)
 	, m_handle(0)
+	, m_pendingHandle(0)
 {
 	APT_ASSERT(GlContext::GetCurrent());
 	memset(m_stageHandles, 0, sizeof(m_stageHandles));
@@ -654,6 +753,10 @@ Shader::~Shader()
 			m_stageHandles[i] = 0;
 		}
 	}
+	if (m_pendingHandle != 0) {
+		glAssert(glDeleteProgram(m_pendingHandle));
+		m_pendingHandle = 0;
+	}
 	if (m_handle != 0) {
 		glAssert(glDeleteProgram(m_handle));
 		m_handle = 0;
@@ -675,14 +778,35 @@ static void AppendLine(const char* _str, eastl::vector<char>& _out_)
 	_out_.push_back('\n');
 }
 
-bool Shader::loadStage(int _i, bool _loadSource)
+static const char* GetCameraClipDefine()
+{
+	#if   defined(Camera_ClipD3D)
+		return "Camera_ClipD3D";
+	#elif defined(Camera_ClipOGL)
+		return "Camera_ClipOGL";
+	#else
+		return "";
+	#endif
+}
+
+bool Shader::loadStageSource(int _i)
 {
 	ShaderDesc::StageDesc& desc = m_desc.m_stages[_i];
 	APT_ASSERT(desc.isEnabled());
 
  // process source file if required
-	if (_loadSource && !desc.m_path.isEmpty()) {
+	if (!desc.m_path.isEmpty()) {
 		ShaderPreprocessor sp;
+	 // defines must match those prepended by compileStage() for conditionals to be evaluated correctly
+		for (auto it = desc.m_defines.begin(); it != desc.m_defines.end(); ++it) {
+			sp.addDefine(*it);
+		}
+		sp.addDefine(internal::GlEnumStr(internal::kShaderStages[_i]) + 3);
+		sp.addDefine(GetCameraClipDefine());
+		if (Texture::GetBindless()) {
+			sp.addDefine("Texture_BINDLESS");
+		}
+		sp.addDefine(String<32>("__VERSION__ %d", atoi(m_desc.m_version)));
 		if (!sp.process(desc.m_path)) {
 			return false;
 		}
@@ -694,11 +818,23 @@ bool Shader::loadStage(int _i, bool _loadSource)
 		}
 		desc.m_source.push_back('\0');
 	}
+	return true;
+}
+
+bool Shader::compileStage(int _i, bool _wait)
+{
+	ShaderDesc::StageDesc& desc = m_desc.m_stages[_i];
+	APT_ASSERT(desc.isEnabled());
 
  // build final source
 	eastl::vector<char> src;
 	Append("#version ", src);
 	AppendLine(m_desc.m_version, src);
+	if (Texture::GetBindless()) {
+	 // extension directives must precede any non-preprocessor tokens, hence the shader can't enable it
+		AppendLine("#extension GL_ARB_bindless_texture : require", src);
+		AppendLine("#define Texture_BINDLESS", src);
+	}
 	for (auto it = desc.m_defines.begin(); it != desc.m_defines.end(); ++it) {
 		Append("#define ", src);
 		AppendLine(*it, src);
@@ -708,11 +844,7 @@ bool Shader::loadStage(int _i, bool _loadSource)
 	AppendLine(internal::GlEnumStr(internal::kShaderStages[_i]) + 3, src); // \hack +3 removes the 'GL_', which is reserved in the shader
 
 	Append("#define ", src);
-	#if   defined(Camera_ClipD3D)
-		AppendLine("Camera_ClipD3D", src);
-	#elif defined(Camera_ClipOGL)
-		AppendLine("Camera_ClipOGL", src);
-	#endif
+	AppendLine(GetCameraClipDefine(), src);
 
 	Append(desc.m_source.data(), src);
 	src.push_back('\n');
@@ -730,6 +862,15 @@ bool Shader::loadStage(int _i, bool _loadSource)
 
  // compile
 	glAssert(glCompileShader(m_stageHandles[_i]));
+	if (!_wait) {
+		return true;
+	}
+	return getStageStatus(_i);
+}
+
+bool Shader::getStageStatus(int _i)
+{
+	const ShaderDesc::StageDesc& desc = m_desc.m_stages[_i];
 	GLint ret = GL_FALSE;
 	glAssert(glGetShaderiv(m_stageHandles[_i], GL_COMPILE_STATUS, &ret));
 	
@@ -760,6 +901,101 @@ bool Shader::loadStage(int _i, bool _loadSource)
 	return ret == GL_TRUE;
 }
 
+GLuint Shader::linkProgram()
+{
+	GLuint ret;
+	glAssert(ret = glCreateProgram());
+	for (int i = 0; i < internal::kShaderStageCount; ++i) {
+		if (m_desc.m_stages[i].isEnabled()) {
+			glAssert(glAttachShader(ret, m_stageHandles[i]));
+		}
+	}
+	if (ShaderCache::IsEnabled()) {
+		glAssert(glProgramParameteri(ret, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+	}
+	glAssert(glLinkProgram(ret));
+	return ret;
+}
+
+bool Shader::getProgramStatus(GLuint _handle)
+{
+	GLint linkStatus = GL_FALSE;
+	glAssert(glGetProgramiv(_handle, GL_LINK_STATUS, &linkStatus));
+	if (linkStatus == GL_FALSE) {
+		APT_LOG_ERR("Program %d link failed:", _handle);
+		APT_LOG("\tstages:");
+		for (int i = 0; i < internal::kShaderStageCount; ++i) {
+			const ShaderDesc::StageDesc& stage = m_desc.m_stages[i];
+			if (stage.isEnabled()) {
+				APT_LOG("\t\t%s", internal::GlEnumStr(internal::kShaderStages[i]));
+				if (!stage.m_path.isEmpty()) {
+					APT_LOG("\t\tpath: '%s'", (const char*)stage.m_path);
+				}
+				if (stage.m_defines.size() > 0) {
+					APT_LOG("\t\tdefines:");
+					for (auto it = stage.m_defines.begin(); it != stage.m_defines.end(); ++it) {
+						APT_LOG("\t\t\t%s", (const char*)*it);
+					}
+				}
+			}
+		}
+		const char* log = GetProgramInfoLog(_handle);
+		APT_LOG("\tlog:\n%s", log);
+		FreeProgramInfoLog(log);
+		//APT_ASSERT(false);
+		return false;
+	}
+	APT_LOG("Program %d link succeeded.", _handle);
+	return true;
+}
+
+void Shader::finishPending()
+{
+	APT_ASSERT(m_pendingHandle != 0);
+	GLuint handle = m_pendingHandle;
+	m_pendingHandle = 0;
+
+ // stage compile status wasn't checked when the compile was issued
+	bool ret = true;
+	for (int i = 0; i < internal::kShaderStageCount; ++i) {
+		if (m_desc.m_stages[i].isEnabled()) {
+			ret &= getStageStatus(i);
+		}
+	}
+	ret = ret && getProgramStatus(handle);
+	if (!ret) {
+		glAssert(glDeleteProgram(handle));
+		setState(m_handle == 0 ? State_Error : State_Loaded);
+		return;
+	}
+	ShaderCache::Store(m_pendingCacheKey, handle, -1.0); // completion is polled once per frame, the compile time isn't known
+	setHandle(handle);
+}
+
+uint64 Shader::getDependencyHash() const
+{
+ // the preprocessed source contains all included files, defines/paths are covered by ShaderDesc::getHash()
+	uint64 ret = HashString<uint64>(GetCameraClipDefine());
+	ret = HashString<uint64>(Texture::GetBindless() ? "Texture_BINDLESS" : "", ret);
+	for (int i = 0; i < internal::kShaderStageCount; ++i) {
+		const ShaderDesc::StageDesc& stage = m_desc.m_stages[i];
+		if (stage.isEnabled()) {
+			ret = Hash<uint64>(stage.m_source.data(), (uint)stage.m_source.size(), ret);
+		}
+	}
+	return ret;
+}
+
+void Shader::setHandle(GLuint _handle)
+{
+	if (m_handle != 0) {
+		glAssert(glDeleteProgram(m_handle));
+	}
+	m_handle = _handle;
+	reflect();
+	setState(State_Loaded);
+}
+
 void Shader::setAutoName()
 {
 	bool first = true;
@@ -780,3 +1016,220 @@ void Shader::setAutoName()
 		}
 	}
 }
+
+void Shader::reflect()
+{
+	APT_ASSERT(m_handle != 0);
+	static const int kMaxResNameLength = 128;
+	char resName[kMaxResNameLength];
+
+	m_uniforms.clear();
+	m_uniformBlocks.clear();
+	m_storageBlocks.clear();
+
+ // uniforms (including samplers/images), block members are skipped
+	GLint count;
+	glAssert(glGetProgramInterfaceiv(m_handle, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count));
+	for (GLint i = 0; i < count; ++i) {
+		static const GLenum kProps[] = { GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE };
+		GLint props[3];
+		glAssert(glGetProgramResourceiv(m_handle, GL_UNIFORM, i, 3, kProps, 3, 0, props));
+		if (props[0] == -1) {
+			continue;
+		}
+		GLsizei len;
+		glAssert(glGetProgramResourceName(m_handle, GL_UNIFORM, i, kMaxResNameLength - 1, &len, resName));
+		ResourceInfo info;
+		info.m_index    = props[0];
+		info.m_dataType = (GLenum)props[1];
+		info.m_size     = props[2];
+		m_uniforms[StringHash(resName)] = info;
+
+	 // array uniforms are reported as "name[0]", add the base name and each element (element locations are sequential)
+		if (len > 3 && strcmp(resName + len - 3, "[0]") == 0) {
+			resName[len - 3] = '\0';
+			m_uniforms[StringHash(resName)] = info;
+			for (GLint j = 1; j < info.m_size; ++j) {
+				ResourceInfo elem = info;
+				elem.m_index += j;
+				elem.m_size   = 1;
+				m_uniforms[StringHash(String<kMaxResNameLength>("%s[%d]", resName, j))] = elem;
+			}
+		}
+	}
+
+ // uniform/storage blocks
+	for (GLenum type : { GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK }) {
+		ResourceMap& map = type == GL_UNIFORM_BLOCK ? m_uniformBlocks : m_storageBlocks;
+		glAssert(glGetProgramInterfaceiv(m_handle, type, GL_ACTIVE_RESOURCES, &count));
+		for (GLint i = 0; i < count; ++i) {
+			static const GLenum kProps[] = { GL_BUFFER_DATA_SIZE };
+			GLint props[1];
+			glAssert(glGetProgramResourceiv(m_handle, type, i, 1, kProps, 1, 0, props));
+			glAssert(glGetProgramResourceName(m_handle, type, i, kMaxResNameLength - 1, 0, resName));
+			ResourceInfo info;
+			info.m_index    = i;
+			info.m_dataType = GL_NONE;
+			info.m_size     = props[0];
+			map[StringHash(resName)] = info;
+		}
+	}
+}
+
+const Shader::ResourceMap* Shader::getResourceMap(GLenum _type) const
+{
+	switch (_type) {
+		case GL_UNIFORM:               return &m_uniforms;
+		case GL_UNIFORM_BLOCK:         return &m_uniformBlocks;
+		case GL_SHADER_STORAGE_BLOCK:  return &m_storageBlocks;
+		default:                       return nullptr;
+	};
+}
+
+/*******************************************************************************
+
+                             ShaderPermutations
+
+*******************************************************************************/
+
+// PUBLIC
+
+ShaderPermutations::ShaderPermutations(const ShaderDesc& _base, bool _async)
+	: m_base(_base)
+	, m_async(_async)
+	, m_keyBits(0)
+{
+}
+
+ShaderPermutations::~ShaderPermutations()
+{
+	clear();
+}
+
+int ShaderPermutations::addFlag(const char* _name)
+{
+	return addAxis(_name, 1);
+}
+
+int ShaderPermutations::addEnum(const char* _name, const char* _values)
+{
+	eastl::vector<Axis::NameStr> values;
+	while (*_values != '\0') {
+		values.push_back(Axis::NameStr(_values));
+		_values = strchr(_values, 0);
+		++_values;
+	}
+	APT_ASSERT(values.size() > 1);
+	int bits = 1;
+	while ((1 << bits) < (int)values.size()) {
+		++bits;
+	}
+	int ret = addAxis(_name, bits);
+	m_axes[ret].m_values = values;
+	return ret;
+}
+
+int ShaderPermutations::findAxis(const char* _name) const
+{
+	for (int i = 0; i < (int)m_axes.size(); ++i) {
+		if (m_axes[i].m_name == _name) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+ShaderPermutations::Key ShaderPermutations::setFlag(Key _key, int _axis, bool _value) const
+{
+	APT_ASSERT(m_axes[_axis].m_values.empty());
+	return setEnum(_key, _axis, _value ? 1 : 0);
+}
+
+ShaderPermutations::Key ShaderPermutations::setEnum(Key _key, int _axis, int _value) const
+{
+	const Axis& axis = m_axes[_axis];
+	APT_ASSERT(_value >= 0 && _value < (axis.m_values.empty() ? 2 : (int)axis.m_values.size()));
+	Key mask = ((1u << axis.m_bits) - 1u) << axis.m_shift;
+	return (_key & ~mask) | (((Key)_value << axis.m_shift) & mask);
+}
+
+bool ShaderPermutations::getFlag(Key _key, int _axis) const
+{
+	return getEnum(_key, _axis) != 0;
+}
+
+int ShaderPermutations::getEnum(Key _key, int _axis) const
+{
+	const Axis& axis = m_axes[_axis];
+	return (int)((_key >> axis.m_shift) & ((1u << axis.m_bits) - 1u));
+}
+
+Shader* ShaderPermutations::get(Key _key)
+{
+	auto it = m_variants.find(_key);
+	if (it != m_variants.end()) {
+		return it->second;
+	}
+
+	ShaderDesc desc;
+	makeDesc(_key, desc);
+	Shader* ret = Shader::Create(desc, m_async);
+	if (ret->getRefCount() == 1) {
+	 // newly created, append the key to the auto generated name
+		String<64> name("%s_%x", ret->getName(), _key); // getName() points to the name being set, format via a copy
+		ret->setName(name);
+	}
+	m_variants[_key] = ret;
+	return ret;
+}
+
+void ShaderPermutations::precompile()
+{
+	for (Key key : m_precompile) {
+		get(key);
+	}
+}
+
+void ShaderPermutations::clear()
+{
+	for (auto& it : m_variants) {
+		Shader::Release(it.second);
+	}
+	m_variants.clear();
+}
+
+// PRIVATE
+
+int ShaderPermutations::addAxis(const char* _name, int _bits)
+{
+	APT_ASSERT(findAxis(_name) == -1);
+	APT_ASSERT(m_variants.empty()); // can't add axes once variants exist, keys would be invalidated
+	APT_ASSERT(m_keyBits + _bits <= kMaxKeyBits);
+	Axis axis;
+	axis.m_name.set(_name);
+	axis.m_shift = m_keyBits;
+	axis.m_bits = _bits;
+	m_axes.push_back(axis);
+	m_keyBits += _bits;
+	return (int)m_axes.size() - 1;
+}
+
+void ShaderPermutations::makeDesc(Key _key, ShaderDesc& desc_) const
+{
+	desc_ = m_base;
+	for (int i = 0; i < (int)m_axes.size(); ++i) {
+		const Axis& axis = m_axes[i];
+		int value = getEnum(_key, i);
+		if (axis.m_values.empty()) {
+			if (value != 0) {
+				desc_.addGlobalDefine(axis.m_name);
+			}
+		} else {
+			APT_ASSERT(value < (int)axis.m_values.size());
+			for (int j = 0; j < (int)axis.m_values.size(); ++j) {
+				desc_.addGlobalDefine(axis.m_values[j], j);
+			}
+			desc_.addGlobalDefine(axis.m_name, value);
+		}
+	}
+}
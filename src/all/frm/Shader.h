@@ -7,8 +7,11 @@
 #include <frm/Resource.h>
 
 #include <apt/String.h>
+#include <apt/StringHash.h>
 
+#include <EASTL/hash_map.h>
 #include <EASTL/vector.h>
+#include <EASTL/vector_map.h>
 
 namespace frm
 {
@@ -102,11 +105,24 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////
 // Shader
+// Active uniforms, uniform blocks and shader storage blocks are reflected once
+// after a successful link; name lookups via getResourceIndex() and 
+// getUniformLocation() hit this table rather than calling into GL.
 ////////////////////////////////////////////////////////////////////////////////
 class Shader: public Resource<Shader>
 {
 public:
-	static Shader* Create(const ShaderDesc& _desc);
+	struct ResourceInfo
+	{
+		GLint  m_index;     // Location (uniforms) or resource index (blocks).
+		GLenum m_dataType;  // Uniforms only, e.g. GL_FLOAT_VEC4, GL_SAMPLER_2D.
+		GLint  m_size;      // Array size (uniforms) or buffer data size (blocks).
+	};
+
+	static Shader* Create(const ShaderDesc& _desc)                     { return Create(_desc, s_async); }
+	// As Create(), override the async compile mode if the shader is loaded
+	// by this call (see SetAsync()).
+	static Shader* Create(const ShaderDesc& _desc, bool _async);
 
 	// Load/compile/link directly from a set of paths. _defines is a list of null-separated strings e.g. "DEFINE1 1\0DEFINE2 1\0"
 	static Shader* CreateVsFs(const char* _vsPath, const char* _fsPath, const char* _defines = 0);
@@ -117,19 +133,53 @@ public:
 
 	static void    ShowShaderViewer(bool* _open_);
 
-	bool load() { return reload(); }
+	// Reload all shaders (hides Resource::ReloadAll() to pick up modified
+	// source files, see ShaderPreprocessor::CheckForChanges()).
+	static bool    ReloadAll();
+
+	// Reload only shaders whose source files (or any included files) changed,
+	// plus any which previously failed to load. Return false if any reload failed.
+	static bool    ReloadChanged();
+
+	// Enable/disable async compilation (default is disabled). In async mode
+	// load()/reload() issue all stage compiles and the link without waiting
+	// for the result and the shader enters State_Compiling; Update() polls
+	// for completion. A previously loaded program remains in use until the new
+	// program links successfully.
+	static void    SetAsync(bool _async);
+	static bool    IsAsync()                                           { return s_async; }
+
+	// Poll pending async compiles. This is non-blocking if 
+	// GL_ARB_parallel_shader_compile is supported. Call once per frame.
+	static void    Update();
+
+	bool load()                                                        { return reload(s_async); }
 
 	// Attempt to reload/compile all stages and link the shader program.
 	// Return false if any stage fails to compile, or if link failed. If a
 	//   previous attempt to load the shader was successful the shader remains
-	//   valid even if reload() fails.
-	bool reload();
+	//   valid even if reload() fails. If _async is true, compile/link errors
+	//   are reported when the compile completes (see Update()).
+	bool reload()                                                      { return reload(s_async); }
+	bool reload(bool _async);
+
+	bool isCompiling() const                                           { return m_pendingHandle != 0; }
 	
-	// Retrieve the index of a program resource via glGetProgramResourceIndex.
+	// Retrieve the index of a program resource. GL_UNIFORM, GL_UNIFORM_BLOCK and
+	// GL_SHADER_STORAGE_BLOCK are resolved from the reflection table, other
+	// interfaces fall back to glGetProgramResourceIndex (const char* only).
+	// Return GL_INVALID_INDEX if _name is not active.
 	GLint getResourceIndex(GLenum _type, const char* _name) const;
+	GLint getResourceIndex(GLenum _type, apt::StringHash _nameHash) const;
 
-	// Retrieve teh location of a named uniform via glGetUniformLocation;
-	GLint getUniformLocation(const char* _name) const;
+	// Retrieve the location of a named uniform. Array elements may be accessed 
+	// individually (e.g. "uArray[2]"). Return -1 if _name is not active.
+	GLint getUniformLocation(const char* _name) const                  { return getUniformLocation(apt::StringHash(_name)); }
+	GLint getUniformLocation(apt::StringHash _nameHash) const;
+
+	// Return reflection info for a named resource of _type (see getResourceIndex()), 
+	// or nullptr if not active.
+	const ResourceInfo* findResource(GLenum _type, apt::StringHash _nameHash) const;
 	
 	GLuint getHandle() const { return m_handle; }
 	
@@ -141,13 +191,22 @@ public:
 	int  getLocalSizeZ() const { return m_localSize[2]; }
 	void setLocalSize(int _x, int _y = 1, int _z = 1);
 private:
+	static bool s_async;
+
 	GLuint     m_handle;
+	GLuint     m_pendingHandle;   // async compile in progress
+	uint64     m_pendingCacheKey;
 
 	ShaderDesc m_desc;
 	GLuint     m_stageHandles[internal::kShaderStageCount];
 
 	int m_localSize[3]; // compute shader only
 
+	typedef eastl::hash_map<apt::StringHash::HashType, ResourceInfo> ResourceMap; // O(1) lookup on the bind path
+	ResourceMap m_uniforms;
+	ResourceMap m_uniformBlocks;
+	ResourceMap m_storageBlocks;
+
 	// Get/free info log for a shader stage.
 	static const char* GetStageInfoLog(GLuint _handle);
 	static void FreeStageInfoLog(const char*& _log_);
@@ -159,14 +218,125 @@ private:
 	Shader(uint64 _id, const char* _name);
 	~Shader();	
 
-	// Load the specified stage, return status.
-	bool loadStage(int _i, bool _loadSource = true);
+	// Load the source for the specified stage (run the preprocessor if the
+	// stage has a path), return status.
+	bool loadStageSource(int _i);
+
+	// Compile the specified stage. If _wait, return the compile status, else
+	// return true immediately (see getStageStatus()).
+	bool compileStage(int _i, bool _wait);
+
+	// Get the compile status for the specified stage, log errors.
+	bool getStageStatus(int _i);
+
+	// Create a program, attach all stages and link (don't wait for the result).
+	GLuint linkProgram();
+
+	// Get the link status for _handle, log errors.
+	bool getProgramStatus(GLuint _handle);
+
+	// Complete a pending async compile.
+	void finishPending();
+
+	// Hash of the preprocessed stage sources, used to key the program cache.
+	uint64 getDependencyHash() const;
+
+	// Release the current program (if any), set _handle and reflect resources.
+	void setHandle(GLuint _handle);
 
 	// Set the name automatically based on desc.
 	void setAutoName();
 
+	// Reflect active resources from m_handle (call after a successful link).
+	void reflect();
+
+	const ResourceMap* getResourceMap(GLenum _type) const;
+
 }; // class Shader
 
+////////////////////////////////////////////////////////////////////////////////
+// ShaderPermutations
+// Set of variants of a base ShaderDesc, selected by a compact key. Each axis
+// is either a boolean flag (1 bit) or an enum (ceil(log2(n)) bits):
+// - Flags add "#define NAME 1" to all stages if set, else are undefined.
+// - Enums add "#define NAME i" where i is the selected value index. All value
+//   names are also defined as their index so that shaders can test e.g.
+//   '#if QUALITY == QUALITY_HIGH'.
+//
+// Variants are created on the first call to get() and cached; use the
+// precompile list to warm up known variants at startup.
+//
+// Typical usage:
+//   ShaderPermutations perms(desc);
+//   int shadows = perms.addFlag("SHADOWS");
+//   int quality = perms.addEnum("QUALITY", "QUALITY_LOW\0QUALITY_HIGH\0");
+//   ShaderPermutations::Key key = 0;
+//   key = perms.setFlag(key, shadows, true);
+//   key = perms.setEnum(key, quality, 1);
+//   Shader* sh = perms.get(key);
+////////////////////////////////////////////////////////////////////////////////
+class ShaderPermutations: private apt::non_copyable<ShaderPermutations>
+{
+public:
+	typedef uint32 Key;
+	static const int kMaxKeyBits = sizeof(Key) * 8;
+
+	ShaderPermutations(const ShaderDesc& _base, bool _async = false);
+	~ShaderPermutations();
+
+	// Add a boolean axis, return the axis index.
+	int    addFlag(const char* _name);
+	// Add an enum axis, return the axis index. _values is a null-separated list
+	// of value names e.g. "QUALITY_LOW\0QUALITY_HIGH\0".
+	int    addEnum(const char* _name, const char* _values);
+	// Return the axis index, or -1 if not found.
+	int    findAxis(const char* _name) const;
+
+	Key    setFlag(Key _key, int _axis, bool _value) const;
+	Key    setEnum(Key _key, int _axis, int _value) const;
+	bool   getFlag(Key _key, int _axis) const;
+	int    getEnum(Key _key, int _axis) const;
+
+	// Get the variant for _key, create it if required. If async compilation
+	// is enabled the variant may be in State_Compiling (see Shader::SetAsync()).
+	Shader* get(Key _key);
+
+	// Add _key to the precompile list.
+	void   addPrecompile(Key _key)                              { m_precompile.push_back(_key); }
+	// Create all variants in the precompile list.
+	void   precompile();
+
+	// Release all variants.
+	void   clear();
+
+	const ShaderDesc& getBaseDesc() const                      { return m_base; }
+	int    getVariantCount() const                             { return (int)m_variants.size(); }
+	void   setAsync(bool _async)                               { m_async = _async; }
+
+private:
+	struct Axis
+	{
+		typedef apt::String<32> NameStr;
+		NameStr                m_name;
+		int                    m_shift;
+		int                    m_bits;
+		eastl::vector<NameStr> m_values; // Enum only.
+	};
+
+	ShaderDesc                        m_base;
+	bool                              m_async;
+	int                               m_keyBits;
+	eastl::vector<Axis>               m_axes;
+	eastl::vector_map<Key, Shader*>   m_variants;
+	eastl::vector<Key>                m_precompile;
+
+	int    addAxis(const char* _name, int _bits);
+
+	// Build the desc for _key.
+	void   makeDesc(Key _key, ShaderDesc& desc_) const;
+
+}; // class ShaderPermutations
+
 } // namespace frm
 
 #endif // frm_Shader_h
@@ -0,0 +1,322 @@
+#include <frm/ShaderCache.h>
+
+#include <frm/gl.h>
+
+#include <apt/log.h>
+#include <apt/hash.h>
+#include <apt/File.h>
+#include <apt/FileSystem.h>
+#include <apt/String.h>
+#include <apt/Time.h>
+
+#include <EASTL/vector.h>
+#include <EASTL/vector_map.h>
+
+#include <cstring>
+
+using namespace frm;
+using namespace apt;
+
+static const uint32 kFileMagic   = 0x53435246; // 'FRCS'
+static const uint32 kFileVersion = 1;
+
+struct FileHeader
+{
+	uint32 m_magic;
+	uint32 m_version;
+	uint64 m_driverHash;
+	uint64 m_useCounter;
+	uint32 m_entryCount;
+	uint32 m_pad;
+};
+
+struct EntryHeader
+{
+	uint64 m_key;
+	uint64 m_lastUse;
+	uint32 m_format;
+	uint32 m_sizeBytes;
+	float  m_compileTimeMs;
+	uint32 m_pad;
+};
+
+struct Entry
+{
+	GLenum              m_format;
+	uint64              m_lastUse;
+	float               m_compileTimeMs;
+	eastl::vector<char> m_data;
+};
+
+typedef eastl::vector_map<ShaderCache::Key, Entry> EntryMap;
+
+static bool                     g_enabled;
+static bool                     g_dirty;
+static FileSystem::PathStr      g_path;
+static uint64                   g_maxSizeBytes;
+static uint64                   g_driverHash;
+static uint64                   g_useCounter;
+static EntryMap                 g_entries;
+static ShaderCache::Stats       g_stats;
+
+static uint64 HashDriver()
+{
+	uint64 ret = HashString<uint64>(internal::GlGetString(GL_VENDOR));
+	ret = HashString<uint64>(internal::GlGetString(GL_RENDERER), ret);
+	ret = HashString<uint64>(internal::GlGetString(GL_VERSION), ret);
+	ret = HashString<uint64>(internal::GlGetString(GL_SHADING_LANGUAGE_VERSION), ret);
+	return ret;
+}
+
+static void Evict(uint64 _requiredBytes)
+{
+	while (!g_entries.empty() && g_stats.m_totalSizeBytes + _requiredBytes > g_maxSizeBytes) {
+		auto lru = g_entries.begin();
+		for (auto it = g_entries.begin(); it != g_entries.end(); ++it) {
+			if (it->second.m_lastUse < lru->second.m_lastUse) {
+				lru = it;
+			}
+		}
+		g_stats.m_totalSizeBytes -= lru->second.m_data.size();
+		g_entries.erase(lru);
+		g_dirty = true;
+	}
+	g_stats.m_entryCount = (int)g_entries.size();
+}
+
+static bool ReadCache(const char* _path)
+{
+	File f;
+	if (!FileSystem::ReadIfExists(f, _path)) {
+		return false;
+	}
+	const char* beg = f.getData();
+	const char* end = beg + f.getDataSize();
+	if (f.getDataSize() < sizeof(FileHeader)) {
+		APT_LOG_ERR("ShaderCache: Invalid cache file '%s'", _path);
+		return false;
+	}
+	FileHeader fh;
+	memcpy(&fh, beg, sizeof(FileHeader));
+	beg += sizeof(FileHeader);
+	if (fh.m_magic != kFileMagic || fh.m_version != kFileVersion) {
+		APT_LOG("ShaderCache: '%s' version mismatch, cache invalidated", _path);
+		return false;
+	}
+	if (fh.m_driverHash != g_driverHash) {
+		APT_LOG("ShaderCache: '%s' driver mismatch, cache invalidated", _path);
+		return false;
+	}
+	g_useCounter = fh.m_useCounter;
+	for (uint32 i = 0; i < fh.m_entryCount; ++i) {
+		EntryHeader eh;
+		if (beg + sizeof(EntryHeader) > end) {
+			break;
+		}
+		memcpy(&eh, beg, sizeof(EntryHeader));
+		beg += sizeof(EntryHeader);
+		if (beg + eh.m_sizeBytes > end) {
+			APT_LOG_ERR("ShaderCache: '%s' truncated (%u/%u entries)", _path, i, fh.m_entryCount);
+			break;
+		}
+		Entry& entry = g_entries[eh.m_key];
+		entry.m_format        = (GLenum)eh.m_format;
+		entry.m_lastUse       = eh.m_lastUse;
+		entry.m_compileTimeMs = eh.m_compileTimeMs;
+		entry.m_data.assign(beg, beg + eh.m_sizeBytes);
+		beg += eh.m_sizeBytes;
+		g_stats.m_totalSizeBytes += eh.m_sizeBytes;
+	}
+	g_stats.m_entryCount = (int)g_entries.size();
+	return true;
+}
+
+static bool WriteCache(const char* _path)
+{
+	eastl::vector<char> data;
+	data.reserve(sizeof(FileHeader) + g_entries.size() * sizeof(EntryHeader) + (size_t)g_stats.m_totalSizeBytes);
+
+	FileHeader fh = {};
+	fh.m_magic      = kFileMagic;
+	fh.m_version    = kFileVersion;
+	fh.m_driverHash = g_driverHash;
+	fh.m_useCounter = g_useCounter;
+	fh.m_entryCount = (uint32)g_entries.size();
+	data.insert(data.end(), (const char*)&fh, (const char*)&fh + sizeof(FileHeader));
+	for (auto it = g_entries.begin(); it != g_entries.end(); ++it) {
+		EntryHeader eh = {};
+		eh.m_key           = it->first;
+		eh.m_lastUse       = it->second.m_lastUse;
+		eh.m_format        = (uint32)it->second.m_format;
+		eh.m_sizeBytes     = (uint32)it->second.m_data.size();
+		eh.m_compileTimeMs = it->second.m_compileTimeMs;
+		data.insert(data.end(), (const char*)&eh, (const char*)&eh + sizeof(EntryHeader));
+		data.insert(data.end(), it->second.m_data.begin(), it->second.m_data.end());
+	}
+
+	File f;
+	f.setData(data.data(), (uint)data.size());
+	return FileSystem::Write(f, _path);
+}
+
+// PUBLIC
+
+bool ShaderCache::Init(const char* _path, uint64 _maxSizeBytes)
+{
+	APT_AUTOTIMER("ShaderCache::Init");
+
+	g_enabled = false;
+	g_entries.clear();
+	memset(&g_stats, 0, sizeof(g_stats));
+	if (!GLEW_ARB_get_program_binary) {
+		APT_LOG("ShaderCache: GL_ARB_get_program_binary not supported, cache disabled");
+		return false;
+	}
+	GLint formatCount = 0;
+	glAssert(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount));
+	if (formatCount == 0) {
+		APT_LOG("ShaderCache: No program binary formats, cache disabled");
+		return false;
+	}
+
+	g_enabled      = true;
+	g_dirty        = false;
+	g_path.set(_path);
+	g_maxSizeBytes = _maxSizeBytes;
+	g_driverHash   = HashDriver();
+	g_useCounter   = 0;
+	if (!ReadCache(_path)) {
+		g_entries.clear();
+		g_stats.m_totalSizeBytes = 0;
+		g_dirty = true; // overwrite the invalid file
+	}
+	Evict(0); // in case the limit changed
+	return true;
+}
+
+void ShaderCache::Shutdown()
+{
+	if (!g_enabled) {
+		return;
+	}
+	if (g_dirty) {
+		if (!WriteCache(g_path)) {
+			APT_LOG_ERR("ShaderCache: Failed to write '%s'", (const char*)g_path);
+		}
+	}
+	g_entries.clear();
+	g_enabled = false;
+}
+
+bool ShaderCache::IsEnabled()
+{
+	return g_enabled;
+}
+
+ShaderCache::Key ShaderCache::MakeKey(uint64 _descHash, uint64 _dependencyHash)
+{
+	Key ret = Hash<uint64>(&_descHash, sizeof(_descHash), g_driverHash);
+	return Hash<uint64>(&_dependencyHash, sizeof(_dependencyHash), ret);
+}
+
+GLuint ShaderCache::Load(Key _key)
+{
+	if (!g_enabled) {
+		return 0;
+	}
+	auto it = g_entries.find(_key);
+	if (it == g_entries.end()) {
+		++g_stats.m_missCount;
+		return 0;
+	}
+
+	Timestamp t = Time::GetTimestamp();
+	Entry& entry = it->second;
+	GLuint ret;
+	glAssert(ret = glCreateProgram());
+	glAssert(glProgramParameteri(ret, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+	glAssert(glProgramBinary(ret, entry.m_format, entry.m_data.data(), (GLsizei)entry.m_data.size()));
+	GLint linkStatus = GL_FALSE;
+	glAssert(glGetProgramiv(ret, GL_LINK_STATUS, &linkStatus));
+	if (linkStatus == GL_FALSE) {
+	 // binary was rejected (driver changed without a version string change, or the binary is corrupt), invalidate the entry
+		glAssert(glDeleteProgram(ret));
+		g_stats.m_totalSizeBytes -= entry.m_data.size();
+		g_entries.erase(it);
+		g_stats.m_entryCount = (int)g_entries.size();
+		g_dirty = true;
+		++g_stats.m_rejectCount;
+		++g_stats.m_missCount;
+		return 0;
+	}
+	entry.m_lastUse = ++g_useCounter;
+	g_dirty = true;
+	++g_stats.m_hitCount;
+	if (entry.m_compileTimeMs < 0.0f) {
+		++g_stats.m_untimedHitCount;
+	} else {
+		g_stats.m_timeSavedMs += (double)entry.m_compileTimeMs - (Time::GetTimestamp() - t).asMilliseconds();
+	}
+	return ret;
+}
+
+bool ShaderCache::Store(Key _key, GLuint _handle, double _compileTimeMs)
+{
+	if (!g_enabled) {
+		return false;
+	}
+	GLint size = 0;
+	glAssert(glGetProgramiv(_handle, GL_PROGRAM_BINARY_LENGTH, &size));
+	if (size <= 0 || (uint64)size > g_maxSizeBytes) {
+		return false;
+	}
+
+	auto it = g_entries.find(_key);
+	if (it != g_entries.end()) {
+		g_stats.m_totalSizeBytes -= it->second.m_data.size();
+		g_entries.erase(it);
+	}
+	Evict((uint64)size);
+
+	Entry& entry = g_entries[_key];
+	entry.m_data.resize(size);
+	GLenum format;
+	glAssert(glGetProgramBinary(_handle, size, nullptr, &format, entry.m_data.data()));
+	entry.m_format        = format;
+	entry.m_lastUse       = ++g_useCounter;
+	entry.m_compileTimeMs = (float)_compileTimeMs;
+	g_stats.m_totalSizeBytes += size;
+	g_stats.m_entryCount = (int)g_entries.size();
+	g_dirty = true;
+	return true;
+}
+
+void ShaderCache::Clear()
+{
+	g_entries.clear();
+	g_stats.m_totalSizeBytes = 0;
+	g_stats.m_entryCount = 0;
+	g_dirty = true;
+}
+
+const ShaderCache::Stats& ShaderCache::GetStats()
+{
+	return g_stats;
+}
+
+void ShaderCache::LogReport()
+{
+	if (!g_enabled) {
+		return;
+	}
+	APT_LOG("ShaderCache: %d hits, %d misses (%d rejected), saved %.2fms (excluding %d async hits); %d entries, %.2f/%.2fMb",
+		g_stats.m_hitCount,
+		g_stats.m_missCount,
+		g_stats.m_rejectCount,
+		g_stats.m_timeSavedMs,
+		g_stats.m_untimedHitCount,
+		g_stats.m_entryCount,
+		(double)g_stats.m_totalSizeBytes / (1024.0 * 1024.0),
+		(double)g_maxSizeBytes / (1024.0 * 1024.0)
+		);
+}
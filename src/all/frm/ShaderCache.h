@@ -0,0 +1,73 @@
+#pragma once
+#ifndef frm_ShaderCache_h
+#define frm_ShaderCache_h
+
+#include <frm/def.h>
+#include <frm/gl.h>
+
+namespace frm {
+
+////////////////////////////////////////////////////////////////////////////////
+// ShaderCache
+// On-disk cache of linked program binaries (glGetProgramBinary/glProgramBinary).
+// - Entries are keyed by a hash of the ShaderDesc, the preprocessed include
+//   dependencies and the driver vendor/renderer/version strings.
+// - The whole cache is read on Init() and written on Shutdown(). The cache file
+//   is discarded if it was written by a different driver.
+// - If the total size exceeds the limit, least recently used entries are
+//   evicted first.
+// - If the driver rejects a binary, the entry is invalidated and Load() returns
+//   0; the caller should then compile from source.
+////////////////////////////////////////////////////////////////////////////////
+class ShaderCache
+{
+public:
+	typedef uint64 Key;
+
+	struct Stats
+	{
+		int    m_hitCount;
+		int    m_missCount;
+		int    m_rejectCount;     // Binaries rejected by the driver.
+		int    m_untimedHitCount; // Hits whose compile time is unknown (async compiles), not included in m_timeSavedMs.
+		double m_timeSavedMs;     // Compile time of hits minus the time taken to load them.
+		uint64 m_totalSizeBytes;
+		int    m_entryCount;
+	};
+
+	// Read the cache from _path, if it exists. _maxSizeBytes limits the total
+	// size of all binaries. Return false if GL_ARB_get_program_binary isn't
+	// supported (the cache is disabled).
+	static bool  Init(const char* _path, uint64 _maxSizeBytes = 64 * 1024 * 1024);
+
+	// Write the cache to disk and release all entries.
+	static void  Shutdown();
+
+	static bool  IsEnabled();
+
+	// Make a cache key from _descHash (see ShaderDesc::getHash()) and
+	// _dependencyHash (hash of the preprocessed source dependencies).
+	static Key   MakeKey(uint64 _descHash, uint64 _dependencyHash);
+
+	// Create and link a new program from the binary for _key. Return 0 if
+	// _key isn't in the cache or if the driver rejected the binary.
+	static GLuint Load(Key _key);
+
+	// Store the binary for the linked program _handle. _compileTimeMs is the
+	// time taken to compile/link _handle from source, or < 0 if unknown.
+	// Programs must be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+	static bool  Store(Key _key, GLuint _handle, double _compileTimeMs);
+
+	// Remove all entries.
+	static void  Clear();
+
+	static const Stats& GetStats();
+
+	// Log hits/misses and time saved.
+	static void  LogReport();
+
+}; // class ShaderCache
+
+} // namespace frm
+
+#endif // frm_ShaderCache_h
@@ -1,81 +1,806 @@
 #include <frm/ShaderPreprocessor.h>
 
 #include <apt/log.h>
+#include <apt/hash.h>
 #include <apt/File.h>
 #include <apt/FileSystem.h>
 #include <apt/String.h>
-#include <apt/TextParser.h>
+
+#include <EASTL/vector_map.h>
+#include <EASTL/vector_set.h>
+
+#include <cctype>
+#include <cstring>
 
 using namespace frm;
 using namespace apt;
 
-// PUBLIC 
+/*******************************************************************************
 
-ShaderPreprocessor::ShaderPreprocessor()
+                                 SourceFile
+
+*******************************************************************************/
+
+// Cached source file with comments removed, split into logical lines (a line
+// with continuations spans several physical lines).
+struct SourceFile
 {
+	enum Directive
+	{
+		Directive_None,
+		Directive_Include,
+		Directive_Define,
+		Directive_Undef,
+		Directive_If,
+		Directive_Ifdef,
+		Directive_Ifndef,
+		Directive_Elif,
+		Directive_Else,
+		Directive_Endif,
+		Directive_Other      // #version, #extension, #pragma, #error, etc. passed through.
+	};
+
+	struct Line
+	{
+		uint       m_beg, m_end;    // Text range in m_text (excluding the newline).
+		uint       m_args;          // Start of the directive arguments in m_text.
+		uint       m_line;          // First physical line.
+		uint       m_lineCount;     // Physical line count.
+		Directive  m_directive;
+		int        m_include;       // Index into m_includes for Directive_Include.
+	};
+
+	struct Include
+	{
+		uint64     m_hash;
+		String<64> m_path;
+	};
+
+	String<64>             m_path;
+	uint64                 m_pathHash;
+	uint64                 m_dataHash;
+	eastl::vector<char>    m_text;
+	eastl::vector<Line>    m_lines;
+	eastl::vector<Include> m_includes;
+};
+
+typedef eastl::vector_map<uint64, SourceFile*>               SourceFileMap;
+typedef eastl::vector_map<uint64, eastl::vector_set<uint64> > DependencyMap;
+static SourceFileMap             g_sourceFiles;
+static DependencyMap             g_includedBy; // reverse dependency graph: path hash -> path hashes of files which include it
+static eastl::vector_set<uint64> g_affected;   // see CheckForChanges()
+static bool                      g_minify;
+
+static const uint kMaxLineGap    = 8;  // append up to this many newlines before using a #line pragma
+static const uint kMaxMacroValue = 63; // longer macro values aren't stored, see ShaderPreprocessor::Macro
+
+static uint64 HashPath(const char* _path)
+{
+	return HashString<uint64>(_path);
 }
 
-bool ShaderPreprocessor::process(const char* _fileName)
+static uint64 HashName(const char* _beg, const char* _end)
+{
+	return Hash<uint64>(_beg, (uint)(_end - _beg));
+}
+
+static bool IsIdentifier(char _c)
+{
+	return isalnum(_c) || _c == '_';
+}
+
+static bool IsWhitespace(const char* _str, const char* _end)
+{
+	return *_str == ' ' || *_str == '\t' || (*_str == '\\' && _str + 1 < _end && _str[1] == '\n');
+}
+
+static bool IsOperator(char _c)
+{
+	return _c != '\0' && strchr("+-*/%<>=!&|^~?:#", _c) != nullptr;
+}
+
+static const char* SkipWhitespace(const char* _str, const char* _end)
+{
+	while (_str < _end && IsWhitespace(_str, _end)) {
+		_str += *_str == '\\' ? 2 : 1;
+	}
+	return _str;
+}
+
+static const char* SkipIdentifier(const char* _str, const char* _end)
+{
+	while (_str < _end && IsIdentifier(*_str)) {
+		++_str;
+	}
+	return _str;
+}
+
+// Names beginning with 'GL_' or '__' are reserved, they may be defined by the driver.
+static bool IsReserved(const char* _beg, const char* _end)
+{
+	return (_end - _beg) > 2 && ((_beg[0] == 'G' && _beg[1] == 'L' && _beg[2] == '_') || (_beg[0] == '_' && _beg[1] == '_'));
+}
+
+static void RemoveDependencies(const SourceFile& _file)
+{
+	for (auto& inc : _file.m_includes) {
+		g_includedBy[inc.m_hash].erase(_file.m_pathHash);
+	}
+}
+
+static SourceFile::Directive ParseDirective(const char* _beg, const char* _end)
+{
+	static const struct { const char* m_name; SourceFile::Directive m_directive; } kDirectives[] =
+	{
+		{ "include", SourceFile::Directive_Include },
+		{ "define",  SourceFile::Directive_Define  },
+		{ "undef",   SourceFile::Directive_Undef   },
+		{ "if",      SourceFile::Directive_If      },
+		{ "ifdef",   SourceFile::Directive_Ifdef   },
+		{ "ifndef",  SourceFile::Directive_Ifndef  },
+		{ "elif",    SourceFile::Directive_Elif    },
+		{ "else",    SourceFile::Directive_Else    },
+		{ "endif",   SourceFile::Directive_Endif   },
+	};
+	uint len = (uint)(_end - _beg);
+	for (auto& directive : kDirectives) {
+		if (strlen(directive.m_name) == len && strncmp(directive.m_name, _beg, len) == 0) {
+			return directive.m_directive;
+		}
+	}
+	return SourceFile::Directive_Other;
+}
+
+// Strip comments from _data and split into lines. Return false if an error occurred.
+static bool Parse(SourceFile& _file_, const char* _data)
+{
+	RemoveDependencies(_file_);
+	_file_.m_lines.clear();
+	_file_.m_includes.clear();
+	_file_.m_text.clear();
+
+	const char* fileName = _file_.m_path;
+
+ // strip comments, replace with a single space (preserve newlines to maintain the line count)
+	uint lineCount = 0u;
+	while (*_data) {
+		if (_data[0] == '/' && _data[1] == '/') {
+			while (*_data && *_data != '\n') {
+				++_data;
+			}
+			continue;
+		}
+		if (_data[0] == '/' && _data[1] == '*') {
+			uint commentLine = lineCount;
+			_data += 2;
+			while (*_data && !(_data[0] == '*' && _data[1] == '/')) {
+				if (*_data == '\n') {
+					_file_.m_text.push_back('\n');
+					++lineCount;
+				}
+				++_data;
+			}
+			if (!*_data) {
+				APT_LOG_ERR("ShaderPreprocessor: Unterminated comment block ('%s' line %d)", fileName, commentLine);
+				return false;
+			}
+			_data += 2;
+			_file_.m_text.push_back(' ');
+			continue;
+		}
+		if (*_data == '\n') {
+			++lineCount;
+		}
+		if (*_data != '\r') {
+			_file_.m_text.push_back(*_data);
+		}
+		++_data;
+	}
+	uint textSize = (uint)_file_.m_text.size();
+	_file_.m_text.push_back('\0');
+
+ // split lines, classify directives
+	const char* text = _file_.m_text.data();
+	uint beg = 0u;
+	lineCount = 0u;
+	while (beg < textSize) {
+		SourceFile::Line line = {};
+		line.m_beg       = beg;
+		line.m_line      = lineCount;
+		line.m_lineCount = 1u;
+		line.m_include   = -1;
+		uint end = beg;
+		for (;;) {
+			while (end < textSize && text[end] != '\n') {
+				++end;
+			}
+			if (end < textSize && end > beg && text[end - 1] == '\\') {
+			 // line continuation
+				++end;
+				++line.m_lineCount;
+				continue;
+			}
+			break;
+		}
+		line.m_end = end;
+
+		const char* lineEnd = text + end;
+		const char* tp = SkipWhitespace(text + beg, lineEnd);
+		if (tp < lineEnd && *tp == '#') {
+			tp = SkipWhitespace(tp + 1, lineEnd);
+			const char* name = tp;
+			tp = SkipIdentifier(tp, lineEnd);
+			line.m_directive = ParseDirective(name, tp);
+			line.m_args = (uint)(SkipWhitespace(tp, lineEnd) - text);
+
+			if (line.m_directive == SourceFile::Directive_Include) {
+			 // extract filename
+				tp = text + line.m_args;
+				const char* pathBeg = tp + 1;
+				const char* pathEnd = pathBeg;
+				while (pathEnd < lineEnd && *pathEnd != '"') {
+					++pathEnd;
+				}
+				if (*tp != '"' || pathEnd == lineEnd) {
+					APT_LOG_ERR("ShaderPreprocessor: Invalid #include ('%s' line %d)", fileName, lineCount);
+					return false;
+				}
+				SourceFile::Include inc;
+				inc.m_path.set(pathBeg, pathEnd - pathBeg);
+				inc.m_hash = HashPath(inc.m_path);
+				line.m_include = (int)_file_.m_includes.size();
+				_file_.m_includes.push_back(inc);
+				g_includedBy[inc.m_hash].insert(_file_.m_pathHash);
+			}
+		}
+		_file_.m_lines.push_back(line);
+
+		beg = end + 1u;
+		lineCount += line.m_lineCount;
+	}
+	return true;
+}
+
+static SourceFile* FindOrLoad(const char* _fileName)
 {
+	uint64 pathHash = HashPath(_fileName);
+	auto it = g_sourceFiles.find(pathHash);
+	if (it != g_sourceFiles.end()) {
+		return it->second;
+	}
+
 	File f;
 	if (!FileSystem::Read(f, _fileName)) {
+		return nullptr;
+	}
+	SourceFile* ret = new SourceFile;
+	ret->m_path.set(_fileName);
+	ret->m_pathHash = pathHash;
+	ret->m_dataHash = Hash<uint64>(f.getData(), (uint)f.getDataSize());
+	if (!Parse(*ret, f.getData())) {
+		RemoveDependencies(*ret);
+		delete ret;
+		return nullptr;
+	}
+	g_sourceFiles[pathHash] = ret;
+	return ret;
+}
+
+/*******************************************************************************
+
+                                 Expression
+
+*******************************************************************************/
+
+// Evaluate a conditional expression. The result may be unknown (see
+// ShaderPreprocessor), in which case the conditional is passed through.
+struct ShaderPreprocessor::Expression
+{
+	struct Value
+	{
+		sint64 m_value;
+		bool   m_known;
+	};
+
+	static const int kMaxDepth = 16; // limit macro expansion depth
+
+	const ShaderPreprocessor& m_pp;
+	const char*               m_str;
+	const char*               m_end;
+	int                       m_depth;
+	bool                      m_error;
+
+	Expression(const ShaderPreprocessor& _pp, const char* _beg, const char* _end, int _depth = 0)
+		: m_pp(_pp)
+		, m_str(_beg)
+		, m_end(_end)
+		, m_depth(_depth)
+		, m_error(false)
+	{
+	}
+
+	Value evaluate()
+	{
+		Value ret = parseTernary();
+		skipWhitespace();
+		if (m_error || m_str != m_end) {
+			ret = Unknown();
+		}
+		return ret;
+	}
+
+	static Value Known(sint64 _value)  { Value ret = { _value, true }; return ret; }
+	static Value Unknown()             { Value ret = { 0, false };    return ret; }
+
+	void skipWhitespace()
+	{
+		m_str = SkipWhitespace(m_str, m_end);
+	}
+
+	bool consume(const char* _token)
+	{
+		skipWhitespace();
+		uint len = (uint)strlen(_token);
+		if ((uint)(m_end - m_str) >= len && strncmp(m_str, _token, len) == 0) {
+			m_str += len;
+			return true;
+		}
+		return false;
+	}
+
+	// Return the precedence of the binary operator at m_str (0 if none), _len_ is the length of the operator.
+	int peekOperator(int& _len_)
+	{
+		static const struct { const char* m_op; int m_precedence; } kOperators[] =
+		{
+		 // 2 char operators first
+			{ "||", 1 }, { "&&", 2 }, { "==", 6 }, { "!=", 6 }, { "<=", 7 }, { ">=", 7 }, { "<<", 8 }, { ">>", 8 },
+			{ "|",  3 }, { "^",  4 }, { "&",  5 }, { "<",  7 }, { ">",  7 }, { "+",  9 }, { "-",  9 }, { "*", 10 }, { "/", 10 }, { "%", 10 },
+		};
+		skipWhitespace();
+		for (auto& op : kOperators) {
+			uint len = (uint)strlen(op.m_op);
+			if ((uint)(m_end - m_str) >= len && strncmp(m_str, op.m_op, len) == 0) {
+				_len_ = (int)len;
+				return op.m_precedence;
+			}
+		}
+		return 0;
+	}
+
+	Value parseTernary()
+	{
+		Value cond = parseBinary(1);
+		if (!consume("?")) {
+			return cond;
+		}
+		Value a = parseTernary();
+		if (!consume(":")) {
+			m_error = true;
+			return Unknown();
+		}
+		Value b = parseTernary();
+		if (cond.m_known) {
+			return cond.m_value ? a : b;
+		}
+		if (a.m_known && b.m_known && a.m_value == b.m_value) {
+			return a;
+		}
+		return Unknown();
+	}
+
+	Value parseBinary(int _minPrecedence)
+	{
+		Value lhs = parseUnary();
+		for (;;) {
+			int len;
+			int precedence = peekOperator(len);
+			if (precedence == 0 || precedence < _minPrecedence) {
+				return lhs;
+			}
+			const char* op = m_str;
+			m_str += len;
+			Value rhs = parseBinary(precedence + 1); // all binary operators are left associative
+			lhs = apply(op, len, lhs, rhs);
+			if (m_error) {
+				return Unknown();
+			}
+		}
+	}
+
+	Value apply(const char* _op, int _len, Value _lhs, Value _rhs)
+	{
+	 // logical operators may be known if only one side is known
+		if (_len == 2 && _op[0] == '&' && _op[1] == '&') {
+			if ((_lhs.m_known && _lhs.m_value == 0) || (_rhs.m_known && _rhs.m_value == 0)) {
+				return Known(0);
+			}
+			return (_lhs.m_known && _rhs.m_known) ? Known(1) : Unknown();
+		}
+		if (_len == 2 && _op[0] == '|' && _op[1] == '|') {
+			if ((_lhs.m_known && _lhs.m_value != 0) || (_rhs.m_known && _rhs.m_value != 0)) {
+				return Known(1);
+			}
+			return (_lhs.m_known && _rhs.m_known) ? Known(0) : Unknown();
+		}
+		if (!_lhs.m_known || !_rhs.m_known) {
+			return Unknown();
+		}
+		sint64 a = _lhs.m_value;
+		sint64 b = _rhs.m_value;
+		if (_len == 2) {
+			switch (_op[0]) {
+				case '=': return Known(a == b);
+				case '!': return Known(a != b);
+				case '<': return _op[1] == '=' ? Known(a <= b) : Known(a << b);
+				case '>': return _op[1] == '=' ? Known(a >= b) : Known(a >> b);
+				default:  break;
+			};
+		} else {
+			switch (_op[0]) {
+				case '|': return Known(a | b);
+				case '^': return Known(a ^ b);
+				case '&': return Known(a & b);
+				case '<': return Known(a < b);
+				case '>': return Known(a > b);
+				case '+': return Known(a + b);
+				case '-': return Known(a - b);
+				case '*': return Known(a * b);
+				case '/': if (b == 0) break; return Known(a / b);
+				case '%': if (b == 0) break; return Known(a % b);
+				default:  break;
+			};
+		}
+		m_error = true;
+		return Unknown();
+	}
+
+	Value parseUnary()
+	{
+		skipWhitespace();
+		if (m_str == m_end) {
+			m_error = true;
+			return Unknown();
+		}
+		char c = *m_str;
+		if (c == '!' || c == '~' || c == '-' || c == '+') {
+			++m_str;
+			Value v = parseUnary();
+			if (v.m_known) {
+				v.m_value = c == '!' ? !v.m_value : c == '~' ? ~v.m_value : c == '-' ? -v.m_value : v.m_value;
+			}
+			return v;
+		}
+		return parsePrimary();
+	}
+
+	Value parsePrimary()
+	{
+		skipWhitespace();
+		if (consume("(")) {
+			Value ret = parseTernary();
+			if (!consume(")")) {
+				m_error = true;
+			}
+			return ret;
+		}
+
+		if (m_str < m_end && isdigit(*m_str)) {
+			char* end;
+			sint64 ret = (sint64)strtoll(m_str, &end, 0);
+			m_str = end;
+			while (m_str < m_end && (*m_str == 'u' || *m_str == 'U')) {
+				++m_str;
+			}
+			return Known(ret);
+		}
+
+		const char* name = m_str;
+		m_str = SkipIdentifier(m_str, m_end);
+		if (name == m_str) {
+			m_error = true;
+			return Unknown();
+		}
+
+		if ((m_str - name) == 7 && strncmp(name, "defined", 7) == 0) {
+			bool paren = consume("(");
+			skipWhitespace();
+			const char* definedName = m_str;
+			const char* definedNameEnd = SkipIdentifier(m_str, m_end);
+			m_str = definedNameEnd;
+			if (definedName == definedNameEnd || (paren && !consume(")"))) {
+				m_error = true;
+				return Unknown();
+			}
+			return IsDefined(m_pp, definedName, definedNameEnd);
+		}
+
+	 // expand macro
+		const Macro* macro = m_pp.findMacro(name, m_str);
+		if (macro && macro->m_isFunction) {
+		 // skip the argument list
+			if (consume("(")) {
+				for (int depth = 1; m_str < m_end && depth > 0; ++m_str) {
+					depth += *m_str == '(' ? 1 : *m_str == ')' ? -1 : 0;
+				}
+			}
+			return Unknown();
+		}
+		if (!macro || macro->m_state != Macro::State_Defined || macro->m_isTruncated || macro->m_value.isEmpty() || m_depth >= kMaxDepth) {
+		 // undefined identifiers are an error in GLSL, let the driver report it
+			return Unknown();
+		}
+		const char* value = macro->m_value;
+		return Expression(m_pp, value, value + strlen(value), m_depth + 1).evaluate();
+	}
+
+	static Value IsDefined(const ShaderPreprocessor& _pp, const char* _beg, const char* _end)
+	{
+		const Macro* macro = _pp.findMacro(_beg, _end);
+		if (!macro) {
+			return IsReserved(_beg, _end) ? Unknown() : Known(0);
+		}
+		switch (macro->m_state) {
+			case Macro::State_Defined:   return Known(1);
+			case Macro::State_Undefined: return Known(0);
+			default:                     return Unknown();
+		};
+	}
+};
+
+/*******************************************************************************
+
+                             ShaderPreprocessor
+
+*******************************************************************************/
+
+// PUBLIC
+
+int ShaderPreprocessor::CheckForChanges()
+{
+	eastl::vector<uint64> changed;
+	for (auto it = g_sourceFiles.begin(); it != g_sourceFiles.end(); ) {
+		SourceFile* file = it->second;
+		File f;
+		if (!FileSystem::ReadIfExists(f, file->m_path)) {
+		 // file was deleted, subsequent process() calls will fail
+			changed.push_back(file->m_pathHash);
+			RemoveDependencies(*file);
+			delete file;
+			it = g_sourceFiles.erase(it);
+			continue;
+		}
+		uint64 dataHash = Hash<uint64>(f.getData(), (uint)f.getDataSize());
+		if (dataHash != file->m_dataHash) {
+			changed.push_back(file->m_pathHash);
+			file->m_dataHash = dataHash;
+			if (!Parse(*file, f.getData())) {
+			 // parse error, drop the file so that the error is reported by process()
+				RemoveDependencies(*file);
+				delete file;
+				it = g_sourceFiles.erase(it);
+				continue;
+			}
+		}
+		++it;
+	}
+
+ // walk the reverse dependency graph to find all affected files
+	g_affected.clear();
+	g_affected.insert(changed.begin(), changed.end());
+	int ret = (int)changed.size();
+	while (!changed.empty()) {
+		uint64 pathHash = changed.back();
+		changed.pop_back();
+		auto deps = g_includedBy.find(pathHash);
+		if (deps == g_includedBy.end()) {
+			continue;
+		}
+		for (uint64 includer : deps->second) {
+			if (g_affected.insert(includer).second) {
+				changed.push_back(includer);
+			}
+		}
+	}
+	return ret;
+}
+
+bool ShaderPreprocessor::IsAffected(const char* _fileName)
+{
+	return g_affected.find(HashPath(_fileName)) != g_affected.end();
+}
+
+void ShaderPreprocessor::ClearCache()
+{
+	for (auto& it : g_sourceFiles) {
+		delete it.second;
+	}
+	g_sourceFiles.clear();
+	g_includedBy.clear();
+	g_affected.clear();
+}
+
+void ShaderPreprocessor::SetMinify(bool _minify)
+{
+	g_minify = _minify;
+}
+
+bool ShaderPreprocessor::GetMinify()
+{
+	return g_minify;
+}
+
+ShaderPreprocessor::ShaderPreprocessor()
+{
+}
+
+void ShaderPreprocessor::addDefine(const char* _define)
+{
+	define(_define, _define + strlen(_define), false, false);
+}
+
+bool ShaderPreprocessor::process(const char* _fileName)
+{
+	SourceFile* file = FindOrLoad(_fileName);
+	if (!file) {
 		return false;
 	}
 
  // initial line pragma marks the start of this file
-	uint lineCount = 0u, fileCount = m_included.size();
-	appendLineComment(_fileName);
-	appendLinePragma(lineCount, fileCount);
-
- // store the filename to prevent recursive includes
-	m_included.push_back(String<64>(_fileName));
-
-	int commentBlock = 0; // if !0 then we're inside a comment block
-	bool commentLine = false;
-	TextParser tp(f.getData());
-	while (!tp.isNull()) {
-		if (tp.isLineEnd()) {
-			++lineCount;
-			commentLine = false;
+	uint fileCount = (uint)m_included.size();
+	if (!g_minify) {
+		appendLineComment(_fileName);
+	}
+	appendLinePragma(0u, fileCount);
+	uint nextLine = 0u; // source line corresponding to the next line of the result
 
-		} else if (*tp == '/') {
-		 // potential comment block/line comment
-			if (tp[1] == '/') { // comment line
-				commentLine = true;
+ // store the path hash to prevent recursive includes
+	m_included.insert(file->m_pathHash);
 
-			} else if (tp[1] == '*') { // comment block
-				++commentBlock;
+	const char* text = file->m_text.data();
+	uint conditionalBase = (uint)m_conditionals.size(); // conditionals can't span files
+	for (auto& line : file->m_lines) {
+		const char* beg  = text + line.m_beg;
+		const char* args = text + line.m_args;
+		const char* end  = text + line.m_end;
+		bool active = isActive();
+
+		if (line.m_directive >= SourceFile::Directive_Elif && line.m_directive <= SourceFile::Directive_Endif && m_conditionals.size() == conditionalBase) {
+			APT_LOG_ERR("ShaderPreprocessor: Unmatched #%s ('%s' line %d)",
+				line.m_directive == SourceFile::Directive_Elif ? "elif" : line.m_directive == SourceFile::Directive_Else ? "else" : "endif",
+				_fileName, line.m_line
+				);
+			return false;
+		}
+
+		switch (line.m_directive) {
+			case SourceFile::Directive_If:
+			case SourceFile::Directive_Ifdef:
+			case SourceFile::Directive_Ifndef: {
+				Conditional cond = {};
+				cond.m_parentActive = active;
+				if (active) {
+					Expression::Value v;
+					if (line.m_directive == SourceFile::Directive_If) {
+						v = Expression(*this, args, end).evaluate();
+					} else {
+						v = Expression::IsDefined(*this, args, SkipIdentifier(args, end));
+						v.m_value = line.m_directive == SourceFile::Directive_Ifndef ? !v.m_value : v.m_value;
+					}
+					if (v.m_known) {
+						cond.m_active = cond.m_taken = v.m_value != 0;
+					} else {
+						cond.m_active = cond.m_passthrough = true;
+						syncLine(line.m_line, fileCount, nextLine);
+						nextLine = line.m_line + appendText(beg, end);
+					}
+				}
+				m_conditionals.push_back(cond);
+				break;
 			}
 
-		} else if (*tp == '*') {
-		 // potential comment block ending
-			if (tp[1] == '/') {
-				--commentBlock;
-				if (commentBlock < 0) {
-					APT_LOG_ERR("ShaderPreprocessor: Comment block error ('%s' line %d)", _fileName, lineCount);
-					return false;
+			case SourceFile::Directive_Elif: {
+				Conditional& cond = m_conditionals.back();
+				if (!cond.m_parentActive) {
+					break;
 				}
+				if (cond.m_passthrough) {
+					syncLine(line.m_line, fileCount, nextLine);
+					nextLine = line.m_line + appendText(beg, end);
+					break;
+				}
+				if (cond.m_taken) {
+					cond.m_active = false;
+					break;
+				}
+				Expression::Value v = Expression(*this, args, end).evaluate();
+				if (v.m_known) {
+					cond.m_active = cond.m_taken = v.m_value != 0;
+				} else {
+				 // all previous groups were inactive, hence the remainder of the chain is equivalent to #if
+					cond.m_active = cond.m_passthrough = true;
+					syncLine(line.m_line, fileCount, nextLine);
+					append("#if ");
+					nextLine = line.m_line + appendText(args, end);
+				}
+				break;
+			}
+
+			case SourceFile::Directive_Else: {
+				Conditional& cond = m_conditionals.back();
+				if (!cond.m_parentActive) {
+					break;
+				}
+				if (cond.m_passthrough) {
+					syncLine(line.m_line, fileCount, nextLine);
+					nextLine = line.m_line + appendText(beg, end);
+					break;
+				}
+				cond.m_active = !cond.m_taken;
+				cond.m_taken = true;
+				break;
 			}
 
-		} else if (*tp == '#' && commentBlock == 0 && !commentLine) {
-		 // potential include directive
-			if (strncmp(tp, "#include", sizeof("#include") - 1u) == 0)  {
-			 // store counters/file name - just a convenience to avoid passing them around
-				tp.advanceToNextWhitespace();
-				tp.skipWhitespace();
-				if (!include(tp, lineCount, fileCount, _fileName)) {
+			case SourceFile::Directive_Endif: {
+				if (m_conditionals.back().m_passthrough && m_conditionals.back().m_parentActive) {
+					syncLine(line.m_line, fileCount, nextLine);
+					nextLine = line.m_line + appendText(beg, end);
+				}
+				m_conditionals.pop_back();
+				break;
+			}
+
+			case SourceFile::Directive_Define:
+			case SourceFile::Directive_Undef: {
+				if (!active) {
+					break;
+				}
+				bool unknown = false;
+				for (auto& cond : m_conditionals) {
+					unknown |= cond.m_passthrough;
+				}
+				define(args, end, line.m_directive == SourceFile::Directive_Undef, unknown);
+				syncLine(line.m_line, fileCount, nextLine);
+				nextLine = line.m_line + appendText(beg, end);
+				break;
+			}
+
+			case SourceFile::Directive_Include: {
+				if (!active) {
+					break;
+				}
+				const SourceFile::Include& inc = file->m_includes[line.m_include];
+
+			 // check whether we already included this file
+				if (m_included.find(inc.m_hash) != m_included.end()) {
+				 // it's not an error for an include to appear multiple times, we simply skip it
+					break;
+				}
+				if (!process(inc.m_path)) {
 					return false;
 				}
-				tp.skipLine();
-				++lineCount;
+				m_result.pop_back(); // pop the terminating '\0' added by process()
 
-				continue; // don't advance tp or push to the result
+			 // force a #line pragma to resume the file
+				nextLine = ~0u;
+				break;
 			}
-		
-		}
 
-		m_result.push_back(*tp);
-		tp.advance();
+			default: {
+				if (!active || (g_minify && SkipWhitespace(beg, end) == end)) {
+					break;
+				}
+				syncLine(line.m_line, fileCount, nextLine);
+				nextLine = line.m_line + appendText(beg, end);
+				break;
+			}
+		};
+	}
+
+	if (m_conditionals.size() != conditionalBase) {
+		APT_LOG_ERR("ShaderPreprocessor: Unterminated conditional ('%s')", _fileName);
+		m_conditionals.resize(conditionalBase);
+		return false;
 	}
 
 	m_result.push_back('\n');
@@ -96,37 +821,89 @@ void ShaderPreprocessor::append(const char* _str, bool _newLine)
 
 // PRIVATE
 
-bool ShaderPreprocessor::include(const char* _tp, uint _line, uint _file, const char* _fileName)
+void ShaderPreprocessor::define(const char* _beg, const char* _end, bool _undef, bool _unknown)
 {
- // extract filename
-	TextParser tp(_tp);
-	if (*tp != '"') {
-		APT_LOG_ERR("ShaderPreprocessor: Invalid #include ('%s' line %d)", _fileName, _line);
-		return false;
+	const char* name = SkipWhitespace(_beg, _end);
+	const char* nameEnd = SkipIdentifier(name, _end);
+	if (name == nameEnd) {
+		return; // invalid, let the driver report it
 	}
-	tp.advance(); // skip '"'
-	const char *beg = tp;
-	if (tp.advanceToNext("\"\n") != '"') {
-		APT_LOG_ERR("ShaderPreprocessor: Invalid #include ('%s' line %d)", _fileName, _line);
-		return false;
+	Macro& macro = m_macros[HashName(name, nameEnd)];
+	macro.m_state       = _unknown ? Macro::State_Unknown : (_undef ? Macro::State_Undefined : Macro::State_Defined);
+	macro.m_isFunction  = !_undef && nameEnd < _end && *nameEnd == '(';
+	macro.m_isTruncated = false;
+	macro.m_value.clear();
+	if (_undef || macro.m_isFunction) {
+		return;
+	}
+	const char* value = SkipWhitespace(nameEnd, _end);
+	while (_end > value && isspace(_end[-1])) {
+		--_end;
+	}
+	if ((uint)(_end - value) > kMaxMacroValue) {
+		macro.m_isTruncated = true;
+	} else if (_end > value) {
+		macro.m_value.set(value, _end - value);
 	}
-	String<64> fname;
-	fname.set(beg, tp - beg);
+}
 
- // check whether we already included this file
-	for (auto it = m_included.begin(); it != m_included.end(); ++it) {
-		if (*it == (const char*)fname) {
-			return true; // it's not an error for an include to appear multiple times, we simply skip it
+const ShaderPreprocessor::Macro* ShaderPreprocessor::findMacro(const char* _beg, const char* _end) const
+{
+	auto it = m_macros.find(HashName(_beg, _end));
+	return it == m_macros.end() ? nullptr : &it->second;
+}
+
+uint ShaderPreprocessor::appendText(const char* _beg, const char* _end)
+{
+	if (!g_minify) {
+		uint ret = 1u;
+		for (const char* c = _beg; c != _end; ++c) {
+			ret += *c == '\n' ? 1u : 0u;
 		}
+		m_result.insert(m_result.end(), _beg, _end);
+		m_result.push_back('\n');
+		return ret;
 	}
-	
-	bool ret = process(fname);
-	m_result.pop_back(); // pop the terminating '\0' added by process()
 
- // resume line/file
-	appendLinePragma(_line + 1u, _file); // +1 because this replaces the #include directive itself
+ // collapse whitespace/line continuations; in directives a single space is kept (e.g. '#define FOO (1)' != '#define FOO(1)'),
+ // otherwise whitespace is only kept between identifiers or between operator chars (e.g. 'a - -b' != 'a--b')
+	_beg = SkipWhitespace(_beg, _end);
+	bool isDirective = _beg < _end && *_beg == '#';
+	bool space = false;
+	char prev = '\0';
+	for (const char* c = _beg; c < _end; ) {
+		if (IsWhitespace(c, _end) || *c == '\n') {
+			space = true;
+			c += *c == '\\' ? 2 : 1;
+			continue;
+		}
+		if (space) {
+			bool identifiers = (IsIdentifier(prev) || prev == '.') && (IsIdentifier(*c) || *c == '.');
+			bool operators   = IsOperator(prev) && IsOperator(*c);
+			if (isDirective || identifiers || operators) {
+				m_result.push_back(' ');
+			}
+			space = false;
+		}
+		m_result.push_back(*c);
+		prev = *c;
+		++c;
+	}
+	m_result.push_back('\n');
+	return 1u;
+}
 
-	return ret;
+void ShaderPreprocessor::syncLine(uint _line, uint _file, uint& _nextLine_)
+{
+	if (_line == _nextLine_) {
+		return;
+	}
+	if (_line > _nextLine_ && _line - _nextLine_ <= kMaxLineGap) {
+		m_result.insert(m_result.end(), _line - _nextLine_, '\n');
+	} else {
+		appendLinePragma(_line, _file);
+	}
+	_nextLine_ = _line;
 }
 
 void ShaderPreprocessor::appendLinePragma(uint _line, uint _file)
@@ -141,4 +918,4 @@ void ShaderPreprocessor::appendLineComment(const char* _str)
 	m_result.push_back('/');
 	m_result.push_back('/');
 	append(_str, true);
-}
\ No newline at end of file
+}
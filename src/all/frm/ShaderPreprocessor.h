@@ -5,21 +5,34 @@
 #include <frm/def.h>
 #include <apt/String.h>
 #include <EASTL/vector.h>
+#include <EASTL/vector_map.h>
+#include <EASTL/vector_set.h>
 
 namespace frm {
 
 ////////////////////////////////////////////////////////////////////////////////
 // ShaderPreprocessor
-// Read source code from a file, process #includes.
+// Read source code from a file, process #includes and conditionals.
 // - Only `#include "filename"` supported (no `#include <filename>`). This means
 //   that filenames are expected to be relative to the working directory of the
 //   exe.
 // - Duplicate include directives are only processed once within a single parse
 //   (prevents recursive includes).
-// - Does **not** track #ifdef/#endif; this may cause issues if an #include
-//   directive is wrapped in #ifdef/#endif but then subsequently redeclared.
-// - Inserts #line pragmas before/after each include to maintain the correctness
-//   of compiler-generated error messages.
+// - #define/#undef are tracked and #if/#ifdef/#ifndef/#elif/#else/#endif are
+//   evaluated against the defines passed to addDefine(). Inactive blocks are
+//   removed along with all comments. #define/#undef are still passed through
+//   (macros are not expanded in the source result).
+// - Conditionals which can't be evaluated (references to GL_* or __* names not
+//   passed to addDefine(), function-like macros, undefined identifiers) are
+//   passed through unmodified for the driver to evaluate.
+// - Inserts #line pragmas where necessary (around includes, after large
+//   removed blocks) to maintain the correctness of compiler-generated error
+//   messages.
+// - If SetMinify(true), whitespace is removed where possible along with blank
+//   lines. Source lines are never joined, so line numbers remain correct.
+// - Files are parsed once and cached process-wide (keyed by path, validated by
+//   a hash of the file contents). Call CheckForChanges() before reloading to
+//   pick up modified files.
 //
 // Typical usage:
 // - Call append() for the version string and any global defines.
@@ -29,28 +42,88 @@ namespace frm {
 class ShaderPreprocessor
 {
 public:
+	// Re-read all cached files and reparse any which changed. Return the number
+	// of files which changed. Until the next call, IsAffected() returns true
+	// for files which changed or which directly/indirectly include a changed
+	// file.
+	static int  CheckForChanges();
+
+	// See CheckForChanges().
+	static bool IsAffected(const char* _fileName);
+
+	// Release all cached files.
+	static void ClearCache();
+
+	// Enable/disable minification of the source result (default is disabled).
+	static void SetMinify(bool _minify);
+	static bool GetMinify();
+
 	ShaderPreprocessor();
 
+	// Add a define for evaluating conditionals, in the same format as a #define
+	// directive without the '#define' ("NAME" or "NAME VALUE"). This does not
+	// append anything to the source result.
+	void addDefine(const char* _define);
+
 	// Open a file, process and append to the source result. Return false if an error occurred.
 	bool process(const char* _fileName);
 
 	// Directly append _str to the source result with an optional newline char.
 	void append(const char* _str, bool _newLine = false);
 
-	// Get the source result. Subsequent calls to append() or process() will invalidate the ptr returned 
+	// Get the source result. Subsequent calls to append() or process() will invalidate the ptr returned
 	// by this method. Note that this may not be a valid null-terminated string if process() failed.
 	const char* getResult() const { return (const char*)m_result.data(); }
 
 private:
-	eastl::vector<char>             m_result;    //< Source code result.
-	eastl::vector<apt::String<64> > m_included;  //< Prevent recursive includes.
-	
-	// Process an include directive. _tp points to the first char after an #include directive. Extract 
-	// filename, check that the file wasn't already included and call process().
-	bool include(const char* _tp, uint _line, uint _file, const char* _fileName);
+	struct Macro
+	{
+		enum State
+		{
+			State_Defined,
+			State_Undefined,
+			State_Unknown     // Defined/undefined inside a conditional which couldn't be evaluated.
+		};
+
+		State           m_state;
+		bool            m_isFunction;
+		bool            m_isTruncated;  // Value too long to store, can't be evaluated.
+		apt::String<64> m_value;
+	};
+
+	struct Conditional
+	{
+		bool m_parentActive;
+		bool m_active;       // Current group is active (always true for a passthrough if the parent is active).
+		bool m_taken;        // Any group was taken.
+		bool m_passthrough;  // Condition couldn't be evaluated, directives are passed through.
+	};
+
+	struct Expression;
+	typedef eastl::vector_map<uint64, Macro> MacroMap;
+
+	eastl::vector<char>        m_result;        //< Source code result.
+	eastl::vector_set<uint64>  m_included;      //< Path hashes, prevent recursive includes.
+	MacroMap                   m_macros;        //< Name hashes.
+	eastl::vector<Conditional> m_conditionals;  //< Conditional stack.
+
+	bool isActive() const { return m_conditionals.empty() || m_conditionals.back().m_active; }
+
+	// Define/undefine a macro from the arguments of a #define or #undef directive.
+	// If _unknown, the macro state can't be known (inside a passthrough conditional).
+	void define(const char* _beg, const char* _end, bool _undef, bool _unknown);
+
+	// Find a macro by name, return nullptr if it was never defined.
+	const Macro* findMacro(const char* _beg, const char* _end) const;
+
+	// Append _beg,_end followed by a newline (minified if required). Return the number of lines appended.
+	uint appendText(const char* _beg, const char* _end);
+
+	// Append newlines or a #line pragma such that the next line of the result corresponds to _line.
+	void syncLine(uint _line, uint _file, uint& _nextLine_);
 
 	void appendLinePragma(uint _line, uint _file);
-	
+
 	void appendLineComment(const char* _str);
 
 }; // class ShaderPreprocessor
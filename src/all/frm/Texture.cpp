@@ -2,11 +2,17 @@
 
 #include <frm/gl.h>
 #include <frm/icon_fa.h>
+#include <frm/Camera.h>
 #include <frm/Framebuffer.h>
 #include <frm/GlContext.h>
+#include <frm/GpuMemory.h>
+#include <frm/Profiler.h>
 #include <frm/Resource.h>
 #include <frm/Shader.h>
+#include <frm/TextureCache.h>
+#include <frm/ThreadPool.h>
 
+#include <apt/log.h>
 #include <apt/File.h>
 #include <apt/FileSystem.h>
 #include <apt/Image.h>
@@ -15,6 +21,11 @@
 #include <imgui/imgui.h>
 
 #include <EASTL/utility.h>
+#include <EASTL/vector.h>
+
+#include <atomic>
+#include <cstring>
+#include <thread>
 
 using namespace frm;
 using namespace apt;
@@ -94,7 +105,9 @@ struct TextureViewer
 
 	void addTextureView(Texture* _tx)
 	{
-		m_txViews.push_back(TextureView(_tx));
+		if (!findTextureView(_tx)) { // Create() may return an existing instance
+			m_txViews.push_back(TextureView(_tx));
+		}
 	}
 
 	void removeTextureView(Texture* _tx)
@@ -160,9 +173,33 @@ struct TextureViewer
 				FileSystem::PathStr pth;
 				if (FileSystem::PlatformSelect(pth)) {
 					FileSystem::StripRoot(pth, pth);
-					Texture::Create(pth);
+					Texture::Create(pth, true);
 				}
 			}
+			if (Texture::GetStreamingCount() > 0) {
+				ImGui::SameLine();
+				ImGui::Text("(%d streaming)", Texture::GetStreamingCount());
+			}
+			if (Texture::GetMipStreamingBudget() > 0) {
+				ImGui::SameLine();
+				ImGui::Text("Mips: %.2f/%.2fMb, bias %d", 
+					(double)Texture::GetMipStreamingResidentBytes() / (1024.0 * 1024.0), 
+					(double)Texture::GetMipStreamingBudget() / (1024.0 * 1024.0), 
+					Texture::GetMipStreamingBias()
+					);
+			}
+			GpuMemory::Stats gpuStats = GpuMemory::GetStats();
+			ImGui::SameLine();
+			ImGui::Text("Gpu: %.2fMb (textures %.2fMb), cached %.2fMb/%d",
+				(double)gpuStats.m_totalBytes / (1024.0 * 1024.0),
+				(double)gpuStats.m_bytes[GpuMemory::Type_Texture] / (1024.0 * 1024.0),
+				(double)gpuStats.m_cachedBytes / (1024.0 * 1024.0),
+				gpuStats.m_cachedCount
+				);
+			if (gpuStats.m_budget > 0) {
+				ImGui::SameLine();
+				ImGui::Text("budget %.2fMb", (double)gpuStats.m_budget / (1024.0 * 1024.0));
+			}
 			
 			ImGui::Separator();
 			
@@ -203,6 +240,13 @@ struct TextureViewer
 					ImGui::BeginTooltip();
 						ImGui::TextColored(kColorTxName, tx.getName());
 						ImGui::TextColored(kColorTxInfo, "%s\n%s\n%dx%dx%d", GlEnumStr(tx.getTarget()), GlEnumStr(tx.getFormat()), tx.getWidth(), tx.getHeight(), APT_MAX(tx.getDepth(), tx.getArrayCount()));
+						ImGui::TextColored(kColorTxInfo, "%.2fMb%s", (double)tx.getGpuSize() / (1024.0 * 1024.0), tx.getRefCount() == 0 ? " (cached)" : "");
+						if (tx.getResidentMip() > 0) {
+							ImGui::TextColored(kColorTxInfo, "Resident mip %d", tx.getResidentMip());
+						}
+						if (tx.isStreaming()) {
+							ImGui::TextColored(kColorTxInfo, "Streaming %.0f%%", tx.getStreamingProgress() * 100.0f);
+						}
 					ImGui::EndTooltip();
 				}
 			}
@@ -428,12 +472,32 @@ static bool GlIsTexFormatCompressed(GLenum _format)
 		case GL_COMPRESSED_RG_RGTC2:
 		case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
 		case GL_COMPRESSED_RGBA_BPTC_UNORM:
+		case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
 			return true;
 		default:
 			return false;
 	};
 }
 
+// Return the sRGB equivalent of _format, or _format if there isn't one.
+static GLenum GlGetTexFormatSrgb(GLenum _format)
+{
+	switch (_format) {
+		case GL_RGB8:                           return GL_SRGB8;
+		case GL_RGBA8:                          return GL_SRGB8_ALPHA8;
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:   return GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:  return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
+		case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:  return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT;
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:  return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+		case GL_COMPRESSED_RGBA_BPTC_UNORM:     return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+		default:                                return _format;
+	};
+}
+
 static bool GlIsTexFormatDepth(GLenum _format)
 {
 	switch (_format) {
@@ -449,6 +513,310 @@ static bool GlIsTexFormatDepth(GLenum _format)
 	};
 }
 
+// Bytes per texel, or per 4x4 block for compressed formats. Unknown formats are assumed to be 4 bytes/texel.
+static GLsizeiptr GlGetTexFormatSizeBytes(GLenum _format)
+{
+	switch (_format) {
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RED_RGTC1:
+			return 8;
+		case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_RG_RGTC2:
+		case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+		case GL_COMPRESSED_RGBA_BPTC_UNORM:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+			return 16;
+		case GL_R8:
+		case GL_R8I:
+		case GL_R8UI:
+			return 1;
+		case GL_RG8:
+		case GL_R16:
+		case GL_R16F:
+		case GL_R16I:
+		case GL_R16UI:
+		case GL_DEPTH_COMPONENT16:
+			return 2;
+		case GL_RGB8:
+		case GL_SRGB8:
+		case GL_DEPTH_COMPONENT24:
+			return 3;
+		case GL_RGB16:
+		case GL_RGB16F:
+			return 6;
+		case GL_RG32F:
+		case GL_RGBA16:
+		case GL_RGBA16F:
+		case GL_DEPTH32F_STENCIL8:
+			return 8;
+		case GL_RGB32F:
+			return 12;
+		case GL_RGBA32F:
+			return 16;
+		default:
+			return 4;
+	};
+}
+
+/*******************************************************************************
+
+                                 Streaming
+
+*******************************************************************************/
+
+static std::atomic<bool> g_compressOnLoad(false); // Read by Texture::Stream::decode() on a worker thread.
+static std::atomic<bool> g_srgbOnLoad(false);     //                         "
+
+struct Texture::Stream
+{
+	enum State
+	{
+		State_Decoding,
+		State_Decoded,
+		State_Error
+	};
+
+	Texture*            m_texture;        // Null if the texture was destroyed/reloaded, the stream is then released by Update().
+	FileSystem::PathStr m_path;
+	std::atomic<int>    m_state;
+	Image               m_image;
+	GLenum              m_srcFormat;
+	GLenum              m_srcType;
+	bool                m_srgb;           // m_image is sRGB encoded, see SetSrgbOnLoad().
+	bool                m_allocated;      // Texture storage was allocated.
+	GLint               m_mip;            // Next mip to upload (smallest first), uploads are complete when m_mip < m_residentMip.
+	GLint               m_array;          // Next array layer to upload.
+	uint64              m_totalBytes;
+	uint64              m_uploadedBytes;
+
+ // mip streaming
+	bool                m_mipStreaming;   // Keep the stream (and m_image) after the initial upload.
+	GLint               m_residentMip;    // Image mip at level 0 of the texture storage.
+	GLint               m_requestedMip;   // Min requested mip during m_requestFrame.
+	sint64              m_requestFrame;   // -1 if never requested.
+	int                 m_evictFrames;    // Consecutive frames for which a lower resident mip was wanted.
+
+	bool isUploading() const { return m_allocated && m_mip >= m_residentMip; }
+
+	// Read and decode m_path, called on a worker thread.
+	void decode()
+	{
+	 // generate a mip chain here rather than via glGenerateMipmap() after the upload, also allows mip streaming
+	 // (in linear space if the image is sRGB encoded)
+		uint32 flags = TextureCache::Flag_Mips | (g_compressOnLoad ? TextureCache::Flag_Compress : 0) | (g_srgbOnLoad ? TextureCache::Flag_Srgb : 0);
+		if (!TextureCache::Load(m_path, flags, m_image)) {
+			m_state = State_Error;
+			return;
+		}
+		m_srgb = g_srgbOnLoad;
+		m_totalBytes = 0;
+		for (uint i = 0; i < m_image.getArrayCount(); ++i) {
+			for (uint j = 0; j < m_image.getMipmapCount(); ++j) {
+				m_totalBytes += m_image.getRawImageSize(j);
+			}
+		}
+		m_state = State_Decoded;
+	}
+};
+
+eastl::vector<Texture::Stream*> Texture::s_streams;
+
+// Persistent-mapped pixel unpack buffer. Allocations are contiguous and made in order; the regions allocated
+// during each call to Texture::Update() are protected by a fence and reclaimed once the fence is signaled.
+struct StreamRing
+{
+	struct Fence
+	{
+		GLsync     m_sync;
+		GLsizeiptr m_size;
+	};
+
+	static const GLsizeiptr kAlignment = 16;
+
+	GLuint               m_buffer;
+	char*                m_data;
+	GLsizeiptr           m_size;
+	GLsizeiptr           m_head;        // Next allocation.
+	GLsizeiptr           m_used;        // Bytes in flight (including padding).
+	GLsizeiptr           m_pending;     // Bytes allocated since the last fence.
+	eastl::vector<Fence> m_fences;
+
+	bool init(GLsizeiptr _size)
+	{
+		APT_ASSERT(m_buffer == 0);
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glAssert(glCreateBuffers(1, &m_buffer));
+		glAssert(glNamedBufferStorage(m_buffer, _size, nullptr, flags));
+		glAssert(m_data = (char*)glMapNamedBufferRange(m_buffer, 0, _size, flags));
+		if (!m_data) {
+			APT_LOG_ERR("Texture: Failed to map streaming buffer (%lld bytes)", (long long)_size);
+			glAssert(glDeleteBuffers(1, &m_buffer));
+			m_buffer = 0;
+			return false;
+		}
+		m_size    = _size;
+		m_head    = 0;
+		m_used    = 0;
+		m_pending = 0;
+		return true;
+	}
+
+	void shutdown()
+	{
+		if (m_buffer == 0) {
+			return;
+		}
+		for (auto& fence : m_fences) {
+			glAssert(glClientWaitSync(fence.m_sync, GL_SYNC_FLUSH_COMMANDS_BIT, (GLuint64)1e9));
+			glAssert(glDeleteSync(fence.m_sync));
+		}
+		m_fences.clear();
+		glAssert(glUnmapNamedBuffer(m_buffer));
+		glAssert(glDeleteBuffers(1, &m_buffer));
+		m_buffer = 0;
+		m_data = nullptr;
+	}
+
+	// Return the offset of a region of _size bytes, or -1 if there isn't enough space (never waits).
+	GLsizeiptr alloc(GLsizeiptr _size)
+	{
+		GLsizeiptr beg = (m_head + kAlignment - 1) & ~(kAlignment - 1);
+		if (beg + _size > m_size) {
+			beg = 0; // wrap
+		}
+		GLsizeiptr padding = (beg >= m_head ? beg : m_size) - m_head;
+		if (m_used + padding + _size > m_size) {
+			return -1;
+		}
+		m_used    += padding + _size;
+		m_pending += padding + _size;
+		m_head     = beg + _size;
+		return beg;
+	}
+
+	// Fence allocations made since the last call.
+	void fence()
+	{
+		if (m_pending > 0) {
+			Fence fence;
+			glAssert(fence.m_sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+			fence.m_size = m_pending;
+			m_fences.push_back(fence);
+			m_pending = 0;
+		}
+	}
+
+	// Reclaim regions whose fence was signaled.
+	void reclaim()
+	{
+		while (!m_fences.empty()) {
+			GLenum status;
+			glAssert(status = glClientWaitSync(m_fences.front().m_sync, 0, 0));
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+				break;
+			}
+			glAssert(glDeleteSync(m_fences.front().m_sync));
+			m_used -= m_fences.front().m_size;
+			m_fences.erase(m_fences.begin());
+		}
+		if (m_used == 0) {
+			m_head = 0;
+		}
+	}
+};
+
+static StreamRing g_streamRing;
+static GLsizeiptr g_streamBudget      = 8 * 1024 * 1024;
+static GLsizeiptr g_streamFrameBytes;  // Bytes uploaded during the current call to Texture::Update().
+static bool       g_streamRingFull;    // Set by Texture::updateStream() if an allocation failed.
+
+// Pixel pack buffers for Texture::Download, recycled to avoid allocating per download.
+struct ReadbackBuffer
+{
+	GLuint     m_handle;
+	GLsizeiptr m_size;
+};
+static const int                     kReadbackPoolMaxSize = 8;
+static eastl::vector<ReadbackBuffer> g_readbackPool;
+
+// Return the smallest pooled buffer of at least _size bytes, else create a new buffer.
+static ReadbackBuffer AllocReadbackBuffer(GLsizeiptr _size)
+{
+	int best = -1;
+	for (int i = 0; i < (int)g_readbackPool.size(); ++i) {
+		if (g_readbackPool[i].m_size >= _size && (best < 0 || g_readbackPool[i].m_size < g_readbackPool[best].m_size)) {
+			best = i;
+		}
+	}
+	if (best >= 0) {
+		ReadbackBuffer ret = g_readbackPool[best];
+		g_readbackPool.erase(g_readbackPool.begin() + best);
+		return ret;
+	}
+	ReadbackBuffer ret;
+	ret.m_size = _size;
+	glAssert(glCreateBuffers(1, &ret.m_handle));
+	glAssert(glNamedBufferStorage(ret.m_handle, _size, nullptr, GL_MAP_READ_BIT | GL_CLIENT_STORAGE_BIT));
+	GpuMemory::Alloc(GpuMemory::Type_Buffer, _size);
+	return ret;
+}
+
+static void DeleteReadbackBuffer(const ReadbackBuffer& _buffer)
+{
+	glAssert(glDeleteBuffers(1, &_buffer.m_handle));
+	GpuMemory::Free(GpuMemory::Type_Buffer, _buffer.m_size);
+}
+
+// Return _buffer to the pool; if the pool is full the smallest buffer is deleted.
+static void FreeReadbackBuffer(const ReadbackBuffer& _buffer)
+{
+	g_readbackPool.push_back(_buffer);
+	if ((int)g_readbackPool.size() > kReadbackPoolMaxSize) {
+		auto smallest = g_readbackPool.begin();
+		for (auto it = g_readbackPool.begin(); it != g_readbackPool.end(); ++it) {
+			if (it->m_size < smallest->m_size) {
+				smallest = it;
+			}
+		}
+		DeleteReadbackBuffer(*smallest);
+		g_readbackPool.erase(smallest);
+	}
+}
+
+static const int  kMipRequestFrames   = 30;  // Requests expire after this many frames.
+static const int  kMipEvictFrames     = 60;  // Hysteresis, evict only after a lower resident mip was wanted for this many frames.
+static GLsizeiptr g_mipBudget         = 0;
+static GLsizeiptr g_mipResidentBytes;
+static GLint      g_mipBias;
+static sint64     g_streamFrame;       // Incremented by Texture::Update().
+
+// Size of mips [_mip, n) of all array layers of _img.
+static GLsizeiptr GetResidentSize(const Image& _img, GLint _mip)
+{
+	GLsizeiptr ret = 0;
+	for (GLint i = _mip; i < (GLint)_img.getMipmapCount(); ++i) {
+		ret += (GLsizeiptr)_img.getRawImageSize(i);
+	}
+	return ret * (GLsizeiptr)_img.getArrayCount();
+}
+
+// Mip streaming initial mip, the first mip <= kMipStreamingInitialSize.
+static GLint GetInitialMip(const Image& _img)
+{
+	GLint ret = 0;
+	GLsizei size = (GLsizei)APT_MAX(_img.getWidth(), _img.getHeight());
+	while (ret < (GLint)_img.getMipmapCount() - 1 && (size >> ret) > Texture::kMipStreamingInitialSize) {
+		++ret;
+	}
+	return ret;
+}
+
 // PUBLIC
 
 Texture* Texture::Create(const char* _path)
@@ -468,6 +836,25 @@ Texture* Texture::Create(const char* _path)
 	return ret;
 }
 
+Texture* Texture::Create(const char* _path, bool _async)
+{
+	if (!_async) {
+		return Create(_path);
+	}
+	Id id = GetHashId(_path);
+	Texture* ret = Find(id);
+	if (!ret) {
+		ret = new Texture(id, _path);
+		ret->m_path.set(_path);
+		ret->initPlaceholder();
+		ret->setState(State_Compiling); // prevent Use() from calling load()
+		ret->beginStream();
+		g_textureViewer.addTextureView(ret);
+	}
+	Use(ret);
+	return ret;
+}
+
 Texture* Texture::CreateCubemap2x3(const char* _path)
 {
 	Id id = GetHashId(_path);
@@ -555,6 +942,16 @@ Texture* Texture::CreateProxy(GLuint _handle, const char* _name)
 
 void Texture::Destroy(Texture*& _inst_)
 {
+	if (_inst_->getRefCount() == 0 && !_inst_->m_path.isEmpty() && _inst_->getState() == State_Loaded) {
+	 // keep the instance, Create() with the same path revives it until it's evicted
+		bool deferred = GpuMemory::Defer(GpuMemory::Type_Texture, _inst_, _inst_->m_gpuSize,
+			[](void* _tx) { return ((Texture*)_tx)->getRefCount() > 0; },
+			[](void* _tx) { g_textureViewer.removeTextureView((Texture*)_tx); delete (Texture*)_tx; }
+			);
+		if (deferred) {
+			return;
+		}
+	}
 	g_textureViewer.removeTextureView(_inst_);
 	delete _inst_;
 }
@@ -568,6 +965,167 @@ GLint Texture::GetMaxMipCount(GLsizei _width, GLsizei _height, GLsizei _depth)
 	return APT_MAX(log2Width, APT_MAX(log2Height, log2Depth)) + 1; // +1 for level 0
 }
 
+void Texture::InitStreaming(GLsizeiptr _ringSizeBytes, GLsizeiptr _budgetBytes)
+{
+	if (g_streamRing.m_buffer != 0) {
+		return;
+	}
+	g_streamRing.init(_ringSizeBytes);
+	g_streamBudget = _budgetBytes;
+}
+
+void Texture::ShutdownStreaming()
+{
+ // detach textures, wait for any pending decodes
+	for (Stream* stream : s_streams) {
+		if (stream->m_texture) {
+			stream->m_texture->m_stream = nullptr;
+			if (stream->m_texture->getState() != State_Loaded) {
+				stream->m_texture->setState(State_Error);
+			}
+		}
+		while (stream->m_state == Stream::State_Decoding) {
+			std::this_thread::yield();
+		}
+		delete stream;
+	}
+	s_streams.clear();
+	g_streamRing.shutdown();
+
+	for (auto& buffer : g_readbackPool) {
+		DeleteReadbackBuffer(buffer);
+	}
+	g_readbackPool.clear();
+}
+
+void Texture::SetStreamingBudget(GLsizeiptr _budgetBytes)
+{
+	g_streamBudget = _budgetBytes;
+}
+
+GLsizeiptr Texture::GetStreamingBudget()
+{
+	return g_streamBudget;
+}
+
+int Texture::GetStreamingCount()
+{
+	int ret = 0;
+	for (Stream* stream : s_streams) {
+		if (!stream->m_allocated || stream->isUploading()) {
+			++ret;
+		}
+	}
+	return ret;
+}
+
+void Texture::SetMipStreamingBudget(GLsizeiptr _budgetBytes)
+{
+	g_mipBudget = _budgetBytes;
+}
+
+GLsizeiptr Texture::GetMipStreamingBudget()
+{
+	return g_mipBudget;
+}
+
+GLsizeiptr Texture::GetMipStreamingResidentBytes()
+{
+	return g_mipResidentBytes;
+}
+
+GLint Texture::GetMipStreamingBias()
+{
+	return g_mipBias;
+}
+
+void Texture::SetCompressOnLoad(bool _enable)
+{
+	g_compressOnLoad = _enable;
+}
+
+bool Texture::GetCompressOnLoad()
+{
+	return g_compressOnLoad;
+}
+
+void Texture::SetSrgbOnLoad(bool _enable)
+{
+	g_srgbOnLoad = _enable;
+}
+
+bool Texture::GetSrgbOnLoad()
+{
+	return g_srgbOnLoad;
+}
+
+static bool g_bindless = false;
+
+void Texture::SetBindless(bool _enable)
+{
+	g_bindless = _enable;
+	if (_enable && !GLEW_ARB_bindless_texture) {
+		APT_LOG("Texture: GL_ARB_bindless_texture not supported, using slot binding");
+	}
+}
+
+bool Texture::GetBindless()
+{
+	return g_bindless && GLEW_ARB_bindless_texture;
+}
+
+void Texture::Update()
+{
+	if (s_streams.empty() && g_streamRing.m_fences.empty()) {
+		return;
+	}
+	CPU_AUTO_MARKER("Texture::Update");
+
+	if (g_streamRing.m_buffer == 0) {
+		InitStreaming();
+	}
+	g_streamRing.reclaim();
+	g_streamFrameBytes = 0;
+	g_streamRingFull = false;
+
+	SCOPED_PIXELSTOREI(GL_UNPACK_ALIGNMENT, 1);
+	glAssert(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, g_streamRing.m_buffer));
+	for (auto it = s_streams.begin(); it != s_streams.end(); ) {
+		Stream* stream = *it;
+		Texture* tx = stream->m_texture;
+		int state = stream->m_state;
+		if (state == Stream::State_Decoding) {
+			++it;
+			continue;
+		}
+		if (tx && state == Stream::State_Error) {
+			APT_LOG_ERR("Texture: Failed to load '%s'", (const char*)stream->m_path);
+			tx->m_stream = nullptr;
+			tx->setState(State_Error);
+			tx = nullptr;
+		}
+		if (tx) {
+			if (stream->m_allocated && !stream->isUploading()) {
+			 // mip-streamed texture, nothing to upload
+				++it;
+				continue;
+			}
+			if (g_streamRingFull || g_streamFrameBytes >= g_streamBudget || !tx->updateStream() || stream->m_mipStreaming) {
+				++it;
+				continue;
+			}
+			tx->m_stream = nullptr;
+		}
+		delete stream;
+		it = s_streams.erase(it);
+	}
+	glAssert(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+	g_streamRing.fence();
+
+	UpdateMipResidency();
+	++g_streamFrame;
+}
+
 bool Texture::ConvertSphereToCube(Texture& _sphere, GLsizei _width)
 {
 	static Shader* shConvert;
@@ -670,17 +1228,20 @@ bool Texture::reload()
 	if (m_path.isEmpty()) {
 		return true;
 	}
+	if (m_stream) {
+	 // cancel the async load, the stream is released by Update()
+		m_stream->m_texture = nullptr;
+		m_stream = nullptr;
+	}
 
 	APT_AUTOTIMER("Texture::load(%s)", (const char*)m_path);
 	
-	File f;
-	if (!FileSystem::Read(f, (const char*)m_path)) {
-		setState(State_Error);
-		return false;
+	uint32 flags = 0;
+	if (m_target == GL_TEXTURE_CUBE_MAP && g_compressOnLoad) {
+		flags = TextureCache::Flag_Cubemap2x3 | TextureCache::Flag_Mips | TextureCache::Flag_Compress;
 	}
-
 	Image img;
-	if (!Image::Read(img, f)) {
+	if (!TextureCache::Load(m_path, flags, img)) {
 		setState(State_Error);
 		return false;
 	}
@@ -773,6 +1334,7 @@ void Texture::generateMipmap()
 {
 	APT_ASSERT(m_handle);
 	m_mipCount = GetMaxMipCount(m_width, m_height, m_depth);
+	updateGpuSize();
 	setMipRange(0, m_mipCount - 1);
 	setMinFilter(GL_LINEAR_MIPMAP_LINEAR);
 	glAssert(glActiveTexture(GL_TEXTURE0));
@@ -787,49 +1349,76 @@ void Texture::setMipRange(GLint _base, GLint _max)
 	glAssert(glTextureParameteri(m_handle, GL_TEXTURE_MAX_LEVEL, (GLint)_max));
 }
 
-Image* Texture::downloadImage()
+// Image layout/type and GL format/type for downloading a texture of _format. Return false if unsupported.
+static bool GetDownloadFormat(
+	GLenum                  _format,
+	Image::Layout&          layout_,
+	Image::DataType&        dataType_,
+	Image::CompressionType& compression_,
+	GLenum&                 glFormat_,
+	GLenum&                 glType_
+	)
 {
-	APT_ASSERT(m_handle);
-
-	Image::Layout layout;
-	Image::DataType dataType;
-	Image::CompressionType compression = Image::Compression_None;
-	GLenum glFormat, glType;
-
-	switch (m_format) {
+	compression_ = Image::Compression_None;
+	glFormat_ = glType_ = GL_NONE;
+	switch (_format) {
 		case GL_R:
-		case GL_R8:   layout = Image::Layout_R; dataType = Image::DataType::Uint8N;  glFormat = GL_RED; glType = GL_UNSIGNED_BYTE;  break;
-		case GL_R16:  layout = Image::Layout_R; dataType = Image::DataType::Uint16N; glFormat = GL_RED; glType = GL_UNSIGNED_SHORT; break;
-		case GL_R16F: layout = Image::Layout_R; dataType = Image::DataType::Float16; glFormat = GL_RED; glType = GL_HALF_FLOAT;     break;
-		case GL_R32F: layout = Image::Layout_R; dataType = Image::DataType::Float32; glFormat = GL_RED; glType = GL_FLOAT;          break;
+		case GL_R8:   layout_ = Image::Layout_R; dataType_ = Image::DataType::Uint8N;  glFormat_ = GL_RED; glType_ = GL_UNSIGNED_BYTE;  break;
+		case GL_R16:  layout_ = Image::Layout_R; dataType_ = Image::DataType::Uint16N; glFormat_ = GL_RED; glType_ = GL_UNSIGNED_SHORT; break;
+		case GL_R16F: layout_ = Image::Layout_R; dataType_ = Image::DataType::Float16; glFormat_ = GL_RED; glType_ = GL_HALF_FLOAT;     break;
+		case GL_R32F: layout_ = Image::Layout_R; dataType_ = Image::DataType::Float32; glFormat_ = GL_RED; glType_ = GL_FLOAT;          break;
 
 		case GL_RG:
-		case GL_RG8:   layout = Image::Layout_RG; dataType = Image::DataType::Uint8N;  glFormat = GL_RG; glType = GL_UNSIGNED_BYTE;  break;
-		case GL_RG16:  layout = Image::Layout_RG; dataType = Image::DataType::Uint16N; glFormat = GL_RG; glType = GL_UNSIGNED_SHORT; break;
-		case GL_RG16F: layout = Image::Layout_RG; dataType = Image::DataType::Float16; glFormat = GL_RG; glType = GL_HALF_FLOAT;     break;
-		case GL_RG32F: layout = Image::Layout_RG; dataType = Image::DataType::Float32; glFormat = GL_RG; glType = GL_FLOAT;          break;
+		case GL_RG8:   layout_ = Image::Layout_RG; dataType_ = Image::DataType::Uint8N;  glFormat_ = GL_RG; glType_ = GL_UNSIGNED_BYTE;  break;
+		case GL_RG16:  layout_ = Image::Layout_RG; dataType_ = Image::DataType::Uint16N; glFormat_ = GL_RG; glType_ = GL_UNSIGNED_SHORT; break;
+		case GL_RG16F: layout_ = Image::Layout_RG; dataType_ = Image::DataType::Float16; glFormat_ = GL_RG; glType_ = GL_HALF_FLOAT;     break;
+		case GL_RG32F: layout_ = Image::Layout_RG; dataType_ = Image::DataType::Float32; glFormat_ = GL_RG; glType_ = GL_FLOAT;          break;
 
 		case GL_RGB:
-		case GL_RGB8:   layout = Image::Layout_RGB; dataType = Image::DataType::Uint8N;  glFormat = GL_RGB; glType = GL_UNSIGNED_BYTE;  break;
-		case GL_RGB16:  layout = Image::Layout_RGB; dataType = Image::DataType::Uint16N; glFormat = GL_RGB; glType = GL_UNSIGNED_SHORT; break;
-		case GL_RGB16F: layout = Image::Layout_RGB; dataType = Image::DataType::Float16; glFormat = GL_RGB; glType = GL_HALF_FLOAT;     break;
-		case GL_RGB32F: layout = Image::Layout_RGB; dataType = Image::DataType::Float32; glFormat = GL_RGB; glType = GL_FLOAT;          break;
+		case GL_RGB8:
+		case GL_SRGB8:  layout_ = Image::Layout_RGB; dataType_ = Image::DataType::Uint8N;  glFormat_ = GL_RGB; glType_ = GL_UNSIGNED_BYTE;  break;
+		case GL_RGB16:  layout_ = Image::Layout_RGB; dataType_ = Image::DataType::Uint16N; glFormat_ = GL_RGB; glType_ = GL_UNSIGNED_SHORT; break;
+		case GL_RGB16F: layout_ = Image::Layout_RGB; dataType_ = Image::DataType::Float16; glFormat_ = GL_RGB; glType_ = GL_HALF_FLOAT;     break;
+		case GL_RGB32F: layout_ = Image::Layout_RGB; dataType_ = Image::DataType::Float32; glFormat_ = GL_RGB; glType_ = GL_FLOAT;          break;
 			
 		case GL_RGBA:
-		case GL_RGBA8:   layout = Image::Layout_RGBA; dataType = Image::DataType::Uint8N;  glFormat = GL_RGBA; glType = GL_UNSIGNED_BYTE;  break;
-		case GL_RGBA16:  layout = Image::Layout_RGBA; dataType = Image::DataType::Uint16N; glFormat = GL_RGBA; glType = GL_UNSIGNED_SHORT; break;
-		case GL_RGBA16F: layout = Image::Layout_RGBA; dataType = Image::DataType::Float16; glFormat = GL_RGBA; glType = GL_HALF_FLOAT;     break;
-		case GL_RGBA32F: layout = Image::Layout_RGBA; dataType = Image::DataType::Float32; glFormat = GL_RGBA; glType = GL_FLOAT;          break;
-
-		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:       layout = Image::Layout_RGB;  dataType = Image::DataType::InvalidType; compression = Image::Compression_BC1; break;
-		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:      layout = Image::Layout_RGBA; dataType = Image::DataType::InvalidType; compression = Image::Compression_BC1; break;
-		case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:      layout = Image::Layout_RGBA; dataType = Image::DataType::InvalidType; compression = Image::Compression_BC2; break;
-		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:      layout = Image::Layout_RGBA; dataType = Image::DataType::InvalidType; compression = Image::Compression_BC3; break;
-		case GL_COMPRESSED_RED_RGTC1:               layout = Image::Layout_R;    dataType = Image::DataType::InvalidType; compression = Image::Compression_BC4; break;
-		case GL_COMPRESSED_RG_RGTC2:                layout = Image::Layout_R;    dataType = Image::DataType::InvalidType; compression = Image::Compression_BC5; break;
-		case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT: layout = Image::Layout_RGB;  dataType = Image::DataType::InvalidType; compression = Image::Compression_BC6; break;
-		case GL_COMPRESSED_RGBA_BPTC_UNORM:         layout = Image::Layout_RGBA; dataType = Image::DataType::InvalidType; compression = Image::Compression_BC7; break;
+		case GL_RGBA8:
+		case GL_SRGB8_ALPHA8: layout_ = Image::Layout_RGBA; dataType_ = Image::DataType::Uint8N;  glFormat_ = GL_RGBA; glType_ = GL_UNSIGNED_BYTE;  break;
+		case GL_RGBA16:  layout_ = Image::Layout_RGBA; dataType_ = Image::DataType::Uint16N; glFormat_ = GL_RGBA; glType_ = GL_UNSIGNED_SHORT; break;
+		case GL_RGBA16F: layout_ = Image::Layout_RGBA; dataType_ = Image::DataType::Float16; glFormat_ = GL_RGBA; glType_ = GL_HALF_FLOAT;     break;
+		case GL_RGBA32F: layout_ = Image::Layout_RGBA; dataType_ = Image::DataType::Float32; glFormat_ = GL_RGBA; glType_ = GL_FLOAT;          break;
+
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:       layout_ = Image::Layout_RGB;  dataType_ = Image::DataType::InvalidType; compression_ = Image::Compression_BC1; break;
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT: layout_ = Image::Layout_RGBA; dataType_ = Image::DataType::InvalidType; compression_ = Image::Compression_BC1; break;
+		case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT: layout_ = Image::Layout_RGBA; dataType_ = Image::DataType::InvalidType; compression_ = Image::Compression_BC2; break;
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT: layout_ = Image::Layout_RGBA; dataType_ = Image::DataType::InvalidType; compression_ = Image::Compression_BC3; break;
+		case GL_COMPRESSED_RED_RGTC1:                layout_ = Image::Layout_R;    dataType_ = Image::DataType::InvalidType; compression_ = Image::Compression_BC4; break;
+		case GL_COMPRESSED_RG_RGTC2:                 layout_ = Image::Layout_RG;   dataType_ = Image::DataType::InvalidType; compression_ = Image::Compression_BC5; break;
+		case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:  layout_ = Image::Layout_RGB;  dataType_ = Image::DataType::InvalidType; compression_ = Image::Compression_BC6; break;
+		case GL_COMPRESSED_RGBA_BPTC_UNORM:
+		case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:    layout_ = Image::Layout_RGBA; dataType_ = Image::DataType::InvalidType; compression_ = Image::Compression_BC7; break;
+		default:
+			return false;
 	};
+	return true;
+}
+
+Image* Texture::downloadImage()
+{
+	APT_ASSERT(m_handle);
+
+	Image::Layout layout;
+	Image::DataType dataType;
+	Image::CompressionType compression;
+	GLenum glFormat, glType;
+	if (!GetDownloadFormat((GLenum)m_format, layout, dataType, compression, glFormat, glType)) {
+		APT_LOG_ERR("Texture: downloadImage unsupported for format '%s'", internal::GlEnumStr(m_format));
+		return nullptr;
+	}
 
 	Image* ret = 0;
 	switch (m_target) {
@@ -862,6 +1451,92 @@ Image* Texture::downloadImage()
 	return ret;
 }
 
+Texture::Download* Texture::downloadImageAsync(GLint _mip, GLint _layer)
+{
+	APT_ASSERT(m_handle);
+	APT_ASSERT(_mip >= 0 && _mip < m_mipCount);
+
+	Image::Layout layout;
+	Image::DataType dataType;
+	Image::CompressionType compression;
+	GLenum glFormat, glType;
+	if (!GetDownloadFormat((GLenum)m_format, layout, dataType, compression, glFormat, glType)) {
+		APT_LOG_ERR("Texture: downloadImageAsync unsupported for format '%s'", internal::GlEnumStr(m_format));
+		return nullptr;
+	}
+
+ // region to download, the layer/face/slice is selected via the y or z offset
+	GLsizei w = APT_MAX(m_width >> _mip, 1);
+	GLsizei h = APT_MAX(m_height >> _mip, 1);
+	GLsizei d = 1;
+	GLint   y = 0;
+	GLint   z = 0;
+	Image*  img = nullptr;
+	switch (m_target) {
+		case GL_TEXTURE_1D:
+			APT_ASSERT(_layer == 0);
+			img = Image::Create1d(w, layout, dataType, 1, compression);
+			h = 1;
+			break;
+		case GL_TEXTURE_1D_ARRAY:
+			APT_ASSERT(_layer >= 0 && _layer < m_arrayCount);
+			img = Image::Create1d(w, layout, dataType, 1, compression);
+			h = 1;
+			y = _layer;
+			break;
+		case GL_TEXTURE_2D:
+			APT_ASSERT(_layer == 0);
+			img = Image::Create2d(w, h, layout, dataType, 1, compression);
+			break;
+		case GL_TEXTURE_2D_ARRAY:
+			APT_ASSERT(_layer >= 0 && _layer < m_arrayCount);
+			img = Image::Create2d(w, h, layout, dataType, 1, compression);
+			z = _layer;
+			break;
+		case GL_TEXTURE_CUBE_MAP:
+			APT_ASSERT(_layer >= 0 && _layer < 6);
+			img = Image::Create2d(w, h, layout, dataType, 1, compression);
+			z = _layer;
+			break;
+		case GL_TEXTURE_3D:
+			if (_layer < 0) {
+				d = APT_MAX(m_depth >> _mip, 1);
+				img = Image::Create3d(w, h, d, layout, dataType, 1, compression);
+			} else {
+				APT_ASSERT(_layer < APT_MAX(m_depth >> _mip, 1));
+				img = Image::Create2d(w, h, layout, dataType, 1, compression);
+				z = _layer;
+			}
+			break;
+		default:
+			APT_LOG_ERR("Texture: downloadImageAsync unsupported for '%s'", internal::GlEnumStr(m_target));
+			return nullptr;
+	};
+
+	Download* ret = new Download;
+	ret->m_image = img;
+	ret->m_mip   = _mip;
+	ret->m_layer = _layer;
+	ReadbackBuffer buffer = AllocReadbackBuffer((GLsizeiptr)img->getRawImageSize(0));
+	ret->m_buffer     = buffer.m_handle;
+	ret->m_bufferSize = buffer.m_size;
+
+	glAssert(glBindBuffer(GL_PIXEL_PACK_BUFFER, ret->m_buffer));
+	{	SCOPED_PIXELSTOREI(GL_PACK_ALIGNMENT, 1);
+		const GLsizei size = (GLsizei)img->getRawImageSize(0);
+		if (img->isCompressed()) {
+			glAssert(glGetCompressedTextureSubImage(m_handle, _mip, 0, y, z, w, h, d, size, nullptr));
+		} else {
+			glAssert(glGetTextureSubImage(m_handle, _mip, 0, y, z, w, h, d, glFormat, glType, size, nullptr));
+		}
+	}
+	glAssert(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+	glAssert(ret->m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+	glAssert(glFlush()); // isReady() doesn't flush, the fence must reach the GPU even if the caller never swaps
+
+	return ret;
+}
+
 void Texture::setFilter(GLenum _mode)
 {
 	APT_ASSERT(m_handle);
@@ -964,12 +1639,16 @@ GLenum Texture::getWrapW() const
 
 Texture::Texture(uint64 _id, const char* _name)
 	: Resource(_id, _name)
+	, m_stream(nullptr)
 	, m_handle(0)
+	, m_bindlessHandle(0)
 	, m_ownsHandle(true)
 	, m_target(GL_NONE)
 	, m_format((GLint)GL_NONE)
 	, m_width(0), m_height(0), m_depth(0)
+	, m_arrayCount(0)
 	, m_mipCount(0)
+	, m_gpuSize(0)
 {
 	APT_ASSERT(GlContext::GetCurrent());
 }
@@ -986,12 +1665,16 @@ Texture::Texture(
 	GLenum      _format
 	)
 	: Resource(_id, _name)
+	, m_stream(nullptr)
+	, m_bindlessHandle(0)
+	, m_ownsHandle(true)
+	, m_gpuSize(0)
 {
 	m_target     = _target;
 	m_format     = _format;
 	m_width      = _width;
 	m_height     = _height;
-	m_height     = _depth;
+	m_depth      = _depth;
 	m_arrayCount = _arrayCount;
 	m_mipCount   = APT_MIN(_mipCount, GetMaxMipCount(_width, _height));
 	glAssert(glCreateTextures(m_target, 1, &m_handle));
@@ -1017,14 +1700,76 @@ Texture::Texture(
 
 Texture::~Texture()
 {
+	if (m_stream) {
+		m_stream->m_texture = nullptr; // released by Update()
+	}
+	releaseBindlessHandle();
 	if (m_ownsHandle && m_handle) {
 		glAssert(glDeleteTextures(1, &m_handle));
 		m_handle = 0;
 	}
+	updateGpuSize();
 	setState(State_Unloaded);
 }
 
 
+bool Texture::isStreaming() const
+{
+	return m_stream && (!m_stream->m_allocated || m_stream->isUploading());
+}
+
+float Texture::getStreamingProgress() const
+{
+	if (!isStreaming()) {
+		return 1.0f;
+	}
+	return m_stream->m_totalBytes > 0 ? (float)((double)m_stream->m_uploadedBytes / (double)m_stream->m_totalBytes) : 0.0f;
+}
+
+float Texture::estimateMip(const Camera& _camera, float _viewportHeight, const vec3& _center, float _radius, float _uvDensity) const
+{
+	GLsizei size = m_stream ? (GLsizei)APT_MAX(m_stream->m_image.getWidth(), m_stream->m_image.getHeight()) : APT_MAX(m_width, m_height);
+	float texelsPerUnit = (float)size * _uvDensity;
+
+ // world space size of a pixel at the nearest point on the bounding sphere
+	float pixelSize = fabs(_camera.m_up - _camera.m_down) / _viewportHeight;
+	if (!_camera.getProjFlag(Camera::ProjFlag_Orthographic)) {
+		float distance = length(_center - _camera.getPosition()) - _radius;
+		pixelSize *= APT_MAX(distance, _camera.m_near);
+	}
+
+	float texelsPerPixel = texelsPerUnit * pixelSize;
+	return texelsPerPixel > 1.0f ? log2(texelsPerPixel) : 0.0f;
+}
+
+void Texture::requestMip(float _mip)
+{
+	if (!m_stream || !m_stream->m_mipStreaming) {
+		return;
+	}
+	GLint mip = (GLint)APT_MAX(_mip, 0.0f);
+	if (m_stream->m_requestFrame != g_streamFrame) {
+		m_stream->m_requestFrame = g_streamFrame;
+		m_stream->m_requestedMip = mip;
+	} else {
+		m_stream->m_requestedMip = APT_MIN(m_stream->m_requestedMip, mip);
+	}
+}
+
+GLint Texture::getResidentMip() const
+{
+	return m_stream ? m_stream->m_residentMip : 0;
+}
+
+GLuint64 Texture::getBindlessHandle()
+{
+	if (m_bindlessHandle == 0 && m_handle != 0 && GetBindless()) {
+		glAssert(m_bindlessHandle = glGetTextureHandleARB(m_handle));
+		glAssert(glMakeTextureHandleResidentARB(m_bindlessHandle));
+	}
+	return m_bindlessHandle;
+}
+
 bool Texture::isCompressed() const
 {
 	return GlIsTexFormatCompressed(m_format);
@@ -1039,8 +1784,9 @@ void frm::swap(Texture& _a, Texture& _b)
 	using eastl::swap;
 	swap(_a.m_path, _b.m_path);
 
-	swap(_a.m_handle,     _b.m_handle);
-	swap(_a.m_ownsHandle, _b.m_ownsHandle);
+	swap(_a.m_handle,         _b.m_handle);
+	swap(_a.m_bindlessHandle, _b.m_bindlessHandle);
+	swap(_a.m_ownsHandle,     _b.m_ownsHandle);
 	swap(_a.m_target,     _b.m_target);
 	swap(_a.m_format,     _b.m_format);
 	swap(_a.m_width,      _b.m_width);
@@ -1048,6 +1794,15 @@ void frm::swap(Texture& _a, Texture& _b)
 	swap(_a.m_depth,      _b.m_depth);
 	swap(_a.m_arrayCount, _b.m_arrayCount);
 	swap(_a.m_mipCount,   _b.m_mipCount);
+	swap(_a.m_gpuSize,    _b.m_gpuSize);
+
+	swap(_a.m_stream,     _b.m_stream);
+	if (_a.m_stream) {
+		_a.m_stream->m_texture = &_a;
+	}
+	if (_b.m_stream) {
+		_b.m_stream->m_texture = &_b;
+	}
 }
 
 // PRIVATE
@@ -1098,69 +1853,95 @@ static void AllocCubemap(Texture& _tx, const Image& _img)
 }
 
 #define Texture_COMPUTE_WHD() \
-	GLsizei div = (GLsizei)pow(2.0, (double)_mip); \
+	GLsizei div = (GLsizei)pow(2.0, (double)_level); \
 	GLsizei w = APT_MAX(_tx.getWidth()  / div, (GLsizei)1); \
 	GLsizei h = APT_MAX(_tx.getHeight() / div, (GLsizei)1);\
 	GLsizei d = APT_MAX(_tx.getDepth()  / div, (GLsizei)1); 
 
-static void Upload1d(Texture& _tx, const Image& _img, GLint _array, GLint _mip, GLenum _srcFormat, GLenum _srcType)
+static void Upload1d(Texture& _tx, const Image& _img, GLint _array, GLint _mip, GLint _level, GLenum _srcFormat, GLenum _srcType, const char* _src)
 {
 	Texture_COMPUTE_WHD();
 	if (_img.isCompressed()) {
-		glAssert(glCompressedTextureSubImage1D(_tx.getHandle(), _mip, 0, w, _tx.getFormat(), (GLsizei)_img.getRawImageSize(_mip), _img.getRawImage(_array, _mip)));
+		glAssert(glCompressedTextureSubImage1D(_tx.getHandle(), _level, 0, w, _tx.getFormat(), (GLsizei)_img.getRawImageSize(_mip), _src));
 	} else {
-		glAssert(glTextureSubImage1D(_tx.getHandle(), _mip, 0, w, _srcFormat, _srcType, _img.getRawImage(_array, _mip)));
+		glAssert(glTextureSubImage1D(_tx.getHandle(), _level, 0, w, _srcFormat, _srcType, _src));
 	}
 }
-static void Upload1dArray(Texture& _tx, const Image& _img, GLint _array, GLint _mip, GLenum _srcFormat, GLenum _srcType)
+static void Upload1dArray(Texture& _tx, const Image& _img, GLint _array, GLint _mip, GLint _level, GLenum _srcFormat, GLenum _srcType, const char* _src)
 {
 	Texture_COMPUTE_WHD();
 	if (_img.isCompressed()) {
-		glAssert(glCompressedTextureSubImage2D(_tx.getHandle(), _mip, 0, _array, w, 1, _tx.getFormat(), (GLsizei)_img.getRawImageSize(_mip), _img.getRawImage(_array, _mip)));
+		glAssert(glCompressedTextureSubImage2D(_tx.getHandle(), _level, 0, _array, w, 1, _tx.getFormat(), (GLsizei)_img.getRawImageSize(_mip), _src));
 	} else {
-		glAssert(glTextureSubImage2D(_tx.getHandle(), _mip, 0, _array, w, 1, _srcFormat, _srcType, _img.getRawImage(_array, _mip)));
+		glAssert(glTextureSubImage2D(_tx.getHandle(), _level, 0, _array, w, 1, _srcFormat, _srcType, _src));
 	}
 }
-static void Upload2d(Texture& _tx, const Image& _img, GLint _array, GLint _mip, GLenum _srcFormat, GLenum _srcType)
+static void Upload2d(Texture& _tx, const Image& _img, GLint _array, GLint _mip, GLint _level, GLenum _srcFormat, GLenum _srcType, const char* _src)
 {
 	Texture_COMPUTE_WHD();
 	if (_img.isCompressed()) {
-		glAssert(glCompressedTextureSubImage2D(_tx.getHandle(), _mip, 0, _array, w, h, _tx.getFormat(), (GLsizei)_img.getRawImageSize(_mip), _img.getRawImage(_array, _mip)));
+		glAssert(glCompressedTextureSubImage2D(_tx.getHandle(), _level, 0, _array, w, h, _tx.getFormat(), (GLsizei)_img.getRawImageSize(_mip), _src));
 	} else {
-		glAssert(glTextureSubImage2D(_tx.getHandle(), _mip, 0, 0, w, h, _srcFormat, _srcType, _img.getRawImage(_array, _mip)));
+		glAssert(glTextureSubImage2D(_tx.getHandle(), _level, 0, 0, w, h, _srcFormat, _srcType, _src));
 	}
 }
-static void Upload2dArray(Texture& _tx, const Image& _img, GLint _array, GLint _mip, GLenum _srcFormat, GLenum _srcType)
+static void Upload2dArray(Texture& _tx, const Image& _img, GLint _array, GLint _mip, GLint _level, GLenum _srcFormat, GLenum _srcType, const char* _src)
 {
 	Texture_COMPUTE_WHD();
 	if (_img.isCompressed()) {
-		glAssert(glCompressedTextureSubImage3D(_tx.getHandle(), _mip, 0, 0, _array, w, h, 1, _tx.getFormat(), (GLsizei)_img.getRawImageSize(_mip), _img.getRawImage(_array, _mip)));
+		glAssert(glCompressedTextureSubImage3D(_tx.getHandle(), _level, 0, 0, _array, w, h, 1, _tx.getFormat(), (GLsizei)_img.getRawImageSize(_mip), _src));
 	} else {
-		glAssert(glTextureSubImage3D(_tx.getHandle(), _mip, 0, 0, _array, w, h, 1, _srcFormat, _srcType, _img.getRawImage(_array, _mip)));
+		glAssert(glTextureSubImage3D(_tx.getHandle(), _level, 0, 0, _array, w, h, 1, _srcFormat, _srcType, _src));
 	}
 }
-static void Upload3d(Texture& _tx, const Image& _img, GLint _array, GLint _mip, GLenum _srcFormat, GLenum _srcType)
+static void Upload3d(Texture& _tx, const Image& _img, GLint _array, GLint _mip, GLint _level, GLenum _srcFormat, GLenum _srcType, const char* _src)
 {
 	Texture_COMPUTE_WHD();
 	if (_img.isCompressed()) {
-		glAssert(glCompressedTextureSubImage3D(_tx.getHandle(), _mip, 0, 0, _array, w, h, d, _tx.getFormat(), (GLsizei)_img.getRawImageSize(_mip), _img.getRawImage(_array, _mip)));
+		glAssert(glCompressedTextureSubImage3D(_tx.getHandle(), _level, 0, 0, _array, w, h, d, _tx.getFormat(), (GLsizei)_img.getRawImageSize(_mip), _src));
 	} else {
-		glAssert(glTextureSubImage3D(_tx.getHandle(), _mip, 0, 0, _array, w, h, d, _srcFormat, _srcType, _img.getRawImage(_array, _mip)));
+		glAssert(glTextureSubImage3D(_tx.getHandle(), _level, 0, 0, _array, w, h, d, _srcFormat, _srcType, _src));
 	}
 }
-static void UploadCubemap3x2(Texture& _tx, const Image& _img, GLint _array, GLint _mip, GLenum _srcFormat, GLenum _srcType)
+static void UploadCubemap3x2(Texture& _tx, const Image& _img, GLint _array, GLint _mip, GLint _level, GLenum _srcFormat, GLenum _srcType, const char* _src)
 {
 	Texture_COMPUTE_WHD();
 	SCOPED_PIXELSTOREI(GL_UNPACK_ROW_LENGTH, w * 2);
 	glAssert(glBindTexture(GL_TEXTURE_CUBE_MAP, _tx.getHandle()));
 
+	if (_img.isCompressed()) {
+	 // faces are block aligned (see GenerateCubemap2x3Mips() in TextureCache.cpp), upload each face as a subregion
+	 // of the block grid; faces smaller than a block are assumed to be padded to a whole block
+		const GLsizei blockSize = (GLsizei)GlGetTexFormatSizeBytes(_tx.getFormat());
+		const GLsizei faceBlocksX = (w + 3) / 4;
+		const GLsizei faceBlocksY = (h + 3) / 4;
+		if ((GLsizeiptr)_img.getRawImageSize(_mip) < (GLsizeiptr)(faceBlocksX * 2 * faceBlocksY * 3 * blockSize)) {
+			APT_ASSERT(false); // faces aren't block aligned, the mip isn't uploaded
+			return;
+		}
+		SCOPED_PIXELSTOREI(GL_UNPACK_ROW_LENGTH,              faceBlocksX * 2 * 4);
+		SCOPED_PIXELSTOREI(GL_UNPACK_COMPRESSED_BLOCK_WIDTH,  4);
+		SCOPED_PIXELSTOREI(GL_UNPACK_COMPRESSED_BLOCK_HEIGHT, 4);
+		SCOPED_PIXELSTOREI(GL_UNPACK_COMPRESSED_BLOCK_DEPTH,  1);
+		SCOPED_PIXELSTOREI(GL_UNPACK_COMPRESSED_BLOCK_SIZE,   blockSize);
+		int face = 0;
+		for (int y = 0; y < 3; ++y) {
+			for (int x = 0; x < 2; ++x) {
+				const char* src = _src + ((y * faceBlocksY) * (faceBlocksX * 2) + x * faceBlocksX) * blockSize;
+				glAssert(glCompressedTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, _level, 0, 0, w, h, _tx.getFormat(), faceBlocksX * faceBlocksY * blockSize, src));
+				++face;
+			}
+		}
+		return;
+	}
+
 	int face = 0;
 	for (int y = 0; y < 3; ++y) {
 		for (int x = 0; x < 2; ++x) {
-			char* src = _img.getRawImage(_array, _mip);
+			const char* src = _src;
 			src += x * w * (GLsizei)_img.getTexelSize();
 			src += y * h * w * 2 * (GLsizei)_img.getTexelSize();
-			glAssert(glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, _mip, 0, 0, w, h, _srcFormat, _srcType, src));
+			glAssert(glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, _level, 0, 0, w, h, _srcFormat, _srcType, src));
 			++face;
 		}
 	}
@@ -1168,125 +1949,164 @@ static void UploadCubemap3x2(Texture& _tx, const Image& _img, GLint _array, GLin
 
 #undef Texture_COMPUTE_WHD
 
-bool Texture::loadImage(const Image& _img)
+bool Texture::ReadImage(Image& img_, File& _file)
 {
-	SCOPED_PIXELSTOREI(GL_UNPACK_ALIGNMENT, 1);
-
- // metadata
-	m_width      = (GLint)_img.getWidth();
-	m_height     = (GLint)_img.getHeight();
-	m_depth      = (GLint)_img.getDepth();
-	m_arrayCount = (GLint)_img.getArrayCount();
-
-	// \hack \todo always allocate a mip chain in case we call generateMipmap() later - make this optional?
-	m_mipCount   = _img.getMipmapCount() == 1 ? (GLint)GetMaxMipCount(m_width, m_height, m_depth) : (GLint) _img.getMipmapCount();
-
- // target, alloc/upload dispatch functions
-	void (*alloc)(Texture& _tx, const Image& _img);
-	void (*upload)(Texture& _tx, const Image& _img, GLint _array, GLint _mip, GLenum _srcFormat, GLenum _srcType);
-
-	if (m_target == GL_TEXTURE_CUBE_MAP) {
-	 // special-case 3x2 cubemaps
-		m_width /= 2;
-		m_height /= 3;
-		m_mipCount = _img.getMipmapCount() == 1 ? (GLint)GetMaxMipCount(m_width, m_height) : (GLint) _img.getMipmapCount();
-		alloc = AllocCubemap;
-		upload = UploadCubemap3x2;
-	} else {
-		switch (_img.getType()) {
-			case Image::Type_1d:           m_target = GL_TEXTURE_1D;        alloc = Alloc1d;      upload = Upload1d; break;
-			case Image::Type_1dArray:      m_target = GL_TEXTURE_1D_ARRAY;  alloc = Alloc1dArray; upload = Upload1dArray; break;
-			case Image::Type_2d:           m_target = GL_TEXTURE_2D;        alloc = Alloc2d;      upload = Upload2d; break;
-			case Image::Type_2dArray:      m_target = GL_TEXTURE_2D_ARRAY;  alloc = Alloc2dArray; upload = Upload2dArray; break;
-			case Image::Type_3d:           m_target = GL_TEXTURE_3D;        alloc = Alloc3d;      upload = Upload3d; break;
-		 // \todo implement cubemaps
-			case Image::Type_Cubemap:      APT_ASSERT(false);//m_target = GL_TEXTURE_CUBE_MAP;       upload = Upload2d; break;
-			case Image::Type_CubemapArray: APT_ASSERT(false);//m_target = GL_TEXTURE_CUBE_MAP_ARRAY; upload = Upload3d; break;
-			default:                       APT_ASSERT(false); return false;
-		};
+	if (FileSystem::CompareExtension("hdr", _file.getPath())) {
+		return ReadHdr(img_, _file.getData(), (uint)_file.getDataSize());
 	}
+	return Image::Read(img_, _file);
+}
 
+bool Texture::GetImageFormat(const Image& _img, GLenum& format_, GLenum& srcFormat_, GLenum& srcType_)
+{
  // src format
-	GLenum srcFormat;
 	switch (_img.getLayout()) {
-		case Image::Layout_R:          srcFormat = m_format = GL_RED;  break;
-		case Image::Layout_RG:         srcFormat = m_format = GL_RG;   break;
-		case Image::Layout_RGB:        srcFormat = m_format = GL_RGB;  break;
-		case Image::Layout_RGBA:       srcFormat = m_format = GL_RGBA; break;
+		case Image::Layout_R:          srcFormat_ = format_ = GL_RED;  break;
+		case Image::Layout_RG:         srcFormat_ = format_ = GL_RG;   break;
+		case Image::Layout_RGB:        srcFormat_ = format_ = GL_RGB;  break;
+		case Image::Layout_RGBA:       srcFormat_ = format_ = GL_RGBA; break;
 		default:                       APT_ASSERT(false); return false;
 	};
 
- // internal format (request only, we read back the actual format the implementation used later)
+ // internal format
 	if (_img.isCompressed()) {
 		switch (_img.getCompressionType()) {
 			case Image::Compression_BC1: 
 				switch (_img.getLayout()) {
-					case Image::Layout_RGB:  m_format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;       break;
-					case Image::Layout_RGBA: m_format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;      break;
+					case Image::Layout_RGB:  format_ = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;       break;
+					case Image::Layout_RGBA: format_ = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;      break;
 					default:                 APT_ASSERT(false); return false;
 				};
 				break;
-			case Image::Compression_BC2: m_format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;      break;
-			case Image::Compression_BC3: m_format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;      break;
-			case Image::Compression_BC4: m_format = GL_COMPRESSED_RED_RGTC1;               break;
-			case Image::Compression_BC5: m_format = GL_COMPRESSED_RG_RGTC2;                break;
-			case Image::Compression_BC6: m_format = GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT; break;
-			case Image::Compression_BC7: m_format = GL_COMPRESSED_RGBA_BPTC_UNORM;         break;
+			case Image::Compression_BC2: format_ = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;      break;
+			case Image::Compression_BC3: format_ = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;      break;
+			case Image::Compression_BC4: format_ = GL_COMPRESSED_RED_RGTC1;               break;
+			case Image::Compression_BC5: format_ = GL_COMPRESSED_RG_RGTC2;                break;
+			case Image::Compression_BC6: format_ = GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT; break;
+			case Image::Compression_BC7: format_ = GL_COMPRESSED_RGBA_BPTC_UNORM;         break;
 		};
 	} else {
 		switch (_img.getLayout()) {
 			case Image::Layout_R:
 				switch (_img.getImageDataType()) {
-					case DataType::Float32: m_format = GL_R32F; break;
-					case DataType::Float16: m_format = GL_R16F; break;
-					case DataType::Uint16N: m_format = GL_R16;  break;
-					default:                m_format = GL_R8;   break;
+					case DataType::Float32: format_ = GL_R32F; break;
+					case DataType::Float16: format_ = GL_R16F; break;
+					case DataType::Uint16N: format_ = GL_R16;  break;
+					default:                format_ = GL_R8;   break;
 				};
 				break;
 			case Image::Layout_RG:
 				switch (_img.getImageDataType()) {
-					case DataType::Float32: m_format = GL_RG32F; break;
-					case DataType::Float16: m_format = GL_RG16F; break;
-					case DataType::Uint16N: m_format = GL_RG16;  break;
-					default:                m_format = GL_RG8;   break;
+					case DataType::Float32: format_ = GL_RG32F; break;
+					case DataType::Float16: format_ = GL_RG16F; break;
+					case DataType::Uint16N: format_ = GL_RG16;  break;
+					default:                format_ = GL_RG8;   break;
 				};
 				break;
 			case Image::Layout_RGB:			
 				switch (_img.getImageDataType()) {
-					case DataType::Float32: m_format = GL_RGB32F; break;
-					case DataType::Float16: m_format = GL_RGB16F; break;
-					case DataType::Uint16N: m_format = GL_RGB16;  break;
-					default:                m_format = GL_RGB8;   break;
+					case DataType::Float32: format_ = GL_RGB32F; break;
+					case DataType::Float16: format_ = GL_RGB16F; break;
+					case DataType::Uint16N: format_ = GL_RGB16;  break;
+					default:                format_ = GL_RGB8;   break;
 				};
 				break;
 			case Image::Layout_RGBA:
 				switch (_img.getImageDataType()) {
-					case DataType::Float32: m_format = GL_RGBA32F; break;
-					case DataType::Float16: m_format = GL_RGBA16F; break;
-					case DataType::Uint16N: m_format = GL_RGBA16;  break;
-					default:                m_format = GL_RGBA8;   break;
+					case DataType::Float32: format_ = GL_RGBA32F; break;
+					case DataType::Float16: format_ = GL_RGBA16F; break;
+					case DataType::Uint16N: format_ = GL_RGBA16;  break;
+					default:                format_ = GL_RGBA8;   break;
 				};
 				break;
 			default: break;
 		};
 	}
 	
-	GLenum srcType = _img.isCompressed() ? GL_UNSIGNED_BYTE : internal::GlDataTypeToEnum(_img.getImageDataType());
+	srcType_ = _img.isCompressed() ? GL_UNSIGNED_BYTE : internal::GlDataTypeToEnum(_img.getImageDataType());
+	return true;
+}
 
- // delete old handle, gen new handle (required since we use immutable storage)
-	if (m_handle) {
-		glAssert(glDeleteTextures(1, &m_handle));
+bool Texture::loadImage(const Image& _img)
+{
+	SCOPED_PIXELSTOREI(GL_UNPACK_ALIGNMENT, 1);
+
+	GLenum srcFormat, srcType;
+	if (!initImage(_img, srcFormat, srcType)) {
+		return false;
 	}
 
  // upload data; apt::Image stores each array layer contiguously with its mip chain, so we need to call
  // glTexSubImage* to upload each layer/mip separately
-	glAssert(glCreateTextures(m_target, 1, &m_handle));
-	alloc(*this, _img);
 	for (GLint i = 0; i < _img.getArrayCount(); ++i) {		
 		for (GLint j = 0; j < _img.getMipmapCount(); ++j) {
-			upload(*this, _img, i, j, srcFormat, srcType);
+			uploadImage(_img, i, j, srcFormat, srcType, _img.getRawImage(i, j));
 		}
 	}
+
+	return true;
+}
+
+bool Texture::initImage(const Image& _img, GLenum& _srcFormat_, GLenum& _srcType_, GLint _residentMip, bool _srgb)
+{
+ // metadata
+	m_width      = (GLint)_img.getWidth();
+	m_height     = (GLint)_img.getHeight();
+	m_depth      = (GLint)_img.getDepth();
+	m_arrayCount = (GLint)_img.getArrayCount();
+
+	// \hack \todo always allocate a mip chain in case we call generateMipmap() later - make this optional?
+	m_mipCount   = _img.getMipmapCount() == 1 ? (GLint)GetMaxMipCount(m_width, m_height, m_depth) : (GLint) _img.getMipmapCount();
+
+ // target, alloc dispatch function
+	void (*alloc)(Texture& _tx, const Image& _img);
+
+	if (m_target == GL_TEXTURE_CUBE_MAP) {
+	 // special-case 3x2 cubemaps
+		m_width /= 2;
+		m_height /= 3;
+		m_mipCount = _img.getMipmapCount() == 1 ? (GLint)GetMaxMipCount(m_width, m_height) : (GLint) _img.getMipmapCount();
+		alloc = AllocCubemap;
+	} else {
+		switch (_img.getType()) {
+			case Image::Type_1d:           m_target = GL_TEXTURE_1D;        alloc = Alloc1d;      break;
+			case Image::Type_1dArray:      m_target = GL_TEXTURE_1D_ARRAY;  alloc = Alloc1dArray; break;
+			case Image::Type_2d:           m_target = GL_TEXTURE_2D;        alloc = Alloc2d;      break;
+			case Image::Type_2dArray:      m_target = GL_TEXTURE_2D_ARRAY;  alloc = Alloc2dArray; break;
+			case Image::Type_3d:           m_target = GL_TEXTURE_3D;        alloc = Alloc3d;      break;
+		 // \todo implement cubemaps
+			case Image::Type_Cubemap:      APT_ASSERT(false);//m_target = GL_TEXTURE_CUBE_MAP;       upload = Upload2d; break;
+			case Image::Type_CubemapArray: APT_ASSERT(false);//m_target = GL_TEXTURE_CUBE_MAP_ARRAY; upload = Upload3d; break;
+			default:                       APT_ASSERT(false); return false;
+		};
+	}
+
+ // partially resident, level 0 is _residentMip
+	if (_residentMip > 0) {
+		APT_ASSERT(_residentMip < (GLint)_img.getMipmapCount());
+		m_width    = APT_MAX(m_width  >> _residentMip, 1);
+		m_height   = APT_MAX(m_height >> _residentMip, 1);
+		if (m_target == GL_TEXTURE_3D) {
+			m_depth = APT_MAX(m_depth >> _residentMip, 1);
+		}
+		m_mipCount = (GLint)_img.getMipmapCount() - _residentMip;
+	}
+
+ // internal format (request only, we read back the actual format the implementation used later)
+	if (!GetImageFormat(_img, m_format, _srcFormat_, _srcType_)) {
+		return false;
+	}
+	if (_srgb) {
+		m_format = GlGetTexFormatSrgb(m_format);
+	}
+
+ // delete old handle, gen new handle (required since we use immutable storage)
+	releaseBindlessHandle();
+	if (m_handle) {
+		glAssert(glDeleteTextures(1, &m_handle));
+	}
+	glAssert(glCreateTextures(m_target, 1, &m_handle));
+	alloc(*this, _img);
 	updateParams();
 
 	setWrap(GL_REPEAT);
@@ -1296,10 +2116,381 @@ bool Texture::loadImage(const Image& _img)
 	return true;
 }
 
+void Texture::uploadImage(const Image& _img, GLint _array, GLint _mip, GLenum _srcFormat, GLenum _srcType, const void* _src)
+{
+	const char* src = (const char*)_src;
+	GLint level = _mip - (m_stream ? m_stream->m_residentMip : 0);
+	APT_ASSERT(level >= 0);
+	switch (m_target) {
+		case GL_TEXTURE_1D:       Upload1d(*this, _img, _array, _mip, level, _srcFormat, _srcType, src);         break;
+		case GL_TEXTURE_1D_ARRAY: Upload1dArray(*this, _img, _array, _mip, level, _srcFormat, _srcType, src);    break;
+		case GL_TEXTURE_2D:       Upload2d(*this, _img, _array, _mip, level, _srcFormat, _srcType, src);         break;
+		case GL_TEXTURE_2D_ARRAY: Upload2dArray(*this, _img, _array, _mip, level, _srcFormat, _srcType, src);    break;
+		case GL_TEXTURE_3D:       Upload3d(*this, _img, _array, _mip, level, _srcFormat, _srcType, src);         break;
+		case GL_TEXTURE_CUBE_MAP: UploadCubemap3x2(*this, _img, _array, _mip, level, _srcFormat, _srcType, src); break;
+		default:                  APT_ASSERT(false); break;
+	};
+}
+
+void Texture::releaseBindlessHandle()
+{
+	if (m_bindlessHandle != 0) {
+		glAssert(glMakeTextureHandleNonResidentARB(m_bindlessHandle));
+		m_bindlessHandle = 0;
+	}
+}
+
+void Texture::updateGpuSize()
+{
+	GLsizeiptr size = 0;
+	if (m_ownsHandle && m_handle) {
+		const bool       compressed = isCompressed();
+		const GLsizeiptr texelBytes = GlGetTexFormatSizeBytes(m_format);
+		for (GLint mip = 0; mip < m_mipCount; ++mip) {
+			GLsizeiptr w = APT_MAX(m_width >> mip, 1);
+			GLsizeiptr h = m_target == GL_TEXTURE_1D || m_target == GL_TEXTURE_1D_ARRAY ? 1 : APT_MAX(m_height >> mip, 1);
+			GLsizeiptr d = m_target == GL_TEXTURE_3D ? APT_MAX(m_depth >> mip, 1) : 1;
+			if (compressed) {
+			 // 4x4 blocks
+				w = (w + 3) / 4;
+				h = (h + 3) / 4;
+			}
+			size += w * h * d * texelBytes;
+		}
+		size *= (GLsizeiptr)APT_MAX(m_arrayCount, 1) * (m_target == GL_TEXTURE_CUBE_MAP ? 6 : 1);
+	}
+	if (m_gpuSize > 0) {
+		GpuMemory::Free(GpuMemory::Type_Texture, m_gpuSize);
+	}
+	m_gpuSize = size;
+	if (m_gpuSize > 0) {
+		GpuMemory::Alloc(GpuMemory::Type_Texture, m_gpuSize);
+	}
+}
+
+void Texture::initPlaceholder()
+{
+	static const uint8 kTexel[4] = { 0x80, 0x80, 0x80, 0xff };
+
+	releaseBindlessHandle();
+	if (m_handle) {
+		glAssert(glDeleteTextures(1, &m_handle));
+	}
+	m_target     = GL_TEXTURE_2D;
+	m_format     = GL_RGBA8;
+	m_width      = m_height = m_depth = 1;
+	m_arrayCount = m_mipCount = 1;
+	glAssert(glCreateTextures(m_target, 1, &m_handle));
+	glAssert(glTextureStorage2D(m_handle, 1, m_format, 1, 1));
+	glAssert(glTextureSubImage2D(m_handle, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, kTexel));
+	updateGpuSize();
+}
+
+void Texture::beginStream()
+{
+	APT_ASSERT(!m_stream);
+	Stream* stream = new Stream;
+	stream->m_texture       = this;
+	stream->m_path.set(m_path);
+	stream->m_state         = Stream::State_Decoding;
+	stream->m_srgb          = false;
+	stream->m_allocated     = false;
+	stream->m_totalBytes    = 0;
+	stream->m_uploadedBytes = 0;
+	stream->m_mipStreaming  = false;
+	stream->m_residentMip   = 0;
+	stream->m_requestedMip  = 0;
+	stream->m_requestFrame  = -1;
+	stream->m_evictFrames   = 0;
+	m_stream = stream;
+	s_streams.push_back(stream);
+	ThreadPool::Dispatch([stream]{ stream->decode(); });
+}
+
+bool Texture::updateStream()
+{
+	APT_ASSERT(m_stream && m_stream->m_state == Stream::State_Decoded);
+	Stream& stream = *m_stream;
+	const Image& img = stream.m_image;
+
+	if (!stream.m_allocated) {
+		stream.m_residentMip = g_mipBudget > 0 ? GetInitialMip(img) : 0;
+		if (!initImage(img, stream.m_srcFormat, stream.m_srcType, stream.m_residentMip, stream.m_srgb)) {
+			APT_LOG_ERR("Texture: Failed to load '%s'", (const char*)m_path);
+			setState(State_Error);
+			return true;
+		}
+		stream.m_allocated     = true;
+		stream.m_mipStreaming  = g_mipBudget > 0 && img.getMipmapCount() > 1;
+		stream.m_mip           = (GLint)img.getMipmapCount() - 1;
+		stream.m_array         = 0;
+		stream.m_totalBytes    = (uint64)GetResidentSize(img, stream.m_residentMip);
+		stream.m_uploadedBytes = 0;
+		TextureView* txView = g_textureViewer.findTextureView(this);
+		if (txView) {
+			txView->reset();
+		}
+	}
+
+ // upload smallest mips first, for each mip upload all array layers
+	while (stream.m_mip >= stream.m_residentMip) {
+		GLsizeiptr size = (GLsizeiptr)img.getRawImageSize(stream.m_mip);
+		if (g_streamFrameBytes > 0 && g_streamFrameBytes + size > g_streamBudget) {
+			return false;
+		}
+		const char* src = img.getRawImage(stream.m_array, stream.m_mip);
+		if (size > g_streamRing.m_size) {
+		 // too big for the ring, upload directly
+			glAssert(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+			uploadImage(img, stream.m_array, stream.m_mip, stream.m_srcFormat, stream.m_srcType, src);
+			glAssert(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, g_streamRing.m_buffer));
+		} else {
+			GLsizeiptr offset = g_streamRing.alloc(size);
+			if (offset < 0) {
+				g_streamRingFull = true;
+				return false;
+			}
+			memcpy(g_streamRing.m_data + offset, src, (size_t)size);
+			uploadImage(img, stream.m_array, stream.m_mip, stream.m_srcFormat, stream.m_srcType, (const void*)offset);
+		}
+		g_streamFrameBytes += size;
+		stream.m_uploadedBytes += (uint64)size;
+
+		if (++stream.m_array == (GLint)img.getArrayCount()) {
+		 // mip complete, allow access
+			setMipRange(stream.m_mip - stream.m_residentMip, m_mipCount - 1);
+			stream.m_array = 0;
+			--stream.m_mip;
+		}
+	}
+
+	setMipRange(0, m_mipCount - 1);
+	setState(State_Loaded);
+	return true;
+}
+
+void Texture::setResidentMip(GLint _mip)
+{
+	APT_ASSERT(m_stream && m_stream->m_mipStreaming && !m_stream->isUploading());
+	Stream& stream = *m_stream;
+	const Image& img = stream.m_image;
+	const GLint oldMip = stream.m_residentMip;
+	if (_mip == oldMip) {
+		return;
+	}
+
+ // initImage() resets the sampler state
+	GLenum  minFilter = getMinFilter();
+	GLenum  magFilter = getMagFilter();
+	GLenum  wrapU     = getWrapU();
+	GLenum  wrapV     = getWrapV();
+	GLenum  wrapW     = getWrapW();
+	GLfloat aniso     = getAnisotropy();
+
+ // alloc new storage, keep the old handle for the copy
+	releaseBindlessHandle();
+	GLuint oldHandle = m_handle;
+	m_handle = 0;
+	stream.m_residentMip = _mip;
+	APT_VERIFY(initImage(img, stream.m_srcFormat, stream.m_srcType, _mip, stream.m_srgb));
+
+	for (GLint mip = APT_MAX(_mip, oldMip); mip < (GLint)img.getMipmapCount(); ++mip) {
+		GLint level = mip - _mip;
+		GLsizei w = APT_MAX(m_width >> level, 1);
+		GLsizei h = m_target == GL_TEXTURE_1D_ARRAY ? m_arrayCount : APT_MAX(m_height >> level, 1);
+		GLsizei d = m_target == GL_TEXTURE_2D_ARRAY ? m_arrayCount : (m_target == GL_TEXTURE_3D ? APT_MAX(m_depth >> level, 1) : 1);
+		glAssert(glCopyImageSubData(oldHandle, m_target, mip - oldMip, 0, 0, 0, m_handle, m_target, level, 0, 0, 0, w, h, d));
+	}
+	glAssert(glDeleteTextures(1, &oldHandle));
+
+	setMinFilter(minFilter);
+	setMagFilter(magFilter);
+	setWrapU(wrapU);
+	setWrapV(wrapV);
+	setWrapW(wrapW);
+	setAnisotropy(aniso);
+
+	if (_mip < oldMip) {
+	 // upload missing mips via updateStream(), only the copied mips are accessible until then
+		stream.m_mip           = oldMip - 1;
+		stream.m_array         = 0;
+		stream.m_totalBytes    = (uint64)(GetResidentSize(img, _mip) - GetResidentSize(img, oldMip));
+		stream.m_uploadedBytes = 0;
+		setMipRange(oldMip - _mip, m_mipCount - 1);
+	} else {
+		stream.m_mip = _mip - 1;
+		setMipRange(0, m_mipCount - 1);
+	}
+
+	TextureView* txView = g_textureViewer.findTextureView(this);
+	if (txView) {
+		txView->m_mip = APT_MIN(txView->m_mip, m_mipCount - 1);
+	}
+}
+
+void Texture::UpdateMipResidency()
+{
+	g_mipResidentBytes = 0;
+	g_mipBias = 0;
+	if (g_mipBudget <= 0) {
+		return;
+	}
+
+	eastl::vector<Stream*> streams;
+	eastl::vector<GLint>   wantMips;
+	GLint maxMipCount = 0;
+	GLsizeiptr residentBytes = 0;
+	for (Stream* stream : s_streams) {
+		if (!stream->m_texture || !stream->m_mipStreaming || !stream->m_allocated) {
+			continue;
+		}
+		const Image& img = stream->m_image;
+		GLint mipCount = (GLint)img.getMipmapCount();
+		bool requested = stream->m_requestFrame >= 0 && g_streamFrame - stream->m_requestFrame <= kMipRequestFrames;
+		streams.push_back(stream);
+		wantMips.push_back(requested ? APT_MIN(stream->m_requestedMip, mipCount - 1) : 0); // no request = full res, subject to the budget
+		maxMipCount = APT_MAX(maxMipCount, mipCount);
+		residentBytes += GetResidentSize(img, stream->m_residentMip);
+	}
+
+ // find the smallest bias which fits the budget
+	for (; g_mipBias < maxMipCount; ++g_mipBias) {
+		GLsizeiptr totalBytes = 0;
+		for (size_t i = 0; i < streams.size(); ++i) {
+			const Image& img = streams[i]->m_image;
+			totalBytes += GetResidentSize(img, APT_MIN(wantMips[i] + g_mipBias, (GLint)img.getMipmapCount() - 1));
+		}
+		if (totalBytes <= g_mipBudget) {
+			break;
+		}
+	}
+
+ // load immediately, evict after kMipEvictFrames unless over budget
+	bool overBudget = residentBytes > g_mipBudget;
+	for (size_t i = 0; i < streams.size(); ++i) {
+		Stream* stream = streams[i];
+		const Image& img = stream->m_image;
+		GLint mip = APT_MIN(wantMips[i] + g_mipBias, (GLint)img.getMipmapCount() - 1);
+		if (mip > stream->m_residentMip) {
+			++stream->m_evictFrames;
+		} else {
+			stream->m_evictFrames = 0;
+		}
+		if (!stream->isUploading()) {
+			if (mip < stream->m_residentMip || (mip > stream->m_residentMip && (overBudget || stream->m_evictFrames >= kMipEvictFrames))) {
+				stream->m_texture->setResidentMip(mip);
+				stream->m_evictFrames = 0;
+			}
+		}
+		g_mipResidentBytes += GetResidentSize(img, stream->m_residentMip);
+	}
+}
+
 void Texture::updateParams()
 {
 	glAssert(glGetTextureLevelParameteriv(m_handle, 0, GL_TEXTURE_INTERNAL_FORMAT, &m_format));
 	glAssert(glGetTextureLevelParameteriv(m_handle, 0, GL_TEXTURE_WIDTH,  &m_width));
 	glAssert(glGetTextureLevelParameteriv(m_handle, 0, GL_TEXTURE_HEIGHT, &m_height));
 	glAssert(glGetTextureLevelParameteriv(m_handle, 0, GL_TEXTURE_DEPTH, m_arrayCount > 1 ? &m_arrayCount : &m_depth));
-}
\ No newline at end of file
+	updateGpuSize();
+}
+
+/*******************************************************************************
+
+                              Texture::Download
+
+*******************************************************************************/
+
+// PUBLIC
+
+void Texture::Download::Destroy(Download*& _inst_)
+{
+	delete _inst_;
+	_inst_ = nullptr;
+}
+
+bool Texture::Download::isReady()
+{
+	if (!m_ready) {
+		GLenum status;
+		glAssert(status = glClientWaitSync(m_fence, 0, 0));
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+			complete();
+		}
+	}
+	return m_ready;
+}
+
+bool Texture::Download::wait()
+{
+	if (!m_ready) {
+		GLenum status;
+		glAssert(status = glClientWaitSync(m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, (GLuint64)1e9));
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+			APT_LOG_ERR("Texture::Download: Wait failed (%s)", internal::GlEnumStr(status));
+			return false;
+		}
+		complete();
+	}
+	return true;
+}
+
+Image* Texture::Download::releaseImage()
+{
+	if (!m_ready) {
+		return nullptr;
+	}
+	Image* ret = m_image;
+	m_image = nullptr;
+	return ret;
+}
+
+// PRIVATE
+
+Texture::Download::Download()
+	: m_buffer(0)
+	, m_bufferSize(0)
+	, m_fence(0)
+	, m_image(nullptr)
+	, m_mip(0)
+	, m_layer(0)
+	, m_ready(false)
+{
+}
+
+Texture::Download::~Download()
+{
+	if (m_fence) {
+		glAssert(glDeleteSync(m_fence));
+	}
+	if (m_buffer) {
+	 // readback may still be in flight, delete rather than recycle (GL keeps the storage alive until it completes)
+		ReadbackBuffer buffer = { m_buffer, m_bufferSize };
+		DeleteReadbackBuffer(buffer);
+	}
+	if (m_image) {
+		Image::Destroy(m_image);
+	}
+}
+
+void Texture::Download::complete()
+{
+	APT_ASSERT(!m_ready && m_fence);
+	glAssert(glDeleteSync(m_fence));
+	m_fence = 0;
+
+	const GLsizeiptr size = (GLsizeiptr)m_image->getRawImageSize(0);
+	const void* src;
+	glAssert(src = glMapNamedBufferRange(m_buffer, 0, size, GL_MAP_READ_BIT));
+	if (src) {
+		memcpy(m_image->getRawImage(0, 0), src, (size_t)size);
+		glAssert(glUnmapNamedBuffer(m_buffer));
+	} else {
+		APT_LOG_ERR("Texture::Download: Failed to map readback buffer (%lld bytes)", (long long)size);
+	}
+
+	ReadbackBuffer buffer = { m_buffer, m_bufferSize };
+	FreeReadbackBuffer(buffer);
+	m_buffer = 0;
+	m_ready = true;
+}
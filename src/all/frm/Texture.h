@@ -7,6 +7,8 @@
 #include <frm/math.h>
 #include <frm/Resource.h>
 
+#include <EASTL/vector.h>
+
 namespace frm {
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -16,8 +18,15 @@ namespace frm {
 class Texture: public Resource<Texture>
 {
 public:
+	class Download;
+
 	// Load from a file.
 	static Texture* Create(const char* _path);
+	// Load from a file. If _async, the file is decoded on a worker thread and uploaded incrementally by Update(),
+	// smallest mip first. The texture is a 1x1 placeholder until the first mip is uploaded and remains in 
+	// State_Compiling until all mips are uploaded (see getStreamingProgress()). If the file has no mip chain 
+	// (and isn't compressed), one is generated on the worker thread via MipGenerator.
+	static Texture* Create(const char* _path, bool _async);
 	static Texture* CreateCubemap2x3(const char* _path); // faces arranged in a 2x3 grid, +x,-x +y,-y, +z,-z
 	// Create an empty texture (the resource name is unique).
 	static Texture* Create1d(GLsizei _width, GLenum _format, GLint _mipCount = 1);
@@ -38,6 +47,58 @@ public:
 
 	static void ShowTextureViewer(bool* _open_);
 
+	// Decode _file into img_. .hdr files are decoded by ReadHdr() (in parallel), other formats via apt::Image::Read().
+	static bool ReadImage(apt::Image& img_, apt::File& _file);
+
+	// Get the internal format for _img and the format/type to pass to setData()/setSubData(). Return false if
+	// the image layout is unsupported.
+	static bool GetImageFormat(const apt::Image& _img, GLenum& format_, GLenum& srcFormat_, GLenum& srcType_);
+
+	// Init/shutdown resources for async loads and downloads. Data is staged in a persistent-mapped pixel unpack buffer of 
+	// _ringSizeBytes; at most _budgetBytes are uploaded per call to Update() (except that at least one mip
+	// is always uploaded). Init is called implicitly with the default values if required.
+	static void       InitStreaming(GLsizeiptr _ringSizeBytes = 32 * 1024 * 1024, GLsizeiptr _budgetBytes = 8 * 1024 * 1024);
+	static void       ShutdownStreaming();
+	static void       SetStreamingBudget(GLsizeiptr _budgetBytes);
+	static GLsizeiptr GetStreamingBudget();
+	// Return the number of async loads in progress.
+	static int        GetStreamingCount();
+
+	// Mip streaming: if the budget is non-zero, async loads with a mip chain initially upload only the mips 
+	// below kMipStreamingInitialSize; the texture then keeps its CPU image and Update() loads/evicts higher mips
+	// according to requestMip(), constrained by the budget. If the sum of the requested mips exceeds the budget,
+	// all requests are biased by the same number of mips until they fit. Textures which weren't requested 
+	// recently want mip 0, subject to the budget. Changing the resident mips reallocates the texture storage, hence
+	// the handle of a mip-streamed texture may change during Update().
+	static const GLsizei kMipStreamingInitialSize = 64;
+	static void       SetMipStreamingBudget(GLsizeiptr _budgetBytes);
+	static GLsizeiptr GetMipStreamingBudget();
+	// Return the total size of the resident mips of all mip-streamed textures.
+	static GLsizeiptr GetMipStreamingResidentBytes();
+	// Return the mip bias applied to all requests during the last call to Update().
+	static GLint      GetMipStreamingBias();
+
+	// Bindless textures (GL_ARB_bindless_texture), disabled by default. If enabled and supported by the implementation,
+	// getBindlessHandle() returns resident handles and shaders are compiled with Texture_BINDLESS defined (reload
+	// shaders after changing this). See TextureTable.
+	static void       SetBindless(bool _enable);
+	// Return true if bindless textures are enabled *and* supported.
+	static bool       GetBindless();
+
+	// If enabled, async loads are block compressed on the worker thread (after mip generation) in the format 
+	// chosen by TextureCompressor::ChooseFormat(). Disabled by default.
+	static void       SetCompressOnLoad(bool _enable);
+	static bool       GetCompressOnLoad();
+
+	// If enabled, async loads of 8-bit RGB/RGBA images are treated as sRGB encoded: mips are generated in linear
+	// space and the internal format is sRGB (e.g. GL_SRGB8_ALPHA8). Disabled by default, non-color data (e.g.
+	// normal maps) would be misinterpreted.
+	static void       SetSrgbOnLoad(bool _enable);
+	static bool       GetSrgbOnLoad();
+
+	// Service async loads, call once per frame.
+	static void Update();
+
 	bool load()   { return reload(); }
 	bool reload();
 
@@ -70,6 +131,13 @@ public:
 	// apt::Image::Destroy().
 	apt::Image* downloadImage();
 
+	// Async variant of downloadImage(): enqueue a readback of a single mip and array layer/cubemap face/3d slice
+	// into a pixel pack buffer and return immediately, the GPU isn't stalled. Poll Download::isReady() (e.g. once
+	// per frame), the result is typically available 1-3 frames later. For 3d textures pass _layer = -1 to download
+	// all slices of the mip. Return nullptr if the format or target is unsupported. The returned Download must be
+	// released via Download::Destroy().
+	Download*   downloadImageAsync(GLint _mip = 0, GLint _layer = 0);
+
 	// Filter mode.
 	void        setFilter(GLenum _mode);    // mipmap filter modes cannot be applied globally
 	void        setMinFilter(GLenum _mode);
@@ -105,6 +173,30 @@ public:
 	bool        isCompressed() const;
 	bool        isDepth() const;
 
+	// True if an async load or a mip upgrade is in progress.
+	bool        isStreaming() const;
+	// Fraction of the texture data which was uploaded, 1 if not streaming.
+	float       getStreamingProgress() const;
+
+	// Estimate the mip required to texture an object with bounding sphere _center,_radius as seen from _camera.
+	// _uvDensity is the number of uv units per world unit on the object's surface (e.g. 1/(quad size) for a 
+	// quad with uvs in [0,1]). The result is relative to the full resolution image (see getResidentMip()).
+	float       estimateMip(const Camera& _camera, float _viewportHeight, const vec3& _center, float _radius, float _uvDensity) const;
+	// Request that _mip is resident for mip-streamed textures (call each frame the texture is used, the 
+	// minimum of all requests during a frame is used). No effect for other textures.
+	void        requestMip(float _mip);
+	// Image mip which corresponds to level 0 of the texture storage, 0 unless mip-streamed.
+	GLint       getResidentMip() const;
+
+	// Return a resident bindless handle, created on the first call (0 if GetBindless() is false). Sampler state
+	// is immutable once the handle exists, hence set the filter/wrap modes first. The handle is made non-resident
+	// when the texture is destroyed (refcount reaches 0) or the GL object is replaced (reload(), mip streaming),
+	// in which case the next call returns a new handle.
+	GLuint64    getBindlessHandle();
+
+	// Estimated size of the texture storage in bytes (see GpuMemory), 0 for proxies.
+	GLsizeiptr  getGpuSize() const              { return m_gpuSize;    }
+
 	friend void swap(Texture& _a, Texture& _b);
 
 protected:
@@ -123,17 +215,23 @@ protected:
 	~Texture();
 
 private:
-	apt::String<32> m_path;  // Empty if not from a file.
+	struct Stream;
+	static eastl::vector<Stream*> s_streams;
 
-	GLuint  m_handle;
-	bool    m_ownsHandle;    // False if this is a proxy.
-	GLenum  m_target;        // GL_TEXTURE_2D, GL_TEXTURE_3D, etc.
-	GLint   m_format;        // Internal format (as used by the implementation, not necessarily the same as the requested format).
-	GLsizei m_width;
-	GLsizei m_height;        // Min is 1.
-	GLsizei m_depth;         //    "
-	GLint   m_arrayCount;    //    "
-	GLint   m_mipCount;      //    "
+	apt::String<32> m_path;  // Empty if not from a file.
+	Stream*         m_stream;  // Non-null while an async load is in progress, or for the lifetime of mip-streamed textures.
+
+	GLuint     m_handle;
+	GLuint64   m_bindlessHandle;  // 0 unless getBindlessHandle() was called.
+	bool       m_ownsHandle;      // False if this is a proxy.
+	GLenum     m_target;          // GL_TEXTURE_2D, GL_TEXTURE_3D, etc.
+	GLint      m_format;          // Internal format (as used by the implementation, not necessarily the same as the requested format).
+	GLsizei    m_width;
+	GLsizei    m_height;          // Min is 1.
+	GLsizei    m_depth;           //    "
+	GLint      m_arrayCount;      //    "
+	GLint      m_mipCount;        //    "
+	GLsizeiptr m_gpuSize;         // Size passed to GpuMemory::Alloc(), updated when the storage changes.
 
 	// Common code for Create* methods. 
 	static Texture* Create(
@@ -146,9 +244,43 @@ private:
 		GLenum  _format
 		);
 
+	// Radiance RGBE (.hdr), scanlines are decoded in parallel via ThreadPool. Implemented in Texture_hdr.cpp.
+	static bool ReadHdr(apt::Image& img_, const char* _srcData, uint _srcDataSize);
+
 	// Load data from a apt::Image.
 	bool loadImage(const apt::Image& _img);
 
+	// Set the metadata/format from _img, create a new handle and allocate storage. _srcFormat_/_srcType_ 
+	// receive the format/type to pass to uploadImage(). Storage is allocated for mips [_residentMip, n). If _srgb,
+	// the sRGB equivalent of the internal format is used (if any).
+	bool initImage(const apt::Image& _img, GLenum& _srcFormat_, GLenum& _srcType_, GLint _residentMip = 0, bool _srgb = false);
+
+	// Upload a single array layer/mip from _img. _src is either a ptr to the data or an offset into the 
+	// currently bound GL_PIXEL_UNPACK_BUFFER. _mip is relative to the resident mip of m_stream, if any.
+	void uploadImage(const apt::Image& _img, GLint _array, GLint _mip, GLenum _srcFormat, GLenum _srcType, const void* _src);
+
+	// Replace the texture with a 1x1 placeholder.
+	void initPlaceholder();
+
+	// Make m_bindlessHandle non-resident, call before deleting m_handle.
+	void releaseBindlessHandle();
+
+	// Recompute m_gpuSize from the format/dimensions, update GpuMemory.
+	void updateGpuSize();
+
+	// Start an async load from m_path.
+	void beginStream();
+
+	// Upload as many layers/mips of m_stream as the ring/budget allow. Return true if the stream is complete.
+	bool updateStream();
+
+	// Reallocate storage for mips [_mip, n) of m_stream, copy the mips common to the old and new storage and 
+	// begin uploading any missing mips.
+	void setResidentMip(GLint _mip);
+
+	// Choose the resident mip for all mip-streamed textures (called by Update()).
+	static void UpdateMipResidency();
+
 	// Update the format and dimensions of the texture via glGetTexLevelParameteriv.
 	// Assumes that the texture is bound to m_target.
 	void updateParams();
@@ -156,6 +288,53 @@ private:
 }; // class Texture
 
 
+////////////////////////////////////////////////////////////////////////////////
+// Texture::Download
+// Future-like handle for an async readback (see Texture::downloadImageAsync()).
+// The readback completes when its fence is signaled; the data is then copied
+// from the pixel pack buffer to the image. Pixel pack buffers are recycled, 
+// hence continuous captures (e.g. one download per frame) don't allocate once 
+// the pool is warm.
+////////////////////////////////////////////////////////////////////////////////
+class Texture::Download
+{
+public:
+	// May be called before the download completes.
+	static void Destroy(Download*& _inst_);
+
+	// Poll the fence (non-blocking), return true if the result is available.
+	bool        isReady();
+	// Block until the result is available. Return false if the wait timed out.
+	bool        wait();
+
+	// Return the result (nullptr if not ready). The image is owned by the download unless released via releaseImage().
+	apt::Image* getImage()        { return m_ready ? m_image : nullptr; }
+	// Transfer ownership of the result to the caller, release via apt::Image::Destroy().
+	apt::Image* releaseImage();
+
+	GLint       getMip() const    { return m_mip;   }
+	GLint       getLayer() const  { return m_layer; }
+
+private:
+	GLuint      m_buffer;
+	GLsizeiptr  m_bufferSize;
+	GLsync      m_fence;
+	apt::Image* m_image;
+	GLint       m_mip;
+	GLint       m_layer;
+	bool        m_ready;
+
+	Download();
+	~Download();
+
+	// Copy the buffer data to m_image, recycle the buffer.
+	void complete();
+
+	friend class Texture;
+
+}; // class Texture::Download
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // TextureView
 // Represents a subregion (offset, size) of a texture mip or array layer, plus
@@ -0,0 +1,200 @@
+#include <frm/TextureArrayPool.h>
+
+#include <frm/GpuMemory.h>
+#include <frm/Texture.h>
+
+#include <apt/log.h>
+#include <apt/Image.h>
+
+#include <EASTL/algorithm.h>
+
+using namespace frm;
+using namespace apt;
+
+// PUBLIC
+
+TextureArrayPool::TextureArrayPool(GLsizei _layersPerArray)
+	: m_layerCount(0)
+{
+	GLint maxLayers = 256;
+	glAssert(glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers));
+	m_layersPerArray = APT_MAX(APT_MIN(_layersPerArray, (GLsizei)maxLayers), (GLsizei)1);
+}
+
+TextureArrayPool::~TextureArrayPool()
+{
+	APT_ASSERT(m_layerCount == 0); // layers weren't freed
+	for (auto& arr : m_arrays) {
+		Texture::Release(arr->m_texture);
+		delete arr;
+	}
+}
+
+TextureArrayPool::Handle TextureArrayPool::alloc(GLsizei _width, GLsizei _height, GLenum _format, GLint _mipCount)
+{
+	Handle ret = { nullptr, 0 };
+	_mipCount = APT_MIN(_mipCount, Texture::GetMaxMipCount(_width, _height)); // as Texture::Create2dArray()
+
+ // find an array with a free layer, else grow an array or create a new one
+	Array* arr = nullptr;
+	Array* growArr = nullptr;
+	for (auto& it : m_arrays) {
+		const Texture& tx = *it->m_texture;
+		if (tx.getWidth() != _width || tx.getHeight() != _height || tx.getMipCount() != _mipCount || it->m_format != _format) {
+			continue;
+		}
+		if (!it->m_freeLayers.empty()) {
+			arr = it;
+			break;
+		}
+		if (!growArr && tx.getArrayCount() < m_layersPerArray) {
+			growArr = it;
+		}
+	}
+	if (!arr && growArr && grow(growArr)) {
+		arr = growArr;
+	}
+	if (!arr) {
+		GLsizei layers = APT_MIN(kInitialLayers, m_layersPerArray);
+		Texture* tx = createArray(_width, _height, layers, _format, _mipCount);
+		if (!tx) {
+			return ret;
+		}
+		arr = new Array;
+		arr->m_texture = tx;
+		arr->m_format  = _format;
+		arr->m_freeLayers.reserve(layers);
+		for (GLint i = layers - 1; i >= 0; --i) {
+			arr->m_freeLayers.push_back(i);
+		}
+		m_arrays.push_back(arr);
+	}
+
+	ret.m_texture = arr->m_texture;
+	ret.m_layer   = arr->m_freeLayers.back();
+	arr->m_freeLayers.pop_back();
+	++m_layerCount;
+	return ret;
+}
+
+TextureArrayPool::Handle TextureArrayPool::alloc(const Image& _img)
+{
+	Handle ret = { nullptr, 0 };
+	if (_img.getType() != Image::Type_2d) {
+		APT_LOG_ERR("TextureArrayPool: Only 2d images are supported");
+		return ret;
+	}
+	GLenum format, srcFormat, srcType;
+	if (!Texture::GetImageFormat(_img, format, srcFormat, srcType)) {
+		return ret;
+	}
+	ret = alloc((GLsizei)_img.getWidth(), (GLsizei)_img.getHeight(), format, (GLint)_img.getMipmapCount());
+	if (!ret.isValid()) {
+		return ret;
+	}
+
+	GLint unpackAlignment;
+	glAssert(glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment));
+	glAssert(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+	for (GLint mip = 0; mip < (GLint)_img.getMipmapCount(); ++mip) {
+		if (_img.isCompressed()) { // \hack, see Texture.h
+			srcType = (GLenum)_img.getRawImageSize(mip);
+		}
+		upload(ret, _img.getRawImage(0, mip), srcFormat, srcType, mip);
+	}
+	glAssert(glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment));
+
+	return ret;
+}
+
+void TextureArrayPool::free(Handle& _handle_)
+{
+	APT_ASSERT(_handle_.isValid());
+	Array* arr = findArray(_handle_.m_texture);
+	APT_ASSERT(arr); // handle wasn't allocated from this pool
+	if (!arr) {
+		return;
+	}
+	APT_ASSERT(eastl::find(arr->m_freeLayers.begin(), arr->m_freeLayers.end(), _handle_.m_layer) == arr->m_freeLayers.end()); // double free
+	arr->m_freeLayers.push_back(_handle_.m_layer);
+	--m_layerCount;
+	_handle_.m_texture = nullptr;
+
+	if ((GLsizei)arr->m_freeLayers.size() == arr->m_texture->getArrayCount()) {
+		Texture::Release(arr->m_texture);
+		m_arrays.erase(eastl::find(m_arrays.begin(), m_arrays.end(), arr));
+		delete arr;
+	}
+}
+
+void TextureArrayPool::upload(const Handle& _handle, const void* _data, GLenum _dataFormat, GLenum _dataType, GLint _mip)
+{
+	APT_ASSERT(_handle.isValid());
+	Texture& tx = *_handle.m_texture;
+	APT_ASSERT(_mip < tx.getMipCount());
+	GLsizei w = APT_MAX(tx.getWidth()  >> _mip, 1);
+	GLsizei h = APT_MAX(tx.getHeight() >> _mip, 1);
+	tx.setSubData(0, 0, _handle.m_layer, w, h, 1, _data, _dataFormat, _dataType, _mip);
+}
+
+// PRIVATE
+
+TextureArrayPool::Array* TextureArrayPool::findArray(const Texture* _texture)
+{
+	for (auto& arr : m_arrays) {
+		if (arr->m_texture == _texture) {
+			return arr;
+		}
+	}
+	return nullptr;
+}
+
+Texture* TextureArrayPool::createArray(GLsizei _width, GLsizei _height, GLsizei _layers, GLenum _format, GLint _mipCount)
+{
+	Texture* ret = Texture::Create2dArray(_width, _height, _layers, _format, _mipCount);
+	if (!ret || ret->getState() == Texture::State_Error) {
+		APT_LOG_ERR("TextureArrayPool: Failed to create %dx%dx%d array", _width, _height, _layers);
+		if (ret) {
+			Texture::Release(ret);
+		}
+		return nullptr;
+	}
+	APT_LOG("TextureArrayPool: Created %dx%dx%d array, %.2fMb (GpuMemory total %.2fMb)",
+		_width, _height, _layers,
+		(double)ret->getGpuSize() / (1024.0 * 1024.0),
+		(double)GpuMemory::GetStats().m_totalBytes / (1024.0 * 1024.0)
+		);
+	return ret;
+}
+
+bool TextureArrayPool::grow(Array* _arr_)
+{
+	Texture& tx = *_arr_->m_texture;
+	GLsizei oldLayers = tx.getArrayCount();
+	GLsizei newLayers = APT_MIN(oldLayers * 2, m_layersPerArray);
+	APT_ASSERT(newLayers > oldLayers);
+	Texture* newTx = createArray(tx.getWidth(), tx.getHeight(), newLayers, _arr_->m_format, tx.getMipCount());
+	if (!newTx) {
+		return false;
+	}
+	for (GLint mip = 0; mip < tx.getMipCount(); ++mip) {
+		GLsizei w = APT_MAX(tx.getWidth()  >> mip, 1);
+		GLsizei h = APT_MAX(tx.getHeight() >> mip, 1);
+		glAssert(glCopyImageSubData(tx.getHandle(), GL_TEXTURE_2D_ARRAY, mip, 0, 0, 0, newTx->getHandle(), GL_TEXTURE_2D_ARRAY, mip, 0, 0, 0, w, h, oldLayers));
+	}
+	newTx->setMinFilter(tx.getMinFilter());
+	newTx->setMagFilter(tx.getMagFilter());
+	newTx->setWrapU(tx.getWrapU());
+	newTx->setWrapV(tx.getWrapV());
+	newTx->setWrapW(tx.getWrapW());
+	newTx->setAnisotropy(tx.getAnisotropy());
+
+ // swap the storage so that existing handles remain valid, then release the old storage
+	swap(tx, *newTx);
+	Texture::Release(newTx);
+
+	for (GLint i = newLayers - 1; i >= oldLayers; --i) {
+		_arr_->m_freeLayers.push_back(i);
+	}
+	return true;
+}
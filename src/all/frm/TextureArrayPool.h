@@ -0,0 +1,83 @@
+#pragma once
+#ifndef frm_TextureArrayPool_h
+#define frm_TextureArrayPool_h
+
+#include <frm/def.h>
+#include <frm/gl.h>
+
+#include <EASTL/vector.h>
+
+namespace frm {
+
+////////////////////////////////////////////////////////////////////////////////
+// TextureArrayPool
+// Allocate 2d textures as layers of shared GL_TEXTURE_2D_ARRAY objects.
+// Textures with the same format, size and mip count share an array, hence
+// draws which differ only by texture can be batched into a single instanced or
+// multi-draw call: bind the array once as a sampler2DArray and pass the layer
+// index per instance/draw (e.g. texture(txArray, vec3(uv, layer))).
+// - Arrays are created with kInitialLayers layers and double in size (up to
+//   the layers per array) when full, copying the existing layers; when all
+//   arrays for a format/size are at the max size a new array is created.
+//   Arrays are released when their last layer is freed.
+// - Handles remain valid until freed (the layer index and Texture* don't
+//   change), however the GL handle of an array changes when it grows.
+////////////////////////////////////////////////////////////////////////////////
+class TextureArrayPool
+{
+public:
+	struct Handle
+	{
+		Texture* m_texture;  // GL_TEXTURE_2D_ARRAY, nullptr if the handle is invalid.
+		GLint    m_layer;
+
+		bool isValid() const { return m_texture != nullptr; }
+	};
+
+	static const GLsizei kInitialLayers = 4;
+
+	// _layersPerArray is the max layers per array, clamped to GL_MAX_ARRAY_TEXTURE_LAYERS.
+	TextureArrayPool(GLsizei _layersPerArray = 64);
+	~TextureArrayPool();
+
+	// Alloc an uninitialized layer. Return an invalid handle if the array couldn't be created.
+	Handle alloc(GLsizei _width, GLsizei _height, GLenum _format, GLint _mipCount = 1);
+	// Alloc a layer matching _img (2d only, e.g. as returned by TextureCache::Load()) and upload all mips.
+	Handle alloc(const apt::Image& _img);
+
+	// Free a previously allocated layer, _handle_ is invalidated.
+	void   free(Handle& _handle_);
+
+	// Upload data to a previously allocated layer.
+	void   upload(const Handle& _handle, const void* _data, GLenum _dataFormat, GLenum _dataType, GLint _mip = 0);
+
+	GLsizei  getLayersPerArray() const  { return m_layersPerArray; }
+	int      getArrayCount() const      { return (int)m_arrays.size(); }
+	Texture* getArray(int _i) const     { return m_arrays[_i]->m_texture; }
+	// Number of allocated layers in all arrays.
+	int      getLayerCount() const      { return m_layerCount; }
+
+private:
+	struct Array
+	{
+		Texture*             m_texture;
+		GLenum               m_format;      // As requested (the texture reports the actual internal format).
+		eastl::vector<GLint> m_freeLayers;  // Stack, the most recently freed layer is reused first.
+	};
+
+	GLsizei               m_layersPerArray;
+	int                   m_layerCount;
+	eastl::vector<Array*> m_arrays;
+
+	Array* findArray(const Texture* _texture);
+
+	// Create a new array texture, log the size. Return nullptr on failure.
+	Texture* createArray(GLsizei _width, GLsizei _height, GLsizei _layers, GLenum _format, GLint _mipCount);
+	// Double the number of layers in _arr_ (up to m_layersPerArray), preserving existing layers. Return false on failure.
+	bool grow(Array* _arr_);
+
+}; // class TextureArrayPool
+
+} // namespace frm
+
+#endif // frm_TextureArrayPool_h
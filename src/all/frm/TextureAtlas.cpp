@@ -4,9 +4,13 @@
 
 #include <apt/Image.h>
 
+#include <EASTL/algorithm.h>
+#include <EASTL/sort.h>
+
+#include <climits>
+
 #ifdef frm_TextureAtlas_DEBUG
 	#include <imgui/imgui.h>
-	static eastl::vector<frm::TextureAtlas::Region*> s_dbgRegionList;
 #endif
 
 using namespace frm;
@@ -14,41 +18,622 @@ using namespace apt;
 
 /*******************************************************************************
 
-                                 TextureAtlas
+                                  Packers
 
 *******************************************************************************/
 
-struct TextureAtlas::Node
+// All packers operate on cells (m_cellSize texels).
+struct TextureAtlas::Packer
 {
-	Node* m_parent;
-	Node* m_children[4];
-
-	bool m_isEmpty;
 	uint16 m_sizeX, m_sizeY;
-	uint16 m_startX, m_startY;
 
-	Node(Node* _parent)
-		: m_parent(_parent)
-		, m_isEmpty(true)
+	Packer(uint16 _sizeX, uint16 _sizeY)
+		: m_sizeX(_sizeX)
+		, m_sizeY(_sizeY)
+	{
+	}
+
+	virtual ~Packer() {}
+
+	// Find space for a _sizeX_ * _sizeY_ rectangle, which may be increased by the packer. The start must be a
+	// multiple of _align (power of 2). Return false if there isn't enough space.
+	virtual bool alloc(uint16& _sizeX_, uint16& _sizeY_, uint16 _align, uint16& startX_, uint16& startY_) = 0;
+
+	// Free a rectangle previously returned by alloc().
+	virtual void free(uint16 _startX, uint16 _startY, uint16 _sizeX, uint16 _sizeY) = 0;
+};
+
+namespace {
+
+struct Rect
+{
+	int m_x, m_y, m_w, m_h;
+
+	bool contains(const Rect& _r) const
+	{
+		return _r.m_x >= m_x && _r.m_y >= m_y && _r.m_x + _r.m_w <= m_x + m_w && _r.m_y + _r.m_h <= m_y + m_h;
+	}
+	bool intersects(const Rect& _r) const
+	{
+		return _r.m_x < m_x + m_w && _r.m_x + _r.m_w > m_x && _r.m_y < m_y + m_h && _r.m_y + _r.m_h > m_y;
+	}
+};
+
+int AlignUp(int _x, int _align)
+{
+	return (_x + _align - 1) & ~(_align - 1);
+}
+
+// Push _r to _rects_, first merging it with any rectangles which share a complete edge (the merged
+// rectangles are removed).
+void MergeRect(eastl::vector<Rect>& _rects_, Rect _r)
+{
+	for (int i = 0; i < (int)_rects_.size(); ) {
+		const Rect& b = _rects_[i];
+		if (_r.m_x == b.m_x && _r.m_w == b.m_w && (_r.m_y + _r.m_h == b.m_y || b.m_y + b.m_h == _r.m_y)) {
+			_r.m_y = APT_MIN(_r.m_y, b.m_y);
+			_r.m_h += b.m_h;
+		} else if (_r.m_y == b.m_y && _r.m_h == b.m_h && (_r.m_x + _r.m_w == b.m_x || b.m_x + b.m_w == _r.m_x)) {
+			_r.m_x = APT_MIN(_r.m_x, b.m_x);
+			_r.m_w += b.m_w;
+		} else {
+			++i;
+			continue;
+		}
+		_rects_[i] = _rects_.back();
+		_rects_.pop_back();
+		i = 0; // _r grew, rectangles already visited may now share an edge
+	}
+	_rects_.push_back(_r);
+}
+
+// Remove rectangles which are contained by another rectangle. Only rectangles at index >= _first are
+// tested (the rectangles before _first must not contain each other), hence this is O(n * new).
+void PruneRects(eastl::vector<Rect>& _rects_, int _first)
+{
+	const int n = (int)_rects_.size();
+	for (int i = _first; i < n; ++i) {
+		if (_rects_[i].m_w == 0) {
+			continue;
+		}
+		for (int j = 0; j < n; ++j) {
+			if (j == i || _rects_[j].m_w == 0) {
+				continue;
+			}
+			if (_rects_[j].contains(_rects_[i])) {
+				_rects_[i].m_w = 0;
+				break;
+			}
+			if (_rects_[i].contains(_rects_[j])) {
+				_rects_[j].m_w = 0;
+			}
+		}
+	}
+	_rects_.erase(eastl::remove_if(_rects_.begin(), _rects_.end(), [](const Rect& _r) { return _r.m_w == 0; }), _rects_.end());
+}
+
+// Push _r to the maximal free rectangles _rects_, plus the unions of _r with the rectangles it overlaps or
+// touches (and so on for each new rectangle). Rectangles contained by an existing rectangle are skipped,
+// call PruneRects() to remove those which became contained.
+void MergeMaxRect(eastl::vector<Rect>& _rects_, Rect _r)
+{
+	auto push = [&_rects_](const Rect& _r) {
+		for (const Rect& r : _rects_) {
+			if (r.contains(_r)) {
+				return;
+			}
+		}
+		_rects_.push_back(_r);
+	};
+	int first = (int)_rects_.size();
+	push(_r);
+	for (int i = first; i < (int)_rects_.size(); ++i) { // only new rectangles, existing pairs were already merged
+		for (int j = 0; j < (int)_rects_.size(); ++j) {
+			const Rect a = _rects_[i]; // copy, push() may reallocate
+			const Rect b = _rects_[j];
+			if (i == j) {
+				continue;
+			}
+		 // a and b overlap/touch along x, the union spans both over their y intersection (skip if either x range
+		 // contains the other, the union would be contained by a or b)
+			int y0 = APT_MAX(a.m_y, b.m_y);
+			int y1 = APT_MIN(a.m_y + a.m_h, b.m_y + b.m_h);
+			if (y1 > y0 && a.m_x <= b.m_x + b.m_w && b.m_x <= a.m_x + a.m_w && (a.m_x < b.m_x) != (a.m_x + a.m_w < b.m_x + b.m_w)) {
+				int x0 = APT_MIN(a.m_x, b.m_x);
+				Rect u = { x0, y0, APT_MAX(a.m_x + a.m_w, b.m_x + b.m_w) - x0, y1 - y0 };
+				push(u);
+			}
+		 // as above, along y
+			int x0 = APT_MAX(a.m_x, b.m_x);
+			int x1 = APT_MIN(a.m_x + a.m_w, b.m_x + b.m_w);
+			if (x1 > x0 && a.m_y <= b.m_y + b.m_h && b.m_y <= a.m_y + a.m_h && (a.m_y < b.m_y) != (a.m_y + a.m_h < b.m_y + b.m_h)) {
+				int y0 = APT_MIN(a.m_y, b.m_y);
+				Rect u = { x0, y0, x1 - x0, APT_MAX(a.m_y + a.m_h, b.m_y + b.m_h) - y0 };
+				push(u);
+			}
+		}
+	}
+}
+
+// Return the index of the smallest rectangle in _rects which fits _w * _h at a multiple of _align, or -1.
+int FindBestAreaFit(const eastl::vector<Rect>& _rects, int _w, int _h, int _align)
+{
+	int ret = -1;
+	int bestArea = INT_MAX;
+	for (int i = 0; i < (int)_rects.size(); ++i) {
+		const Rect& r = _rects[i];
+		int x = AlignUp(r.m_x, _align);
+		int y = AlignUp(r.m_y, _align);
+		if (x + _w <= r.m_x + r.m_w && y + _h <= r.m_y + r.m_h && r.m_w * r.m_h < bestArea) {
+			bestArea = r.m_w * r.m_h;
+			ret = i;
+		}
+	}
+	return ret;
+}
+
+} // namespace
+
+/*	Quadtree
+	Each node is split into 4 equal children until the next split would be too small.
+*/
+struct TextureAtlas::QuadtreePacker: public TextureAtlas::Packer
+{
+	struct Node
+	{
+		Node*  m_children[4];
+		bool   m_isEmpty;
+		uint16 m_sizeX, m_sizeY;
+		uint16 m_startX, m_startY;
+
+		bool isLeaf() const  { return m_children[0] == nullptr; }
+		bool isEmpty() const { return m_isEmpty; }
+	};
+
+	Pool<Node> m_nodePool;
+	Node*      m_root;
+
+	QuadtreePacker(uint16 _sizeX, uint16 _sizeY)
+		: Packer(_sizeX, _sizeY)
+		, m_nodePool(128)
+	{
+		m_root = newNode(0, 0, _sizeX, _sizeY);
+	}
+
+	~QuadtreePacker()
+	{
+		deleteNode(m_root);
+	}
+
+	bool alloc(uint16& _sizeX_, uint16& _sizeY_, uint16 _align, uint16& startX_, uint16& startY_) override
+	{
+		Node* node = insert(m_root, _sizeX_, _sizeY_, _align);
+		if (!node) {
+			return false;
+		}
+		_sizeX_ = node->m_sizeX;
+		_sizeY_ = node->m_sizeY;
+		startX_ = node->m_startX;
+		startY_ = node->m_startY;
+		return true;
+	}
+
+	void free(uint16 _startX, uint16 _startY, uint16 _sizeX, uint16 _sizeY) override
+	{
+		remove(m_root, _startX, _startY);
+	}
+
+	Node* newNode(uint16 _startX, uint16 _startY, uint16 _sizeX, uint16 _sizeY)
+	{
+		Node* ret = m_nodePool.alloc();
+		memset(ret->m_children, 0, sizeof(ret->m_children));
+		ret->m_isEmpty = true;
+		ret->m_startX  = _startX;
+		ret->m_startY  = _startY;
+		ret->m_sizeX   = _sizeX;
+		ret->m_sizeY   = _sizeY;
+		return ret;
+	}
+
+	void deleteNode(Node* _node)
+	{
+		if (!_node->isLeaf()) {
+			for (int i = 0; i < 4; ++i) {
+				deleteNode(_node->m_children[i]);
+			}
+		}
+		m_nodePool.free(_node);
+	}
+
+	Node* insert(Node* _root, uint16 _sizeX, uint16 _sizeY, uint16 _align)
+	{
+		if (!_root->isEmpty()) {
+			return nullptr;
+		}
+
+		if (_root->isLeaf()) {
+		 // node is too small or unaligned (only if the atlas size isn't a power of 2)
+			if (_root->m_sizeX < _sizeX || _root->m_sizeY < _sizeY || _root->m_startX % _align != 0 || _root->m_startY % _align != 0) {
+				return nullptr;
+			}
+		 // node is best fit
+			uint16 nextSizeX = _root->m_sizeX / 2;
+			uint16 nextSizeY = _root->m_sizeY / 2;
+			if (nextSizeX < _sizeX || nextSizeY < _sizeY) {
+				_root->m_isEmpty = false;
+				return _root;
+			}
+
+		 // subdivide the node
+		 // +---+---+
+		 // | 0 | 1 |
+		 // +---+---+
+		 // | 3 | 2 |
+		 // +---+---+
+			_root->m_children[0] = newNode(_root->m_startX,             _root->m_startY,             nextSizeX, nextSizeY);
+			_root->m_children[1] = newNode(_root->m_startX + nextSizeX, _root->m_startY,             nextSizeX, nextSizeY);
+			_root->m_children[2] = newNode(_root->m_startX + nextSizeX, _root->m_startY + nextSizeY, nextSizeX, nextSizeY);
+			_root->m_children[3] = newNode(_root->m_startX,             _root->m_startY + nextSizeY, nextSizeX, nextSizeY);
+			return insert(_root->m_children[0], _sizeX, _sizeY, _align);
+		}
+
+		for (int i = 0; i < 4; ++i) {
+			Node* ret = insert(_root->m_children[i], _sizeX, _sizeY, _align);
+			if (ret) {
+				return ret;
+			}
+		}
+		return nullptr;
+	}
+
+	// Free the leaf at _startX,_startY. Return true if _root became an empty leaf.
+	bool remove(Node* _root, uint16 _startX, uint16 _startY)
+	{
+		if (_root->isLeaf()) {
+			APT_ASSERT(!_root->isEmpty() && _root->m_startX == _startX && _root->m_startY == _startY);
+			_root->m_isEmpty = true;
+			return true;
+		}
+		int i = (_startX >= _root->m_children[2]->m_startX ? 1 : 0) + (_startY >= _root->m_children[2]->m_startY ? 2 : 0);
+		static const int kQuadrantToChild[4] = { 0, 1, 3, 2 };
+		if (!remove(_root->m_children[kQuadrantToChild[i]], _startX, _startY)) {
+			return false;
+		}
+	 // collapse the node if all children are empty leaves
+		for (int j = 0; j < 4; ++j) {
+			if (!_root->m_children[j]->isLeaf() || !_root->m_children[j]->isEmpty()) {
+				return false;
+			}
+		}
+		for (int j = 0; j < 4; ++j) {
+			m_nodePool.free(_root->m_children[j]);
+			_root->m_children[j] = nullptr;
+		}
+		return true;
+	}
+};
+
+/*	Skyline
+	Bottom-left: place each rectangle at the position which minimizes the top edge. Space below the skyline
+	is lost, except for freed rectangles and alignment gaps which are kept in a list and reused first (best
+	area fit).
+*/
+struct TextureAtlas::SkylinePacker: public TextureAtlas::Packer
+{
+	struct Segment { int m_x, m_y, m_w; };
+
+	eastl::vector<Segment> m_skyline;
+	eastl::vector<Rect>    m_freeList;
+
+	SkylinePacker(uint16 _sizeX, uint16 _sizeY)
+		: Packer(_sizeX, _sizeY)
+	{
+		Segment s = { 0, 0, _sizeX };
+		m_skyline.push_back(s);
+	}
+
+	bool alloc(uint16& _sizeX_, uint16& _sizeY_, uint16 _align, uint16& startX_, uint16& startY_) override
+	{
+		const int w = _sizeX_;
+		const int h = _sizeY_;
+
+	 // freed rectangles, split the remainder along the longer leftover axis
+		int i = FindBestAreaFit(m_freeList, w, h, _align);
+		if (i != -1) {
+			Rect r = m_freeList[i];
+			m_freeList.erase(m_freeList.begin() + i);
+		 // alignment gaps
+			int x = AlignUp(r.m_x, _align);
+			int y = AlignUp(r.m_y, _align);
+			if (x > r.m_x) {
+				Rect left = { r.m_x, r.m_y, x - r.m_x, r.m_h };
+				m_freeList.push_back(left);
+				r.m_w -= x - r.m_x;
+				r.m_x  = x;
+			}
+			if (y > r.m_y) {
+				Rect top = { r.m_x, r.m_y, r.m_w, y - r.m_y };
+				m_freeList.push_back(top);
+				r.m_h -= y - r.m_y;
+				r.m_y  = y;
+			}
+			startX_ = (uint16)r.m_x;
+			startY_ = (uint16)r.m_y;
+			Rect right  = { r.m_x + w, r.m_y, r.m_w - w, h };
+			Rect bottom = { r.m_x, r.m_y + h, r.m_w, r.m_h - h };
+			if (r.m_w - w > r.m_h - h) {
+				right.m_h  = r.m_h;
+				bottom.m_w = w;
+			}
+			if (right.m_w > 0 && right.m_h > 0) {
+				m_freeList.push_back(right);
+			}
+			if (bottom.m_w > 0 && bottom.m_h > 0) {
+				m_freeList.push_back(bottom);
+			}
+			return true;
+		}
+
+	 // skyline
+		int bestIndex = -1;
+		int bestTop   = INT_MAX;
+		int bestWidth = INT_MAX;
+		int bestX     = 0;
+		int bestY     = 0;
+		int bestFloor = 0;
+		for (i = 0; i < (int)m_skyline.size(); ++i) {
+			const Segment& s = m_skyline[i];
+			int x = AlignUp(s.m_x, _align);
+			if (x >= s.m_x + s.m_w) {
+				continue; // x is in a later segment
+			}
+			int floor = fit(i, x, w);
+			int y = AlignUp(floor, _align);
+			if (floor < 0 || y + h > m_sizeY) {
+				continue;
+			}
+			if (y + h < bestTop || (y + h == bestTop && s.m_w < bestWidth)) {
+				bestIndex = i;
+				bestTop   = y + h;
+				bestWidth = s.m_w;
+				bestX     = x;
+				bestY     = y;
+				bestFloor = floor;
+			}
+		}
+		if (bestIndex == -1) {
+			return false;
+		}
+		startX_ = (uint16)bestX;
+		startY_ = (uint16)bestY;
+		if (bestY > bestFloor) {
+			Rect gap = { bestX, bestFloor, w, bestY - bestFloor };
+			m_freeList.push_back(gap);
+		}
+		insert(bestX, w, bestY + h);
+		return true;
+	}
+
+	void free(uint16 _startX, uint16 _startY, uint16 _sizeX, uint16 _sizeY) override
+	{
+		Rect r = { _startX, _startY, _sizeX, _sizeY };
+		MergeRect(m_freeList, r);
+	}
+
+	// Return the max height of the skyline over [_x, _x + _w), where _x is within segment _i, or -1 if the
+	// range exceeds the atlas.
+	int fit(int _i, int _x, int _w) const
 	{
-		m_children[0] = 0;
-		m_children[1] = 0;
-		m_children[2] = 0;
-		m_children[3] = 0;
+		if (_x + _w > m_sizeX) {
+			return -1;
+		}
+		int y = 0;
+		for (int remaining = _x + _w - m_skyline[_i].m_x; remaining > 0; ++_i) {
+			y = APT_MAX(y, m_skyline[_i].m_y);
+			remaining -= m_skyline[_i].m_w;
+		}
+		return y;
 	}
 
-	bool isLeaf() const  { return m_children[0] == 0; }
-	bool isEmpty() const { return m_isEmpty; }
+	// Insert a new segment [_x, _x + _w) of height _y, shrink/remove the segments it covers.
+	void insert(int _x, int _w, int _y)
+	{
+		eastl::vector<Segment> skyline;
+		skyline.reserve(m_skyline.size() + 2);
+		bool inserted = false;
+		for (const Segment& s : m_skyline) {
+			const int end = s.m_x + s.m_w;
+			if (s.m_x < _x) {
+				Segment left = { s.m_x, s.m_y, APT_MIN(end, _x) - s.m_x };
+				skyline.push_back(left);
+			}
+			if (!inserted && end > _x) {
+				Segment ins = { _x, _y, _w };
+				skyline.push_back(ins);
+				inserted = true;
+			}
+			if (end > _x + _w) {
+				int x = APT_MAX(s.m_x, _x + _w);
+				Segment right = { x, s.m_y, end - x };
+				skyline.push_back(right);
+			}
+		}
+		APT_ASSERT(inserted);
+		m_skyline.swap(skyline);
+		for (int j = 0; j < (int)m_skyline.size() - 1; ) {
+			if (m_skyline[j].m_y == m_skyline[j + 1].m_y) {
+				m_skyline[j].m_w += m_skyline[j + 1].m_w;
+				m_skyline.erase(m_skyline.begin() + j + 1);
+			} else {
+				++j;
+			}
+		}
+	}
 };
 
+/*	MaxRects
+	Maintain the list of maximal free rectangles (which may overlap). Place each rectangle in the free
+	rectangle which minimizes the shorter leftover side, then split all free rectangles which intersect it.
+	Freed rectangles are grown into the free rectangles they overlap or touch (see MergeMaxRect()). This may
+	miss some maximal rectangles, hence if an allocation fails after a free the list is rebuilt from the used
+	rectangles and the allocation retried, such that the free space doesn't fragment with alloc/free churn.
+*/
+struct TextureAtlas::MaxRectsPacker: public TextureAtlas::Packer
+{
+	eastl::vector<Rect> m_freeRects;
+	eastl::vector<Rect> m_usedRects;
+	bool                m_dirty;      // free() was called since the last rebuild().
+
+	MaxRectsPacker(uint16 _sizeX, uint16 _sizeY)
+		: Packer(_sizeX, _sizeY)
+		, m_dirty(false)
+	{
+		Rect r = { 0, 0, _sizeX, _sizeY };
+		m_freeRects.push_back(r);
+	}
+
+	bool alloc(uint16& _sizeX_, uint16& _sizeY_, uint16 _align, uint16& startX_, uint16& startY_) override
+	{
+		Rect placed = { 0, 0, _sizeX_, _sizeY_ };
+		if (!find(placed, _align)) {
+			if (!m_dirty) {
+				return false;
+			}
+		 // the merged free rectangles may miss some of the free space, rebuild and retry
+			rebuild();
+			if (!find(placed, _align)) {
+				return false;
+			}
+		}
+		startX_ = (uint16)placed.m_x;
+		startY_ = (uint16)placed.m_y;
+		place(placed);
+		m_usedRects.push_back(placed);
+		return true;
+	}
+
+	void free(uint16 _startX, uint16 _startY, uint16 _sizeX, uint16 _sizeY) override
+	{
+		for (int i = 0; i < (int)m_usedRects.size(); ++i) {
+			if (m_usedRects[i].m_x == _startX && m_usedRects[i].m_y == _startY) {
+				m_usedRects[i] = m_usedRects.back();
+				m_usedRects.pop_back();
+				break;
+			}
+		}
+		Rect r = { _startX, _startY, _sizeX, _sizeY };
+		int first = (int)m_freeRects.size();
+		MergeMaxRect(m_freeRects, r);
+		PruneRects(m_freeRects, first);
+		m_dirty = true;
+	}
+
+	// Set the position of _rect_ (best short side fit, aligned to _align). Return false if it doesn't fit.
+	bool find(Rect& _rect_, int _align) const
+	{
+		const int w = _rect_.m_w;
+		const int h = _rect_.m_h;
+		int bestShort = INT_MAX;
+		int bestLong  = INT_MAX;
+		for (const Rect& r : m_freeRects) {
+			int x = AlignUp(r.m_x, _align);
+			int y = AlignUp(r.m_y, _align);
+			int dx = r.m_x + r.m_w - x - w;
+			int dy = r.m_y + r.m_h - y - h;
+			if (dx < 0 || dy < 0) {
+				continue;
+			}
+			int shortSide = APT_MIN(dx, dy);
+			int longSide  = APT_MAX(dx, dy);
+			if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong)) {
+				bestShort = shortSide;
+				bestLong  = longSide;
+				_rect_.m_x = x;
+				_rect_.m_y = y;
+			}
+		}
+		return bestShort != INT_MAX;
+	}
+
+	// Split free rects which intersect _placed, the new rects are appended to the list.
+	void place(const Rect& _placed)
+	{
+		int n = (int)m_freeRects.size();
+		for (int i = 0; i < n; ) {
+			Rect r = m_freeRects[i];
+			if (!r.intersects(_placed)) {
+				++i;
+				continue;
+			}
+			m_freeRects[i] = m_freeRects[--n];
+			m_freeRects.erase(m_freeRects.begin() + n);
+			if (_placed.m_x > r.m_x) {
+				Rect s = { r.m_x, r.m_y, _placed.m_x - r.m_x, r.m_h };
+				m_freeRects.push_back(s);
+			}
+			if (_placed.m_x + _placed.m_w < r.m_x + r.m_w) {
+				Rect s = { _placed.m_x + _placed.m_w, r.m_y, r.m_x + r.m_w - _placed.m_x - _placed.m_w, r.m_h };
+				m_freeRects.push_back(s);
+			}
+			if (_placed.m_y > r.m_y) {
+				Rect s = { r.m_x, r.m_y, r.m_w, _placed.m_y - r.m_y };
+				m_freeRects.push_back(s);
+			}
+			if (_placed.m_y + _placed.m_h < r.m_y + r.m_h) {
+				Rect s = { r.m_x, _placed.m_y + _placed.m_h, r.m_w, r.m_y + r.m_h - _placed.m_y - _placed.m_h };
+				m_freeRects.push_back(s);
+			}
+		}
+		PruneRects(m_freeRects, n);
+	}
+
+	// Recompute the maximal free rectangles from the used rectangles.
+	void rebuild()
+	{
+		m_freeRects.clear();
+		Rect r = { 0, 0, m_sizeX, m_sizeY };
+		m_freeRects.push_back(r);
+		for (const Rect& used : m_usedRects) {
+			place(used);
+		}
+		m_dirty = false;
+	}
+};
+
+/*******************************************************************************
+
+                                 TextureAtlas
+
+*******************************************************************************/
+
+struct TextureAtlas::Defrag
+{
+	struct Move
+	{
+		Region* m_region;
+		uint16  m_startX, m_startY;  // New position (texels).
+	};
+
+	Texture*            m_texture;
+	Packer*             m_packer;
+	eastl::vector<Move> m_moves;
+	int                 m_next;      // Next move to copy.
+};
+
+static const char* kAllocatorNames[] =
+{
+	"Quadtree",
+	"Skyline",
+	"MaxRects"
+};
 
 // PUBLIC
 
-TextureAtlas* TextureAtlas::Create(GLsizei _width, GLsizei _height, GLenum _format, GLsizei _mipCount)
+TextureAtlas* TextureAtlas::Create(GLsizei _width, GLsizei _height, GLenum _format, GLsizei _mipCount, Allocator _allocator)
 {
 	uint64 id = GetUniqueId();
 	APT_ASSERT(!Find(id)); // id collision
-	TextureAtlas* ret = new TextureAtlas(id, "", _format, _width, _height, _mipCount);
+	TextureAtlas* ret = new TextureAtlas(id, "", _format, _width, _height, _mipCount, _allocator);
 	ret->setNamef("%llu", id);
 	Use((Texture*&)ret);
 	return ret;
@@ -64,36 +649,64 @@ void TextureAtlas::Destroy(TextureAtlas*& _inst_)
 	}
 }
 
+const char* TextureAtlas::GetAllocatorName(Allocator _allocator)
+{
+	APT_STATIC_ASSERT(APT_ARRAY_COUNT(kAllocatorNames) == Allocator_Count);
+	return kAllocatorNames[_allocator];
+}
 
 TextureAtlas::Region* TextureAtlas::alloc(GLsizei _width, GLsizei _height)
 {
-	Node* node = insert(m_root, _width, _height);
-	if (node) {
-		Region* ret = m_regionPool.alloc();
-		ret->m_uvScale = vec2(_width, _height) * m_rsize; // note it's the requested size, not the node size
-		ret->m_uvBias = vec2(node->m_startX, node->m_startY) * m_rsize;
-		
-		if (isCompressed()) {
-		 // compressed atlas, the smallest usable region is 4x4, hence the max lod is log2(w/4)
-			ret->m_lodMax = APT_MIN((int)log2((double)(_width / 4)), (int)log2((double)(_height / 4)));
-		} else {
-		 // uncompressed, the smallest usable region is log2(w)
-			ret->m_lodMax = APT_MIN((int)log2((double)(_width)), (int)log2((double)(_height)));
-		}
-		
-		#ifdef frm_TextureAtlas_DEBUG
-			s_dbgRegionList.push_back(ret);
-		#endif
-		return ret;
+	cancelDefrag();
+
+	int lodMax;
+	if (isCompressed()) {
+	 // compressed atlas, the smallest usable region is 4x4, hence the max lod is log2(w/4)
+		lodMax = APT_MIN((int)log2((double)APT_MAX(_width / 4, 1)), (int)log2((double)APT_MAX(_height / 4, 1)));
+	} else {
+	 // uncompressed, the smallest usable region is log2(w)
+		lodMax = APT_MIN((int)log2((double)APT_MAX(_width, 1)), (int)log2((double)APT_MAX(_height, 1)));
 	}
 
-	return 0;
+ // the start is aligned such that the region remains aligned at every mip it uses, smaller regions pack on a
+ // finer grid
+	uint16 align = (uint16)(1 << GetAlignLog2(lodMax, getMipCount()));
+	uint16 sizeX = (uint16)((_width  + m_cellSize - 1) / m_cellSize);
+	uint16 sizeY = (uint16)((_height + m_cellSize - 1) / m_cellSize);
+	if (isCompressed()) {
+	 // pad the size such that copies/uploads cover whole blocks at every mip (see defragment())
+		sizeX = (uint16)AlignUp(sizeX, align);
+		sizeY = (uint16)AlignUp(sizeY, align);
+	}
+	uint16 startX, startY;
+	if (!m_packer->alloc(sizeX, sizeY, align, startX, startY)) {
+		++m_stats.m_failedAllocCount;
+		return 0;
+	}
+
+	Region* ret = m_regionPool.alloc();
+	ret->m_id       = 0;
+	ret->m_refCount = 0;
+	ret->m_index    = (int)m_regions.size();
+	ret->m_lodMax   = lodMax;
+	ret->m_dataX    = (uint16)_width;
+	ret->m_dataY    = (uint16)_height;
+	setRegionRect(*ret, startX * m_cellSize, startY * m_cellSize, sizeX * m_cellSize, sizeY * m_cellSize);
+	m_regions.push_back(ret);
+
+	++m_stats.m_regionCount;
+	m_stats.m_usedTexels      += (uint64)_width * (uint64)_height;
+	m_stats.m_allocatedTexels += (uint64)ret->m_sizeX * (uint64)ret->m_sizeY;
+	return ret;
 }
 
 TextureAtlas::Region* TextureAtlas::alloc(const apt::Image& _img, RegionId _id)
 {
 	APT_ASSERT(_img.getType() == Image::Type_2d);
 	Region* ret = alloc((GLsizei)_img.getWidth(), (GLsizei)_img.getHeight());
+	if (!ret) {
+		return 0;
+	}
 
 	GLenum srcFormat;
 	switch (_img.getLayout()) {
@@ -101,7 +714,7 @@ TextureAtlas::Region* TextureAtlas::alloc(const apt::Image& _img, RegionId _id)
 		case Image::Layout_RG:   srcFormat = GL_RG;   break;
 		case Image::Layout_RGB:  srcFormat = GL_RGB;  break;
 		case Image::Layout_RGBA: srcFormat = GL_RGBA; break;
-		default:                   APT_ASSERT(false); return false;
+		default:                   APT_ASSERT(false); return 0;
 	};
 	GLenum srcType = _img.isCompressed() ? GL_UNSIGNED_BYTE : internal::GlDataTypeToEnum(_img.getImageDataType());
 	int mipMax = APT_MIN(APT_MIN((int)getMipCount(), (int)_img.getMipmapCount()), ret->m_lodMax + 1);
@@ -113,10 +726,10 @@ TextureAtlas::Region* TextureAtlas::alloc(const apt::Image& _img, RegionId _id)
 	}
 
 	if (_id != 0) {
-		m_regionMap.push_back(RegionRef());
-		m_regionMap.back().m_id = _id;
-		m_regionMap.back().m_region = ret;
-		m_regionMap.back().m_refCount = 1;
+		APT_ASSERT(m_regionMap.find(_id) == m_regionMap.end()); // use findUse() first
+		ret->m_id = _id;
+		ret->m_refCount = 1;
+		m_regionMap[_id] = ret;
 	}
 	return ret;
 }
@@ -124,17 +737,21 @@ TextureAtlas::Region* TextureAtlas::alloc(const apt::Image& _img, RegionId _id)
 void TextureAtlas::free(Region*& _region_)
 {
 	APT_ASSERT(_region_);
-	#ifdef APT_DEBUG
-		for (auto it = m_regionMap.begin(); it != m_regionMap.end(); ++it) {
-			if (it->m_region == _region_) {
-				APT_ASSERT(false); // named regions must be freed via unuseFree()
-			}
-		}
-	#endif
+	APT_ASSERT(_region_->m_refCount == 0); // named regions must be freed via unuseFree()
+	cancelDefrag();
 
-	Node* node = find(*_region_);
-	APT_ASSERT(node);
-	remove(node);
+	Region* region = _region_;
+	m_packer->free(region->m_startX / m_cellSize, region->m_startY / m_cellSize, region->m_sizeX / m_cellSize, region->m_sizeY / m_cellSize);
+
+	--m_stats.m_regionCount;
+	m_stats.m_usedTexels      -= (uint64)region->m_dataX * (uint64)region->m_dataY;
+	m_stats.m_allocatedTexels -= (uint64)region->m_sizeX * (uint64)region->m_sizeY;
+
+ // swap-remove from m_regions
+	Region* last = m_regions.back();
+	m_regions[region->m_index] = last;
+	last->m_index = region->m_index;
+	m_regions.pop_back();
 
 	m_regionPool.free(_region_);
 	_region_ = 0;
@@ -142,252 +759,224 @@ void TextureAtlas::free(Region*& _region_)
 
 TextureAtlas::Region* TextureAtlas::findUse(RegionId _id)
 {
-	for (auto it = m_regionMap.begin(); it != m_regionMap.end(); ++it) {
-		if (it->m_id == _id) {
-			++it->m_refCount;
-			return it->m_region;
-		}
+	auto it = m_regionMap.find(_id);
+	if (it == m_regionMap.end()) {
+		return 0; // not found
 	}
-	return 0; // not found
+	++it->second->m_refCount;
+	return it->second;
 }
 
 void TextureAtlas::unuseFree(Region*& _region_)
 {
-	for (auto it = m_regionMap.begin(); it != m_regionMap.end(); ++it) {
-		if (it->m_region == _region_) {
-			if (--it->m_refCount == 0) {
-				m_regionMap.erase(it);
-				free(_region_);
-			}
-			_region_ = 0; // always null the ptr
-			return;
-		}
+	APT_ASSERT(_region_->m_id != 0); // didn't set the region name via alloc()?
+	if (--_region_->m_refCount == 0) {
+		m_regionMap.erase(_region_->m_id);
+		free(_region_);
 	}
-	APT_ASSERT(false); // region not found, didn't set the region name via alloc()?
+	_region_ = 0; // always null the ptr
 }
 
 void TextureAtlas::upload(const Region& _region, const void* _data, GLenum _dataFormat, GLenum _dataType, GLint _mip)
 {
 	APT_ASSERT(_mip < getMipCount());
-	
-	GLsizei x = (GLsizei)(_region.m_uvBias.x  * (float)getWidth());
-	GLsizei y = (GLsizei)(_region.m_uvBias.y  * (float)getHeight());
-	GLsizei w = (GLsizei)(_region.m_uvScale.x * (float)getWidth());
-	GLsizei h = (GLsizei)(_region.m_uvScale.y * (float)getHeight());
-	
-	GLsizei div = (GLsizei)pow(2.0, (double)_mip);
-	w = w  / div;
-	h = h  / div;
-	x = x  / div;
-	y = y  / div;
 
+	GLsizei x = _region.m_startX >> _mip;
+	GLsizei y = _region.m_startY >> _mip;
+	GLsizei w = APT_MAX((GLsizei)_region.m_dataX >> _mip, 1);
+	GLsizei h = APT_MAX((GLsizei)_region.m_dataY >> _mip, 1);
 	setSubData(x, y, 0, w, h, 0, _data, _dataFormat, _dataType, _mip);
 }
 
+bool TextureAtlas::defragment(int _maxCopies)
+{
+	if (!m_defrag) {
+		if (m_regions.empty()) {
+			return false;
+		}
+	 // new layout, largest regions first
+		eastl::vector<Region*> sorted(m_regions);
+		eastl::sort(sorted.begin(), sorted.end(), [](const Region* _a, const Region* _b) {
+				return _a->m_sizeY != _b->m_sizeY ? _a->m_sizeY > _b->m_sizeY : _a->m_sizeX > _b->m_sizeX;
+			});
+		Defrag* defrag = new Defrag;
+		defrag->m_packer = CreatePacker(m_allocator, m_packer->m_sizeX, m_packer->m_sizeY);
+		defrag->m_next = 0;
+		for (Region* region : sorted) {
+			uint16 sizeX = region->m_sizeX / m_cellSize;
+			uint16 sizeY = region->m_sizeY / m_cellSize;
+			uint16 align = (uint16)(1 << GetAlignLog2(region->m_lodMax, getMipCount()));
+			uint16 startX, startY;
+			if (!defrag->m_packer->alloc(sizeX, sizeY, align, startX, startY)) {
+				APT_LOG("TextureAtlas::defragment: Regions don't fit the new layout (%s)", GetAllocatorName(m_allocator));
+				delete defrag->m_packer;
+				delete defrag;
+				return false;
+			}
+			Defrag::Move move = { region, (uint16)(startX * m_cellSize), (uint16)(startY * m_cellSize) };
+			defrag->m_moves.push_back(move);
+		}
+		defrag->m_texture = Texture::Create2d(getWidth(), getHeight(), getFormat(), getMipCount());
+		defrag->m_texture->setMinFilter(getMinFilter());
+		defrag->m_texture->setMagFilter(getMagFilter());
+		defrag->m_texture->setWrapU(getWrapU());
+		defrag->m_texture->setWrapV(getWrapV());
+		defrag->m_texture->setAnisotropy(getAnisotropy());
+		m_defrag = defrag;
+	}
+
+	for (int i = 0; i < _maxCopies && m_defrag->m_next < (int)m_defrag->m_moves.size(); ++i, ++m_defrag->m_next) {
+		const Defrag::Move& move = m_defrag->m_moves[m_defrag->m_next];
+		const Region& region = *move.m_region;
+	 // mips beyond the region's alignment aren't used by the region
+		for (GLint mip = 0, mipMax = GetAlignLog2(region.m_lodMax, getMipCount()); mip <= mipMax; ++mip) {
+			glAssert(glCopyImageSubData(
+				getHandle(),                    GL_TEXTURE_2D, mip, region.m_startX >> mip, region.m_startY >> mip, 0,
+				m_defrag->m_texture->getHandle(), GL_TEXTURE_2D, mip, move.m_startX   >> mip, move.m_startY   >> mip, 0,
+				APT_MAX(region.m_sizeX >> mip, 1), APT_MAX(region.m_sizeY >> mip, 1), 1
+				));
+		}
+	}
+	if (m_defrag->m_next < (int)m_defrag->m_moves.size()) {
+		return true;
+	}
+
+ // all regions copied, switch to the new texture/layout
+	swap(*(Texture*)this, *m_defrag->m_texture);
+	Texture::Release(m_defrag->m_texture);
+	delete m_packer;
+	m_packer = m_defrag->m_packer;
+	for (const Defrag::Move& move : m_defrag->m_moves) {
+		setRegionRect(*move.m_region, move.m_startX, move.m_startY, move.m_region->m_sizeX, move.m_region->m_sizeY);
+	}
+	delete m_defrag;
+	m_defrag = nullptr;
+	return false;
+}
+
+float TextureAtlas::getOccupancy() const
+{
+	return (float)((double)m_stats.m_usedTexels / ((double)getWidth() * (double)getHeight()));
+}
 
 // PROTECTED
 
 TextureAtlas::TextureAtlas(
-	uint64      _id, 
+	uint64      _id,
 	const char* _name,
 	GLenum      _format,
-	GLsizei     _width, 
+	GLsizei     _width,
 	GLsizei     _height,
-	GLsizei     _mipCount	
+	GLsizei     _mipCount,
+	Allocator   _allocator
 	)
 	: Texture(_id, _name, GL_TEXTURE_2D, _width, _height, 0, 0, _mipCount, _format)
+	, m_allocator(_allocator)
+	, m_defrag(nullptr)
 	, m_regionPool(256)
 {
-
+	memset(&m_stats, 0, sizeof(m_stats));
 	m_rsize = 1.0f / vec2(getWidth(), getHeight());
 
- // init allocator
- 	m_nodePool = new Pool<Node>(128);
-	m_root = m_nodePool->alloc(Node(0));
-	m_root->m_startX = m_root->m_startY = 0;
-	m_root->m_sizeX = getWidth();
-	m_root->m_sizeY = getHeight();
+ // regions are allocated on a grid of the block size, the start alignment depends on the region size (see alloc())
+	m_cellSize = isCompressed() ? 4 : 1;
+	m_packer = CreatePacker(_allocator, (uint16)(getWidth() / m_cellSize), (uint16)(getHeight() / m_cellSize));
 }
 
 TextureAtlas::~TextureAtlas()
 {
- // destroy allocator
-	m_nodePool->free(m_root);
-	delete m_nodePool;
+	cancelDefrag();
+	delete m_packer;
 }
 
 // PRIVATE
 
-TextureAtlas::Node* TextureAtlas::insert(Node* _root, uint16 _sizeX, uint16 _sizeY)
+TextureAtlas::Packer* TextureAtlas::CreatePacker(Allocator _allocator, uint16 _sizeX, uint16 _sizeY)
 {
-	if (!_root->isEmpty()) {
-		return 0;
-	}
-	
-	if (_root->isLeaf()) {
-	 // node is too small
-		if (_root->m_sizeX < _sizeX || _root->m_sizeY < _sizeY) {
-			return 0;
-		}
-	 // node is best fit
-		uint16 nextSizeX = _root->m_sizeX / 2;
-		uint16 nextSizeY = _root->m_sizeY / 2;
-		if (nextSizeX < _sizeX || nextSizeY < _sizeY) {
-			_root->m_isEmpty = false;
-			return _root;
-		}
-
-	 // subdivide the node
-	 // +---+---+
-	 // | 0 | 1 |
-	 // +---+---+
-	 // | 3 | 2 |
-	 // +---+---+
-		for (int i = 0; i < 4; ++i) {
-			_root->m_children[i] = m_nodePool->alloc(Node(_root));
-			_root->m_children[i]->m_sizeX = nextSizeX;
-			_root->m_children[i]->m_sizeY = nextSizeY;
-		}
-		_root->m_children[0]->m_startX = _root->m_startX;
-		_root->m_children[0]->m_startY = _root->m_startY;
-		_root->m_children[1]->m_startX = _root->m_startX + nextSizeX;
-		_root->m_children[1]->m_startY = _root->m_startY;
-		_root->m_children[2]->m_startX = _root->m_startX + nextSizeX;
-		_root->m_children[2]->m_startY = _root->m_startY + nextSizeY;		
-		_root->m_children[3]->m_startX = _root->m_startX;
-		_root->m_children[3]->m_startY = _root->m_startY + nextSizeY;
-
-		return insert(_root->m_children[0], _sizeX, _sizeY);
-
-	} else {
-		Node* ret = 0;
-		for (int i = 0; i < 4; ++i) {
-			ret = insert(_root->m_children[i], _sizeX, _sizeY);
-			if (ret != 0) {
-				break;
-			}
-		}
-		return ret;
-	}
-
+	switch (_allocator) {
+		case Allocator_Quadtree: return new QuadtreePacker(_sizeX, _sizeY);
+		case Allocator_Skyline:  return new SkylinePacker(_sizeX, _sizeY);
+		default:
+		case Allocator_MaxRects: return new MaxRectsPacker(_sizeX, _sizeY);
+	};
 }
 
-void TextureAtlas::remove(Node*& _node_)
+int TextureAtlas::GetAlignLog2(int _lodMax, GLsizei _mipCount)
 {
-	APT_ASSERT(_node_->isLeaf());
-	_node_->m_isEmpty = true;
-	Node* parent = _node_->m_parent;
-
- // remove parent if all children are empty leaves
- 	for (int i = 0; i < 4; ++i) {
-		bool canRemove = parent->m_children[i]->isEmpty() && parent->m_children[i]->isLeaf();
-		if (!canRemove) {
-			return;
-		}
-	}
-	for (int i = 0; i < 4; ++i) {
-		m_nodePool->free(parent->m_children[i]);
-		parent->m_children[i] = 0;
-	}
-	if (parent != m_root) {
-		remove(parent);
-	}
+	return APT_MAX(APT_MIN(_lodMax, (int)_mipCount - 1), 0);
 }
 
-// \todo improve find(), search for the node corner rather than the node center
-TextureAtlas::Node* TextureAtlas::find(const Region& _region)
+void TextureAtlas::setRegionRect(Region& _region, uint16 _startX, uint16 _startY, uint16 _sizeX, uint16 _sizeY)
 {
- // convert region -> node center
-	uint16 startX = (uint16)(_region.m_uvBias.x  * (float)getWidth());
-	uint16 startY = (uint16)(_region.m_uvBias.y  * (float)getHeight());
-	uint16 sizeX  = (uint16)(_region.m_uvScale.x * (float)getWidth());
-	uint16 sizeY  = (uint16)(_region.m_uvScale.y * (float)getHeight());
-	uint16 originX = startX + sizeX / 2;
-	uint16 originY = startY + sizeY / 2;
-
-	return find(m_root, originX, originY);
+	_region.m_startX  = _startX;
+	_region.m_startY  = _startY;
+	_region.m_sizeX   = _sizeX;
+	_region.m_sizeY   = _sizeY;
+	_region.m_uvScale = vec2(_region.m_dataX, _region.m_dataY) * m_rsize; // note it's the requested size, not the allocated size
+	_region.m_uvBias  = vec2(_startX, _startY) * m_rsize;
 }
 
-TextureAtlas::Node* TextureAtlas::find(Node* _root, uint16 _originX, uint16 _originY)
+void TextureAtlas::cancelDefrag()
 {
-	uint16 x0 = _root->m_startX;
-	uint16 y0 = _root->m_startY;
-	uint16 x1 = x0 + _root->m_sizeX; 
-	uint16 y1 = y0 + _root->m_sizeY;
-	if (_originX >= x0 && _originX <= x1 && _originY >= y0 && _originY <= y1) {
-		if (_root->isLeaf()) {
-			return _root;
-		}
-		for (int i = 0; i < 4; ++i) {
-			Node* ret = find(_root->m_children[i], _originX, _originY);
-			if (ret) {
-				return ret;
-			}
-		}
+	if (m_defrag) {
+		Texture::Release(m_defrag->m_texture);
+		delete m_defrag->m_packer;
+		delete m_defrag;
+		m_defrag = nullptr;
 	}
-	return 0;
 }
 
 
-
 #ifdef frm_TextureAtlas_DEBUG
 	static const ImU32 kDbgColorBackground = ImColor(0.1f, 0.1f, 0.1f, 1.0f);
 	static const ImU32 kDbgColorLines      = ImColor(1.0f, 1.0f, 1.0f, 1.0f);
 	static const float kDbgLineThickness   = 1.0f;
 	void TextureAtlas::debug()
 	{
+		ImGui::Text("%s: %d regions, %.1f%% occupancy (%.1f%% allocated), %d failed allocs",
+			GetAllocatorName(m_allocator),
+			m_stats.m_regionCount,
+			getOccupancy() * 100.0f,
+			(float)((double)m_stats.m_allocatedTexels / ((double)getWidth() * (double)getHeight())) * 100.0f,
+			m_stats.m_failedAllocCount
+			);
+		if (ImGui::Button("Defragment")) {
+			while (defragment());
+		}
+
 		ImDrawList* drawList = ImGui::GetWindowDrawList();
 		const vec2 drawSize = ImGui::GetContentRegionAvail();
 		const vec2 drawStart = vec2(ImGui::GetWindowPos()) + vec2(ImGui::GetCursorPos());
 		const vec2 drawEnd   = drawStart + drawSize;
 		drawList->AddRectFilled(drawStart, drawStart + drawSize, kDbgColorBackground);
-	
-		const vec2 txSize = vec2(getWidth(), getHeight());
+
 		const vec2 buttonStart = ImGui::GetCursorPos();
-		for (int i = 0; i < s_dbgRegionList.size(); ++i) {
+		for (int i = 0; i < (int)m_regions.size(); ++i) {
+			Region* region = m_regions[i];
 			ImGui::PushID(i);
-			vec2 start = s_dbgRegionList[i]->m_uvBias * drawSize;
-			vec2 size  = s_dbgRegionList[i]->m_uvScale * drawSize;
+			vec2 start = region->m_uvBias * drawSize;
+			vec2 size  = region->m_uvScale * drawSize;
 			ImGui::SetCursorPos(buttonStart + start);
 			if (ImGui::Button("", size)) {
-				free(s_dbgRegionList[i]);
-				s_dbgRegionList.erase(s_dbgRegionList.begin() + i);
+				if (region->m_id == 0) {
+					free(region);
+					--i;
+				}
 			} else {
 				if (ImGui::IsItemHovered()) {
 					ImGui::BeginTooltip();
-						ImGui::Text("Uv Bias:  %1.2f, %1.2f", s_dbgRegionList[i]->m_uvBias.x, s_dbgRegionList[i]->m_uvBias.y);
-						ImGui::Text("Uv Scale: %1.2f, %1.2f", s_dbgRegionList[i]->m_uvScale.x, s_dbgRegionList[i]->m_uvScale.y);
-						ImGui::Text("Max Lod:  %d", s_dbgRegionList[i]->m_lodMax);
+						ImGui::Text("Uv Bias:  %1.2f, %1.2f", region->m_uvBias.x, region->m_uvBias.y);
+						ImGui::Text("Uv Scale: %1.2f, %1.2f", region->m_uvScale.x, region->m_uvScale.y);
+						ImGui::Text("Max Lod:  %d", region->m_lodMax);
 					ImGui::EndTooltip();
 				}
 			}
 			ImGui::PopID();
 		}
-	
+
 		drawList->AddLine(vec2(drawStart.x, drawStart.y), vec2(drawEnd.x,   drawStart.y), kDbgColorLines, kDbgLineThickness);
 		drawList->AddLine(vec2(drawEnd.x,   drawStart.y), vec2(drawEnd.x,   drawEnd.y),   kDbgColorLines, kDbgLineThickness);
 		drawList->AddLine(vec2(drawEnd.x,   drawEnd.y),   vec2(drawStart.x, drawEnd.y),   kDbgColorLines, kDbgLineThickness);
 		drawList->AddLine(vec2(drawStart.x, drawEnd.y),   vec2(drawStart.x, drawStart.y), kDbgColorLines, kDbgLineThickness);
-		debugDrawNode(m_root, drawStart, drawSize);
-	}
-	void TextureAtlas::debugDrawNode(const Node* _node, const vec2& _drawStart, const vec2& _drawSize)
-	{
-		if (!_node->isLeaf()) {
-			ImDrawList* drawList = ImGui::GetWindowDrawList();
-	
-	
-			vec2 a, b;
-			a = vec2(_node->m_startX + _node->m_sizeX / 2, _node->m_startY                  ) * m_rsize;
-			b = vec2(_node->m_startX + _node->m_sizeX / 2, _node->m_startY + _node->m_sizeY ) * m_rsize;
-			drawList->AddLine(_drawStart + a * _drawSize, _drawStart + b * _drawSize, kDbgColorLines, kDbgLineThickness);
-			
-			a = vec2(_node->m_startX,                      _node->m_startY + _node->m_sizeY / 2) * m_rsize;
-			b = vec2(_node->m_startX + _node->m_sizeX,     _node->m_startY + _node->m_sizeY / 2) * m_rsize;
-			drawList->AddLine(_drawStart + a * _drawSize, _drawStart + b * _drawSize, kDbgColorLines, kDbgLineThickness);
-			
-			for (int i = 0; i < 4; ++i) {
-				debugDrawNode(_node->m_children[i], _drawStart, _drawSize);
-			}
-		}
 	}
 #endif // frm_TextureAtlas_DEBUG
@@ -9,6 +9,7 @@
 #include <apt/Pool.h>
 #include <apt/StringHash.h>
 
+#include <EASTL/hash_map.h>
 #include <EASTL/vector.h>
 
 #ifdef APT_DEBUG
@@ -19,29 +20,60 @@ namespace frm {
 
 ////////////////////////////////////////////////////////////////////////////////
 // TextureAtlas
-// \todo Pass an ID when uploading an image (detect if you already uploaded the
-//   the image). Requires refcounting for regions!
-// \todo Select between quadtree/BSP allocator, more efficient implementation
-//   for both. See commit 7c6ac7e for a working version of the BSP.
+// Regions are allocated on a grid of m_cellSize texels (the block size if the
+// atlas is compressed). The start of each region is aligned such that it
+// remains aligned at every mip the region uses (up to m_lodMax), hence small
+// regions don't waste space in atlases with a full mip chain.
+// - Named regions (see alloc()) are refcounted and indexed by a hash map.
+// - Freed space is reused by the allocator but may become fragmented, call
+//   defragment() to repack (e.g. after a level unload).
 ////////////////////////////////////////////////////////////////////////////////
 class TextureAtlas: public Texture
 {
 public:
 	typedef apt::StringHash::HashType RegionId;
 
+	enum Allocator
+	{
+		Allocator_Quadtree,  // Power of two nodes, regions are padded to a power of two size.
+		Allocator_Skyline,   // Bottom-left skyline + list of freed rectangles, fast. Best for regions of similar height (e.g. glyphs).
+		Allocator_MaxRects,  // Maximal free rectangles, best short side fit. Best occupancy, allocation is O(n^2) in the number of free rectangles.
+
+		Allocator_Count
+	};
+
 	struct Region
 	{
 		vec2 m_uvScale;
 		vec2 m_uvBias;
 		int  m_lodMax;
+
+	private:
+		friend class TextureAtlas;
+		RegionId m_id;                // 0 if unnamed.
+		int      m_refCount;          // Named regions only.
+		int      m_index;             // Index in m_regions.
+		uint16   m_startX, m_startY;  // Allocated rectangle in texels (includes alignment padding).
+		uint16   m_sizeX,  m_sizeY;   //                "
+		uint16   m_dataX,  m_dataY;   // Requested size.
 	};
 
-	static TextureAtlas* Create(GLsizei _width, GLsizei _height, GLenum _format, GLint _mipCount = 1);
+	struct Stats
+	{
+		int    m_regionCount;
+		uint64 m_usedTexels;       // Sum of the requested region sizes.
+		uint64 m_allocatedTexels;  // Sum of the allocated region sizes (includes alignment/allocator padding).
+		int    m_failedAllocCount;
+	};
+
+	static TextureAtlas* Create(GLsizei _width, GLsizei _height, GLenum _format, GLint _mipCount = 1, Allocator _allocator = Allocator_MaxRects);
 	static void Destroy(TextureAtlas*& _inst_);
 
+	static const char* GetAllocatorName(Allocator _allocator);
+
 	// Alloc an uninitialized _width * _height region. Return 0 if the allocation failed.
 	Region* alloc(GLsizei _width, GLsizei _height);
-	// Alloc a region large enough to fit _img and upload data (to all mips). Optionally 
+	// Alloc a region large enough to fit _img and upload data (to all mips). Optionally
 	// set the region id (e.g. a hash of the image path), see findUse()/unuseFree().
 	Region* alloc(const apt::Image& _img, RegionId _id = 0);
 
@@ -56,39 +88,62 @@ public:
 	// Upload data to a previously allocated region.
 	void upload(const Region& _region, const void* _data, GLenum _dataFormat, GLenum _dataType, GLint _mip = 0);
 
+	// Repack all regions with the current allocator, in order of decreasing size. The first call computes the
+	// new layout and creates a new texture, each call copies at most _maxCopies regions (all mips) to the new
+	// texture via glCopyImageSubData(). Once all regions are copied the atlas switches to the new texture (the
+	// handle changes) and the region uvs are updated in place. alloc()/free() cancel a repack in progress.
+	// Return true while the repack is in progress (call again), false once complete or if the regions don't
+	// fit the new layout.
+	bool defragment(int _maxCopies = 64);
+	bool isDefragmenting() const        { return m_defrag != nullptr; }
+
+	Allocator    getAllocator() const   { return m_allocator; }
+	const Stats& getStats() const       { return m_stats; }
+	// Fraction of the atlas covered by regions (requested sizes).
+	float        getOccupancy() const;
 
 protected:
 	TextureAtlas(
-		uint64      _id, 
+		uint64      _id,
 		const char* _name,
 		GLenum      _format,
-		GLsizei     _width, 
+		GLsizei     _width,
 		GLsizei     _height,
-		GLsizei     _mipCount
+		GLsizei     _mipCount,
+		Allocator   _allocator
 		);
 	~TextureAtlas();
 
 private:
-	vec2 m_rsize;
+	struct Packer;
+	struct QuadtreePacker;
+	struct SkylinePacker;
+	struct MaxRectsPacker;
+	struct Defrag;
+
+	Allocator m_allocator;
+	GLsizei   m_cellSize;   // Allocation granularity in texels.
+	vec2      m_rsize;
+	Packer*   m_packer;     // Operates on a grid of m_cellSize texels.
+	Defrag*   m_defrag;     // Non-null while a repack is in progress.
+	Stats     m_stats;
+
 	apt::Pool<Region> m_regionPool;
+	eastl::vector<Region*> m_regions;
+	eastl::hash_map<RegionId, Region*> m_regionMap;
 
-	struct RegionRef { RegionId m_id; Region* m_region; int m_refCount; };
-	eastl::vector<RegionRef> m_regionMap;
+	static Packer* CreatePacker(Allocator _allocator, uint16 _sizeX, uint16 _sizeY);
+	// Log2 of the start alignment (in cells) for a region with _lodMax, such that it is aligned at every mip it uses.
+	static int     GetAlignLog2(int _lodMax, GLsizei _mipCount);
 
- // quad tree allocator
- 	struct Node;
-	Node* m_root;
-	apt::Pool<Node>* m_nodePool;	
+	// Set the allocated rectangle/uvs of _region.
+	void setRegionRect(Region& _region, uint16 _startX, uint16 _startY, uint16 _sizeX, uint16 _sizeY);
 
-	Node* insert(Node* _root, uint16 _sizeX, uint16 _sizeY);
-	void  remove(Node*& _node_);
-	Node* find(const Region& _region);
-	Node* find(Node* _root, uint16 _originX, uint16 _originY);
+	void cancelDefrag();
 
 #ifdef frm_TextureAtlas_DEBUG
 public:
 	void debug();
-	void debugDrawNode(const Node* _node, const vec2& _drawStart, const vec2& _drawSize);
 #endif
 
 }; // class TextureAtlas
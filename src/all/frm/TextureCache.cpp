@@ -0,0 +1,382 @@
+#include <frm/TextureCache.h>
+
+#include <frm/FileUtil.h>
+#include <frm/MipGenerator.h>
+#include <frm/Texture.h>
+#include <frm/TextureCompressor.h>
+#include <frm/ThreadPool.h>
+
+#include <apt/log.h>
+#include <apt/hash.h>
+#include <apt/platform.h>
+#include <apt/File.h>
+#include <apt/FileSystem.h>
+#include <apt/Image.h>
+#include <apt/Time.h>
+
+#ifdef APT_PLATFORM_WIN
+	#include <apt/win.h> // FindFirstFile
+#else
+	#include <dirent.h>
+	#include <sys/stat.h>
+#endif
+
+#include <EASTL/utility.h>
+#include <EASTL/vector.h>
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+using namespace frm;
+using namespace apt;
+
+static const uint32 kFileMagic   = 0x43545246; // 'FRTC'
+static const uint32 kFileVersion = 1;          // Increment if the processing changes, invalidates all cooked files.
+
+// Source extensions cooked by Precook().
+static const char* kSourceExtensions[] = { "bmp", "dds", "hdr", "jpg", "jpeg", "ktx", "png", "psd", "tga" };
+
+struct FileHeader
+{
+	uint32 m_magic;
+	uint32 m_version;
+	uint64 m_key;
+	uint64 m_srcSize;
+	uint32 m_type;
+	uint32 m_layout;
+	uint32 m_dataType;
+	uint32 m_compression;
+	uint32 m_width;
+	uint32 m_height;
+	uint32 m_depth;
+	uint32 m_mipCount;
+	uint64 m_dataSize;
+};
+
+static bool                 g_enabled;
+static FileSystem::PathStr  g_dir;
+static std::mutex           g_statsMutex;
+static TextureCache::Stats  g_stats;
+
+static uint64 MakeKey(const File& _src, uint32 _flags)
+{
+	uint64 ret = Hash<uint64>(_src.getData(), (uint)_src.getDataSize(), (uint64)kFileVersion);
+	return Hash<uint64>(&_flags, sizeof(_flags), ret);
+}
+
+static void MakeCookedPath(FileSystem::PathStr& ret_, uint64 _key)
+{
+	ret_.setf("%s/%016llx.tex", (const char*)g_dir, (unsigned long long)_key);
+}
+
+// Append the paths of files in _dir with one of kSourceExtensions to list_, recurse into subdirectories.
+static bool ListSourceFiles(const char* _dir, eastl::vector<FileSystem::PathStr>& list_)
+{
+	auto isSource = [](const char* _path) {
+		for (const char* ext : kSourceExtensions) {
+			if (FileSystem::CompareExtension(ext, _path)) {
+				return true;
+			}
+		}
+		return false;
+	};
+
+	#ifdef APT_PLATFORM_WIN
+		FileSystem::PathStr pattern("%s/*", _dir);
+		WIN32_FIND_DATA ffd;
+		HANDLE h = FindFirstFile(pattern, &ffd);
+		if (h == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		do {
+			if (ffd.cFileName[0] == '.') {
+				continue;
+			}
+			FileSystem::PathStr pth("%s/%s", _dir, ffd.cFileName);
+			if (ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+				ListSourceFiles(pth, list_);
+			} else if (isSource(pth)) {
+				list_.push_back(pth);
+			}
+		} while (FindNextFile(h, &ffd));
+		FindClose(h);
+	#else
+		DIR* dir = opendir(_dir);
+		if (!dir) {
+			return false;
+		}
+		while (dirent* ent = readdir(dir)) {
+			if (ent->d_name[0] == '.') {
+				continue;
+			}
+			FileSystem::PathStr pth("%s/%s", _dir, ent->d_name);
+			struct stat st;
+			if (stat(pth, &st) != 0) {
+				continue;
+			}
+			if (S_ISDIR(st.st_mode)) {
+				ListSourceFiles(pth, list_);
+			} else if (isSource(pth)) {
+				list_.push_back(pth);
+			}
+		}
+		closedir(dir);
+	#endif
+	return true;
+}
+
+// Box filter mips for a 2x3 cubemap. The chain stops at the first mip whose face size isn't a multiple of 4,
+// hence the filter never crosses a face boundary and each face remains block aligned for compression.
+static void GenerateCubemap2x3Mips(Image& _img_, uint32 _mipFlags)
+{
+	uint mipCount = 0;
+	for (uint face = _img_.getWidth() / 2; face >= 4 && face % 4 == 0 && _img_.getHeight() == face * 3; face /= 2) {
+		++mipCount;
+	}
+	if (mipCount < 2) {
+		return;
+	}
+	Image* mips = Image::Create2d(_img_.getWidth(), _img_.getHeight(), _img_.getLayout(), _img_.getImageDataType(), mipCount);
+	memcpy(mips->getRawImage(0, 0), _img_.getRawImage(0, 0), _img_.getRawImageSize(0));
+	MipGenerator::Generate(*mips, MipGenerator::Filter_Box, _mipFlags);
+	swap(_img_, *mips);
+	Image::Destroy(mips);
+}
+
+// Apply the processing specified by _flags to _img_.
+static void Cook(Image& _img_, uint32 _flags)
+{
+	const bool cubemap2x3 = (_flags & TextureCache::Flag_Cubemap2x3) != 0;
+	if ((_flags & TextureCache::Flag_Mips) && _img_.getMipmapCount() == 1 && !_img_.isCompressed() && (_img_.getWidth() > 1 || _img_.getHeight() > 1)) {
+		const bool srgb = (_flags & TextureCache::Flag_Srgb) && _img_.getImageDataType() == DataType::Uint8N
+			&& (_img_.getLayout() == Image::Layout_RGB || _img_.getLayout() == Image::Layout_RGBA);
+		const uint32 mipFlags = srgb ? MipGenerator::Flag_Srgb : 0;
+		if (cubemap2x3) {
+			GenerateCubemap2x3Mips(_img_, mipFlags);
+		} else {
+			Image* img = MipGenerator::Create(_img_, MipGenerator::Filter_Kaiser, mipFlags);
+			if (img) {
+				swap(_img_, *img);
+				Image::Destroy(img);
+			}
+		}
+	}
+	TextureCompressor::Format format;
+	if ((_flags & TextureCache::Flag_Compress) && TextureCompressor::ChooseFormat(_img_, format)) {
+		if (cubemap2x3 && (_img_.getWidth() / 2) % 4 != 0) {
+			return; // faces aren't block aligned
+		}
+		Image* img = TextureCompressor::Compress(_img_, format);
+		if (img) {
+			swap(_img_, *img);
+			Image::Destroy(img);
+		}
+	}
+}
+
+// Read the cooked file for _key into img_. Return false if the file doesn't exist or is invalid (in which
+// case it's counted as a reject).
+static bool ReadCooked(uint64 _key, uint64 _srcSize, Image& img_)
+{
+	FileSystem::PathStr pth;
+	MakeCookedPath(pth, _key);
+	File f;
+	if (!FileSystem::ReadIfExists(f, pth)) {
+		return false;
+	}
+	bool ret = false;
+	Image* img = nullptr;
+	FileHeader fh;
+	if (f.getDataSize() >= sizeof(FileHeader)) {
+		memcpy(&fh, f.getData(), sizeof(FileHeader));
+		ret = fh.m_magic == kFileMagic && fh.m_version == kFileVersion && fh.m_key == _key && fh.m_srcSize == _srcSize
+			&& fh.m_dataSize == f.getDataSize() - sizeof(FileHeader);
+	}
+	if (ret) {
+		Image::Layout layout = (Image::Layout)fh.m_layout;
+		Image::DataType dataType = (Image::DataType::Enum)fh.m_dataType;
+		Image::CompressionType compression = (Image::CompressionType)fh.m_compression;
+		switch ((Image::Type)fh.m_type) {
+			case Image::Type_1d: img = Image::Create1d(fh.m_width, layout, dataType, fh.m_mipCount, compression); break;
+			case Image::Type_2d: img = Image::Create2d(fh.m_width, fh.m_height, layout, dataType, fh.m_mipCount, compression); break;
+			case Image::Type_3d: img = Image::Create3d(fh.m_width, fh.m_height, fh.m_depth, layout, dataType, fh.m_mipCount, compression); break;
+			default: ret = false; break;
+		};
+	}
+	if (img) {
+		const char* src = f.getData() + sizeof(FileHeader);
+		const char* end = f.getData() + f.getDataSize();
+		for (uint i = 0; ret && i < img->getMipmapCount(); ++i) {
+			uint size = img->getRawImageSize(i);
+			if (src + size > end) {
+				ret = false;
+				break;
+			}
+			memcpy(img->getRawImage(0, i), src, size);
+			src += size;
+		}
+		if (ret) {
+			swap(img_, *img);
+		}
+		Image::Destroy(img);
+	}
+	if (!ret) {
+		APT_LOG_ERR("TextureCache: Invalid cooked file '%s'", (const char*)pth);
+		std::lock_guard<std::mutex> lock(g_statsMutex);
+		++g_stats.m_rejectCount;
+	}
+	return ret;
+}
+
+static bool WriteCooked(uint64 _key, uint64 _srcSize, const Image& _img)
+{
+	switch (_img.getType()) {
+		case Image::Type_1d:
+		case Image::Type_2d:
+		case Image::Type_3d:
+			break;
+		default:
+			return false;
+	};
+
+	FileHeader fh = {};
+	fh.m_magic       = kFileMagic;
+	fh.m_version     = kFileVersion;
+	fh.m_key         = _key;
+	fh.m_srcSize     = _srcSize;
+	fh.m_type        = (uint32)_img.getType();
+	fh.m_layout      = (uint32)_img.getLayout();
+	fh.m_dataType    = (uint32)(Image::DataType::Enum)_img.getImageDataType();
+	fh.m_compression = (uint32)_img.getCompressionType();
+	fh.m_width       = _img.getWidth();
+	fh.m_height      = _img.getHeight();
+	fh.m_depth       = _img.getDepth();
+	fh.m_mipCount    = _img.getMipmapCount();
+	for (uint i = 0; i < _img.getMipmapCount(); ++i) {
+		fh.m_dataSize += _img.getRawImageSize(i);
+	}
+
+	eastl::vector<char> data;
+	data.reserve(sizeof(FileHeader) + (size_t)fh.m_dataSize);
+	data.insert(data.end(), (const char*)&fh, (const char*)&fh + sizeof(FileHeader));
+	for (uint i = 0; i < _img.getMipmapCount(); ++i) {
+		const char* raw = _img.getRawImage(0, i);
+		data.insert(data.end(), raw, raw + _img.getRawImageSize(i));
+	}
+
+	FileSystem::PathStr pth;
+	MakeCookedPath(pth, _key);
+	File f;
+	f.setData(data.data(), (uint)data.size());
+	if (!FileSystem::Write(f, pth)) {
+		APT_LOG_ERR("TextureCache: Failed to write '%s'", (const char*)pth);
+		return false;
+	}
+	return true;
+}
+
+// PUBLIC
+
+bool TextureCache::Init(const char* _dir)
+{
+	g_enabled = false;
+	memset(&g_stats, 0, sizeof(g_stats));
+	if (!FileUtil::CreateDir(_dir)) {
+		APT_LOG_ERR("TextureCache: Failed to create '%s', cache disabled", _dir);
+		return false;
+	}
+	g_dir.set(_dir);
+	g_enabled = true;
+	return true;
+}
+
+void TextureCache::Shutdown()
+{
+	g_enabled = false;
+}
+
+bool TextureCache::IsEnabled()
+{
+	return g_enabled;
+}
+
+bool TextureCache::Load(const char* _path, uint32 _flags, Image& img_)
+{
+	Timestamp t = Time::GetTimestamp();
+	File f;
+	if (!FileSystem::Read(f, _path)) {
+		return false;
+	}
+	const uint64 srcSize = (uint64)f.getDataSize();
+	uint64 key = 0;
+	if (g_enabled) {
+		key = MakeKey(f, _flags);
+		if (ReadCooked(key, srcSize, img_)) {
+			std::lock_guard<std::mutex> lock(g_statsMutex);
+			++g_stats.m_hitCount;
+			g_stats.m_hitTimeMs += (Time::GetTimestamp() - t).asMilliseconds();
+			return true;
+		}
+	}
+
+	if (!Texture::ReadImage(img_, f)) {
+		return false;
+	}
+	Cook(img_, _flags);
+
+	if (g_enabled) {
+		WriteCooked(key, srcSize, img_);
+		std::lock_guard<std::mutex> lock(g_statsMutex);
+		++g_stats.m_missCount;
+		g_stats.m_missTimeMs += (Time::GetTimestamp() - t).asMilliseconds();
+	}
+	return true;
+}
+
+int TextureCache::Precook(const char* _dir, uint32 _flags)
+{
+	if (!g_enabled) {
+		APT_LOG_ERR("TextureCache::Precook: Cache not enabled");
+		return -1;
+	}
+	APT_AUTOTIMER("TextureCache::Precook(%s)", _dir);
+
+	eastl::vector<FileSystem::PathStr> paths;
+	if (!ListSourceFiles(_dir, paths)) {
+		APT_LOG_ERR("TextureCache::Precook: Failed to read '%s'", _dir);
+		return -1;
+	}
+	std::atomic<int> ret(0);
+	ThreadPool::ParallelFor((int)paths.size(), [&](int _i) {
+		Image img;
+		if (Load(paths[_i], _flags, img)) {
+			++ret;
+		} else {
+			APT_LOG_ERR("TextureCache::Precook: Failed to cook '%s'", (const char*)paths[_i]);
+		}
+	});
+	APT_LOG("TextureCache::Precook: Cooked %d/%d files from '%s'", (int)ret, (int)paths.size(), _dir);
+	return ret;
+}
+
+TextureCache::Stats TextureCache::GetStats()
+{
+	std::lock_guard<std::mutex> lock(g_statsMutex);
+	return g_stats;
+}
+
+void TextureCache::LogReport()
+{
+	if (!g_enabled) {
+		return;
+	}
+	Stats stats = GetStats();
+	APT_LOG("TextureCache: %d hits (%.2fms), %d misses (%.2fms), %d rejected",
+		stats.m_hitCount,
+		stats.m_hitTimeMs,
+		stats.m_missCount,
+		stats.m_missTimeMs,
+		stats.m_rejectCount
+		);
+}
@@ -0,0 +1,71 @@
+#pragma once
+#ifndef frm_TextureCache_h
+#define frm_TextureCache_h
+
+#include <frm/def.h>
+
+namespace frm {
+
+////////////////////////////////////////////////////////////////////////////////
+// TextureCache
+// On-disk cache of cooked (decoded, mipmapped, block compressed) images.
+// - Load() reads a source file, applies the processing specified by the flags
+//   and writes the result to the cache directory. Subsequent loads of the same
+//   source data read the cooked file directly (a single read + copy, no
+//   decoding or processing).
+// - Entries are keyed by a hash of the source file data and the flags, hence
+//   an edited source is cooked again and stale entries are never read. Stale
+//   files aren't deleted, clear the directory to reclaim space.
+// - Cooked files contain a header plus the raw data of each array layer/mip,
+//   in the order expected by apt::Image (1d/2d/3d images only, other types are
+//   processed but not cached).
+// - Precook() cooks all supported files in a directory ahead of time.
+// - Load() may be called from worker threads.
+////////////////////////////////////////////////////////////////////////////////
+class TextureCache
+{
+public:
+	enum Flag
+	{
+		Flag_Mips       = 1 << 0, // Generate a mip chain if the image has none (MipGenerator).
+		Flag_Compress   = 1 << 1, // Block compress in the format chosen by TextureCompressor::ChooseFormat().
+		Flag_Cubemap2x3 = 1 << 2, // Image is a 2x3 cubemap (see Texture::CreateCubemap2x3), box filter mips within each face.
+		Flag_Srgb       = 1 << 3  // RGB is sRGB encoded (8-bit RGB/RGBA images only), mips are filtered in linear space.
+	};
+
+	struct Stats
+	{
+		int    m_hitCount;
+		int    m_missCount;
+		int    m_rejectCount;   // Cooked files which failed validation (cooked again).
+		double m_hitTimeMs;     // Total time spent loading hits.
+		double m_missTimeMs;    // Total time spent decoding/processing misses.
+	};
+
+	// Enable the cache, cooked files are read from/written to _dir (created if it doesn't exist). Return false
+	// if the directory couldn't be created (the cache is disabled).
+	static bool  Init(const char* _dir);
+
+	static void  Shutdown();
+
+	static bool  IsEnabled();
+
+	// Read _path into img_, process according to _flags. If the cache is enabled the result is read from the
+	// cooked file, if valid, else the cooked file is written.
+	static bool  Load(const char* _path, uint32 _flags, apt::Image& img_);
+
+	// Cook all supported files in _dir and its subdirectories with _flags (the cache must be enabled). Files
+	// are processed in parallel via ThreadPool. Return the number of files cooked (or already up to date), -1
+	// if _dir couldn't be read.
+	static int   Precook(const char* _dir, uint32 _flags);
+
+	static Stats GetStats();
+
+	// Log hits/misses and load times.
+	static void  LogReport();
+
+}; // class TextureCache
+
+} // namespace frm
+
+#endif // frm_TextureCache_h
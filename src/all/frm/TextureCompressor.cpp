@@ -0,0 +1,958 @@
+#include <frm/TextureCompressor.h>
+
+#include <frm/ThreadPool.h>
+
+#include <apt/log.h>
+#include <apt/Image.h>
+
+#include <EASTL/utility.h>
+#include <EASTL/vector.h>
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define TextureCompressor_SSE 1
+	#include <xmmintrin.h>
+#else
+	#define TextureCompressor_SSE 0
+#endif
+
+using namespace frm;
+using namespace apt;
+
+// 4x4 texels, stored as separate channels. Values are in [0,255], or half float bit patterns for BC6H.
+struct Block
+{
+	alignas(16) float m_c[4][16];
+};
+
+static const float kHalfMax = 31743.0f; // 0x7bff, max finite half float.
+
+struct FormatDesc
+{
+	const char*             m_name;
+	Image::CompressionType  m_compression;
+	Image::Layout           m_layout;
+	int                     m_blockSize;  // Bytes.
+	int                     m_channelCount;
+	float                   m_peak;       // Max channel value (255, or the max half float for BC6H).
+};
+static const FormatDesc kFormats[TextureCompressor::Format_Count] =
+{
+	{ "BC1",  Image::Compression_BC1, Image::Layout_RGB,  8,  3, 255.0f      },
+	{ "BC3",  Image::Compression_BC3, Image::Layout_RGBA, 16, 4, 255.0f      },
+	{ "BC4",  Image::Compression_BC4, Image::Layout_R,    8,  1, 255.0f      },
+	{ "BC5",  Image::Compression_BC5, Image::Layout_RG,   16, 2, 255.0f      },
+	{ "BC6H", Image::Compression_BC6, Image::Layout_RGB,  16, 3, kHalfMax    },
+	{ "BC7",  Image::Compression_BC7, Image::Layout_RGBA, 16, 4, 255.0f      },
+};
+
+// Per-quality encoder parameters.
+struct QualityDesc
+{
+	const char* m_name;
+	int         m_iterations;      // Least squares endpoint refinement iterations.
+	bool        m_alphaModes;      // BC4: also try the 6 value mode (exact 0 and 255).
+	int         m_alphaSearch;     // BC4: search +-N around the initial endpoints.
+	bool        m_exhaustivePbits; // BC7: try all p-bit combinations.
+};
+static const QualityDesc kQualities[TextureCompressor::Quality_Count] =
+{
+	{ "Fast",   0, false, 0, false },
+	{ "Normal", 2, true,  0, false },
+	{ "High",   8, true,  2, true  },
+};
+
+static const int kBlockRowsPerJob = 4;   // Granularity of the parallel encode.
+static const int kWeights4[16]    = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 }; // BC6H/BC7 4-bit index weights (/64).
+static const float kWeights4f[16] =
+{
+	 0.0f / 64.0f,  4.0f / 64.0f,  9.0f / 64.0f, 13.0f / 64.0f, 17.0f / 64.0f, 21.0f / 64.0f, 26.0f / 64.0f, 30.0f / 64.0f,
+	34.0f / 64.0f, 38.0f / 64.0f, 43.0f / 64.0f, 47.0f / 64.0f, 51.0f / 64.0f, 55.0f / 64.0f, 60.0f / 64.0f, 64.0f / 64.0f
+};
+
+static int GetComponentCount(Image::Layout _layout)
+{
+	switch (_layout) {
+		case Image::Layout_R:    return 1;
+		case Image::Layout_RG:   return 2;
+		case Image::Layout_RGB:  return 3;
+		case Image::Layout_RGBA: return 4;
+		default:                 return 0;
+	};
+}
+
+// Call _job(i) for i in [0,_count), via ThreadPool unless _serial.
+static void For(int _count, bool _serial, const ThreadPool::IndexJob& _job)
+{
+	if (_serial) {
+		for (int i = 0; i < _count; ++i) {
+			_job(i);
+		}
+	} else {
+		ThreadPool::ParallelFor(_count, _job);
+	}
+}
+
+static float Clamp(float _x, float _max)
+{
+	return APT_MIN(APT_MAX(_x, 0.0f), _max);
+}
+
+// Return the bit pattern of the nearest half float to _x, clamped to [0,kHalfMax]. BC6H endpoints are 
+// interpolated as integers in this domain, which is approximately logarithmic.
+static uint16 FloatToHalfBits(float _x)
+{
+	_x = APT_MIN(APT_MAX(_x, 0.0f), 65504.0f);
+	if (_x < 6.103515625e-5f) {
+		return (uint16)(_x * 16777216.0f + 0.5f); // denormal, multiple of 2^-24
+	}
+	uint32 u;
+	memcpy(&u, &_x, 4);
+	uint32 mant = u & 0x7fffff;
+	uint32 ret = ((((u >> 23) & 0xff) - 127 + 15) << 10) | (mant >> 13);
+	uint32 rem = mant & 0x1fff;
+	if (rem > 0x1000 || (rem == 0x1000 && (ret & 1))) {
+		++ret;
+	}
+	return (uint16)APT_MIN(ret, (uint32)kHalfMax);
+}
+
+// Load the 4x4 block at _bx,_by from _raw (_img format, _w*_h texels), clamp at the image edges. Missing
+// channels are 0,0,0,255 (or 1 if _hdr, in which case the values are half float bit patterns).
+static void ReadBlock(const Image& _img, const char* _raw, int _w, int _h, int _bx, int _by, bool _hdr, Block& block_)
+{
+	const int compCount = GetComponentCount(_img.getLayout());
+	const DataType srcType = _img.getImageDataType();
+	const int texelSize = (int)_img.getTexelSize();
+	for (int y = 0; y < 4; ++y) {
+		const int sy = APT_MIN(_by * 4 + y, _h - 1);
+		const char* row = _raw + (size_t)sy * _w * texelSize;
+		for (int x = 0; x < 4; ++x) {
+			const int sx = APT_MIN(_bx * 4 + x, _w - 1);
+			const char* src = row + sx * texelSize;
+			float texel[4] = { 0.0f, 0.0f, 0.0f, 255.0f };
+			if (_hdr) {
+				float tmp[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+				if (srcType == DataType::Float32) {
+					memcpy(tmp, src, compCount * sizeof(float));
+				} else {
+					DataType::Convert(srcType, DataType::Float32, src, tmp, (uint)compCount);
+				}
+				for (int c = 0; c < 4; ++c) {
+					texel[c] = (float)FloatToHalfBits(tmp[c]);
+				}
+			} else if (srcType == DataType::Uint8N) {
+				for (int c = 0; c < compCount; ++c) {
+					texel[c] = (float)((const uint8*)src)[c];
+				}
+			} else {
+				float tmp[4];
+				DataType::Convert(srcType, DataType::Float32, src, tmp, (uint)compCount);
+				for (int c = 0; c < compCount; ++c) {
+					texel[c] = Clamp(floorf(tmp[c] * 255.0f + 0.5f), 255.0f);
+				}
+			}
+			for (int c = 0; c < 4; ++c) {
+				block_.m_c[c][y * 4 + x] = texel[c];
+			}
+		}
+	}
+}
+
+/*******************************************************************************
+
+                                  Encoding
+
+*******************************************************************************/
+
+// Find the nearest entry in _palette for each texel of _channels (_channelCount arrays of 16 values),
+// return the total squared error.
+static float FindIndices(const float* const* _channels, int _channelCount, const float (*_palette)[4], int _paletteSize, uint8* indices_)
+{
+	float ret = 0.0f;
+	#if TextureCompressor_SSE
+		for (int i = 0; i < 16; i += 4) {
+			__m128 best = _mm_set1_ps(FLT_MAX);
+			__m128 bestIndex = _mm_setzero_ps();
+			for (int p = 0; p < _paletteSize; ++p) {
+				__m128 d = _mm_setzero_ps();
+				for (int c = 0; c < _channelCount; ++c) {
+					__m128 e = _mm_sub_ps(_mm_load_ps(_channels[c] + i), _mm_set1_ps(_palette[p][c]));
+					d = _mm_add_ps(d, _mm_mul_ps(e, e));
+				}
+				__m128 mask = _mm_cmplt_ps(d, best);
+				best = _mm_min_ps(d, best);
+				bestIndex = _mm_or_ps(_mm_and_ps(mask, _mm_set1_ps((float)p)), _mm_andnot_ps(mask, bestIndex));
+			}
+			alignas(16) float err[4];
+			alignas(16) float idx[4];
+			_mm_store_ps(err, best);
+			_mm_store_ps(idx, bestIndex);
+			for (int j = 0; j < 4; ++j) {
+				indices_[i + j] = (uint8)idx[j];
+				ret += err[j];
+			}
+		}
+	#else
+		for (int i = 0; i < 16; ++i) {
+			float best = FLT_MAX;
+			for (int p = 0; p < _paletteSize; ++p) {
+				float d = 0.0f;
+				for (int c = 0; c < _channelCount; ++c) {
+					float e = _channels[c][i] - _palette[p][c];
+					d += e * e;
+				}
+				if (d < best) {
+					best = d;
+					indices_[i] = (uint8)p;
+				}
+			}
+			ret += best;
+		}
+	#endif
+	return ret;
+}
+
+// Initialize endpoints _e0_,_e1_ from the extent of _channels along the principal axis, clamp to [0,_max].
+static void FitPrincipalAxis(const float* const* _channels, int _channelCount, float _max, float* e0_, float* e1_)
+{
+	float mean[4] = {};
+	for (int c = 0; c < _channelCount; ++c) {
+		for (int i = 0; i < 16; ++i) {
+			mean[c] += _channels[c][i];
+		}
+		mean[c] /= 16.0f;
+	}
+	float cov[4][4] = {};
+	for (int i = 0; i < 16; ++i) {
+		for (int c = 0; c < _channelCount; ++c) {
+			float dc = _channels[c][i] - mean[c];
+			for (int k = c; k < _channelCount; ++k) {
+				cov[c][k] += dc * (_channels[k][i] - mean[k]);
+			}
+		}
+	}
+	for (int c = 0; c < _channelCount; ++c) {
+		for (int k = 0; k < c; ++k) {
+			cov[c][k] = cov[k][c];
+		}
+	}
+
+ // power iteration
+	float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (int it = 0; it < 8; ++it) {
+		float next[4] = {};
+		float len = 0.0f;
+		for (int c = 0; c < _channelCount; ++c) {
+			for (int k = 0; k < _channelCount; ++k) {
+				next[c] += cov[c][k] * axis[k];
+			}
+			len = APT_MAX(len, fabsf(next[c]));
+		}
+		if (len < 1e-6f) {
+			break; // constant block (or the initial axis is orthogonal to the data)
+		}
+		for (int c = 0; c < _channelCount; ++c) {
+			axis[c] = next[c] / len;
+		}
+	}
+	float len2 = 0.0f;
+	for (int c = 0; c < _channelCount; ++c) {
+		len2 += axis[c] * axis[c];
+	}
+	for (int c = 0; c < _channelCount; ++c) {
+		axis[c] /= sqrtf(len2);
+	}
+
+	float tmin = FLT_MAX, tmax = -FLT_MAX;
+	for (int i = 0; i < 16; ++i) {
+		float t = 0.0f;
+		for (int c = 0; c < _channelCount; ++c) {
+			t += (_channels[c][i] - mean[c]) * axis[c];
+		}
+		tmin = APT_MIN(tmin, t);
+		tmax = APT_MAX(tmax, t);
+	}
+	for (int c = 0; c < _channelCount; ++c) {
+		e0_[c] = Clamp(mean[c] + axis[c] * tmax, _max);
+		e1_[c] = Clamp(mean[c] + axis[c] * tmin, _max);
+	}
+}
+
+// Solve for endpoints _e0_,_e1_ which minimize the error given _indices, where _weights[index] is the
+// interpolation factor toward _e1_, clamp to [0,_max]. Return false if singular.
+static bool RefineEndpoints(const float* const* _channels, int _channelCount, const uint8* _indices, const float* _weights, float _max, float* e0_, float* e1_)
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[4] = {}, bx[4] = {};
+	for (int i = 0; i < 16; ++i) {
+		float w = _weights[_indices[i]];
+		float a = 1.0f - w;
+		aa += a * a;
+		ab += a * w;
+		bb += w * w;
+		for (int c = 0; c < _channelCount; ++c) {
+			ax[c] += a * _channels[c][i];
+			bx[c] += w * _channels[c][i];
+		}
+	}
+	float det = aa * bb - ab * ab;
+	if (fabsf(det) < 1e-6f) {
+		return false;
+	}
+	det = 1.0f / det;
+	for (int c = 0; c < _channelCount; ++c) {
+		e0_[c] = Clamp((bb * ax[c] - ab * bx[c]) * det, _max);
+		e1_[c] = Clamp((aa * bx[c] - ab * ax[c]) * det, _max);
+	}
+	return true;
+}
+
+static uint16 Pack565(const float* _c)
+{
+	uint16 r = (uint16)(_c[0] * 31.0f / 255.0f + 0.5f);
+	uint16 g = (uint16)(_c[1] * 63.0f / 255.0f + 0.5f);
+	uint16 b = (uint16)(_c[2] * 31.0f / 255.0f + 0.5f);
+	return (uint16)((r << 11) | (g << 5) | b);
+}
+
+static void Unpack565(uint16 _c, int* rgb_)
+{
+	int r = (_c >> 11) & 31, g = (_c >> 5) & 63, b = _c & 31;
+	rgb_[0] = (r << 3) | (r >> 2);
+	rgb_[1] = (g << 2) | (g >> 4);
+	rgb_[2] = (b << 3) | (b >> 2);
+}
+
+// Encode the RGB channels of _block as a 4 color BC1 block.
+static float EncodeColorBlock(const Block& _block, const QualityDesc& _quality, uint8* dst_)
+{
+	static const float kWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	const float* channels[3] = { _block.m_c[0], _block.m_c[1], _block.m_c[2] };
+
+	float e0[4], e1[4];
+	FitPrincipalAxis(channels, 3, 255.0f, e0, e1);
+
+	float bestErr = FLT_MAX;
+	for (int it = 0; it <= _quality.m_iterations; ++it) {
+		uint16 c0 = Pack565(e0);
+		uint16 c1 = Pack565(e1);
+		if (c0 < c1) {
+			eastl::swap(c0, c1);
+		}
+		float palette[4][4];
+		int rgb0[3], rgb1[3];
+		Unpack565(c0, rgb0);
+		Unpack565(c1, rgb1);
+		for (int c = 0; c < 3; ++c) {
+			palette[0][c] = (float)rgb0[c];
+			palette[1][c] = (float)rgb1[c];
+			palette[2][c] = (float)((2 * rgb0[c] + rgb1[c]) / 3);
+			palette[3][c] = (float)((rgb0[c] + 2 * rgb1[c]) / 3);
+		}
+		alignas(16) uint8 indices[16];
+		float err = FindIndices(channels, 3, palette, c0 == c1 ? 1 : 4, indices); // c0 == c1 is the 3 color mode, only use index 0
+
+		if (err < bestErr) {
+			bestErr = err;
+			uint32 bits = 0;
+			for (int i = 0; i < 16; ++i) {
+				bits |= (uint32)indices[i] << (i * 2);
+			}
+			dst_[0] = (uint8)c0; dst_[1] = (uint8)(c0 >> 8);
+			dst_[2] = (uint8)c1; dst_[3] = (uint8)(c1 >> 8);
+			memcpy(dst_ + 4, &bits, 4);
+		}
+		if (err == 0.0f || it == _quality.m_iterations || !RefineEndpoints(channels, 3, indices, kWeights, 255.0f, e0, e1)) {
+			break;
+		}
+	}
+	return bestErr;
+}
+
+// Build the BC4 palette for _r0,_r1 (the 6 value mode if _r0 <= _r1).
+static void GetAlphaPalette(int _r0, int _r1, float (*palette_)[4])
+{
+	palette_[0][0] = (float)_r0;
+	palette_[1][0] = (float)_r1;
+	if (_r0 > _r1) {
+		for (int i = 1; i < 7; ++i) {
+			palette_[i + 1][0] = (float)(((7 - i) * _r0 + i * _r1) / 7);
+		}
+	} else {
+		for (int i = 1; i < 5; ++i) {
+			palette_[i + 1][0] = (float)(((5 - i) * _r0 + i * _r1) / 5);
+		}
+		palette_[6][0] = 0.0f;
+		palette_[7][0] = 255.0f;
+	}
+}
+
+// Encode a single channel (16 values) as a BC4 block.
+static float EncodeAlphaBlock(const float* _values, const QualityDesc& _quality, uint8* dst_)
+{
+	float vmin = 255.0f, vmax = 0.0f;
+	float innerMin = 255.0f, innerMax = 0.0f; // excluding 0 and 255
+	for (int i = 0; i < 16; ++i) {
+		vmin = APT_MIN(vmin, _values[i]);
+		vmax = APT_MAX(vmax, _values[i]);
+		if (_values[i] > 0.5f && _values[i] < 254.5f) {
+			innerMin = APT_MIN(innerMin, _values[i]);
+			innerMax = APT_MAX(innerMax, _values[i]);
+		}
+	}
+
+	float bestErr = FLT_MAX;
+	int bestR0 = 0, bestR1 = 0;
+	alignas(16) uint8 bestIndices[16];
+	auto tryEndpoints = [&](int _r0, int _r1) {
+		float palette[8][4];
+		GetAlphaPalette(_r0, _r1, palette);
+		alignas(16) uint8 indices[16];
+		float err = FindIndices(&_values, 1, palette, 8, indices);
+		if (err < bestErr) {
+			bestErr = err;
+			bestR0 = _r0;
+			bestR1 = _r1;
+			memcpy(bestIndices, indices, 16);
+		}
+	};
+
+	int r0 = (int)(vmax + 0.5f);
+	int r1 = (int)(vmin + 0.5f);
+	if (r0 == r1) {
+		tryEndpoints(r0, r1); // exact
+	} else {
+		tryEndpoints(r0, r1);
+		for (int d0 = -_quality.m_alphaSearch; d0 <= _quality.m_alphaSearch && bestErr > 0.0f; ++d0) {
+			for (int d1 = -_quality.m_alphaSearch; d1 <= _quality.m_alphaSearch; ++d1) {
+				int s0 = APT_MIN(APT_MAX(r0 + d0, 0), 255);
+				int s1 = APT_MIN(APT_MAX(r1 + d1, 0), 255);
+				if (s0 > s1) {
+					tryEndpoints(s0, s1);
+				}
+			}
+		}
+		if (_quality.m_alphaModes && bestErr > 0.0f && (vmin < 0.5f || vmax > 254.5f)) {
+			if (innerMin > innerMax) {
+				tryEndpoints(0, 0); // only 0 and 255
+			} else {
+				tryEndpoints((int)(innerMin + 0.5f), (int)(innerMax + 0.5f));
+			}
+		}
+	}
+
+	dst_[0] = (uint8)bestR0;
+	dst_[1] = (uint8)bestR1;
+	uint64 bits = 0;
+	for (int i = 0; i < 16; ++i) {
+		bits |= (uint64)bestIndices[i] << (i * 3);
+	}
+	for (int i = 0; i < 6; ++i) {
+		dst_[2 + i] = (uint8)(bits >> (i * 8));
+	}
+	return bestErr;
+}
+
+struct BitWriter
+{
+	uint8* m_dst;
+	int    m_bit;
+
+	BitWriter(uint8* _dst): m_dst(_dst), m_bit(0) { memset(_dst, 0, 16); }
+
+	void write(uint32 _value, int _bitCount)
+	{
+		for (int i = 0; i < _bitCount; ++i, ++m_bit) {
+			m_dst[m_bit / 8] |= (uint8)(((_value >> i) & 1) << (m_bit % 8));
+		}
+	}
+};
+
+struct BitReader
+{
+	const uint8* m_src;
+	int          m_bit;
+
+	BitReader(const uint8* _src): m_src(_src), m_bit(0) {}
+
+	uint32 read(int _bitCount)
+	{
+		uint32 ret = 0;
+		for (int i = 0; i < _bitCount; ++i, ++m_bit) {
+			ret |= (uint32)((m_src[m_bit / 8] >> (m_bit % 8)) & 1) << i;
+		}
+		return ret;
+	}
+};
+
+// Quantize _e to 7 bits per channel + a shared p-bit. If _pbit < 0 choose the p-bit which minimizes the
+// quantization error.
+static void QuantizeBc7Endpoint(const float* _e, int _pbit, uint8* q_, int& pbit_)
+{
+	float bestErr = FLT_MAX;
+	for (int p = 0; p < 2; ++p) {
+		if (_pbit >= 0 && p != _pbit) {
+			continue;
+		}
+		uint8 q[4];
+		float err = 0.0f;
+		for (int c = 0; c < 4; ++c) {
+			int v = (int)floorf((_e[c] - (float)p) * 0.5f + 0.5f);
+			q[c] = (uint8)APT_MIN(APT_MAX(v, 0), 127);
+			float d = (float)((q[c] << 1) | p) - _e[c];
+			err += d * d;
+		}
+		if (err < bestErr) {
+			bestErr = err;
+			memcpy(q_, q, 4);
+			pbit_ = p;
+		}
+	}
+}
+
+// Encode _block as a BC7 mode 6 block.
+static float EncodeBc7Block(const Block& _block, const QualityDesc& _quality, uint8* dst_)
+{
+	const float* channels[4] = { _block.m_c[0], _block.m_c[1], _block.m_c[2], _block.m_c[3] };
+
+	float e0[4], e1[4];
+	FitPrincipalAxis(channels, 4, 255.0f, e0, e1);
+
+	float bestErr = FLT_MAX;
+	uint8 bestQ[2][4];
+	int bestP[2] = { 0, 0 };
+	alignas(16) uint8 bestIndices[16];
+	for (int it = 0; it <= _quality.m_iterations; ++it) {
+		alignas(16) uint8 indices[16];
+		const int pbitCombos = _quality.m_exhaustivePbits ? 4 : 1;
+		for (int pc = 0; pc < pbitCombos; ++pc) {
+			uint8 q[2][4];
+			int p[2];
+			QuantizeBc7Endpoint(e0, _quality.m_exhaustivePbits ? (pc & 1) : -1, q[0], p[0]);
+			QuantizeBc7Endpoint(e1, _quality.m_exhaustivePbits ? (pc >> 1) : -1, q[1], p[1]);
+			float palette[16][4];
+			for (int c = 0; c < 4; ++c) {
+				int a = (q[0][c] << 1) | p[0];
+				int b = (q[1][c] << 1) | p[1];
+				for (int i = 0; i < 16; ++i) {
+					palette[i][c] = (float)(((64 - kWeights4[i]) * a + kWeights4[i] * b + 32) >> 6);
+				}
+			}
+			float err = FindIndices(channels, 4, palette, 16, indices);
+			if (err < bestErr) {
+				bestErr = err;
+				memcpy(bestQ, q, sizeof(q));
+				bestP[0] = p[0];
+				bestP[1] = p[1];
+				memcpy(bestIndices, indices, 16);
+			}
+		}
+		if (bestErr == 0.0f || it == _quality.m_iterations || !RefineEndpoints(channels, 4, bestIndices, kWeights4f, 255.0f, e0, e1)) {
+			break;
+		}
+	}
+
+ // the MSB of the first index is implicitly 0
+	if (bestIndices[0] & 8) {
+		for (int c = 0; c < 4; ++c) {
+			eastl::swap(bestQ[0][c], bestQ[1][c]);
+		}
+		eastl::swap(bestP[0], bestP[1]);
+		for (int i = 0; i < 16; ++i) {
+			bestIndices[i] = (uint8)(15 - bestIndices[i]);
+		}
+	}
+	BitWriter bits(dst_);
+	bits.write(1 << 6, 7); // mode 6
+	for (int c = 0; c < 4; ++c) {
+		bits.write(bestQ[0][c], 7);
+		bits.write(bestQ[1][c], 7);
+	}
+	bits.write((uint32)bestP[0], 1);
+	bits.write((uint32)bestP[1], 1);
+	bits.write(bestIndices[0], 3);
+	for (int i = 1; i < 16; ++i) {
+		bits.write(bestIndices[i], 4);
+	}
+	return bestErr;
+}
+
+// BC6H (unsigned) endpoint unquantization for 10-bit endpoints.
+static int UnquantizeBc6(int _q)
+{
+	if (_q == 0) {
+		return 0;
+	}
+	if (_q == 1023) {
+		return 0xffff;
+	}
+	return ((_q << 16) + 0x8000) >> 10;
+}
+
+// Interpolate unquantized BC6H endpoints, return the resulting half float bit pattern.
+static int InterpolateBc6(int _a, int _b, int _weight)
+{
+	return ((((64 - _weight) * _a + _weight * _b + 32) >> 6) * 31) >> 6;
+}
+
+// Encode the RGB channels of _block (half float bit patterns) as a BC6H mode 11 block.
+static float EncodeBc6Block(const Block& _block, const QualityDesc& _quality, uint8* dst_)
+{
+	const float* channels[3] = { _block.m_c[0], _block.m_c[1], _block.m_c[2] };
+
+	float e0[4], e1[4];
+	FitPrincipalAxis(channels, 3, kHalfMax, e0, e1);
+
+	float bestErr = FLT_MAX;
+	int bestQ[2][3] = {};
+	alignas(16) uint8 bestIndices[16] = {};
+	for (int it = 0; it <= _quality.m_iterations; ++it) {
+	 // finish(unquantize(q)) = q * 31 + 15 for 0 < q < 1023
+		int q[2][3];
+		for (int c = 0; c < 3; ++c) {
+			q[0][c] = APT_MIN(APT_MAX((int)floorf((e0[c] - 15.0f) / 31.0f + 0.5f), 0), 1023);
+			q[1][c] = APT_MIN(APT_MAX((int)floorf((e1[c] - 15.0f) / 31.0f + 0.5f), 0), 1023);
+		}
+		float palette[16][4];
+		for (int c = 0; c < 3; ++c) {
+			int a = UnquantizeBc6(q[0][c]);
+			int b = UnquantizeBc6(q[1][c]);
+			for (int i = 0; i < 16; ++i) {
+				palette[i][c] = (float)InterpolateBc6(a, b, kWeights4[i]);
+			}
+		}
+		alignas(16) uint8 indices[16];
+		float err = FindIndices(channels, 3, palette, 16, indices);
+		if (err < bestErr) {
+			bestErr = err;
+			memcpy(bestQ, q, sizeof(q));
+			memcpy(bestIndices, indices, 16);
+		}
+		if (bestErr == 0.0f || it == _quality.m_iterations || !RefineEndpoints(channels, 3, bestIndices, kWeights4f, kHalfMax, e0, e1)) {
+			break;
+		}
+	}
+
+ // the MSB of the first index is implicitly 0
+	if (bestIndices[0] & 8) {
+		for (int c = 0; c < 3; ++c) {
+			eastl::swap(bestQ[0][c], bestQ[1][c]);
+		}
+		for (int i = 0; i < 16; ++i) {
+			bestIndices[i] = (uint8)(15 - bestIndices[i]);
+		}
+	}
+	BitWriter bits(dst_);
+	bits.write(0x03, 5); // mode 11
+	for (int c = 0; c < 3; ++c) {
+		bits.write((uint32)bestQ[0][c], 10);
+	}
+	for (int c = 0; c < 3; ++c) {
+		bits.write((uint32)bestQ[1][c], 10);
+	}
+	bits.write(bestIndices[0], 3);
+	for (int i = 1; i < 16; ++i) {
+		bits.write(bestIndices[i], 4);
+	}
+	return bestErr;
+}
+
+static float EncodeBlock(TextureCompressor::Format _format, const Block& _block, const QualityDesc& _quality, uint8* dst_)
+{
+	switch (_format) {
+		case TextureCompressor::Format_BC1:
+			return EncodeColorBlock(_block, _quality, dst_);
+		case TextureCompressor::Format_BC3:
+			return EncodeAlphaBlock(_block.m_c[3], _quality, dst_) + EncodeColorBlock(_block, _quality, dst_ + 8);
+		case TextureCompressor::Format_BC4:
+			return EncodeAlphaBlock(_block.m_c[0], _quality, dst_);
+		case TextureCompressor::Format_BC5:
+			return EncodeAlphaBlock(_block.m_c[0], _quality, dst_) + EncodeAlphaBlock(_block.m_c[1], _quality, dst_ + 8);
+		case TextureCompressor::Format_BC6H:
+			return EncodeBc6Block(_block, _quality, dst_);
+		case TextureCompressor::Format_BC7:
+			return EncodeBc7Block(_block, _quality, dst_);
+		default:
+			APT_ASSERT(false);
+			return 0.0f;
+	};
+}
+
+/*******************************************************************************
+
+                                  Decoding
+
+*******************************************************************************/
+
+static void DecodeColorBlock(const uint8* _src, bool _fourColor, float (*dst_)[4])
+{
+	uint16 c0 = (uint16)(_src[0] | (_src[1] << 8));
+	uint16 c1 = (uint16)(_src[2] | (_src[3] << 8));
+	int palette[4][4];
+	Unpack565(c0, palette[0]);
+	Unpack565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+	for (int c = 0; c < 3; ++c) {
+		if (_fourColor || c0 > c1) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		} else {
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+			palette[3][3] = 0;
+		}
+	}
+	uint32 bits;
+	memcpy(&bits, _src + 4, 4);
+	for (int i = 0; i < 16; ++i) {
+		const int* p = palette[(bits >> (i * 2)) & 3];
+		for (int c = 0; c < 4; ++c) {
+			dst_[i][c] = (float)p[c];
+		}
+	}
+}
+
+static void DecodeAlphaBlock(const uint8* _src, int _channel, float (*dst_)[4])
+{
+	float palette[8][4];
+	GetAlphaPalette(_src[0], _src[1], palette);
+	uint64 bits = 0;
+	for (int i = 0; i < 6; ++i) {
+		bits |= (uint64)_src[2 + i] << (i * 8);
+	}
+	for (int i = 0; i < 16; ++i) {
+		dst_[i][_channel] = palette[(bits >> (i * 3)) & 7][0];
+	}
+}
+
+static bool DecodeBc7Block(const uint8* _src, float (*dst_)[4])
+{
+	BitReader bits(_src);
+	if (bits.read(7) != (1 << 6)) {
+		return false; // not mode 6
+	}
+	int e[2][4];
+	for (int c = 0; c < 4; ++c) {
+		e[0][c] = (int)bits.read(7) << 1;
+		e[1][c] = (int)bits.read(7) << 1;
+	}
+	int p0 = (int)bits.read(1);
+	int p1 = (int)bits.read(1);
+	for (int c = 0; c < 4; ++c) {
+		e[0][c] |= p0;
+		e[1][c] |= p1;
+	}
+	for (int i = 0; i < 16; ++i) {
+		int w = kWeights4[bits.read(i == 0 ? 3 : 4)];
+		for (int c = 0; c < 4; ++c) {
+			dst_[i][c] = (float)(((64 - w) * e[0][c] + w * e[1][c] + 32) >> 6);
+		}
+	}
+	return true;
+}
+
+static bool DecodeBc6Block(const uint8* _src, float (*dst_)[4])
+{
+	BitReader bits(_src);
+	if (bits.read(5) != 0x03) {
+		return false; // not mode 11
+	}
+	int e[2][3];
+	for (int i = 0; i < 2; ++i) {
+		for (int c = 0; c < 3; ++c) {
+			e[i][c] = UnquantizeBc6((int)bits.read(10));
+		}
+	}
+	for (int i = 0; i < 16; ++i) {
+		int w = kWeights4[bits.read(i == 0 ? 3 : 4)];
+		for (int c = 0; c < 3; ++c) {
+			dst_[i][c] = (float)InterpolateBc6(e[0][c], e[1][c], w);
+		}
+	}
+	return true;
+}
+
+static bool DecodeBlock(Image::CompressionType _compression, const uint8* _src, float (*dst_)[4])
+{
+	memset(dst_, 0, sizeof(float) * 16 * 4);
+	switch (_compression) {
+		case Image::Compression_BC1:
+			DecodeColorBlock(_src, false, dst_);
+			return true;
+		case Image::Compression_BC3:
+			DecodeColorBlock(_src + 8, true, dst_);
+			DecodeAlphaBlock(_src, 3, dst_);
+			return true;
+		case Image::Compression_BC4:
+			DecodeAlphaBlock(_src, 0, dst_);
+			return true;
+		case Image::Compression_BC5:
+			DecodeAlphaBlock(_src, 0, dst_);
+			DecodeAlphaBlock(_src + 8, 1, dst_);
+			return true;
+		case Image::Compression_BC6:
+			return DecodeBc6Block(_src, dst_);
+		case Image::Compression_BC7:
+			return DecodeBc7Block(_src, dst_);
+		default:
+			return false;
+	};
+}
+
+/*******************************************************************************
+
+                             TextureCompressor
+
+*******************************************************************************/
+
+// PUBLIC
+
+bool TextureCompressor::ChooseFormat(const Image& _img, Format& format_)
+{
+	if (_img.isCompressed() || _img.getType() != Image::Type_2d) {
+		return false;
+	}
+	switch (_img.getImageDataType()) {
+		case DataType::Uint8N:
+		case DataType::Uint16N:
+		case DataType::Uint32N:
+			break;
+		case DataType::Float16:
+		case DataType::Float32:
+			if (_img.getLayout() == Image::Layout_RGB || _img.getLayout() == Image::Layout_RGBA) {
+				format_ = Format_BC6H;
+				return true;
+			}
+			return false;
+		default:
+			return false;
+	};
+	switch (_img.getLayout()) {
+		case Image::Layout_R:    format_ = Format_BC4; return true;
+		case Image::Layout_RG:   format_ = Format_BC5; return true;
+		case Image::Layout_RGB:  format_ = Format_BC1; return true;
+		case Image::Layout_RGBA: format_ = Format_BC7; return true;
+		default:                 return false;
+	};
+}
+
+Image* TextureCompressor::Compress(const Image& _img, Format _format, Quality _quality, uint32 _flags)
+{
+	APT_ASSERT(_format < Format_Count && _quality < Quality_Count);
+	if (_img.isCompressed()) {
+		APT_LOG_ERR("TextureCompressor: Image is already compressed");
+		return nullptr;
+	}
+	const FormatDesc& format = kFormats[_format];
+	const QualityDesc& quality = kQualities[_quality];
+	const bool hdr = _format == Format_BC6H;
+	const int w = (int)_img.getWidth();
+	const int h = (int)_img.getHeight();
+	const int arrayCount = (int)_img.getArrayCount();
+	const int mipCount = (int)_img.getMipmapCount();
+
+	Image* ret = nullptr;
+	switch (_img.getType()) {
+		case Image::Type_2d: ret = Image::Create2d(w, h, format.m_layout, hdr ? DataType::Float16 : DataType::Uint8N, mipCount, format.m_compression); break;
+		default:             APT_LOG_ERR("TextureCompressor: Unsupported image type"); return nullptr;
+	};
+
+ // each job encodes kBlockRowsPerJob rows of blocks from a single layer/mip
+	struct Job { int m_array, m_mip, m_row; };
+	eastl::vector<Job> jobs;
+	for (int i = 0; i < arrayCount; ++i) {
+		for (int j = 0; j < mipCount; ++j) {
+			int rows = (APT_MAX(h >> j, 1) + 3) / 4;
+			for (int k = 0; k < rows; k += kBlockRowsPerJob) {
+				Job job = { i, j, k };
+				jobs.push_back(job);
+			}
+		}
+	}
+	For((int)jobs.size(), (_flags & Flag_Serial) != 0, [&](int _i) {
+		const Job& job = jobs[_i];
+		const int mw = APT_MAX(w >> job.m_mip, 1);
+		const int mh = APT_MAX(h >> job.m_mip, 1);
+		const int bw = (mw + 3) / 4;
+		const int bh = (mh + 3) / 4;
+		APT_ASSERT((int)ret->getRawImageSize(job.m_mip) >= bw * bh * format.m_blockSize);
+		const char* src = _img.getRawImage(job.m_array, job.m_mip);
+		uint8* dst = (uint8*)ret->getRawImage(job.m_array, job.m_mip);
+		Block block;
+		for (int by = job.m_row, byEnd = APT_MIN(job.m_row + kBlockRowsPerJob, bh); by < byEnd; ++by) {
+			for (int bx = 0; bx < bw; ++bx) {
+				ReadBlock(_img, src, mw, mh, bx, by, hdr, block);
+				EncodeBlock(_format, block, quality, dst + (by * bw + bx) * format.m_blockSize);
+			}
+		}
+	});
+
+	return ret;
+}
+
+double TextureCompressor::ComputePsnr(const Image& _src, const Image& _compressed, int _array, int _mip)
+{
+	if (_src.isCompressed() || !_compressed.isCompressed() ||
+		_src.getWidth() != _compressed.getWidth() || _src.getHeight() != _compressed.getHeight() ||
+		_array >= (int)APT_MIN(_src.getArrayCount(), _compressed.getArrayCount()) ||
+		_mip >= (int)APT_MIN(_src.getMipmapCount(), _compressed.getMipmapCount())) {
+		return -1.0;
+	}
+	int formatIndex = 0;
+	while (formatIndex < Format_Count && kFormats[formatIndex].m_compression != _compressed.getCompressionType()) {
+		++formatIndex;
+	}
+	if (formatIndex == Format_Count) {
+		return -1.0;
+	}
+	const FormatDesc& format = kFormats[formatIndex];
+	const int mw = APT_MAX((int)_src.getWidth()  >> _mip, 1);
+	const int mh = APT_MAX((int)_src.getHeight() >> _mip, 1);
+	const int bw = (mw + 3) / 4;
+	const int bh = (mh + 3) / 4;
+	const char* src = _src.getRawImage(_array, _mip);
+	const uint8* blocks = (const uint8*)_compressed.getRawImage(_array, _mip);
+
+	const bool hdr = format.m_compression == Image::Compression_BC6;
+	double sse = 0.0;
+	Block block;
+	float decoded[16][4];
+	for (int by = 0; by < bh; ++by) {
+		for (int bx = 0; bx < bw; ++bx) {
+			ReadBlock(_src, src, mw, mh, bx, by, hdr, block);
+			if (!DecodeBlock(format.m_compression, blocks + (by * bw + bx) * format.m_blockSize, decoded)) {
+				return -1.0;
+			}
+			for (int i = 0; i < 16; ++i) {
+				if (bx * 4 + i % 4 >= mw || by * 4 + i / 4 >= mh) {
+					continue;
+				}
+				for (int c = 0; c < format.m_channelCount; ++c) {
+					double d = (double)block.m_c[c][i] - (double)decoded[i][c];
+					sse += d * d;
+				}
+			}
+		}
+	}
+	double mse = sse / ((double)mw * mh * format.m_channelCount);
+	if (mse == 0.0) {
+		return 100.0;
+	}
+	return 10.0 * log10((double)format.m_peak * format.m_peak / mse);
+}
+
+const char* TextureCompressor::GetFormatName(Format _format)
+{
+	APT_ASSERT(_format < Format_Count);
+	return kFormats[_format].m_name;
+}
+
+const char* TextureCompressor::GetQualityName(Quality _quality)
+{
+	APT_ASSERT(_quality < Quality_Count);
+	return kQualities[_quality].m_name;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#ifndef frm_TextureCompressor_h
+#define frm_TextureCompressor_h
+
+#include <frm/def.h>
+
+namespace frm {
+
+////////////////////////////////////////////////////////////////////////////////
+// TextureCompressor
+// Block compress an apt::Image on the CPU (no GL calls, hence usable from
+// worker threads and offline tools).
+// - Blocks are encoded in parallel via ThreadPool, the inner loops (palette
+//   index selection) use SSE if available.
+// - Endpoints are initialized from the principal axis of each block and
+//   refined by least squares; the quality preset controls the number of
+//   refinement iterations and the endpoint search.
+// - BC7 is encoded using mode 6 only (single subset RGBA, 4-bit indices),
+//   BC6H (unsigned) using mode 11 only (single region, 10-bit endpoints).
+// - Data is treated as linear UNORM, except for BC6H which clamps to the
+//   positive half float range.
+////////////////////////////////////////////////////////////////////////////////
+class TextureCompressor
+{
+public:
+	enum Format
+	{
+		Format_BC1,  // RGB, 4bpp.
+		Format_BC3,  // RGBA, 8bpp (BC1 color + BC4 alpha).
+		Format_BC4,  // R, 4bpp.
+		Format_BC5,  // RG, 8bpp.
+		Format_BC6H, // RGB half float, 8bpp.
+		Format_BC7,  // RGBA, 8bpp.
+
+		Format_Count
+	};
+
+	enum Quality
+	{
+		Quality_Fast,
+		Quality_Normal,
+		Quality_High,
+
+		Quality_Count
+	};
+
+	enum Flag
+	{
+		Flag_Serial = 1 << 0  // Don't use ThreadPool.
+	};
+
+	// Choose a format based on the layout of _img (BC4/BC5 for R/RG, BC1/BC7 for RGB/RGBA, BC6H for float
+	// RGB/RGBA). Return false if _img isn't suitable for block compression (already compressed, float R/RG 
+	// data, unsupported image type).
+	static bool ChooseFormat(const apt::Image& _img, Format& format_);
+
+	// Compress all mips of _img (2d images only). Return nullptr if _img is compressed
+	// or the image type is unsupported. The result must be released via apt::Image::Destroy().
+	static apt::Image* Compress(const apt::Image& _img, Format _format, Quality _quality = Quality_Normal, uint32 _flags = 0);
+
+	// Return the PSNR (dB) of _compressed relative to _src for _array/_mip, over the channels stored by the
+	// compression format. For BC6H the error is measured on the half float bit patterns (approximately log
+	// space). Return -1 if _compressed can't be decoded (BC6H/BC7 blocks in other modes, mismatched images),
+	// 100 if the images are identical.
+	static double ComputePsnr(const apt::Image& _src, const apt::Image& _compressed, int _array = 0, int _mip = 0);
+
+	static const char* GetFormatName(Format _format);
+	static const char* GetQualityName(Quality _quality);
+
+}; // class TextureCompressor
+
+} // namespace frm
+
+#endif // frm_TextureCompressor_h
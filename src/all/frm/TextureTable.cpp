@@ -0,0 +1,135 @@
+#include <frm/TextureTable.h>
+
+#include <frm/Buffer.h>
+#include <frm/GlContext.h>
+#include <frm/Texture.h>
+
+#include <apt/log.h>
+#include <apt/String.h>
+
+#include <climits>
+
+using namespace frm;
+using namespace apt;
+
+// PUBLIC
+
+TextureTable* TextureTable::Create(int _capacity)
+{
+	return new TextureTable(_capacity);
+}
+
+void TextureTable::Destroy(TextureTable*& _inst_)
+{
+	delete _inst_;
+	_inst_ = nullptr;
+}
+
+int TextureTable::add(Texture* _texture)
+{
+	APT_ASSERT(_texture);
+	auto it = m_indexMap.find(_texture);
+	if (it != m_indexMap.end()) {
+		++m_entries[it->second].m_refCount;
+		return it->second;
+	}
+
+	int ret;
+	if (!m_freeList.empty()) {
+		ret = m_freeList.back();
+		m_freeList.pop_back();
+	} else if ((int)m_entries.size() < m_capacity) {
+		ret = (int)m_entries.size();
+		m_entries.push_back();
+	} else {
+		APT_LOG_ERR("TextureTable: Table is full (%d entries)", m_capacity);
+		return -1;
+	}
+	Texture::Use(_texture);
+	Entry& entry = m_entries[ret];
+	entry.m_texture  = _texture;
+	entry.m_handle   = 0; // uploaded by bind()
+	entry.m_refCount = 1;
+	m_indexMap[_texture] = ret;
+	++m_count;
+	return ret;
+}
+
+void TextureTable::remove(int _index)
+{
+	Entry& entry = m_entries[_index];
+	APT_ASSERT(entry.m_refCount > 0);
+	if (--entry.m_refCount > 0) {
+		return;
+	}
+	m_indexMap.erase(entry.m_texture);
+	Texture::Release(entry.m_texture);
+	entry.m_handle = 0; // the buffer isn't updated, the shader must not access freed entries
+	m_freeList.push_back(_index);
+	--m_count;
+}
+
+void TextureTable::bind(GlContext* _ctx)
+{
+	if (!Texture::GetBindless()) {
+		for (int i = 0, n = APT_MIN((int)m_entries.size(), kFallbackCount); i < n; ++i) {
+			if (m_entries[i].m_texture) {
+				_ctx->bindTexture((const char*)String<32>("uTextureTable[%d]", i), m_entries[i].m_texture);
+			}
+		}
+		return;
+	}
+
+	if (!m_buffer) {
+		m_buffer = Buffer::Create(GL_SHADER_STORAGE_BUFFER, m_capacity * sizeof(GLuint64), GL_DYNAMIC_STORAGE_BIT);
+		m_buffer->setName("_bfTextureTable");
+	}
+
+ // upload the dirty range; handles change if a texture was added or its GL object was replaced (reload, mip streaming)
+	int dirtyBeg = INT_MAX;
+	int dirtyEnd = -1;
+	for (int i = 0; i < (int)m_entries.size(); ++i) {
+		Entry& entry = m_entries[i];
+		if (!entry.m_texture) {
+			continue;
+		}
+		GLuint64 handle = entry.m_texture->getBindlessHandle();
+		if (handle != entry.m_handle) {
+			entry.m_handle = handle;
+			dirtyBeg = APT_MIN(dirtyBeg, i);
+			dirtyEnd = APT_MAX(dirtyEnd, i);
+		}
+	}
+	if (dirtyEnd >= dirtyBeg) {
+		eastl::vector<GLuint64> handles;
+		handles.reserve(dirtyEnd - dirtyBeg + 1);
+		for (int i = dirtyBeg; i <= dirtyEnd; ++i) {
+			handles.push_back(m_entries[i].m_handle);
+		}
+		m_buffer->setData((GLsizeiptr)(handles.size() * sizeof(GLuint64)), handles.data(), (GLintptr)(dirtyBeg * sizeof(GLuint64)));
+	}
+
+	_ctx->bindBuffer(m_buffer);
+}
+
+// PRIVATE
+
+TextureTable::TextureTable(int _capacity)
+	: m_capacity(_capacity)
+	, m_count(0)
+	, m_buffer(nullptr)
+{
+	m_entries.reserve(_capacity);
+}
+
+TextureTable::~TextureTable()
+{
+	for (auto& entry : m_entries) {
+		if (entry.m_texture) {
+			Texture::Release(entry.m_texture);
+		}
+	}
+	if (m_buffer) {
+		Buffer::Destroy(m_buffer);
+	}
+}
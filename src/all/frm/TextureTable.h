@@ -0,0 +1,69 @@
+#pragma once
+#ifndef frm_TextureTable_h
+#define frm_TextureTable_h
+
+#include <frm/def.h>
+#include <frm/gl.h>
+
+#include <EASTL/hash_map.h>
+#include <EASTL/vector.h>
+
+namespace frm {
+
+////////////////////////////////////////////////////////////////////////////////
+// TextureTable
+// Table of 2d textures indexed from shaders (e.g. via a per-draw material
+// index), which replaces per-draw texture binds. Include
+// shaders/TextureTable.glsl and sample via TextureTable_Get(index).
+// - If Texture::GetBindless(), the table is an SSBO of resident 64-bit handles
+//   (_bfTextureTable), bind() binds only the buffer.
+// - Otherwise bind() falls back to binding each texture to an element of the
+//   sampler array uTextureTable[], in which case only the first
+//   kFallbackCount entries are accessible and the index must be dynamically
+//   uniform.
+// - The table holds a reference to each texture (hence textures stay resident
+//   while they're in the table). Adding a texture twice returns the same index.
+////////////////////////////////////////////////////////////////////////////////
+class TextureTable
+{
+public:
+	static const int kFallbackCount = 16; // Must match TextureTable_kFallbackCount (TextureTable.glsl).
+
+	static TextureTable* Create(int _capacity = 1024);
+	static void Destroy(TextureTable*& _inst_);
+
+	// Add _texture to the table, return its index or -1 if the table is full.
+	int      add(Texture* _texture);
+	// Remove a reference to the texture at _index (the entry is freed when the last reference is removed).
+	void     remove(int _index);
+
+	// Bind the table to the current shader. Call after GlContext::setShader().
+	void     bind(GlContext* _ctx);
+
+	Texture* getTexture(int _index) const  { return m_entries[_index].m_texture; }
+	int      getCapacity() const           { return m_capacity; }
+	int      getCount() const              { return m_count; }
+
+private:
+	struct Entry
+	{
+		Texture* m_texture;
+		GLuint64 m_handle;    // Handle in the buffer, compared with Texture::getBindlessHandle() to detect changes.
+		int      m_refCount;
+	};
+
+	int                            m_capacity;
+	int                            m_count;
+	eastl::vector<Entry>           m_entries;
+	eastl::vector<int>             m_freeList;
+	eastl::hash_map<Texture*, int> m_indexMap;
+	Buffer*                        m_buffer;    // Created by the first call to bind() if bindless is enabled.
+
+	TextureTable(int _capacity);
+	~TextureTable();
+
+}; // class TextureTable
+
+} // namespace frm
+
+#endif // frm_TextureTable_h
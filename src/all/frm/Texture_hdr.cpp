@@ -0,0 +1,215 @@
+#include <frm/Texture.h>
+
+#include <frm/ThreadPool.h>
+
+#include <apt/log.h>
+#include <apt/Image.h>
+
+#include <EASTL/vector.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define Texture_hdr_SSE 1
+	#include <emmintrin.h>
+#else
+	#define Texture_hdr_SSE 0
+#endif
+
+using namespace frm;
+using namespace apt;
+
+static const int kHdrRowsPerJob = 16; // Granularity of the parallel decode.
+
+// Scale for each RGBE exponent, ldexp(1, e - (128 + 8)).
+static const struct RgbeScaleTable
+{
+	float m_scale[256];
+
+	RgbeScaleTable()
+	{
+		m_scale[0] = 0.0f;
+		for (int i = 1; i < 256; ++i) {
+			m_scale[i] = (float)ldexp(1.0, i - 136);
+		}
+	}
+} g_rgbeScale;
+
+// Read a line from [_src,_end), advance _src past the newline. Return false if the end was reached.
+static bool ReadLine(const char*& _src, const char* _end, const char*& beg_, const char*& end_)
+{
+	if (_src >= _end) {
+		return false;
+	}
+	beg_ = _src;
+	while (_src < _end && *_src != '\n') {
+		++_src;
+	}
+	end_ = _src;
+	if (_src < _end) {
+		++_src;
+	}
+	return true;
+}
+
+// Return a pointer to the end of the scanline at _src, or nullptr if the data is invalid.
+static const uint8* SkipScanline(const uint8* _src, const uint8* _end, int _width)
+{
+	if (_width < 8 || _width > 0x7fff || _end - _src < 4 || _src[0] != 2 || _src[1] != 2 || (_src[2] & 0x80)) {
+	 // flat
+		return _end - _src >= _width * 4 ? _src + _width * 4 : nullptr;
+	}
+	if (((_src[2] << 8) | _src[3]) != _width) {
+		return nullptr;
+	}
+	_src += 4;
+	for (int c = 0; c < 4; ++c) {
+		for (int x = 0; x < _width; ) {
+			if (_src >= _end) {
+				return nullptr;
+			}
+			int count = *_src++;
+			if (count > 128) {
+				count -= 128;
+				++_src;
+			} else {
+				_src += count;
+			}
+			x += count;
+			if (count == 0 || x > _width) {
+				return nullptr;
+			}
+		}
+	}
+	return _src <= _end ? _src : nullptr;
+}
+
+// Decode the scanline at _src (validated by SkipScanline()) to RGBE.
+static void DecodeScanline(const uint8* _src, int _width, uint8* dst_)
+{
+	if (_width < 8 || _width > 0x7fff || _src[0] != 2 || _src[1] != 2 || (_src[2] & 0x80)) {
+		memcpy(dst_, _src, _width * 4);
+		return;
+	}
+	_src += 4;
+	for (int c = 0; c < 4; ++c) {
+		for (int x = 0; x < _width; ) {
+			int count = *_src++;
+			if (count > 128) {
+				count -= 128;
+				uint8 value = *_src++;
+				for (int i = 0; i < count; ++i) {
+					dst_[(x + i) * 4 + c] = value;
+				}
+			} else {
+				for (int i = 0; i < count; ++i) {
+					dst_[(x + i) * 4 + c] = *_src++;
+				}
+			}
+			x += count;
+		}
+	}
+}
+
+// Convert _count RGBE texels to RGB float.
+static void ConvertRgbe(const uint8* _src, int _count, float* dst_)
+{
+	int i = 0;
+	#if Texture_hdr_SSE
+	 // 4 texels per iteration, the last iteration stops short so that the 4-wide store doesn't overrun dst_
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 4 < _count; i += 4) {
+			__m128i rgbe = _mm_loadu_si128((const __m128i*)(_src + i * 4));
+			__m128i lo = _mm_unpacklo_epi8(rgbe, zero);
+			__m128i hi = _mm_unpackhi_epi8(rgbe, zero);
+			__m128 t0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+			__m128 t1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+			__m128 t2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+			__m128 t3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+			const uint8* e = _src + i * 4 + 3;
+			_mm_storeu_ps(dst_ + (i + 0) * 3, _mm_mul_ps(t0, _mm_set1_ps(g_rgbeScale.m_scale[e[0]])));
+			_mm_storeu_ps(dst_ + (i + 1) * 3, _mm_mul_ps(t1, _mm_set1_ps(g_rgbeScale.m_scale[e[4]])));
+			_mm_storeu_ps(dst_ + (i + 2) * 3, _mm_mul_ps(t2, _mm_set1_ps(g_rgbeScale.m_scale[e[8]])));
+			_mm_storeu_ps(dst_ + (i + 3) * 3, _mm_mul_ps(t3, _mm_set1_ps(g_rgbeScale.m_scale[e[12]])));
+		}
+	#endif
+	for (; i < _count; ++i) {
+		float scale = g_rgbeScale.m_scale[_src[i * 4 + 3]];
+		dst_[i * 3 + 0] = (float)_src[i * 4 + 0] * scale;
+		dst_[i * 3 + 1] = (float)_src[i * 4 + 1] * scale;
+		dst_[i * 3 + 2] = (float)_src[i * 4 + 2] * scale;
+	}
+}
+
+bool Texture::ReadHdr(Image& img_, const char* _srcData, uint _srcDataSize)
+{
+	const char* src = _srcData;
+	const char* end = _srcData + _srcDataSize;
+	const char* lineBeg;
+	const char* lineEnd;
+
+ // header
+	if (!ReadLine(src, end, lineBeg, lineEnd) || lineEnd - lineBeg < 2 || strncmp(lineBeg, "#?", 2) != 0) {
+		APT_LOG_ERR("Texture::ReadHdr: Invalid header");
+		return false;
+	}
+	for (;;) {
+		if (!ReadLine(src, end, lineBeg, lineEnd)) {
+			APT_LOG_ERR("Texture::ReadHdr: Unexpected end of file");
+			return false;
+		}
+		if (lineBeg == lineEnd) {
+			break;
+		}
+		static const char kFormat[] = "FORMAT=";
+		const size_t formatLen = sizeof(kFormat) - 1;
+		if ((size_t)(lineEnd - lineBeg) >= formatLen && strncmp(lineBeg, kFormat, formatLen) == 0) {
+			const char* fmt = lineBeg + formatLen;
+			if ((size_t)(lineEnd - fmt) < 15 || strncmp(fmt, "32-bit_rle_rgbe", 15) != 0) {
+				APT_LOG_ERR("Texture::ReadHdr: Unsupported format '%.*s'", (int)(lineEnd - fmt), fmt);
+				return false;
+			}
+		}
+	}
+
+ // resolution string, only the standard orientations are supported
+	char line[64] = {};
+	char yDir = 0;
+	int width = 0, height = 0;
+	if (ReadLine(src, end, lineBeg, lineEnd)) {
+		memcpy(line, lineBeg, APT_MIN((size_t)(lineEnd - lineBeg), sizeof(line) - 1));
+	}
+	if (sscanf(line, "%cY %d +X %d", &yDir, &height, &width) != 3 || (yDir != '-' && yDir != '+') || width <= 0 || height <= 0) {
+		APT_LOG_ERR("Texture::ReadHdr: Unsupported resolution string '%s'", line);
+		return false;
+	}
+
+ // find the start of each scanline (serial), the RLE data must be parsed to find the scanline size
+	eastl::vector<const uint8*> scanlines(height + 1);
+	scanlines[0] = (const uint8*)src;
+	for (int y = 0; y < height; ++y) {
+		scanlines[y + 1] = SkipScanline(scanlines[y], (const uint8*)end, width);
+		if (!scanlines[y + 1]) {
+			APT_LOG_ERR("Texture::ReadHdr: Invalid scanline data (%d)", y);
+			return false;
+		}
+	}
+
+ // decode + convert (parallel)
+	Image* ret = Image::Create2d(width, height, Image::Layout_RGB, DataType::Float32);
+	float* dst = (float*)ret->getRawImage(0, 0);
+	ThreadPool::ParallelFor((height + kHdrRowsPerJob - 1) / kHdrRowsPerJob, [&](int _i) {
+		eastl::vector<uint8> rgbe(width * 4);
+		for (int y = _i * kHdrRowsPerJob, yEnd = APT_MIN(y + kHdrRowsPerJob, height); y < yEnd; ++y) {
+			int dstY = yDir == '-' ? y : height - y - 1;
+			DecodeScanline(scanlines[y], width, rgbe.data());
+			ConvertRgbe(rgbe.data(), width, dst + (size_t)dstY * width * 3);
+		}
+	});
+	swap(img_, *ret);
+	Image::Destroy(ret);
+
+	return true;
+}
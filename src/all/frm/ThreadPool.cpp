@@ -0,0 +1,161 @@
+#include <frm/ThreadPool.h>
+
+#include <frm/Profiler.h>
+
+#include <apt/log.h>
+#include <apt/String.h>
+
+#include <EASTL/deque.h>
+#include <EASTL/vector.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace frm;
+using namespace apt;
+
+static std::mutex                    g_mutex;
+static std::condition_variable       g_jobAvailable;
+static std::condition_variable       g_idle;
+static eastl::deque<ThreadPool::Job> g_queue;
+static eastl::vector<std::thread>    g_threads;
+static int                           g_activeCount;  // jobs currently executing
+static bool                          g_stop;
+static thread_local bool             g_isWorker;
+
+static void WorkerMain(int _index)
+{
+	g_isWorker = true;
+	Profiler::SetCpuThreadName((const char*)String<16>("Worker %d", _index));
+	for (;;) {
+		ThreadPool::Job job;
+		{	std::unique_lock<std::mutex> lock(g_mutex);
+			g_jobAvailable.wait(lock, []{ return g_stop || !g_queue.empty(); });
+			if (g_queue.empty()) {
+				return; // g_stop and no more work
+			}
+			job = std::move(g_queue.front());
+			g_queue.pop_front();
+			++g_activeCount;
+		}
+
+		{	CPU_AUTO_MARKER("ThreadPool::Job");
+			job();
+		}
+
+		{	std::lock_guard<std::mutex> lock(g_mutex);
+			--g_activeCount;
+			if (g_activeCount == 0 && g_queue.empty()) {
+				g_idle.notify_all();
+			}
+		}
+	}
+}
+
+// PUBLIC
+
+void ThreadPool::Init(int _threadCount)
+{
+	if (!g_threads.empty()) {
+		return;
+	}
+	if (_threadCount <= 0) {
+		_threadCount = APT_MAX((int)std::thread::hardware_concurrency() - 1, 1);
+	}
+	APT_LOG("ThreadPool: %d threads", _threadCount);
+	g_stop = false;
+	for (int i = 0; i < _threadCount; ++i) {
+		g_threads.push_back(std::thread(WorkerMain, i));
+	}
+}
+
+void ThreadPool::Shutdown()
+{
+	{	std::lock_guard<std::mutex> lock(g_mutex);
+		g_stop = true;
+	}
+	g_jobAvailable.notify_all();
+	for (auto& thread : g_threads) {
+		thread.join();
+	}
+	g_threads.clear();
+}
+
+int ThreadPool::GetThreadCount()
+{
+	return (int)g_threads.size();
+}
+
+bool ThreadPool::IsWorkerThread()
+{
+	return g_isWorker;
+}
+
+void ThreadPool::Dispatch(Job&& _job)
+{
+	Init();
+	{	std::lock_guard<std::mutex> lock(g_mutex);
+		g_queue.push_back(std::move(_job));
+	}
+	g_jobAvailable.notify_one();
+}
+
+void ThreadPool::ParallelFor(int _count, const IndexJob& _job)
+{
+	if (_count <= 0) {
+		return;
+	}
+	if (_count == 1) {
+		_job(0);
+		return;
+	}
+	Init();
+
+ // shared state outlives this call in case a helper starts after all indices were consumed
+	struct State
+	{
+		IndexJob                m_job;
+		int                     m_count;
+		std::atomic<int>        m_next;
+		std::atomic<int>        m_done;
+		std::mutex              m_mutex;
+		std::condition_variable m_complete;
+
+		void run()
+		{
+			int n = 0;
+			for (int i = m_next++; i < m_count; i = m_next++) {
+				m_job(i);
+				++n;
+			}
+			if (n > 0 && (m_done += n) == m_count) {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_complete.notify_all();
+			}
+		}
+	};
+	std::shared_ptr<State> state = std::make_shared<State>();
+	state->m_job   = _job;
+	state->m_count = _count;
+	state->m_next  = 0;
+	state->m_done  = 0;
+
+	int helperCount = APT_MIN(_count - 1, GetThreadCount());
+	for (int i = 0; i < helperCount; ++i) {
+		Dispatch([state]{ state->run(); });
+	}
+	state->run();
+
+	std::unique_lock<std::mutex> lock(state->m_mutex);
+	state->m_complete.wait(lock, [&state]{ return state->m_done == state->m_count; });
+}
+
+void ThreadPool::WaitIdle()
+{
+	APT_ASSERT(!IsWorkerThread());
+	std::unique_lock<std::mutex> lock(g_mutex);
+	g_idle.wait(lock, []{ return g_queue.empty() && g_activeCount == 0; });
+}
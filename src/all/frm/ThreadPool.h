@@ -0,0 +1,50 @@
+#pragma once
+#ifndef frm_ThreadPool_h
+#define frm_ThreadPool_h
+
+#include <frm/def.h>
+
+#include <functional>
+
+namespace frm {
+
+////////////////////////////////////////////////////////////////////////////////
+// ThreadPool
+// Process-wide pool of worker threads for CPU work (file decoding, mip
+// generation, compression, etc.). Jobs must not make GL calls.
+// - Init() is called implicitly by the first Dispatch()/ParallelFor() if
+//   required.
+// - ParallelFor() may be called from a worker thread; the calling thread
+//   participates, hence nested calls can't deadlock.
+////////////////////////////////////////////////////////////////////////////////
+class ThreadPool
+{
+public:
+	typedef std::function<void()>    Job;
+	typedef std::function<void(int)> IndexJob;
+
+	// Start _threadCount workers (if 0, one less than the number of hardware threads).
+	static void Init(int _threadCount = 0);
+
+	// Wait for all pending jobs to complete and join the workers.
+	static void Shutdown();
+
+	static int  GetThreadCount();
+
+	// Return true if the calling thread is a worker.
+	static bool IsWorkerThread();
+
+	// Push _job onto the queue, return immediately.
+	static void Dispatch(Job&& _job);
+
+	// Call _job(i) for i in [0,_count), return when all calls completed.
+	static void ParallelFor(int _count, const IndexJob& _job);
+
+	// Block until the queue is empty and all workers are idle.
+	static void WaitIdle();
+
+}; // class ThreadPool
+
+} // namespace frm
+
+#endif // frm_ThreadPool_h
@@ -34,10 +34,12 @@ namespace frm {
 	class  App;
 	class  AppSample;
 	class  AppSample3d;
+	class  Benchmark;
 	class  Buffer;
 	class  Camera;
 	class  Device;
 	class  Framebuffer;
+	class  FrameCapture;
 	class  Gamepad;
 	class  GlContext;
 	class  Keyboard;
@@ -64,6 +66,7 @@ namespace frm {
 	class  SkeletonAnimationTrack;
 	class  SplinePath;
 	class  Texture;
+	class  TextureArrayPool;
 	class  TextureAtlas;
 	struct TextureView;
 	class  ValueCurve;
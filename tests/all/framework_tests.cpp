@@ -9,23 +9,31 @@
 #include <frm/Input.h>
 #include <frm/Mesh.h>
 #include <frm/MeshData.h>
+#include <frm/MipGenerator.h>
 #include <frm/Profiler.h>
 #include <frm/Property.h>
 #include <frm/Shader.h>
 #include <frm/SkeletonAnimation.h>
 #include <frm/Spline.h>
 #include <frm/Texture.h>
+#include <frm/TextureAtlas.h>
+#include <frm/TextureCompressor.h>
+#include <frm/ThreadPool.h>
 #include <frm/ValueCurve.h>
 #include <frm/Window.h>
 #include <frm/XForm.h>
 
 #include <apt/ArgList.h>
+#include <apt/File.h>
+#include <apt/Image.h>
 
 #include <imgui/imgui.h>
 #include <imgui/imgui_internal.h>
 
 #include <EASTL/vector.h>
 
+#include <atomic>
+
 using namespace frm;
 using namespace apt;
 
@@ -297,6 +305,246 @@ public:
 			ImGui::TreePop();
 		}
 
+		//ImGui::SetNextTreeNodeOpen(true, ImGuiSetCond_Once);
+		if (ImGui::TreeNode("Mipmap Generation")) {
+			static int   filter      = MipGenerator::Filter_Kaiser;
+			static int   sizeLog2    = 11;
+			static bool  srgb        = true;
+			static bool  serial      = false;
+			static float alphaCutoff = 0.0f;
+			static int   runCount    = 4;
+			static double avg        = 0.0;
+			ImGui::Combo("Filter", &filter, "Box\0Kaiser\0Lanczos\0");
+			ImGui::SliderInt("Size Log2", &sizeLog2, 4, 13);
+			ImGui::Checkbox("sRGB", &srgb);
+			ImGui::SameLine();
+			ImGui::Checkbox("Serial", &serial);
+			ImGui::SliderFloat("Alpha Cutoff", &alphaCutoff, 0.0f, 1.0f);
+			ImGui::SliderInt("Run Count", &runCount, 1, 16);
+			int size = 1 << sizeLog2;
+			if (ImGui::Button("Run")) {
+				Image* img = Image::Create2d(size, size, Image::Layout_RGBA, DataType::Uint8N, Texture::GetMaxMipCount(size, size));
+				uint8* raw = (uint8*)img->getRawImage(0, 0);
+				uint32 rnd = 0x9e3779b9;
+				for (int i = 0, n = size * size * 4; i < n; ++i) {
+					rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5;
+					raw[i] = (uint8)rnd;
+				}
+				uint32 flags = (srgb ? MipGenerator::Flag_Srgb : 0) | (serial ? MipGenerator::Flag_Serial : 0);
+				Timestamp t = Time::GetTimestamp();
+				for (int i = 0; i < runCount; ++i) {
+					MipGenerator::Generate(*img, (MipGenerator::Filter)filter, flags, alphaCutoff);
+				}
+				avg = (Time::GetTimestamp() - t).asMilliseconds() / (double)runCount;
+				Image::Destroy(img);
+			}
+			if (avg > 0.0) {
+				ImGui::Text("%s %dx%d: %.2fms (%.1f MPix/s)", MipGenerator::GetFilterName((MipGenerator::Filter)filter), size, size, (float)avg, (float)((double)size * size / (avg * 1000.0)));
+			}
+
+			ImGui::TreePop();
+		}
+
+		//ImGui::SetNextTreeNodeOpen(true, ImGuiSetCond_Once);
+		if (ImGui::TreeNode("Block Compression")) {
+			static FileSystem::PathStr path("textures/baboon.png");
+			static int    format  = TextureCompressor::Format_Count; // auto
+			static int    quality = TextureCompressor::Quality_Normal;
+			static bool   serial  = false;
+			static double ms      = 0.0;
+			static double psnr    = 0.0;
+			static int    texels  = 0;
+			static TextureCompressor::Format usedFormat;
+			ImGui::InputText("Path", path, path.getCapacity());
+			ImGui::Combo("Format", &format, "BC1\0BC3\0BC4\0BC5\0BC6H\0BC7\0Auto\0");
+			ImGui::Combo("Quality", &quality, "Fast\0Normal\0High\0");
+			ImGui::Checkbox("Serial", &serial);
+			if (ImGui::Button("Run")) {
+				ms = 0.0;
+				File f;
+				Image img;
+				if (FileSystem::Read(f, (const char*)path) && Image::Read(img, f)) {
+					usedFormat = (TextureCompressor::Format)format;
+					if (format != TextureCompressor::Format_Count || TextureCompressor::ChooseFormat(img, usedFormat)) {
+						Timestamp t = Time::GetTimestamp();
+						Image* compressed = TextureCompressor::Compress(img, usedFormat, (TextureCompressor::Quality)quality, serial ? TextureCompressor::Flag_Serial : 0);
+						ms = (Time::GetTimestamp() - t).asMilliseconds();
+						if (compressed) {
+							psnr = TextureCompressor::ComputePsnr(img, *compressed);
+							texels = (int)(img.getWidth() * img.getHeight());
+							Image::Destroy(compressed);
+						} else {
+							ms = 0.0;
+						}
+					}
+				}
+			}
+			if (ms > 0.0) {
+				ImGui::Text("%s %s: %.2fms (%.1f MPix/s), PSNR %.2fdB", TextureCompressor::GetFormatName(usedFormat), TextureCompressor::GetQualityName((TextureCompressor::Quality)quality), (float)ms, (float)(texels / (ms * 1000.0)), (float)psnr);
+			}
+
+			ImGui::TreePop();
+		}
+
+		//ImGui::SetNextTreeNodeOpen(true, ImGuiSetCond_Once);
+		if (ImGui::TreeNode("Texture Atlas")) {
+		 // many small regions in a mipmapped atlas, fill then free/realloc half the regions repeatedly
+			static int   sizeLog2    = 11;
+			static int   maxRegion   = 64;
+			static int   churnCount  = 16;
+			static float occupancy[TextureAtlas::Allocator_Count][2];
+			static int   regionCount[TextureAtlas::Allocator_Count];
+			static int   errorCount[TextureAtlas::Allocator_Count];
+			static double ms[TextureAtlas::Allocator_Count];
+			static bool  hasResult   = false;
+			ImGui::SliderInt("Size Log2", &sizeLog2, 8, 13);
+			ImGui::SliderInt("Max Region", &maxRegion, 4, 256);
+			ImGui::SliderInt("Churn Count", &churnCount, 0, 64);
+			if (ImGui::Button("Run")) {
+				const int size = 1 << sizeLog2;
+				const int mipCount = Texture::GetMaxMipCount(size, size);
+				for (int allocator = 0; allocator < TextureAtlas::Allocator_Count; ++allocator) {
+					TextureAtlas* atlas = TextureAtlas::Create(size, size, GL_RGBA8, mipCount, (TextureAtlas::Allocator)allocator);
+					eastl::vector<TextureAtlas::Region*> regions;
+					eastl::vector<uint8> used((size_t)size * size, 0);
+					uint32 rnd = 0x9e3779b9;
+					auto rand = [&rnd](int _n) { rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5; return (int)(rnd % (uint32)_n); };
+					errorCount[allocator] = 0;
+				 // the region must be aligned at every mip it uses and mustn't overlap another region
+					auto mark = [&](TextureAtlas::Region* _region, uint8 _value) {
+						int x = (int)(_region->m_uvBias.x * size);
+						int y = (int)(_region->m_uvBias.y * size);
+						int w = (int)(_region->m_uvScale.x * size + 0.5f);
+						int h = (int)(_region->m_uvScale.y * size + 0.5f);
+						int align = 1 << APT_MAX(APT_MIN(_region->m_lodMax, mipCount - 1), 0);
+						if (_value && (x % align != 0 || y % align != 0)) {
+							++errorCount[allocator];
+						}
+						for (int i = y; i < y + h; ++i) {
+							for (int j = x; j < x + w; ++j) {
+								if (_value && used[i * size + j]) {
+									++errorCount[allocator];
+								}
+								used[i * size + j] = _value;
+							}
+						}
+					};
+					auto fill = [&]() {
+						for (int failCount = 0; failCount < 32; ) {
+							TextureAtlas::Region* region = atlas->alloc(4 + rand(maxRegion - 3), 4 + rand(maxRegion - 3));
+							if (region) {
+								mark(region, 1);
+								regions.push_back(region);
+							} else {
+								++failCount;
+							}
+						}
+					};
+					Timestamp t = Time::GetTimestamp();
+					fill();
+					occupancy[allocator][0] = atlas->getOccupancy();
+					for (int i = 0; i < churnCount; ++i) {
+						for (int j = (int)regions.size() / 2; j > 0; --j) {
+							int k = rand((int)regions.size());
+							mark(regions[k], 0);
+							atlas->free(regions[k]);
+							regions[k] = regions.back();
+							regions.pop_back();
+						}
+						fill();
+					}
+					ms[allocator] = (Time::GetTimestamp() - t).asMilliseconds();
+					occupancy[allocator][1] = atlas->getOccupancy();
+					regionCount[allocator] = (int)regions.size();
+					for (TextureAtlas::Region* region : regions) {
+						atlas->free(region);
+					}
+					TextureAtlas::Destroy(atlas);
+				}
+				hasResult = true;
+			}
+			if (hasResult) {
+				for (int allocator = 0; allocator < TextureAtlas::Allocator_Count; ++allocator) {
+					ImGui::Text("%-10s %d regions, %.1f%% occupancy (%.1f%% after churn), %d errors, %.2fms",
+						TextureAtlas::GetAllocatorName((TextureAtlas::Allocator)allocator),
+						regionCount[allocator],
+						occupancy[allocator][0] * 100.0f,
+						occupancy[allocator][1] * 100.0f,
+						errorCount[allocator],
+						(float)ms[allocator]
+						);
+				}
+			}
+
+			ImGui::TreePop();
+		}
+
+		//ImGui::SetNextTreeNodeOpen(true, ImGuiSetCond_Once);
+		if (ImGui::TreeNode("Profiler Markers")) {
+		 // push/pop pairs are spread over several frames to stay within the per-frame marker limit
+			static int    pairCount   = 512;
+			static int    frameCount  = 60;
+			static bool   parallel    = false;
+			static int    framesLeft  = 0;
+			static uint64 totalTicks  = 0;
+			static double totalPairs  = 0.0;
+			static double timestampNs = 0.0;
+			static uint   dropCount   = 0;
+			auto getDropCount = []() {
+				uint ret = 0;
+				for (uint i = 0, n = Profiler::GetCpuThreadCount(); i < n; ++i) {
+					ret += Profiler::GetCpuThreadDropCount(i);
+				}
+				return ret;
+			};
+			ImGui::SliderInt("Pairs/Frame", &pairCount, 1, 4096);
+			ImGui::SliderInt("Frame Count", &frameCount, 1, 600);
+			ImGui::Checkbox("ParallelFor", &parallel);
+			if (ImGui::Button("Run") && framesLeft == 0) {
+				framesLeft = frameCount;
+				totalTicks = 0;
+				totalPairs = 0.0;
+				dropCount  = getDropCount();
+			 // each pair reads 2 timestamps
+				volatile uint64 sink = 0;
+				Timestamp t = Time::GetTimestamp();
+				for (int i = 0; i < 10000; ++i) {
+					sink += Time::GetTimestamp().getRaw();
+				}
+				timestampNs = (Time::GetTimestamp() - t).asMicroseconds() * 1000.0 / 10000.0;
+			}
+			if (framesLeft > 0) {
+				--framesLeft;
+				auto run = [](int) {
+					Timestamp t = Time::GetTimestamp();
+					for (int i = 0; i < pairCount; ++i) {
+						Profiler::PushCpuMarker("Profiler Bench");
+						Profiler::PopCpuMarker("Profiler Bench");
+					}
+					return (Time::GetTimestamp() - t).getRaw();
+				};
+				if (parallel) {
+					int jobCount = ThreadPool::GetThreadCount() + 1;
+					std::atomic<uint64> ticks(0);
+					ThreadPool::ParallelFor(jobCount, [&](int _i) { ticks += run(_i); });
+					totalTicks += ticks;
+					totalPairs += (double)pairCount * jobCount;
+				} else {
+					totalTicks += run(0);
+					totalPairs += (double)pairCount;
+				}
+				if (framesLeft == 0) {
+					dropCount = getDropCount() - dropCount;
+				}
+			}
+			if (framesLeft == 0 && totalPairs > 0.0) {
+				double ns = Timestamp(totalTicks).asMicroseconds() * 1000.0 / totalPairs;
+				ImGui::Text("%.1fns/pair, %.1fns excluding timestamps (%.1fns each), %u dropped", (float)ns, (float)(ns - timestampNs * 2.0), (float)timestampNs, dropCount);
+			}
+
+			ImGui::TreePop();
+		}
+
 		return true;
 	}
 
@@ -437,7 +685,20 @@ AppSampleTest s_app;
 int main(int _argc, char** _argv)
 {
 	AppSample* app = AppSample::GetCurrent();
-	if (!app->init(ArgList(_argc, _argv))) {
+	ArgList args(_argc, _argv);
+	if (args.find("precook")) {
+	 // batch mode, e.g. -precook common/textures
+		return app->precook(args) ? 0 : 1;
+	}
+	if (args.find("profilerConvert")) {
+	 // batch mode, e.g. -profilerConvert Profiler.bin
+		return app->convertProfilerCapture(args) ? 0 : 1;
+	}
+	if (args.find("benchmarkCompare")) {
+	 // batch mode, e.g. -benchmarkCompare Benchmark.json Baseline.json
+		return app->compareBenchmark(args) ? 0 : 1;
+	}
+	if (!app->init(args)) {
 		APT_ASSERT(false);
 		return 1;
 	}
@@ -453,5 +714,5 @@ int main(int _argc, char** _argv)
 	}
 	app->shutdown();
 
-	return 0;
+	return app->getExitCode();
 }